@@ -0,0 +1,121 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// Measures how well report batches compress with each gaus_compression_t codec and level, and what it costs in CPU.
+//
+// The batches have the shape gaus_report sends: generic metric reports with a handful of v_ints, v_floats and
+// v_strings each, so key names repeat in every report.  No server is needed.
+//
+// Usage: compression_bench [reports-per-batch] [iterations]
+
+#include "compression.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *int_names[] = {"cpu_load", "mem_free_kb", "rssi", "uptime_s", "reboots"};
+static const char *float_names[] = {"temperature", "voltage", "latitude", "longitude"};
+static const char *string_names[] = {"network", "firmware"};
+
+static void append(char **buffer, size_t *length, size_t *capacity, const char *fmt, ...)
+__attribute__((format(printf, 4, 5)));
+
+static void append(char **buffer, size_t *length, size_t *capacity, const char *fmt, ...) {
+  va_list args;
+  for (;;) {
+    va_start(args, fmt);
+    int needed = vsnprintf(*buffer + *length, *capacity - *length, fmt, args);
+    va_end(args);
+    if ((size_t) needed < *capacity - *length) {
+      *length += needed;
+      return;
+    }
+    *capacity = (*capacity + needed) * 2;
+    if (!(*buffer = realloc(*buffer, *capacity))) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+}
+
+static char *create_batch(unsigned int report_count, size_t *length) {
+  size_t capacity = 4096;
+  char *batch = malloc(capacity);
+  *length = 0;
+
+  append(&batch, length, &capacity, "{\"version\":\"1.0.0\",\"header\":{\"ts\":\"2018-01-01T00:00:00Z\"},\"data\":[");
+  for (unsigned int i = 0; i < report_count; i++) {
+    append(&batch, length, &capacity, "%s{\"type\":\"event.generic.metrics\",\"ts\":\"2018-01-01T00:%02u:%02u.%03uZ\"",
+           i ? "," : "", (i / 60) % 60, i % 60, (i * 37) % 1000);
+    append(&batch, length, &capacity, ",\"v_ints\":[");
+    for (size_t j = 0; j < sizeof(int_names) / sizeof(int_names[0]); j++) {
+      append(&batch, length, &capacity, "%s{\"%s\":%d}", j ? "," : "", int_names[j], rand() % 100000);
+    }
+    append(&batch, length, &capacity, "],\"v_floats\":[");
+    for (size_t j = 0; j < sizeof(float_names) / sizeof(float_names[0]); j++) {
+      append(&batch, length, &capacity, "%s{\"%s\":%f}", j ? "," : "", float_names[j], rand() / (double) RAND_MAX);
+    }
+    append(&batch, length, &capacity, "],\"v_strings\":[");
+    for (size_t j = 0; j < sizeof(string_names) / sizeof(string_names[0]); j++) {
+      append(&batch, length, &capacity, "%s{\"%s\":\"%s\"}", j ? "," : "", string_names[j], rand() % 2 ? "lte" : "3g");
+    }
+    append(&batch, length, &capacity, "]}");
+  }
+  append(&batch, length, &capacity, "]}");
+  return batch;
+}
+
+static double cpu_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  unsigned int report_count = argc > 1 ? (unsigned int) atoi(argv[1]) : 100;
+  unsigned int iterations = argc > 2 ? (unsigned int) atoi(argv[2]) : 200;
+  const struct {
+    gaus_compression_t codec;
+    const char *name;
+  } codecs[] = {
+      {GAUS_COMPRESSION_GZIP, "gzip"},
+      {GAUS_COMPRESSION_DEFLATE, "deflate"}
+  };
+  const int levels[] = {1, 6, 9};
+  size_t batch_length;
+
+  srand(1);
+  char *batch = create_batch(report_count, &batch_length);
+  printf("batch of %u reports: %zu bytes, %u iterations\n", report_count, batch_length, iterations);
+  printf("%-8s %5s %12s %8s %14s\n", "codec", "level", "compressed", "ratio", "cpu us/batch");
+
+  for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++) {
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+      size_t compressed_length = 0;
+      double start = cpu_seconds();
+      for (unsigned int i = 0; i < iterations; i++) {
+        char *compressed = NULL;
+        if (compression_encode(codecs[c].codec, levels[l], batch, batch_length, &compressed, &compressed_length)) {
+          fprintf(stderr, "compression failed\n");
+          return 1;
+        }
+        free(compressed);
+      }
+      double elapsed = cpu_seconds() - start;
+      printf("%-8s %5d %12zu %7.1fx %14.1f\n", codecs[c].name, levels[l], compressed_length,
+             batch_length / (double) compressed_length, elapsed * 1e6 / iterations);
+    }
+  }
+
+  free(batch);
+  return 0;
+}
@@ -0,0 +1,125 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Compares gaus_report throughput over HTTP/1.1 and over multiplexed HTTP/2.
+//
+// Run it against a local stand-in server that answers every POST with `200 {}` over TLS with HTTP/2 enabled, for
+// example nginx with:
+//
+//   server {
+//     listen 8443 ssl http2;
+//     ssl_certificate cert.pem;
+//     ssl_certificate_key key.pem;
+//     location / { return 200 '{}'; }
+//   }
+//
+// Usage: http2_bench <server-url> [threads] [reports-per-thread] [ca-path]
+// The library must be built with GAUS_WITH_NGHTTP2 (and GAUS_NO_CA_CHECK for self signed certificates without ca-path).
+
+#include <gaus/gaus_client.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  unsigned int reports;
+  unsigned int errors;
+} worker_t;
+
+static gaus_session_t session = {
+    "benchDeviceGUID",
+    "benchProductGUID",
+    "benchToken"
+};
+
+static void *report_worker(void *arg) {
+  worker_t *worker = arg;
+  gaus_report_header_t header = {"2018-01-01T00:00:00Z"};
+  gaus_report_t report;
+  memset(&report, 0, sizeof(report));
+  report.report_type = GAUS_REPORT_GENERIC;
+  report.report.generic.type = "bench";
+  report.report.generic.ts = "2018-01-01T00:00:00Z";
+
+  for (unsigned int i = 0; i < worker->reports; i++) {
+    gaus_error_t *error = gaus_report(&session, 0, NULL, &header, 1, &report);
+    if (error) {
+      worker->errors++;
+      free(error->description);
+      free(error);
+    }
+  }
+  return NULL;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run(const char *server_url, const char *ca_path, bool http2, unsigned int thread_count,
+               unsigned int reports_per_thread) {
+  gaus_initialization_options_t options;
+  memset(&options, 0, sizeof(options));
+  options.ca_path = ca_path;
+  options.enable_http2 = http2;
+  //Let every thread have a request in flight, HTTP/2 still uses a single connection.
+  options.max_connections_per_host = thread_count;
+
+  gaus_error_t *error = gaus_global_init(server_url, &options);
+  if (error) {
+    fprintf(stderr, "gaus_global_init failed: %s\n", error->description);
+    free(error->description);
+    free(error);
+    return 1;
+  }
+
+  pthread_t *threads = calloc(thread_count, sizeof(pthread_t));
+  worker_t *workers = calloc(thread_count, sizeof(worker_t));
+  double start = now_seconds();
+  for (unsigned int i = 0; i < thread_count; i++) {
+    workers[i].reports = reports_per_thread;
+    pthread_create(&threads[i], NULL, report_worker, &workers[i]);
+  }
+  unsigned int errors = 0;
+  for (unsigned int i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+    errors += workers[i].errors;
+  }
+  double elapsed = now_seconds() - start;
+  gaus_global_cleanup();
+
+  unsigned int total = thread_count * reports_per_thread;
+  printf("%-8s %u reports in %.3f s: %.1f reports/s, %u errors\n", http2 ? "HTTP/2" : "HTTP/1.1", total, elapsed,
+         total / elapsed, errors);
+  free(threads);
+  free(workers);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <server-url> [threads] [reports-per-thread] [ca-path]\n", argv[0]);
+    return 1;
+  }
+  const char *server_url = argv[1];
+  unsigned int thread_count = argc > 2 ? (unsigned int) strtoul(argv[2], NULL, 10) : 16;
+  unsigned int reports_per_thread = argc > 3 ? (unsigned int) strtoul(argv[3], NULL, 10) : 100;
+  const char *ca_path = argc > 4 ? argv[4] : NULL;
+
+  if (run(server_url, ca_path, false, thread_count, reports_per_thread) != 0) {
+    return 1;
+  }
+  return run(server_url, ca_path, true, thread_count, reports_per_thread);
+}
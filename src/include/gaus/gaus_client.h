@@ -59,7 +59,8 @@ gaus_version_t gaus_client_library_version(void);
  * program starts, while it is still only one thread and before it uses libgaus at all. Call gaus_global_cleanup
  * immediately before the program exits, when the program is again only one thread and after its last use of libgaus.
  *
- * The serverUrl provided will be used for all subsequent gaus calls.
+ * The serverUrl provided will be used for all subsequent gaus calls, other backends can be reached through clients
+ * created by ::gaus_client_create.
  *
  * Parameters:
  * \param[in] serverUrl: A weak pointer to a null terminated url.  For example "http://example.gaus.com"
@@ -141,8 +142,12 @@ gaus_error_t *gaus_authenticate(const char *device_access, const char *device_se
  * Check Gaus to find any available updates for this device.  This is a synchronous blocking call. The caller is
  * responsible for processing the updates appropriately after the call returns.
  *
+ * The library remembers the last reply per device and filter set.  If the server tags its reply with an ETag or
+ * Last-Modified header, later checks ask only for changes and return a copy of the remembered updates when the server
+ * answers that nothing changed.
+ *
  * Out parameters are only valid if return value is `NULL`.  To prevent memory leaks out parameters (and their contents)
- * should always be freed by the caller.
+ * should always be freed by the caller with ::gaus_updates_free.
  *
  * \param[in] session: A weak pointer to a session generated by gaus backend during \c ::gaus_authenticate call.
  * \param[in] filter_count: An integer specifying the number of filters in the filters parameter.
@@ -153,7 +158,7 @@ gaus_error_t *gaus_authenticate(const char *device_access, const char *device_se
  * \param[out] updates: A strong pointer to an array of gaus_update_t updates.  Each of these updates should be
  *   processed by the caller.  \c::gaus_check_for_updates assumes that no memory is currently allocated and will allocate
  *   memory as required to store the updates.  The caller is responsible for freeing both the array of updates, and its
- *   members.
+ *   members, with ::gaus_updates_free.  Later versions may add members, so do not free them one by one.
  *
  * \return gaus_error_t A strong pointer to an error describing what went wrong, or `NULL`.  The caller is responsible
  *   for freeing this memory if non null.
@@ -164,6 +169,119 @@ gaus_check_for_updates(const gaus_session_t *session, unsigned int filter_count,
                        unsigned int *update_count, gaus_update_t **updates);
 
 
+/*************************************************************//**
+ *
+ * \brief Check Gaus for updates, handing each to a callback as it arrives
+ *
+ * Like ::gaus_check_for_updates, but every update is passed to \p callback as soon as it has been read, so a large
+ * reply is never held in memory at once and the caller can act on the first updates before the last arrived.  The
+ * reply is not remembered and the request is never conditional.
+ *
+ * If an error is returned, updates already passed to \p callback may come from a reply that later turned out to be
+ * invalid.
+ *
+ * \param[in] session: A weak pointer to a session generated by gaus backend during \c ::gaus_authenticate call.
+ * \param[in] filter_count: An integer specifying the number of filters in the filters parameter.
+ * \param[in] filters: A weak pointer to an array of filters to be used to build the query string parameters.
+ * \param[in] callback: Called on the calling thread for each update, see \c ::gaus_update_callback_t.
+ * \param[in] user_data: Passed unchanged to \p callback.
+ *
+ * \return gaus_error_t A strong pointer to an error describing what went wrong, or `NULL`.  The caller is responsible
+ *   for freeing this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_check_for_updates_streamed(const gaus_session_t *session, unsigned int filter_count,
+                                const gaus_header_filter_t *filters, gaus_update_callback_t callback,
+                                void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief Free the members of an update
+ *
+ * Frees every member of \p update allocated by the library and sets them to `NULL`, the update itself is not freed.
+ *
+ * \param[in] update: A weak pointer to the update, may be `NULL`.
+ *
+ *************************************************************/
+void gaus_update_free(gaus_update_t *update);
+
+/*************************************************************//**
+ *
+ * \brief Free updates returned by ::gaus_check_for_updates
+ *
+ * Frees the members of each update, then the array itself.
+ *
+ * \param[in] update_count: The number of updates in \p updates.
+ * \param[in] updates: A strong pointer to the array of updates, may be `NULL`.
+ *
+ *************************************************************/
+void gaus_updates_free(unsigned int update_count, gaus_update_t *updates);
+
+/*************************************************************//**
+ *
+ * \brief Download the package of an update
+ *
+ * Download gaus_update_t::download_url of \p update to \p destination_path.  This is a synchronous blocking call.
+ *
+ * Transfers that break off are resumed with HTTP Range requests where they stopped.  Progress is kept in a small
+ * journal next to the destination, `<destination_path>.journal`, so a download interrupted by a reboot or a failed call
+ * also continues where it stopped when ::gaus_download_update is called again for the same update and destination.
+ * The journal is removed once the download is complete.  How often the data and the journal are synced to storage is
+ * set with gaus_download_options_t::sync_policy.  Room for the whole package is reserved before the first write where
+ * the file system supports it.
+ *
+ * Packages of more than 512 KiB are split into segments that are downloaded concurrently, over up to
+ * gaus_download_options_t::max_streams Range requests, into their place in the file.  The number of streams adapts to
+ * the throughput each of them gets, so a link with a high latency is filled without overloading a slow one.  If the
+ * server does not support ranges the package is downloaded over a single connection.  The journal of a segmented
+ * download covers the data up to the first incomplete segment, segments after it start over after a restart.
+ *
+ * The MD5 digest of the package is computed while it is written and compared to gaus_update_t::md5.  Segments that
+ * arrive ahead of the ones before them are read back once those are complete, everything else is never read back.
+ * A mismatch returns a #GAUS_CHECKSUM_ERROR, the file is then left as is and the next call downloads it again from the
+ * start.
+ *
+ * For `file` packages with a gaus_update_t::hash_tree_url, the tree is fetched first and checked against
+ * gaus_update_t::hash_tree_root.  Each chunk is then checked as soon as it arrived, on every stream, and a bad chunk
+ * is fetched again on its own instead of the whole package.  Only checked chunks are journaled, so a resumed download
+ * never builds on bad data, and an extraction that was fed a bad chunk starts over.  Segments are then read back
+ * once their chunks were checked.  If the tree cannot be fetched or does not match its root, the package is only
+ * checked as a whole.
+ *
+ * For updates with a `delta` package the patch is applied to gaus_download_options_t::base_path while it downloads,
+ * and \p destination_path receives the rebuilt version, checked against gaus_update_t::target_md5.  The base
+ * must not be \p destination_path.  Delta packages are not journaled, an interrupted one is downloaded again from the
+ * start.
+ *
+ * For `file` packages with a gaus_update_t::chunk_index_url, and a gaus_download_options_t::base_path or
+ * gaus_download_options_t::chunk_store_path to take chunks from, the package is assembled from chunks instead.  The
+ * base is split into chunks the way the package was, chunks of the package found there, in the store or already in
+ * \p destination_path are copied, and only the rest are downloaded, over several concurrent Range requests.  Every
+ * chunk is checked against the md5 in the index and the whole file against gaus_update_t::md5 afterwards.  If the
+ * index or Range requests cannot be used the package is downloaded as a whole.
+ *
+ * With a gaus_download_options_t::artifact_cache_path a `file` package found there is copied instead of downloaded,
+ * after checking it against gaus_update_t::md5, and a downloaded one is added to it.
+ *
+ * With a gaus_download_options_t::extract_path the file, a tar archive that may be gzip compressed, is also extracted
+ * into that directory while it downloads.  Decompression and extraction run on threads of their own, so installing
+ * overlaps with downloading, and a resumed download first extracts what it already has.  The extracted files can only
+ * be trusted once this returns `NULL`, after the md5 was checked.
+ *
+ * \param[in] session: A weak pointer to a session generated by gaus backend during \c ::gaus_authenticate call.
+ * \param[in] update: A weak pointer to the update to download, as returned by \c ::gaus_check_for_updates.  Only
+ *   updates with gaus_update_t::package_type `file` can be downloaded.
+ * \param[in] destination_path: A null terminated path of the file or block device to write the package to.
+ * \param[in] options: A weak pointer to options for this download, or `NULL` to use the defaults.
+ *
+ * \return gaus_error_t A strong pointer to an error describing what went wrong, or `NULL`.  The caller is responsible
+ *   for freeing this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_download_update(const gaus_session_t *session, const gaus_update_t *update,
+                                   const char *destination_path, const gaus_download_options_t *options);
+
 /*************************************************************//**
  *
  * \brief Report an update to gaus.
@@ -184,11 +302,410 @@ gaus_check_for_updates(const gaus_session_t *session, unsigned int filter_count,
 gaus_error_t *gaus_report(const gaus_session_t *session, unsigned int filter_count, const gaus_header_filter_t *filters,
                           const gaus_report_header_t *header, unsigned int report_count, const gaus_report_t *reports);
 
+/*************************************************************//**
+ *
+ * \brief Register a new device without blocking
+ *
+ * Asynchronous version of \c ::gaus_register.  The request is queued on the library I/O thread and this call returns
+ * immediately.  Once the request completes \p callback is called with the result.  All input parameters are copied
+ * before this call returns, the out parameters must stay valid until \p callback has been called.
+ *
+ * \param[in] callback: Called once the request completed, see \c ::gaus_completion_callback_t.
+ * \param[in] user_data: Passed unchanged to \p callback.
+ * \return gaus_error_t* A strong pointer to an error if the request could not be queued, in which case \p callback
+ *   is never called, or `NULL`.  The caller is responsible for freeing this memory if non null.
+ *
+ * See \c ::gaus_register for the remaining parameters.
+ *
+ *************************************************************/
+gaus_error_t *gaus_register_async(const char *product_access, const char *product_secret, const char *device_id,
+                                  char **device_access, char **device_secret, unsigned int *poll_interval_seconds,
+                                  gaus_completion_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief Authenticate a device without blocking
+ *
+ * Asynchronous version of \c ::gaus_authenticate.  The request is queued on the library I/O thread and this call
+ * returns immediately.  Once the request completes \p callback is called with the result.  All input parameters are
+ * copied before this call returns, \p session must stay valid until \p callback has been called.
+ *
+ * \param[in] callback: Called once the request completed, see \c ::gaus_completion_callback_t.
+ * \param[in] user_data: Passed unchanged to \p callback.
+ * \return gaus_error_t* A strong pointer to an error if the request could not be queued, in which case \p callback
+ *   is never called, or `NULL`.  The caller is responsible for freeing this memory if non null.
+ *
+ * See \c ::gaus_authenticate for the remaining parameters.
+ *
+ *************************************************************/
+gaus_error_t *gaus_authenticate_async(const char *device_access, const char *device_secret, gaus_session_t *session,
+                                      gaus_completion_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief Check Gaus for updates without blocking
+ *
+ * Asynchronous version of \c ::gaus_check_for_updates.  The request is queued on the library I/O thread and this call
+ * returns immediately.  Once the request completes \p callback is called with the result.  All input parameters are
+ * copied before this call returns, the out parameters must stay valid until \p callback has been called.
+ *
+ * \param[in] callback: Called once the request completed, see \c ::gaus_completion_callback_t.
+ * \param[in] user_data: Passed unchanged to \p callback.
+ * \return gaus_error_t* A strong pointer to an error if the request could not be queued, in which case \p callback
+ *   is never called, or `NULL`.  The caller is responsible for freeing this memory if non null.
+ *
+ * See \c ::gaus_check_for_updates for the remaining parameters.
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_check_for_updates_async(const gaus_session_t *session, unsigned int filter_count,
+                             const gaus_header_filter_t *filters, unsigned int *update_count, gaus_update_t **updates,
+                             gaus_completion_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief Report to gaus without blocking
+ *
+ * Asynchronous version of \c ::gaus_report.  The report is encoded and queued on the library I/O thread and this call
+ * returns immediately, so \p header and \p reports may be freed as soon as it returns.  Once the request completes
+ * \p callback is called with the result.
+ *
+ * \param[in] callback: Called once the request completed, see \c ::gaus_completion_callback_t.
+ * \param[in] user_data: Passed unchanged to \p callback.
+ * \return gaus_error_t* A strong pointer to an error if the request could not be queued, in which case \p callback
+ *   is never called, or `NULL`.  The caller is responsible for freeing this memory if non null.
+ *
+ * See \c ::gaus_report for the remaining parameters.
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_report_async(const gaus_session_t *session, unsigned int filter_count, const gaus_header_filter_t *filters,
+                  const gaus_report_header_t *header, unsigned int report_count, const gaus_report_t *reports,
+                  gaus_completion_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief Drive asynchronous calls from a host event loop
+ *
+ * By default asynchronous gaus_*_async calls are processed on a library owned I/O thread.  After this call they are
+ * instead processed on the thread of a host event loop (epoll, libuv, glib, ...) and no thread is started:
+ * - \c gaus_loop_options_t::socket_callback tells the host which sockets to watch for which events.
+ * - \c gaus_loop_options_t::timer_callback tells the host when to call ::gaus_loop_timeout.
+ * - The host calls ::gaus_loop_socket_action when a watched socket becomes ready.
+ *
+ * Completion callbacks of asynchronous calls are then called from within ::gaus_loop_socket_action and
+ * ::gaus_loop_timeout.  The loop callbacks must not call gaus_loop_* functions themselves, they should only update
+ * the watched sockets and timer.  Synchronous gaus_* calls still block.
+ *
+ * Asynchronous calls may be made from any thread.  The loop callbacks are then also called from that thread, never
+ * at the same time as a gaus_loop_* call runs on the loop thread.
+ *
+ * Must be called after ::gaus_global_init and before the first asynchronous call.  The setting lasts until
+ * ::gaus_global_cleanup.
+ *
+ * \param[in] options: A weak pointer to the callbacks to use, both callbacks are required.
+ * \return gaus_error_t* A strong pointer to an error if one occurred or `NULL`.  The caller is responsible for freeing
+ *   this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_loop_init(const gaus_loop_options_t *options);
+
+/*************************************************************//**
+ *
+ * \brief Tell the library that a socket watched for it is ready
+ *
+ * \param[in] fd: The socket, as passed to gaus_loop_options_t::socket_callback.
+ * \param[in] events: A mask of the gaus_loop_event_t that occurred on \p fd.
+ * \return gaus_error_t* A strong pointer to an error if one occurred or `NULL`.  The caller is responsible for freeing
+ *   this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_loop_socket_action(int fd, unsigned int events);
+
+/*************************************************************//**
+ *
+ * \brief Tell the library that the timer requested through gaus_loop_options_t::timer_callback expired
+ *
+ * \return gaus_error_t* A strong pointer to an error if one occurred or `NULL`.  The caller is responsible for freeing
+ *   this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_loop_timeout(void);
+
+/*************************************************************//**
+ *
+ * \brief Serve the artifact cache of a gateway to the devices behind it
+ *
+ * Starts a small HTTP/1.1 server on a thread of its own.  `GET` and `HEAD` requests for `/<md5>` are answered with the
+ * package kept under that md5 in gaus_cache_server_options_t::cache_path, Range requests included, so the devices can
+ * resume and split their downloads as they do with the gaus backend.  Packages are sent with `sendfile`, straight from
+ * the page cache to the socket.  Devices download from the gateway by using
+ * `http://<gateway>:<port>/<gaus_update_t::md5>` as gaus_update_t::download_url.
+ *
+ * Does not require ::gaus_global_init.
+ *
+ * \param[in] options: A weak pointer to the options of the server.
+ * \param[out] server: Set to the started server, stop it with ::gaus_cache_server_stop.
+ * \return gaus_error_t* A strong pointer to an error if one occurred or `NULL`.  The caller is responsible for freeing
+ *   this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_cache_server_start(const gaus_cache_server_options_t *options, gaus_cache_server_t **server);
+
+/*************************************************************//**
+ *
+ * \brief The TCP port a cache server listens on, useful when it was started with port 0
+ *
+ *************************************************************/
+unsigned short gaus_cache_server_port(const gaus_cache_server_t *server);
+
+/*************************************************************//**
+ *
+ * \brief Stop a cache server and free it
+ *
+ * Transfers in progress are broken off, devices resume them later.
+ *
+ * \param[in] server: A strong pointer to the server, may be `NULL`.
+ *
+ *************************************************************/
+void gaus_cache_server_stop(gaus_cache_server_t *server);
+
+/*************************************************************//**
+ *
+ * \brief Serve the packages of this device to its peers on the local network
+ *
+ * Serves gaus_peer_options_t::cache_path as ::gaus_cache_server_start does, on a free TCP port, and answers the peers
+ * asking for a package on the multicast group of \p options when the package is there.  Only packages that matched
+ * their md5 when they were downloaded are kept in the cache, and a peer checks the md5 again after its download.  A
+ * site rolling out an update to devices started this way downloads it from the gaus backend about once.
+ *
+ * Does not require ::gaus_global_init.
+ *
+ * \param[in] options: A weak pointer to the options of the peer.
+ * \param[out] peer: Set to the started peer, stop it with ::gaus_peer_stop.
+ * \return gaus_error_t* A strong pointer to an error if one occurred or `NULL`.  The caller is responsible for freeing
+ *   this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_peer_start(const gaus_peer_options_t *options, gaus_peer_t **peer);
+
+/*************************************************************//**
+ *
+ * \brief Stop serving peers and free the peer
+ *
+ * \param[in] peer: A strong pointer to the peer, may be `NULL`.
+ *
+ *************************************************************/
+void gaus_peer_stop(gaus_peer_t *peer);
+
+/*************************************************************//**
+ *
+ * \brief Start a worker downloading updates in the background, ahead of their installation
+ *
+ * The updates queued with ::gaus_prefetch_update are downloaded one at a time on a thread of the worker, over a single
+ * connection each.  They only take the bandwidth other transfers of the library leave: while any other request or
+ * download runs, a prefetch slows down to a trickle.  Downloads are resumable as with ::gaus_download_update, a
+ * prefetch interrupted by ::gaus_prefetch_stop or a restart continues where it was once queued again.
+ *
+ * Only one worker can run at a time.
+ *
+ * \param[in] options: A weak pointer to the options of the worker.
+ * \param[out] prefetcher: Set to the started worker, stop it with ::gaus_prefetch_stop.
+ * \return gaus_error_t* A strong pointer to an error if one occurred or `NULL`.  The caller is responsible for freeing
+ *   this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_prefetch_start(const gaus_prefetch_options_t *options, gaus_prefetcher_t **prefetcher);
+
+/*************************************************************//**
+ *
+ * \brief Queue an update found by ::gaus_check_for_updates for prefetching
+ *
+ * Once the package is in gaus_prefetch_options_t::store_path, ::gaus_download_update with that directory as
+ * gaus_download_options_t::artifact_cache_path copies it from there instead of downloading it.  Packages already in
+ * the store are not downloaded again.  Only `file` packages can be prefetched.  \p session and \p update are copied
+ * before this call returns.
+ *
+ * \param[in] prefetcher: A weak pointer to the worker.
+ * \param[in] session: A weak pointer to a session with a valid token.
+ * \param[in] update: A weak pointer to the update to prefetch.
+ * \param[in] callback: Called from the thread of the worker once the package is in the store, or with the error that
+ *   stopped it, see \c ::gaus_completion_callback_t.  May be `NULL`.
+ * \param[in] user_data: Passed unchanged to \p callback.
+ * \return gaus_error_t* A strong pointer to an error if the update could not be queued, in which case \p callback is
+ *   never called, or `NULL`.  The caller is responsible for freeing this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_prefetch_update(gaus_prefetcher_t *prefetcher, const gaus_session_t *session,
+                                   const gaus_update_t *update, gaus_completion_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief Stop prefetching and free the worker
+ *
+ * The running prefetch is stopped, its progress is kept for the next time it is queued.  The callbacks of the updates
+ * still queued are called with an error before this call returns.
+ *
+ * \param[in] prefetcher: A strong pointer to the worker, may be `NULL`.
+ *
+ *************************************************************/
+void gaus_prefetch_stop(gaus_prefetcher_t *prefetcher);
+
+/*************************************************************//**
+ *
+ * \brief Create a client of another gaus backend
+ *
+ * A client has its own server url, proxy, CA path, HTTP/2 and request compression settings, its own connections and
+ * its own statistics.  Calls made through gaus_client_* functions use them while the plain gaus_* calls keep using
+ * the settings passed to ::gaus_global_init, so several backends can be used from one process, from any number of
+ * threads.  The bandwidth limit, the DNS and TLS session cache and the I/O thread of asynchronous calls stay shared
+ * by the whole process, \c gaus_initialization_options_t::max_bandwidth is ignored here.
+ *
+ * Must be called after ::gaus_global_init.  Updates queued to a prefetcher through ::gaus_client_prefetch_update are
+ * downloaded with the settings of the client, which must then live until they completed.
+ *
+ * \param[in] serverUrl: A weak pointer to a null terminated url.  For example "http://example.gaus.com"
+ * \param[in] options: A weak pointer to the options of this client, or `NULL` for the defaults.
+ * \param[out] client: Set to a strong pointer to the client, free it with ::gaus_client_destroy.
+ * \return gaus_error_t* A strong pointer to an error describing what went wrong, or `NULL`.  The caller is responsible
+ *   for freeing this memory if non null.
+ *
+ *************************************************************/
+gaus_error_t *gaus_client_create(const char *serverUrl, const gaus_initialization_options_t *options,
+                                 gaus_client_t **client);
+
+/*************************************************************//**
+ *
+ * \brief Free a client and close its connections
+ *
+ * No call may be running through the client, asynchronous calls made through it must have completed.
+ *
+ * \param[in] client: A strong pointer to the client, may be `NULL`.
+ *
+ *************************************************************/
+void gaus_client_destroy(gaus_client_t *client);
+
+/*************************************************************//**
+ *
+ * \brief Read the counters of a client
+ *
+ * \param[in] client: A weak pointer to the client, or `NULL` for the one set up by ::gaus_global_init.
+ * \param[out] stats: Filled in with a snapshot of the counters.
+ *
+ *************************************************************/
+void gaus_client_get_stats(gaus_client_t *client, gaus_client_stats_t *stats);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_register through \p client
+ *
+ *************************************************************/
+gaus_error_t *gaus_client_register(gaus_client_t *client, const char *product_access, const char *product_secret,
+                                   const char *device_id, char **device_access, char **device_secret,
+                                   unsigned int *poll_interval_seconds);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_authenticate through \p client
+ *
+ *************************************************************/
+gaus_error_t *gaus_client_authenticate(gaus_client_t *client, const char *device_access, const char *device_secret,
+                                       gaus_session_t *session);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_check_for_updates through \p client
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_client_check_for_updates(gaus_client_t *client, const gaus_session_t *session, unsigned int filter_count,
+                              const gaus_header_filter_t *filters, unsigned int *update_count,
+                              gaus_update_t **updates);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_check_for_updates_streamed through \p client
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_client_check_for_updates_streamed(gaus_client_t *client, const gaus_session_t *session,
+                                       unsigned int filter_count, const gaus_header_filter_t *filters,
+                                       gaus_update_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_download_update through \p client
+ *
+ *************************************************************/
+gaus_error_t *gaus_client_download_update(gaus_client_t *client, const gaus_session_t *session,
+                                          const gaus_update_t *update, const char *destination_path,
+                                          const gaus_download_options_t *options);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_report through \p client
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_client_report(gaus_client_t *client, const gaus_session_t *session, unsigned int filter_count,
+                   const gaus_header_filter_t *filters, const gaus_report_header_t *header, unsigned int report_count,
+                   const gaus_report_t *reports);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_register_async through \p client
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_client_register_async(gaus_client_t *client, const char *product_access, const char *product_secret,
+                           const char *device_id, char **device_access, char **device_secret,
+                           unsigned int *poll_interval_seconds, gaus_completion_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_authenticate_async through \p client
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_client_authenticate_async(gaus_client_t *client, const char *device_access, const char *device_secret,
+                               gaus_session_t *session, gaus_completion_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_check_for_updates_async through \p client
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_client_check_for_updates_async(gaus_client_t *client, const gaus_session_t *session, unsigned int filter_count,
+                                    const gaus_header_filter_t *filters, unsigned int *update_count,
+                                    gaus_update_t **updates, gaus_completion_callback_t callback, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_report_async through \p client
+ *
+ *************************************************************/
+gaus_error_t *
+gaus_client_report_async(gaus_client_t *client, const gaus_session_t *session, unsigned int filter_count,
+                         const gaus_header_filter_t *filters, const gaus_report_header_t *header,
+                         unsigned int report_count, const gaus_report_t *reports, gaus_completion_callback_t callback,
+                         void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief ::gaus_prefetch_update through \p client
+ *
+ *************************************************************/
+gaus_error_t *gaus_client_prefetch_update(gaus_client_t *client, gaus_prefetcher_t *prefetcher,
+                                          const gaus_session_t *session, const gaus_update_t *update,
+                                          gaus_completion_callback_t callback, void *user_data);
+
 /*************************************************************//**
  *
  * \brief Cleanup the gaus library
  *
- * This function releases resources acquired by \c ::gaus_global_init.
+ * This function releases resources acquired by \c ::gaus_global_init.  Asynchronous calls that have not completed yet
+ * are aborted, their callbacks are called with an error before this function returns.
  *
  * You should call ::gaus_global_cleanup once for each call you make to gaus_global_init, after you are done using
  * libgaus.
@@ -10,6 +10,8 @@
 #ifndef UPDATE_CLIENT_C_GAUS_CLIENT_TYPES_H
 #define UPDATE_CLIENT_C_GAUS_CLIENT_TYPES_H
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,7 +38,11 @@ typedef enum {
   /*!
    * An unknown error occurred while attempting to process your request.  Check gaus_error_t::description for details.
    */
-      GAUS_UNKNOWN_ERROR  //!<
+      GAUS_UNKNOWN_ERROR,
+  /*!
+   * Downloaded data does not match its checksum, see ::gaus_download_update
+   */
+      GAUS_CHECKSUM_ERROR  //!<
 } gaus_error_type_t;
 
 /*************************************************************//**
@@ -66,6 +72,17 @@ typedef struct {
 } gaus_error_t;
 
 
+/*************************************************************//**
+ *
+ * \brief Codecs for compressing request bodies, see gaus_initialization_options_t::request_compression
+ *
+ *************************************************************/
+typedef enum {
+  GAUS_COMPRESSION_NONE = 0, //!< Send request bodies as they are
+  GAUS_COMPRESSION_GZIP,     //!< `Content-Encoding: gzip`
+  GAUS_COMPRESSION_DEFLATE   //!< `Content-Encoding: deflate`, zlib format
+} gaus_compression_t;
+
 /*************************************************************//**
  *
  * \brief The options object passed into ::gaus_global_init to specify options
@@ -86,8 +103,128 @@ typedef struct {
    * is used this may be set to NULL.
    * */
   const char *ca_path;
+  /*!
+   *
+   * The maximum number of connections the library keeps open to a single host.  Connections are reused between
+   * requests, a request made while all connections to its host are busy waits until one is released.  Set to 0 to use
+   * the default of 6.
+   * */
+  unsigned int max_connections_per_host;
+  /*!
+   *
+   * The number of seconds an unused connection is kept open for reuse by later requests before it is closed.  Set to 0
+   * to use the default of 300 seconds.
+   * */
+  unsigned int connection_idle_timeout_seconds;
+  /*!
+   *
+   * Set to true to negotiate HTTP/2 with the server.  Concurrent requests, from gaus_*_async calls or from blocking
+   * calls on several threads, are then multiplexed as streams over a single connection instead of each using their
+   * own connection.  gaus_initialization_options_t::max_connections_per_host then limits the number of concurrent
+   * requests.  Falls back to HTTP/1.1 if the server or curl does not support HTTP/2.
+   * */
+  bool enable_http2;
+  /*!
+   *
+   * Compress the bodies of requests sent to the server, such as ::gaus_report batches, with this codec.  Only enable it
+   * if the server accepts compressed request bodies.  Responses are always decompressed transparently, whatever this is
+   * set to.
+   * */
+  gaus_compression_t request_compression;
+  /*!
+   *
+   * The compression level used for gaus_initialization_options_t::request_compression, from 1 (fastest) to 9
+   * (smallest).  Set to 0 to use the zlib default of 6.
+   * */
+  int compression_level;
+  /*!
+   *
+   * The most bytes per second all transfers of the library together may use, 0 for no limit.  Transfers share it by
+   * priority: requests such as ::gaus_authenticate and ::gaus_check_for_updates get the largest share, then
+   * ::gaus_report, then ::gaus_download_update.  A share that is not in use goes to the others, and concurrent
+   * transfers of the same kind split their share evenly.
+   * */
+  unsigned long max_bandwidth;
 } gaus_initialization_options_t;
 
+/*************************************************************//**
+ *
+ * \brief A client of one gaus backend, created by ::gaus_client_create.
+ *
+ *************************************************************/
+typedef struct gaus_client gaus_client_t;
+
+/*************************************************************//**
+ *
+ * \brief Counters of a ::gaus_client_t, see ::gaus_client_get_stats
+ *
+ *************************************************************/
+typedef struct {
+  /*!
+   * The number of requests the client sent so far, each Range request of a download counting as one.
+   * */
+  unsigned long requests;
+} gaus_client_stats_t;
+
+/*************************************************************//**
+ *
+ * \brief The callback invoked when an asynchronous gaus_*_async call completes.
+ *
+ * Called exactly once per successfully queued call, from the library I/O thread.  The callback should return quickly
+ * since no other request makes progress while it runs.  It may queue further asynchronous calls.
+ *
+ * \param[in] error: A strong pointer to an error describing what went wrong, or `NULL` if the call succeeded and its
+ *   out parameters are filled in.  The callback is responsible for freeing this memory if non null.
+ * \param[in] user_data: The user_data pointer passed to the gaus_*_async call.
+ *
+ *************************************************************/
+typedef void (*gaus_completion_callback_t)(gaus_error_t *error, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief Socket events exchanged with a host event loop, see \c ::gaus_loop_init.
+ *
+ *************************************************************/
+typedef enum {
+  GAUS_LOOP_POLL_IN = 1,    //!< The socket is, or should be watched for being, readable
+  GAUS_LOOP_POLL_OUT = 2,   //!< The socket is, or should be watched for being, writable
+  GAUS_LOOP_POLL_ERROR = 4  //!< An error condition was reported on the socket, only passed to ::gaus_loop_socket_action
+} gaus_loop_event_t;
+
+/*************************************************************//**
+ *
+ * \brief Called when the library wants the host event loop to change how it watches a socket.
+ *
+ * \param[in] fd: The socket to watch.
+ * \param[in] events: A mask of gaus_loop_event_t values to watch \p fd for.  `0` means the library is done with \p fd
+ *   and the host should stop watching it.
+ * \param[in] user_data: gaus_loop_options_t::user_data.
+ *
+ *************************************************************/
+typedef void (*gaus_loop_socket_callback_t)(int fd, unsigned int events, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief Called when the library wants the host event loop to (re)arm its single timer.
+ *
+ * \param[in] timeout_ms: Call ::gaus_loop_timeout once this many milliseconds have passed, `0` means as soon as
+ *   possible.  `-1` means the timer should be disarmed.
+ * \param[in] user_data: gaus_loop_options_t::user_data.
+ *
+ *************************************************************/
+typedef void (*gaus_loop_timer_callback_t)(long timeout_ms, void *user_data);
+
+/*************************************************************//**
+ *
+ * \brief The options object passed into ::gaus_loop_init
+ *
+ *************************************************************/
+typedef struct {
+  gaus_loop_socket_callback_t socket_callback; //!< Required, see gaus_loop_socket_callback_t
+  gaus_loop_timer_callback_t timer_callback; //!< Required, see gaus_loop_timer_callback_t
+  void *user_data; //!< Passed unchanged to both callbacks
+} gaus_loop_options_t;
+
 /*************************************************************//**
  *
  * \brief The session type retrieved from authentication.
@@ -155,7 +292,9 @@ typedef struct {
    * */
   char *update_type;
   /*!
-   * A null terminated string specifying of what package type this update has.
+   * A null terminated string specifying of what package type this update has.  `file` packages hold the new version
+   * itself, `delta` packages a patch from gaus_update_t::base_version to it.  Both can be downloaded with
+   * ::gaus_download_update.
    * */
   char *package_type;
   /*!
@@ -180,8 +319,269 @@ typedef struct {
    * A null terminated string with the URL to download this version
    * */
   char *download_url;
+  /*!
+   * For `delta` packages, a null terminated string with the version the patch applies to, otherwise NULL.  The size
+   * and md5 above are those of the patch.
+   * */
+  char *base_version;
+  /*!
+   * For `delta` packages, the size in bytes of the version the patch rebuilds, otherwise 0.
+   * */
+  unsigned int target_size;
+  /*!
+   * For `delta` packages, a null terminated string with the md5 checksum of the version the patch rebuilds, otherwise
+   * NULL.
+   * */
+  char *target_md5;
+  /*!
+   * For `file` packages, a null terminated string with the URL of the index of the chunks the package is split into,
+   * or NULL if the server offers none.  With it ::gaus_download_update only downloads chunks not found locally.
+   * */
+  char *chunk_index_url;
+  /*!
+   * For `file` packages, a null terminated string with the URL of the hash tree of the package, or NULL if the server
+   * offers none.  It lists the md5 of each fixed size chunk, so ::gaus_download_update checks every chunk as it
+   * arrives and only fetches bad chunks again.
+   * */
+  char *hash_tree_url;
+  /*!
+   * For `file` packages with a gaus_update_t::hash_tree_url, a null terminated string with the md5 root of that tree,
+   * otherwise NULL.  A tree that does not hash to it is not used.
+   * */
+  char *hash_tree_root;
 } gaus_update_t;
 
+/*************************************************************//**
+ *
+ * \brief The callback invoked by ::gaus_check_for_updates_streamed for each update
+ *
+ * Called as soon as an update has been read from the reply, while the rest of it is still arriving.
+ *
+ * \param[in] update: A weak pointer to the update, freed once the callback returns.  Copy what is needed later.
+ * \param[in] user_data: The user_data pointer passed to ::gaus_check_for_updates_streamed.
+ * \return int 0 to go on, anything else to stop reading the reply.
+ *
+ *************************************************************/
+typedef int (*gaus_update_callback_t)(const gaus_update_t *update, void *user_data);
+
+
+/*************************************************************//**
+ *
+ * \brief When ::gaus_download_update flushes the downloaded data to storage
+ *
+ *************************************************************/
+typedef enum {
+  /*!
+   * Sync every gaus_download_options_t::sync_interval bytes, a download interrupted by a power loss resumes from the
+   * last sync.
+   */
+      GAUS_SYNC_PERIODIC = 0,
+  /*!
+   * Sync only when a transfer breaks off and when the download is complete.  Fewer writes to the storage, but a power
+   * loss during a transfer restarts the download from where it last broke off or from the start.
+   */
+      GAUS_SYNC_ON_COMPLETION  //!<
+} gaus_sync_policy_t;
+
+/*************************************************************//**
+ *
+ * \brief How devices on a local network find each other, passed into ::gaus_peer_start and
+ *   gaus_download_options_t::peers
+ *
+ *************************************************************/
+typedef struct {
+  /*!
+   *
+   * A weak pointer to a null terminated path of an existing directory keeping packages by their md5, served to the
+   * peers.  Used as gaus_download_options_t::artifact_cache_path when that is not set.
+   * */
+  const char *cache_path;
+  /*!
+   *
+   * A weak pointer to a null terminated IPv4 address of the interface facing the peers, or NULL for the default one.
+   * */
+  const char *address;
+  /*!
+   *
+   * A weak pointer to a null terminated IPv4 multicast group the peers are asked on, or NULL to use 239.255.71.71.
+   * */
+  const char *group;
+  /*!
+   *
+   * The UDP port the peers are asked on, or 0 to use 47071.  All peers of a site use the same group and port.
+   * */
+  unsigned short port;
+} gaus_peer_options_t;
+
+/*************************************************************//**
+ *
+ * \brief The options object passed into ::gaus_download_update
+ *
+ *************************************************************/
+typedef struct {
+  /*!
+   *
+   * How many times a transfer is started, and resumed after it broke off, before giving up.  Set to 0 to use the
+   * default of 5.
+   * */
+  unsigned int max_attempts;
+  /*!
+   *
+   * When the downloaded data is flushed to storage.
+   * */
+  gaus_sync_policy_t sync_policy;
+  /*!
+   *
+   * Bytes written between syncs with #GAUS_SYNC_PERIODIC.  Set to 0 to use the default of 4 MiB.
+   * */
+  unsigned int sync_interval;
+  /*!
+   *
+   * A weak pointer to a null terminated path of the installed gaus_update_t::base_version, required to download
+   * updates with a `delta` package.  For `file` packages with a gaus_update_t::chunk_index_url it is the previous
+   * image, chunks found in it are not downloaded.
+   * */
+  const char *base_path;
+  /*!
+   *
+   * A weak pointer to a null terminated path of an existing directory keeping chunks by their md5, or NULL.  Used with
+   * gaus_update_t::chunk_index_url: chunks found in it are not downloaded, and downloaded chunks are added to it.
+   * */
+  const char *chunk_store_path;
+  /*!
+   *
+   * The most Range requests to run at the same time for one download.  The download starts with one and adds more
+   * while that raises the throughput.  Set to 1 to always download over a single connection, or to 0 to use the
+   * default of 4.
+   * */
+  unsigned int max_streams;
+  /*!
+   *
+   * A weak pointer to a null terminated path of an existing directory, or NULL.  The file, a tar archive that may be
+   * gzip compressed, is extracted into it while it downloads.  For `delta` packages that is the rebuilt version.
+   * */
+  const char *extract_path;
+  /*!
+   *
+   * Write the file with O_DIRECT, past the page cache, for example to flash an image to an inactive partition without
+   * evicting the cache of the running system.  Several blocks are written while the next ones download.  The package
+   * is downloaded over a single stream.  Chunked downloads, which write out of order, still use the page cache, as do
+   * file systems without O_DIRECT support.
+   * */
+  bool direct_io;
+  /*!
+   *
+   * A weak pointer to a null terminated path of an existing directory keeping packages by their md5, or NULL.  A `file`
+   * package found in it is copied from there instead of downloaded, and downloaded ones are added to it.  A gateway
+   * serving the directory with ::gaus_cache_server_start then fetches each package once for all devices behind it.
+   * */
+  const char *artifact_cache_path;
+  /*!
+   *
+   * The most bytes of packages kept in gaus_download_options_t::artifact_cache_path, the least recently downloaded or
+   * served ones are removed to stay below it.  Set to 0 for no limit.
+   * */
+  unsigned long long artifact_cache_size;
+  /*!
+   *
+   * A weak pointer to how to find peers on the local network, or NULL.  A `file` package not found in the artifact
+   * cache is downloaded from a peer that has it, and from gaus_update_t::download_url only if no peer answers or the
+   * transfer from the peer fails.  The downloaded package is kept for the peers, which find it once this device runs
+   * ::gaus_peer_start.
+   * */
+  const gaus_peer_options_t *peers;
+  /*!
+   *
+   * A weak pointer to an array of gaus_download_options_t::mirror_count weak pointers to null terminated URLs serving
+   * the same package as gaus_update_t::download_url, or NULL.  The session token is only sent to the download_url.
+   * A transfer that breaks off or falls below gaus_download_options_t::min_speed is resumed from the source that was
+   * fastest so far, mirrors not tried yet first, keeping the bytes already received.  A source answering with a client
+   * error is not used again.
+   * */
+  const char *const *mirror_urls;
+  unsigned int mirror_count;
+  /*!
+   *
+   * The slowest a transfer may get, in bytes per second, before it is aborted and resumed, from a mirror if there is
+   * one.  Set to 0 to use the default of 1.
+   * */
+  unsigned int min_speed;
+  /*!
+   *
+   * How many seconds a transfer may stay below gaus_download_options_t::min_speed.  Set to 0 to use the default of 60.
+   * */
+  unsigned int min_speed_time;
+} gaus_download_options_t;
+
+/*************************************************************//**
+ *
+ * \brief The options object passed into ::gaus_cache_server_start
+ *
+ *************************************************************/
+typedef struct {
+  /*!
+   *
+   * A weak pointer to a null terminated path of the directory used as gaus_download_options_t::artifact_cache_path.
+   * */
+  const char *cache_path;
+  /*!
+   *
+   * A weak pointer to a null terminated IPv4 address to listen on, or NULL to listen on all addresses.
+   * */
+  const char *address;
+  /*!
+   *
+   * The TCP port to listen on, or 0 to pick a free one, see ::gaus_cache_server_port.
+   * */
+  unsigned short port;
+} gaus_cache_server_options_t;
+
+/*************************************************************//**
+ *
+ * \brief A running cache server, started by ::gaus_cache_server_start.
+ *
+ *************************************************************/
+typedef struct gaus_cache_server gaus_cache_server_t;
+
+/*************************************************************//**
+ *
+ * \brief A device serving its packages to its peers, started by ::gaus_peer_start.
+ *
+ *************************************************************/
+typedef struct gaus_peer gaus_peer_t;
+
+/*************************************************************//**
+ *
+ * \brief The options object passed into ::gaus_prefetch_start
+ *
+ *************************************************************/
+typedef struct {
+  /*!
+   *
+   * A weak pointer to a null terminated path of an existing directory keeping packages by their md5, the prefetched
+   * packages are added to it.  Pass it as gaus_download_options_t::artifact_cache_path to download from it.
+   * */
+  const char *store_path;
+  /*!
+   *
+   * The most bytes of packages kept in gaus_prefetch_options_t::store_path, the least recently used ones are removed
+   * to stay below it.  Set to 0 for no limit.
+   * */
+  unsigned long long store_size;
+  /*!
+   *
+   * The bytes per second prefetches may use while no other transfer of the library runs.  Set to 0 to use
+   * gaus_initialization_options_t::max_bandwidth, or no limit without one.
+   * */
+  unsigned long max_bandwidth;
+} gaus_prefetch_options_t;
+
+/*************************************************************//**
+ *
+ * \brief A worker prefetching updates, started by ::gaus_prefetch_start.
+ *
+ *************************************************************/
+typedef struct gaus_prefetcher gaus_prefetcher_t;
 
 /*************************************************************//**
  *
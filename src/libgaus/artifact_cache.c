@@ -0,0 +1,221 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "artifact_cache.h"
+#include "log.h"
+#include "md5.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ARTIFACT_COPY_SIZE (1024 * 1024)
+
+typedef struct {
+  char name[MD5_HEX_LENGTH + 1];
+  off_t size;
+  struct timespec used;
+} cache_entry_t;
+
+/* Entries are named by their md5 in lowercase hex, NULL if md5 is not a digest. */
+static char *entry_path(const char *directory, const char *md5) {
+  unsigned char digest[MD5_DIGEST_LENGTH];
+  char hex[MD5_HEX_LENGTH + 1];
+  size_t length = strlen(directory) + MD5_HEX_LENGTH + 2;
+  char *path;
+
+  if (strlen(md5) != MD5_HEX_LENGTH || md5_from_hex(md5, digest) != 0 || !(path = malloc(length))) {
+    return NULL;
+  }
+  md5_to_hex(digest, hex);
+  snprintf(path, length, "%s/%s", directory, hex);
+  return path;
+}
+
+int artifact_cache_open(const char *directory, const char *md5, off_t size) {
+  char *path = entry_path(directory, md5);
+  struct stat entry_stat;
+  int fd = path ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+
+  free(path);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fstat(fd, &entry_stat) != 0 || !S_ISREG(entry_stat.st_mode) || (size >= 0 && entry_stat.st_size != size)) {
+    close(fd);
+    return -1;
+  }
+  //The modification time orders the entries for eviction, a failure only makes this one go sooner.
+  futimens(fd, NULL);
+  return fd;
+}
+
+bool artifact_cache_contains(const char *directory, const char *md5, off_t size) {
+  char *path = entry_path(directory, md5);
+  struct stat entry_stat;
+  bool found = path && stat(path, &entry_stat) == 0 && S_ISREG(entry_stat.st_mode) && entry_stat.st_size == size;
+
+  free(path);
+  return found;
+}
+
+static int copy_file(int in_fd, int out_fd, off_t size) {
+  off_t offset = 0;
+  char *buffer = NULL;
+  int result = -1;
+
+  //sendfile copies within the kernel, files it cannot copy are read and written.
+  while (offset < size) {
+    size_t count = size - offset < ARTIFACT_COPY_SIZE ? (size_t) (size - offset) : ARTIFACT_COPY_SIZE;
+    ssize_t done = buffer ? pread(in_fd, buffer, count, offset) : sendfile(out_fd, in_fd, &offset, count);
+
+    if (done < 0 && !buffer && (errno == EINVAL || errno == ENOSYS)) {
+      if (!(buffer = malloc(ARTIFACT_COPY_SIZE))) {
+        goto out;
+      }
+      continue;
+    }
+    if (done <= 0 || (buffer && write(out_fd, buffer, (size_t) done) != done)) {
+      goto out;
+    }
+    if (buffer) {
+      offset += done;
+    }
+  }
+  result = 0;
+
+  out:
+  free(buffer);
+  return result;
+}
+
+static int by_use(const void *a, const void *b) {
+  const cache_entry_t *first = a;
+  const cache_entry_t *second = b;
+
+  if (first->used.tv_sec != second->used.tv_sec) {
+    return first->used.tv_sec < second->used.tv_sec ? -1 : 1;
+  }
+  if (first->used.tv_nsec != second->used.tv_nsec) {
+    return first->used.tv_nsec < second->used.tv_nsec ? -1 : 1;
+  }
+  return 0;
+}
+
+/* Remove the least recently used entries until the rest fit in max_size. */
+static void trim(const char *directory, unsigned long long max_size) {
+  DIR *dir = opendir(directory);
+  cache_entry_t *entries = NULL;
+  size_t count = 0;
+  size_t capacity = 0;
+  unsigned long long total = 0;
+  struct dirent *file;
+  int dir_fd;
+
+  if (!dir) {
+    return;
+  }
+  dir_fd = dirfd(dir);
+  while ((file = readdir(dir))) {
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    struct stat entry_stat;
+
+    if (strlen(file->d_name) != MD5_HEX_LENGTH || md5_from_hex(file->d_name, digest) != 0 ||
+        fstatat(dir_fd, file->d_name, &entry_stat, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(entry_stat.st_mode)) {
+      continue;
+    }
+    if (count == capacity) {
+      cache_entry_t *grown = realloc(entries, (capacity ? capacity * 2 : 16) * sizeof(*entries));
+      if (!grown) {
+        goto out;
+      }
+      entries = grown;
+      capacity = capacity ? capacity * 2 : 16;
+    }
+    strcpy(entries[count].name, file->d_name);
+    entries[count].size = entry_stat.st_size;
+    entries[count].used = entry_stat.st_mtim;
+    total += (unsigned long long) entry_stat.st_size;
+    count++;
+  }
+  qsort(entries, count, sizeof(*entries), by_use);
+  for (size_t i = 0; i < count && total > max_size; i++) {
+    if (unlinkat(dir_fd, entries[i].name, 0) == 0) {
+      logging(L_INFO, "Removed %s from the artifact cache", entries[i].name);
+      total -= (unsigned long long) entries[i].size;
+    }
+  }
+
+  out:
+  free(entries);
+  closedir(dir);
+}
+
+int artifact_cache_add(const char *directory, const char *md5, const char *path, off_t size,
+                       unsigned long long max_size) {
+  char *entry = entry_path(directory, md5);
+  char *temporary_path = NULL;
+  int in_fd = -1;
+  int out_fd = -1;
+  bool added = false;
+
+  if (!entry || (max_size && (unsigned long long) size > max_size)) {
+    free(entry);
+    return -1;
+  }
+  //Named after the process, so gateways sharing the cache do not write the same file.
+  if ((temporary_path = malloc(strlen(entry) + 32))) {
+    sprintf(temporary_path, "%s.%ld.tmp", entry, (long) getpid());
+    in_fd = open(path, O_RDONLY | O_CLOEXEC);
+    out_fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    added = in_fd >= 0 && out_fd >= 0 && copy_file(in_fd, out_fd, size) == 0 && fdatasync(out_fd) == 0;
+    added = out_fd >= 0 && close(out_fd) == 0 && added && rename(temporary_path, entry) == 0;
+    if (!added && out_fd >= 0) {
+      unlink(temporary_path);
+    }
+  }
+  if (in_fd >= 0) {
+    close(in_fd);
+  }
+  if (added && max_size) {
+    trim(directory, max_size);
+  }
+  free(temporary_path);
+  free(entry);
+  return added ? 0 : -1;
+}
+
+int artifact_cache_adopt(const char *directory, const char *md5, const char *path, unsigned long long max_size) {
+  char *entry = entry_path(directory, md5);
+  struct stat file_stat;
+  bool added = entry && stat(path, &file_stat) == 0 &&
+               (!max_size || (unsigned long long) file_stat.st_size <= max_size) && rename(path, entry) == 0;
+
+  if (added && max_size) {
+    trim(directory, max_size);
+  }
+  free(entry);
+  return added ? 0 : -1;
+}
+
+void artifact_cache_remove(const char *directory, const char *md5) {
+  char *path = entry_path(directory, md5);
+
+  if (path) {
+    unlink(path);
+  }
+  free(path);
+}
@@ -0,0 +1,45 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_ARTIFACT_CACHE_H
+#define GAUS_ARTIFACT_CACHE_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Packages kept under their md5 in a directory, shared by the downloads of a gateway and served from it to the devices
+ * behind it.  The modification time of an entry tells when it was last used, the least recently used entries are
+ * removed once they take up more than the size of the cache. */
+
+/* Open the entry for md5 read only and mark it as used.  With a size of 0 or more the entry must have that size.
+ * Returns the descriptor or -1. */
+int artifact_cache_open(const char *directory, const char *md5, off_t size);
+
+/* Whether an entry of size bytes is kept for md5, without marking it as used. */
+bool artifact_cache_contains(const char *directory, const char *md5, off_t size);
+
+/* Copy the first size bytes of the file at path into the cache as md5, and trim the cache to max_size bytes, 0 for no
+ * limit.  Returns -1 if the entry could not be added. */
+int artifact_cache_add(const char *directory, const char *md5, const char *path, off_t size,
+                       unsigned long long max_size);
+
+/* Move the complete package at path into the cache as md5, and trim the cache to max_size bytes, 0 for no limit.
+ * Returns -1 if the entry could not be added, path is then left where it is. */
+int artifact_cache_adopt(const char *directory, const char *md5, const char *path, unsigned long long max_size);
+
+void artifact_cache_remove(const char *directory, const char *md5);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_ARTIFACT_CACHE_H
@@ -0,0 +1,139 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "bandwidth.h"
+#include "curl_wrapper.h"
+#include "log.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+static const unsigned int class_weights[BANDWIDTH_CLASS_COUNT] = {
+    8, //Control
+    4, //Report
+    1, //Bulk
+    0  //Background, only gets what the others leave
+};
+
+struct bandwidth_transfer {
+  CURL *curl;
+  bandwidth_class_t traffic_class;
+  unsigned long generation; //Of the shares the current rate was computed from
+};
+
+static struct {
+  pthread_mutex_t lock;
+  curl_off_t limit;
+  curl_off_t background_limit;
+  unsigned int active[BANDWIDTH_CLASS_COUNT];
+  unsigned long generation; //Changes whenever the shares change
+} bandwidth = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* The rate of a transfer of traffic_class, 0 for no limit.  Called with bandwidth.lock held. */
+static curl_off_t class_rate(bandwidth_class_t traffic_class) {
+  unsigned int total_weight = 0;
+  curl_off_t limit;
+  curl_off_t rate;
+
+  for (int i = 0; i < BANDWIDTH_CLASS_COUNT; i++) {
+    if (bandwidth.active[i]) {
+      total_weight += class_weights[i];
+    }
+  }
+  if (traffic_class == BANDWIDTH_BACKGROUND) {
+    if (total_weight > 0) {
+      return BANDWIDTH_BACKGROUND_TRICKLE;
+    }
+    limit = bandwidth.background_limit ? bandwidth.background_limit : bandwidth.limit;
+    if (!limit) {
+      return 0;
+    }
+    rate = limit / bandwidth.active[traffic_class];
+  } else {
+    if (!bandwidth.limit) {
+      return 0;
+    }
+    rate = bandwidth.limit * class_weights[traffic_class] / total_weight / bandwidth.active[traffic_class];
+  }
+  return rate < 1 ? 1 : rate; //0 would lift the limit
+}
+
+/* Called with bandwidth.lock held. */
+static void apply_rate(bandwidth_transfer_t *transfer) {
+  curl_off_t rate = class_rate(transfer->traffic_class);
+
+  //curl paces the transfer itself, so neither the blocking calls nor the event loop sleep in a callback.
+  gaus_curl_easy_setopt(transfer->curl, CURLOPT_MAX_RECV_SPEED_LARGE, rate);
+  gaus_curl_easy_setopt(transfer->curl, CURLOPT_MAX_SEND_SPEED_LARGE, rate);
+  transfer->generation = bandwidth.generation;
+}
+
+/* Progress callback of limited transfers, picks up new shares while the transfer runs. */
+static int bandwidth_progress(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal,
+                              curl_off_t ulnow) {
+  bandwidth_transfer_t *transfer = clientp;
+  (void) dltotal;
+  (void) dlnow;
+  (void) ultotal;
+  (void) ulnow;
+
+  pthread_mutex_lock(&bandwidth.lock);
+  if (transfer->generation != bandwidth.generation) {
+    apply_rate(transfer);
+  }
+  pthread_mutex_unlock(&bandwidth.lock);
+  return 0;
+}
+
+void bandwidth_init(curl_off_t max_bytes_per_second) {
+  pthread_mutex_lock(&bandwidth.lock);
+  bandwidth.limit = max_bytes_per_second;
+  pthread_mutex_unlock(&bandwidth.lock);
+}
+
+void bandwidth_set_background(curl_off_t max_bytes_per_second) {
+  pthread_mutex_lock(&bandwidth.lock);
+  bandwidth.background_limit = max_bytes_per_second;
+  bandwidth.generation++;
+  pthread_mutex_unlock(&bandwidth.lock);
+}
+
+bandwidth_transfer_t *bandwidth_attach(CURL *curl, bandwidth_class_t traffic_class) {
+  bandwidth_transfer_t *transfer;
+
+  if (!(transfer = malloc(sizeof(*transfer)))) {
+    return NULL;
+  }
+  //Every transfer is counted, even without a limit, so a background transfer started later still makes way for it.
+  pthread_mutex_lock(&bandwidth.lock);
+  transfer->curl = curl;
+  transfer->traffic_class = traffic_class;
+  bandwidth.active[traffic_class]++;
+  bandwidth.generation++;
+  apply_rate(transfer);
+  pthread_mutex_unlock(&bandwidth.lock);
+
+  gaus_curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, bandwidth_progress);
+  gaus_curl_easy_setopt(curl, CURLOPT_XFERINFODATA, transfer);
+  gaus_curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+  return transfer;
+}
+
+void bandwidth_detach(bandwidth_transfer_t *transfer) {
+  if (!transfer) {
+    return;
+  }
+  pthread_mutex_lock(&bandwidth.lock);
+  bandwidth.active[transfer->traffic_class]--;
+  bandwidth.generation++;
+  pthread_mutex_unlock(&bandwidth.lock);
+  free(transfer);
+}
@@ -0,0 +1,50 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_BANDWIDTH_H
+#define GAUS_BANDWIDTH_H
+
+#include <curl/curl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Traffic classes, in order of priority.  Active classes split the bandwidth limit by weight, the transfers of a class
+ * split its share evenly.  Background transfers only run at full speed while no other class is active, and trickle
+ * along otherwise. */
+typedef enum {
+  BANDWIDTH_CONTROL,     //Register, authenticate and check for updates
+  BANDWIDTH_REPORT,      //Reports
+  BANDWIDTH_BULK,        //Update downloads
+  BANDWIDTH_BACKGROUND,  //Prefetched updates
+  BANDWIDTH_CLASS_COUNT
+} bandwidth_class_t;
+
+//Bytes per second of each background transfer while other transfers run, enough to keep its connection alive.
+#define BANDWIDTH_BACKGROUND_TRICKLE 4096
+
+typedef struct bandwidth_transfer bandwidth_transfer_t;
+
+/* Limit all transfers together to max_bytes_per_second, 0 for no limit. */
+void bandwidth_init(curl_off_t max_bytes_per_second);
+
+/* Limit background transfers to max_bytes_per_second while they run alone, 0 for the limit of all transfers. */
+void bandwidth_set_background(curl_off_t max_bytes_per_second);
+
+/* Count the transfer set up on curl against its class until bandwidth_detach.  Without a limit only background
+ * transfers are slowed, the others run unlimited.  Returns NULL, and leaves curl unlimited, if out of memory. */
+bandwidth_transfer_t *bandwidth_attach(CURL *curl, bandwidth_class_t traffic_class);
+
+void bandwidth_detach(bandwidth_transfer_t *transfer);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_BANDWIDTH_H
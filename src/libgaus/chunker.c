@@ -0,0 +1,66 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "chunker.h"
+
+#include <pthread.h>
+
+static uint64_t gear[256];
+static pthread_once_t gear_once = PTHREAD_ONCE_INIT;
+
+static void fill_gear(void) {
+  uint64_t state = 0;
+
+  for (int i = 0; i < 256; i++) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    gear[i] = z ^ (z >> 31);
+  }
+}
+
+int chunker_init(chunker_t *chunker, size_t min_size, size_t average_size, size_t max_size) {
+  unsigned int bits = 0;
+
+  if (min_size == 0 || min_size > average_size || average_size > max_size ||
+      (average_size & (average_size - 1)) != 0) {
+    return -1;
+  }
+  while (((size_t) 1 << bits) < average_size) {
+    bits++;
+  }
+  if (bits == 0 || bits > 63) {
+    return -1;
+  }
+  pthread_once(&gear_once, fill_gear);
+  chunker->min_size = min_size;
+  chunker->max_size = max_size;
+  //The low bits of a gear hash only depend on the last few bytes, the top ones on the last 64.
+  chunker->mask = ~(UINT64_MAX >> bits);
+  chunker->hash = 0;
+  chunker->length = 0;
+  return 0;
+}
+
+size_t chunker_scan(chunker_t *chunker, const unsigned char *data, size_t length) {
+  uint64_t hash = chunker->hash;
+
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash << 1) + gear[data[i]];
+    chunker->length++;
+    if (chunker->length >= chunker->max_size ||
+        (chunker->length >= chunker->min_size && (hash & chunker->mask) == 0)) {
+      chunker->hash = 0;
+      chunker->length = 0;
+      return i + 1;
+    }
+  }
+  chunker->hash = hash;
+  return 0;
+}
@@ -0,0 +1,42 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_CHUNKER_H
+#define GAUS_CHUNKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Content defined chunking.  A chunk ends where a gear hash of its last 64 bytes has its top log2(average_size) bits
+ * clear, but not before min_size and no later than max_size bytes, so equal content is split into equal chunks
+ * wherever it sits in a file.  The gear table holds the first 256 outputs of splitmix64 seeded with 0, a server splits
+ * packages the same way by using the same table and sizes. */
+typedef struct {
+  size_t min_size;
+  size_t max_size;
+  uint64_t mask;    //Hash bits that must be clear at a boundary
+  uint64_t hash;
+  size_t length;    //Bytes of the current chunk seen so far
+} chunker_t;
+
+/* average_size must be a power of two between min_size and max_size.  Returns 0 if the sizes are valid. */
+int chunker_init(chunker_t *chunker, size_t min_size, size_t average_size, size_t max_size);
+
+/* Look for the end of the current chunk in the next length bytes.  Returns the number of bytes of data up to and
+ * including the end of the chunk, after which the next chunk starts, or 0 if all of data belongs to the current one. */
+size_t chunker_scan(chunker_t *chunker, const unsigned char *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_CHUNKER_H
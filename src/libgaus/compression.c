@@ -0,0 +1,78 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "compression.h"
+#include "log.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+//zlib window bits, adding 16 makes deflate write a gzip instead of a zlib wrapper.
+#define COMPRESSION_WINDOW_BITS 15
+#define COMPRESSION_GZIP_WRAPPER 16
+
+const char *compression_header(gaus_compression_t codec) {
+  switch (codec) {
+    case GAUS_COMPRESSION_GZIP:
+      return "Content-Encoding: gzip";
+    case GAUS_COMPRESSION_DEFLATE:
+      //HTTP "deflate" is the zlib format, not a raw deflate stream.
+      return "Content-Encoding: deflate";
+    default:
+      return NULL;
+  }
+}
+
+int compression_encode(gaus_compression_t codec, int level, const char *data, size_t length,
+                       char **out, size_t *out_length) {
+  z_stream stream = {0};
+  char *buffer = NULL;
+  int window_bits = COMPRESSION_WINDOW_BITS;
+
+  if (codec == GAUS_COMPRESSION_GZIP) {
+    window_bits += COMPRESSION_GZIP_WRAPPER;
+  } else if (codec != GAUS_COMPRESSION_DEFLATE) {
+    logging(L_ERROR, "compression_encode error: unknown codec %d", codec);
+    return -1;
+  }
+  if (length > UINT_MAX) {
+    logging(L_ERROR, "compression_encode error: %zu bytes is too large to compress at once", length);
+    return -1;
+  }
+
+  if (deflateInit2(&stream, level ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    logging(L_ERROR, "compression_encode error: unable to initialize zlib");
+    return -1;
+  }
+
+  //deflateBound is large enough to compress everything in a single call.
+  uLong bound = deflateBound(&stream, (uLong) length);
+  if (!(buffer = malloc(bound))) {
+    goto error;
+  }
+  stream.next_in = (Bytef *) data;
+  stream.avail_in = (uInt) length;
+  stream.next_out = (Bytef *) buffer;
+  stream.avail_out = (uInt) bound;
+  if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+    goto error;
+  }
+
+  *out = buffer;
+  *out_length = stream.total_out;
+  deflateEnd(&stream);
+  return 0;
+
+  error:
+  logging(L_ERROR, "compression_encode error: unable to compress %zu bytes", length);
+  free(buffer);
+  deflateEnd(&stream);
+  return -1;
+}
@@ -0,0 +1,31 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_COMPRESSION_H
+#define GAUS_COMPRESSION_H
+
+#include "gaus/gaus_client_types.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The Content-Encoding header for bodies compressed with codec, NULL for GAUS_COMPRESSION_NONE. */
+const char *compression_header(gaus_compression_t codec);
+
+/* Compress length bytes of data with codec at level (1 to 9, 0 for the zlib default).  On success *out holds a malloc'd
+ * buffer of *out_length bytes.  Returns -1 on failure. */
+int compression_encode(gaus_compression_t codec, int level, const char *data, size_t length,
+                       char **out, size_t *out_length);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_COMPRESSION_H
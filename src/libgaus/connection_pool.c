@@ -0,0 +1,199 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "connection_pool.h"
+#include "curl_wrapper.h"
+#include "log.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  CURL *curl;
+  char *host;       //scheme://host:port this handle last connected to
+  time_t last_used; //Monotonic seconds when the handle was last released
+  bool in_use;
+} pool_entry_t;
+
+struct connection_pool {
+  pthread_mutex_t lock;
+  pthread_cond_t released;
+  pool_entry_t *entries;
+  size_t entry_count;
+  unsigned int max_per_host;
+  unsigned int idle_timeout_seconds;
+};
+
+static time_t now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+/* Length of the "scheme://host:port" part of url, used as the pool key. */
+static size_t host_key_length(const char *url) {
+  const char *authority = strstr(url, "://");
+  authority = authority ? authority + 3 : url;
+  return (size_t) (authority - url) + strcspn(authority, "/?#");
+}
+
+static bool entry_matches_host(const pool_entry_t *entry, const char *url, size_t key_length) {
+  return strncmp(entry->host, url, key_length) == 0 && entry->host[key_length] == '\0';
+}
+
+static void remove_entry(connection_pool_t *pool, size_t index) {
+  gaus_curl_easy_cleanup(pool->entries[index].curl);
+  free(pool->entries[index].host);
+  pool->entries[index] = pool->entries[--pool->entry_count];
+}
+
+static void expire_idle_entries(connection_pool_t *pool) {
+  time_t now = now_seconds();
+  size_t i = 0;
+  while (i < pool->entry_count) {
+    if (!pool->entries[i].in_use && now - pool->entries[i].last_used >= (time_t) pool->idle_timeout_seconds) {
+      logging(L_DEBUG, "Closing idle connection to %s", pool->entries[i].host);
+      remove_entry(pool, i);
+    } else {
+      i++;
+    }
+  }
+}
+
+connection_pool_t *connection_pool_create(unsigned int max_connections_per_host, unsigned int idle_timeout_seconds) {
+  connection_pool_t *pool = calloc(1, sizeof(connection_pool_t));
+
+  if (!pool) {
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->released, NULL);
+  pool->max_per_host = max_connections_per_host ? max_connections_per_host : CONNECTION_POOL_DEFAULT_MAX_PER_HOST;
+  pool->idle_timeout_seconds = idle_timeout_seconds ? idle_timeout_seconds
+                                                    : CONNECTION_POOL_DEFAULT_IDLE_TIMEOUT_SECONDS;
+  return pool;
+}
+
+static CURL *acquire(connection_pool_t *pool, const char *url, bool wait) {
+  CURL *curl = NULL;
+  size_t key_length = host_key_length(url);
+
+  if (!pool) {
+    return gaus_curl_easy_init();
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    expire_idle_entries(pool);
+
+    unsigned int host_in_use = 0;
+    pool_entry_t *idle = NULL;
+    for (size_t i = 0; i < pool->entry_count; i++) {
+      if (!entry_matches_host(&pool->entries[i], url, key_length)) {
+        continue;
+      }
+      if (pool->entries[i].in_use) {
+        host_in_use++;
+      } else if (!idle) {
+        idle = &pool->entries[i];
+      }
+    }
+
+    if (idle) {
+      idle->in_use = true;
+      curl = idle->curl;
+      break;
+    }
+
+    if (host_in_use < pool->max_per_host) {
+      pool_entry_t *entries = realloc(pool->entries, sizeof(pool_entry_t) * (pool->entry_count + 1));
+      char *host = NULL;
+      if (!entries || !(host = strndup(url, key_length)) || !(curl = gaus_curl_easy_init())) {
+        logging(L_ERROR, "connection_pool_acquire: Failed to create curl handle");
+        if (entries) {
+          pool->entries = entries;
+        }
+        free(host);
+        break;
+      }
+      pool->entries = entries;
+      pool->entries[pool->entry_count].curl = curl;
+      pool->entries[pool->entry_count].host = host;
+      pool->entries[pool->entry_count].last_used = now_seconds();
+      pool->entries[pool->entry_count].in_use = true;
+      pool->entry_count++;
+      break;
+    }
+
+    if (!wait) {
+      break;
+    }
+    //All connections to this host are busy, wait for one to be released.
+    pthread_cond_wait(&pool->released, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return curl;
+}
+
+CURL *connection_pool_acquire(connection_pool_t *pool, const char *url) {
+  return acquire(pool, url, true);
+}
+
+CURL *connection_pool_try_acquire(connection_pool_t *pool, const char *url) {
+  return acquire(pool, url, false);
+}
+
+unsigned int connection_pool_max_per_host(connection_pool_t *pool) {
+  if (!pool) {
+    return CONNECTION_POOL_DEFAULT_MAX_PER_HOST;
+  }
+  //Set when the pool is created and never changed.
+  return pool->max_per_host;
+}
+
+void connection_pool_release(connection_pool_t *pool, CURL *curl) {
+  if (!curl) {
+    return;
+  }
+
+  if (pool) {
+    pthread_mutex_lock(&pool->lock);
+    for (size_t i = 0; i < pool->entry_count; i++) {
+      if (pool->entries[i].curl == curl) {
+        //Drop per request options but keep live connections, DNS and TLS session caches of the handle.
+        gaus_curl_easy_reset(curl);
+        pool->entries[i].in_use = false;
+        pool->entries[i].last_used = now_seconds();
+        pthread_cond_broadcast(&pool->released);
+        pthread_mutex_unlock(&pool->lock);
+        return;
+      }
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  //Not a pooled handle (there was no pool when it was acquired)
+  gaus_curl_easy_cleanup(curl);
+}
+
+void connection_pool_free(connection_pool_t *pool) {
+  if (!pool) {
+    return;
+  }
+  while (pool->entry_count > 0) {
+    remove_entry(pool, pool->entry_count - 1);
+  }
+  free(pool->entries);
+  pthread_cond_destroy(&pool->released);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
@@ -0,0 +1,50 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_CONNECTION_POOL_H
+#define GAUS_CONNECTION_POOL_H
+
+#include <curl/curl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONNECTION_POOL_DEFAULT_MAX_PER_HOST 6
+#define CONNECTION_POOL_DEFAULT_IDLE_TIMEOUT_SECONDS 300
+
+/* Reusable curl easy handles, each client has a pool of its own.  Functions given a NULL pool create a handle for
+ * every request instead. */
+typedef struct connection_pool connection_pool_t;
+
+/* Create a pool of reusable curl easy handles.  Passing 0 for either value selects the default. */
+connection_pool_t *connection_pool_create(unsigned int max_connections_per_host, unsigned int idle_timeout_seconds);
+
+/* Get a handle for a request to url.  A handle that last talked to the same host is preferred so its
+ * open connection can be reused.  Blocks while max_connections_per_host handles for that host are in use. */
+CURL *connection_pool_acquire(connection_pool_t *pool, const char *url);
+
+/* Like connection_pool_acquire, but returns NULL instead of blocking while max_connections_per_host handles for the
+ * host are in use. */
+CURL *connection_pool_try_acquire(connection_pool_t *pool, const char *url);
+
+/* Handles for one host that can be in use at the same time. */
+unsigned int connection_pool_max_per_host(connection_pool_t *pool);
+
+/* Return a handle acquired from pool with connection_pool_acquire.  Request options are reset, open connections are
+ * kept. */
+void connection_pool_release(connection_pool_t *pool, CURL *curl);
+
+/* Close all pooled handles and their connections and free pool. */
+void connection_pool_free(connection_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_CONNECTION_POOL_H
@@ -18,3 +18,17 @@ curl_easy_setopt_t *gaus_curl_easy_setopt = curl_easy_setopt;
 curl_easy_cleanup_t *gaus_curl_easy_cleanup = curl_easy_cleanup;
 curl_global_cleanup_t *gaus_curl_global_cleanup = curl_global_cleanup;
 curl_easy_getinfo_t *gaus_curl_easy_getinfo = curl_easy_getinfo;
+curl_easy_reset_t *gaus_curl_easy_reset = curl_easy_reset;
+curl_multi_init_t *gaus_curl_multi_init = curl_multi_init;
+curl_multi_add_handle_t *gaus_curl_multi_add_handle = curl_multi_add_handle;
+curl_multi_remove_handle_t *gaus_curl_multi_remove_handle = curl_multi_remove_handle;
+curl_multi_perform_t *gaus_curl_multi_perform = curl_multi_perform;
+curl_multi_wait_t *gaus_curl_multi_wait = curl_multi_wait;
+curl_multi_info_read_t *gaus_curl_multi_info_read = curl_multi_info_read;
+curl_multi_cleanup_t *gaus_curl_multi_cleanup = curl_multi_cleanup;
+curl_multi_setopt_t *gaus_curl_multi_setopt = curl_multi_setopt;
+curl_multi_socket_action_t *gaus_curl_multi_socket_action = curl_multi_socket_action;
+curl_share_init_t *gaus_curl_share_init = curl_share_init;
+curl_share_setopt_t *gaus_curl_share_setopt = curl_share_setopt;
+curl_share_cleanup_t *gaus_curl_share_cleanup = curl_share_cleanup;
+curl_version_info_t *gaus_curl_version_info = curl_version_info;
@@ -24,6 +24,21 @@ typedef CURLcode (curl_easy_setopt_t)(CURL *curl, CURLoption option, ...);
 typedef void (curl_easy_cleanup_t)(CURL *curl);
 typedef void (curl_global_cleanup_t)(void);
 typedef CURLcode (curl_easy_getinfo_t)(CURL *curl, CURLINFO info, ...);
+typedef void (curl_easy_reset_t)(CURL *curl);
+typedef CURLM *(curl_multi_init_t)(void);
+typedef CURLMcode (curl_multi_add_handle_t)(CURLM *multi, CURL *curl);
+typedef CURLMcode (curl_multi_remove_handle_t)(CURLM *multi, CURL *curl);
+typedef CURLMcode (curl_multi_perform_t)(CURLM *multi, int *running_handles);
+typedef CURLMcode (curl_multi_wait_t)(CURLM *multi, struct curl_waitfd extra_fds[], unsigned int extra_nfds,
+                                      int timeout_ms, int *numfds);
+typedef CURLMsg *(curl_multi_info_read_t)(CURLM *multi, int *msgs_in_queue);
+typedef CURLMcode (curl_multi_cleanup_t)(CURLM *multi);
+typedef CURLMcode (curl_multi_setopt_t)(CURLM *multi, CURLMoption option, ...);
+typedef CURLMcode (curl_multi_socket_action_t)(CURLM *multi, curl_socket_t s, int ev_bitmask, int *running_handles);
+typedef CURLSH *(curl_share_init_t)(void);
+typedef CURLSHcode (curl_share_setopt_t)(CURLSH *share, CURLSHoption option, ...);
+typedef CURLSHcode (curl_share_cleanup_t)(CURLSH *share);
+typedef curl_version_info_data *(curl_version_info_t)(CURLversion version);
 
 extern curl_global_init_t *gaus_curl_global_init;
 extern curl_easy_perform_t *gaus_curl_easy_perform;
@@ -32,6 +47,20 @@ extern curl_easy_setopt_t *gaus_curl_easy_setopt;
 extern curl_easy_cleanup_t *gaus_curl_easy_cleanup;
 extern curl_global_cleanup_t *gaus_curl_global_cleanup;
 extern curl_easy_getinfo_t *gaus_curl_easy_getinfo;
+extern curl_easy_reset_t *gaus_curl_easy_reset;
+extern curl_multi_init_t *gaus_curl_multi_init;
+extern curl_multi_add_handle_t *gaus_curl_multi_add_handle;
+extern curl_multi_remove_handle_t *gaus_curl_multi_remove_handle;
+extern curl_multi_perform_t *gaus_curl_multi_perform;
+extern curl_multi_wait_t *gaus_curl_multi_wait;
+extern curl_multi_info_read_t *gaus_curl_multi_info_read;
+extern curl_multi_cleanup_t *gaus_curl_multi_cleanup;
+extern curl_multi_setopt_t *gaus_curl_multi_setopt;
+extern curl_multi_socket_action_t *gaus_curl_multi_socket_action;
+extern curl_share_init_t *gaus_curl_share_init;
+extern curl_share_setopt_t *gaus_curl_share_setopt;
+extern curl_share_cleanup_t *gaus_curl_share_cleanup;
+extern curl_version_info_t *gaus_curl_version_info;
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,247 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "delta_patch.h"
+#include "log.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define DELTA_MAGIC "ENDSLEY/BSDIFF43"
+#define DELTA_MAGIC_LENGTH 16
+#define DELTA_FIELD_LENGTH 8
+#define DELTA_CHUNK_SIZE (64 * 1024)
+
+typedef enum {
+  DELTA_HEADER,   //Magic and target size
+  DELTA_CONTROL,  //Diff length, extra length and base seek
+  DELTA_DIFF,     //Bytes added to the base
+  DELTA_EXTRA,    //Bytes copied as they are
+  DELTA_DONE
+} delta_state_t;
+
+struct delta_patch {
+  z_stream zstream;
+  bool stream_end;
+  int base_fd;
+  int64_t base_size;
+  delta_output_t output;
+  void *user_data;
+  delta_state_t state;
+  unsigned char fields[DELTA_MAGIC_LENGTH + DELTA_FIELD_LENGTH]; //Header or control triple being collected
+  size_t fields_length;
+  int64_t new_size;
+  int64_t new_pos;
+  int64_t old_pos;
+  int64_t diff_left;
+  int64_t extra_left;
+  int64_t seek;
+  unsigned char inflated[DELTA_CHUNK_SIZE];
+  unsigned char base[DELTA_CHUNK_SIZE];
+};
+
+/* bsdiff stores numbers as 8 bytes little endian magnitude with the sign in the top bit. */
+static int64_t offtin(const unsigned char *buffer) {
+  int64_t value = buffer[7] & 0x7f;
+  for (int i = 6; i >= 0; i--) {
+    value = value * 256 + buffer[i];
+  }
+  return (buffer[7] & 0x80) ? -value : value;
+}
+
+static int damaged(const char *description) {
+  logging(L_ERROR, "delta_patch: damaged patch, %s", description);
+  return -1;
+}
+
+delta_patch_t *delta_patch_create(int base_fd, delta_output_t output, void *user_data) {
+  struct stat base_stat;
+  delta_patch_t *patch;
+
+  if (fstat(base_fd, &base_stat) != 0) {
+    logging(L_ERROR, "delta_patch: unable to read base: %s", strerror(errno));
+    return NULL;
+  }
+  if (!(patch = calloc(1, sizeof(*patch)))) {
+    return NULL;
+  }
+  //32 added to the window bits accepts both gzip and zlib headers.
+  if (inflateInit2(&patch->zstream, 15 + 32) != Z_OK) {
+    free(patch);
+    return NULL;
+  }
+  patch->base_fd = base_fd;
+  patch->base_size = base_stat.st_size;
+  patch->output = output;
+  patch->user_data = user_data;
+  patch->state = DELTA_HEADER;
+  return patch;
+}
+
+/* Fill patch->base with length bytes of the base from old_pos, bytes outside of it read as 0 like in bspatch. */
+static int read_base(delta_patch_t *patch, size_t length) {
+  int64_t start = patch->old_pos < 0 ? 0 : patch->old_pos;
+  int64_t end = patch->old_pos + (int64_t) length > patch->base_size ? patch->base_size
+                                                                     : patch->old_pos + (int64_t) length;
+  size_t done = 0;
+
+  memset(patch->base, 0, length);
+  while (start + (int64_t) done < end) {
+    ssize_t result = pread(patch->base_fd, patch->base + (start - patch->old_pos) + done,
+                           (size_t) (end - start) - done, (off_t) (start + (int64_t) done));
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      logging(L_ERROR, "delta_patch: unable to read base: %s", result < 0 ? strerror(errno) : "file shrank");
+      return -1;
+    }
+    done += (size_t) result;
+  }
+  return 0;
+}
+
+/* Move on from a finished diff or extra block, past empty ones. */
+static void next_block(delta_patch_t *patch) {
+  if (patch->state == DELTA_DIFF && patch->diff_left == 0) {
+    patch->state = DELTA_EXTRA;
+  }
+  if (patch->state == DELTA_EXTRA && patch->extra_left == 0) {
+    patch->old_pos += patch->seek;
+    patch->state = patch->new_pos == patch->new_size ? DELTA_DONE : DELTA_CONTROL;
+  }
+}
+
+static int parse_fields(delta_patch_t *patch) {
+  if (patch->state == DELTA_HEADER) {
+    if (memcmp(patch->fields, DELTA_MAGIC, DELTA_MAGIC_LENGTH) != 0) {
+      return damaged("not an ENDSLEY/BSDIFF43 patch");
+    }
+    if ((patch->new_size = offtin(patch->fields + DELTA_MAGIC_LENGTH)) < 0) {
+      return damaged("negative target size");
+    }
+    patch->state = patch->new_size ? DELTA_CONTROL : DELTA_DONE;
+    return 0;
+  }
+
+  patch->diff_left = offtin(patch->fields);
+  patch->extra_left = offtin(patch->fields + DELTA_FIELD_LENGTH);
+  patch->seek = offtin(patch->fields + 2 * DELTA_FIELD_LENGTH);
+  if (patch->diff_left < 0 || patch->extra_left < 0 ||
+      patch->diff_left > patch->new_size - patch->new_pos ||
+      patch->extra_left > patch->new_size - patch->new_pos - patch->diff_left) {
+    return damaged("block outside of the target");
+  }
+  patch->state = DELTA_DIFF;
+  next_block(patch);
+  return 0;
+}
+
+/* Apply inflated patch bytes, data is modified in place. */
+static int apply(delta_patch_t *patch, unsigned char *data, size_t length) {
+  while (length > 0) {
+    size_t used;
+
+    switch (patch->state) {
+      case DELTA_HEADER:
+      case DELTA_CONTROL: {
+        size_t wanted = patch->state == DELTA_HEADER ? DELTA_MAGIC_LENGTH + DELTA_FIELD_LENGTH
+                                                     : 3 * DELTA_FIELD_LENGTH;
+        used = wanted - patch->fields_length < length ? wanted - patch->fields_length : length;
+        memcpy(patch->fields + patch->fields_length, data, used);
+        patch->fields_length += used;
+        if (patch->fields_length == wanted) {
+          patch->fields_length = 0;
+          if (parse_fields(patch) != 0) {
+            return -1;
+          }
+        }
+        break;
+      }
+      case DELTA_DIFF:
+        used = (int64_t) length < patch->diff_left ? length : (size_t) patch->diff_left;
+        if (read_base(patch, used) != 0) {
+          return -1;
+        }
+        for (size_t i = 0; i < used; i++) {
+          data[i] += patch->base[i];
+        }
+        if (patch->output((const char *) data, used, patch->user_data) != 0) {
+          return -1;
+        }
+        patch->diff_left -= (int64_t) used;
+        patch->new_pos += (int64_t) used;
+        patch->old_pos += (int64_t) used;
+        next_block(patch);
+        break;
+      case DELTA_EXTRA:
+        used = (int64_t) length < patch->extra_left ? length : (size_t) patch->extra_left;
+        if (patch->output((const char *) data, used, patch->user_data) != 0) {
+          return -1;
+        }
+        patch->extra_left -= (int64_t) used;
+        patch->new_pos += (int64_t) used;
+        next_block(patch);
+        break;
+      default:
+        return damaged("data after the end of the target");
+    }
+    data += used;
+    length -= used;
+  }
+  return 0;
+}
+
+int delta_patch_feed(delta_patch_t *patch, const char *data, size_t length) {
+  patch->zstream.next_in = (Bytef *) data;
+  patch->zstream.avail_in = (uInt) length;
+
+  //Keep inflating while input is left or the last call filled the whole buffer, zlib may hold more output.
+  do {
+    int result;
+
+    if (patch->stream_end) {
+      return patch->zstream.avail_in > 0 ? damaged("data after the end of the compressed stream") : 0;
+    }
+    patch->zstream.next_out = patch->inflated;
+    patch->zstream.avail_out = sizeof(patch->inflated);
+    result = inflate(&patch->zstream, Z_NO_FLUSH);
+    if (result == Z_BUF_ERROR) {
+      return 0; //Nothing pending, wait for more input
+    }
+    if (result != Z_OK && result != Z_STREAM_END) {
+      return damaged(patch->zstream.msg ? patch->zstream.msg : "unable to inflate");
+    }
+    patch->stream_end = result == Z_STREAM_END;
+    if (apply(patch, patch->inflated, sizeof(patch->inflated) - patch->zstream.avail_out) != 0) {
+      return -1;
+    }
+  } while (patch->zstream.avail_in > 0 || patch->zstream.avail_out == 0);
+  return 0;
+}
+
+int delta_patch_finish(delta_patch_t *patch) {
+  if (!patch->stream_end || patch->state != DELTA_DONE) {
+    return damaged("patch ends early");
+  }
+  return 0;
+}
+
+void delta_patch_free(delta_patch_t *patch) {
+  if (patch) {
+    inflateEnd(&patch->zstream);
+    free(patch);
+  }
+}
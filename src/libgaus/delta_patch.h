@@ -0,0 +1,41 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_DELTA_PATCH_H
+#define GAUS_DELTA_PATCH_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Applies a delta package while it downloads.  A delta package is a gzip or zlib compressed bsdiff patch in the
+ * streamable ENDSLEY/BSDIFF43 layout, where each control triple is directly followed by its diff and extra bytes, so
+ * the target is rebuilt in order from the base file without holding the patch. */
+typedef struct delta_patch delta_patch_t;
+
+/* Receives the rebuilt target in order, returns 0 to continue. */
+typedef int (*delta_output_t)(const char *data, size_t length, void *user_data);
+
+/* base_fd is the readable installed version the patch applies to. */
+delta_patch_t *delta_patch_create(int base_fd, delta_output_t output, void *user_data);
+
+/* Feed the next bytes of the package, returns -1 if the patch is damaged or output failed. */
+int delta_patch_feed(delta_patch_t *patch, const char *data, size_t length);
+
+/* Returns 0 if the whole patch was fed and the target is complete. */
+int delta_patch_finish(delta_patch_t *patch);
+
+void delta_patch_free(delta_patch_t *patch);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_DELTA_PATCH_H
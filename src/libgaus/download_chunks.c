@@ -0,0 +1,560 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "download_chunks.h"
+#include "chunker.h"
+#include "download_journal.h"
+#include "download_sink.h"
+#include "gaus.h"
+#include "gaus_json_helpers.h"
+#include "log.h"
+#include "md5.h"
+#include "request.h"
+#include "request_ranges.h"
+#include "response_buffer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHUNK_MAX_SIZE (16 * 1024 * 1024)  //Largest chunk accepted from an index
+#define CHUNK_RUN_SIZE (8 * 1024 * 1024)   //Most bytes of missing chunks fetched with one range request
+#define CHUNK_READ_SIZE (1024 * 1024)      //Bytes read at a time when splitting base_path into chunks
+
+typedef enum {
+  CHUNK_FETCH,     //Not found locally, downloaded
+  CHUNK_IN_PLACE,  //Already at its offset in the destination
+  CHUNK_BASE,      //Copied from base_path
+  CHUNK_STORE      //Copied from the chunk store
+} chunk_source_t;
+
+typedef struct {
+  off_t offset;    //Offset of the chunk in the update
+  size_t size;
+  unsigned char md5[MD5_DIGEST_LENGTH];
+  chunk_source_t source;
+  off_t base_offset;
+} chunk_t;
+
+typedef struct {
+  chunk_t *chunks;
+  size_t count;
+  size_t min_size;
+  size_t average_size;
+  size_t max_size;
+} chunk_index_t;
+
+/* Consecutive missing chunks fetched with one range request. */
+typedef struct {
+  download_sink_t *sink;
+  chunk_t *chunk;         //Chunk being received
+  size_t chunk_received;  //Bytes of chunk received so far
+  md5_context_t md5;      //Digest of them
+  bool failed;            //Writing failed, fetching again will not help
+} chunk_run_t;
+
+static int fetch_index(const gaus_session_t *session, const gaus_update_t *update, chunk_index_t *index);
+
+static int find_in_place(chunk_index_t *index, download_sink_t *sink, off_t kept, char *buffer);
+
+static int find_in_base(chunk_index_t *index, const char *base_path);
+
+static int copy_local_chunks(chunk_index_t *index, download_sink_t *sink, const gaus_download_options_t *options,
+                             char *buffer);
+
+static gaus_error_t *fetch_missing_chunks(const gaus_session_t *session, const gaus_update_t *update,
+                                          chunk_index_t *index, download_sink_t *sink,
+                                          const gaus_download_options_t *options, unsigned int max_streams,
+                                          unsigned int max_attempts, bool *unsupported);
+
+static int check_file_md5(download_sink_t *sink, const gaus_update_t *update, char *buffer, size_t buffer_size);
+
+static void add_to_store(const chunk_index_t *index, download_sink_t *sink, const char *store_path, char *buffer);
+
+gaus_error_t *download_chunks(const gaus_session_t *session, const gaus_update_t *update, const char *destination_path,
+                              const gaus_download_options_t *options, unsigned int max_streams,
+                              unsigned int max_attempts, bool *unsupported) {
+  gaus_error_t *status = NULL;
+  chunk_index_t index = {0};
+  download_sink_t sink = {.fd = -1};
+  char *journal_path = NULL;
+  char *buffer = NULL;
+  off_t kept;
+  off_t reused = 0;
+
+  *unsupported = false;
+  if (fetch_index(session, update, &index) != 0) {
+    *unsupported = true;
+    goto out;
+  }
+  if (!(buffer = malloc(index.max_size)) || !(journal_path = download_journal_path(destination_path))) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to download update");
+    goto out;
+  }
+  //The file is written out of order from here on, so the journal no longer describes it.
+  download_journal_remove(journal_path);
+
+  if (download_sink_open(&sink, destination_path) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to open %s", destination_path);
+    goto out;
+  }
+  kept = sink.written < (off_t) update->size ? sink.written : (off_t) update->size;
+  if (download_sink_reset(&sink, kept, update->size) != 0 || find_in_place(&index, &sink, kept, buffer) != 0 ||
+      (options->base_path && find_in_base(&index, options->base_path) != 0) ||
+      copy_local_chunks(&index, &sink, options, buffer) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to prepare %s", destination_path);
+    goto out;
+  }
+  for (size_t i = 0; i < index.count; i++) {
+    reused += index.chunks[i].source == CHUNK_FETCH ? 0 : (off_t) index.chunks[i].size;
+  }
+  logging(L_INFO, "Reusing %lld of %u bytes of %s", (long long) reused, update->size, update->update_id);
+
+  if ((status = fetch_missing_chunks(session, update, &index, &sink, options, max_streams, max_attempts,
+                                     unsupported)) || *unsupported) {
+    goto out;
+  }
+  if (check_file_md5(&sink, update, buffer, index.max_size) != 0) {
+    status = gaus_create_error(__func__, GAUS_CHECKSUM_ERROR, 500, "Download of %s does not match md5 %s",
+                               update->download_url, update->md5);
+    goto out;
+  }
+  if (download_sink_flush(&sink, 1) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to write %s", destination_path);
+    goto out;
+  }
+  if (options->chunk_store_path) {
+    add_to_store(&index, &sink, options->chunk_store_path, buffer);
+  }
+
+  out:
+  if (sink.fd >= 0 && download_sink_close(&sink) != 0 && !status) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to close %s", destination_path);
+  }
+  free(index.chunks);
+  free(buffer);
+  free(journal_path);
+  return status;
+}
+
+static int fetch_index(const gaus_session_t *session, const gaus_update_t *update, chunk_index_t *index) {
+  long status_code = 0;
+  char *raw_index = NULL;
+  json_t *json_index = NULL;
+  json_t *json_chunks;
+  json_error_t json_error;
+  chunker_t chunker;
+  off_t offset = 0;
+  int result = -1;
+
+  if (!(raw_index = request_get_as_string(update->chunk_index_url, session->token, &status_code))) {
+    logging(L_WARNING, "Unable to get chunk index %s", update->chunk_index_url);
+    goto out;
+  }
+  if (!(json_index = json_loads(raw_index, 0, &json_error))) {
+    logging(L_WARNING, "Error parsing chunk index: %s", json_error.text);
+    goto out;
+  }
+  index->min_size = (size_t) get_dict_int(json_index, CHUNK_MIN_SIZE_JSON, 0);
+  index->average_size = (size_t) get_dict_int(json_index, CHUNK_AVERAGE_SIZE_JSON, 0);
+  index->max_size = (size_t) get_dict_int(json_index, CHUNK_MAX_SIZE_JSON, 0);
+  json_chunks = json_object_get(json_index, CHUNKS_JSON);
+  if (!json_is_array(json_chunks) || index->max_size > CHUNK_MAX_SIZE ||
+      chunker_init(&chunker, index->min_size, index->average_size, index->max_size) != 0) {
+    logging(L_WARNING, "Chunk index %s is invalid", update->chunk_index_url);
+    goto out;
+  }
+
+  index->count = json_array_size(json_chunks);
+  if (!(index->chunks = calloc(index->count ? index->count : 1, sizeof(chunk_t)))) {
+    goto out;
+  }
+  for (size_t i = 0; i < index->count; i++) {
+    json_t *json_chunk = json_array_get(json_chunks, i);
+    chunk_t *chunk = &index->chunks[i];
+    int size = get_dict_int(json_chunk, SIZE_JSON, 0);
+
+    if (size <= 0 || (size_t) size > index->max_size ||
+        md5_from_hex(get_dict_string(json_chunk, MD5_JSON, NULL), chunk->md5) != 0) {
+      logging(L_WARNING, "Chunk %zu in chunk index %s is invalid", i, update->chunk_index_url);
+      goto out;
+    }
+    chunk->offset = offset;
+    chunk->size = (size_t) size;
+    offset += size;
+  }
+  if (offset != (off_t) update->size) {
+    logging(L_WARNING, "Chunk index %s covers %lld bytes, not %u", update->chunk_index_url, (long long) offset,
+            update->size);
+    goto out;
+  }
+  result = 0;
+
+  out:
+  if (result != 0) {
+    free(index->chunks);
+    index->chunks = NULL;
+    index->count = 0;
+  }
+  json_decref(json_index);
+  response_buffer_free(raw_index);
+  return result;
+}
+
+static int read_all(int fd, char *buffer, size_t length, off_t offset) {
+  size_t done = 0;
+
+  while (done < length) {
+    ssize_t result = pread(fd, buffer + done, length - done, offset + (off_t) done);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return -1;
+    }
+    done += (size_t) result;
+  }
+  return 0;
+}
+
+static bool chunk_matches(const chunk_t *chunk, const char *data) {
+  md5_context_t md5;
+  unsigned char digest[MD5_DIGEST_LENGTH];
+
+  md5_init(&md5);
+  md5_update(&md5, data, chunk->size);
+  md5_final(&md5, digest);
+  return memcmp(digest, chunk->md5, MD5_DIGEST_LENGTH) == 0;
+}
+
+/* Keep the chunks an earlier, interrupted download already wrote. */
+static int find_in_place(chunk_index_t *index, download_sink_t *sink, off_t kept, char *buffer) {
+  for (size_t i = 0; i < index->count && index->chunks[i].offset + (off_t) index->chunks[i].size <= kept; i++) {
+    chunk_t *chunk = &index->chunks[i];
+    if (read_all(sink->fd, buffer, chunk->size, chunk->offset) != 0) {
+      logging(L_ERROR, "Unable to read back downloaded chunks: %s", strerror(errno));
+      return -1;
+    }
+    if (chunk_matches(chunk, buffer)) {
+      chunk->source = CHUNK_IN_PLACE;
+    }
+  }
+  return 0;
+}
+
+static int compare_chunk_md5(const void *a, const void *b) {
+  return memcmp((*(const chunk_t *const *) a)->md5, (*(const chunk_t *const *) b)->md5, MD5_DIGEST_LENGTH);
+}
+
+/* Point every missing chunk with the digest of the base_path chunk at offset to it. */
+static void match_base_chunk(chunk_t **by_md5, size_t count, md5_context_t *md5, off_t offset, size_t size) {
+  chunk_t key = {0};
+  chunk_t *key_pointer = &key;
+  chunk_t **match;
+
+  md5_final(md5, key.md5);
+  if (!(match = bsearch(&key_pointer, by_md5, count, sizeof(chunk_t *), compare_chunk_md5))) {
+    return;
+  }
+  while (match > by_md5 && compare_chunk_md5(match - 1, &key_pointer) == 0) {
+    match--;
+  }
+  for (; match < by_md5 + count && compare_chunk_md5(match, &key_pointer) == 0; match++) {
+    if ((*match)->size == size) {
+      (*match)->source = CHUNK_BASE;
+      (*match)->base_offset = offset;
+    }
+  }
+}
+
+/* Split base_path into chunks the way the update was split, and look for the missing ones among them. */
+static int find_in_base(chunk_index_t *index, const char *base_path) {
+  chunk_t **by_md5 = NULL;
+  unsigned char *buffer = NULL;
+  size_t missing = 0;
+  chunker_t chunker;
+  md5_context_t md5;
+  off_t chunk_start = 0;
+  off_t position = 0;
+  ssize_t length;
+  int fd = -1;
+  int result = -1;
+
+  if (!(by_md5 = malloc(sizeof(chunk_t *) * (index->count ? index->count : 1))) ||
+      !(buffer = malloc(CHUNK_READ_SIZE))) {
+    goto out;
+  }
+  for (size_t i = 0; i < index->count; i++) {
+    if (index->chunks[i].source == CHUNK_FETCH) {
+      by_md5[missing++] = &index->chunks[i];
+    }
+  }
+  qsort(by_md5, missing, sizeof(chunk_t *), compare_chunk_md5);
+  if ((fd = open(base_path, O_RDONLY | O_CLOEXEC)) < 0) {
+    //Without a base every chunk is fetched, that is slower but still works.
+    logging(L_WARNING, "Unable to read %s: %s", base_path, strerror(errno));
+    result = 0;
+    goto out;
+  }
+
+  chunker_init(&chunker, index->min_size, index->average_size, index->max_size);
+  md5_init(&md5);
+  while (missing > 0 && (length = read(fd, buffer, CHUNK_READ_SIZE)) != 0) {
+    size_t done = 0;
+    if (length < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      logging(L_WARNING, "Unable to read %s: %s", base_path, strerror(errno));
+      break;
+    }
+    while (done < (size_t) length) {
+      size_t end = chunker_scan(&chunker, buffer + done, (size_t) length - done);
+      size_t part = end ? end : (size_t) length - done;
+      md5_update(&md5, buffer + done, part);
+      done += part;
+      position += (off_t) part;
+      if (end) {
+        match_base_chunk(by_md5, missing, &md5, chunk_start, (size_t) (position - chunk_start));
+        chunk_start = position;
+        md5_init(&md5);
+      }
+    }
+  }
+  if (missing > 0 && position > chunk_start) {
+    match_base_chunk(by_md5, missing, &md5, chunk_start, (size_t) (position - chunk_start));
+  }
+  result = 0;
+
+  out:
+  if (fd >= 0) {
+    close(fd);
+  }
+  free(buffer);
+  free(by_md5);
+  return result;
+}
+
+static char *store_chunk_path(const char *store_path, const chunk_t *chunk) {
+  char hex[MD5_HEX_LENGTH + 1];
+  size_t length = strlen(store_path) + MD5_HEX_LENGTH + sizeof("/.tmp");
+  char *path = malloc(length);
+
+  if (path) {
+    md5_to_hex(chunk->md5, hex);
+    snprintf(path, length, "%s/%s", store_path, hex);
+  }
+  return path;
+}
+
+/* Copy chunk from offset of fd into place.  Returns 1 if the data there does not match, it is then fetched. */
+static int copy_chunk(chunk_t *chunk, int fd, off_t offset, download_sink_t *sink, char *buffer) {
+  if (read_all(fd, buffer, chunk->size, offset) != 0 || !chunk_matches(chunk, buffer)) {
+    return 1;
+  }
+  return download_sink_write_at(sink, chunk->offset, buffer, chunk->size);
+}
+
+static int copy_local_chunks(chunk_index_t *index, download_sink_t *sink, const gaus_download_options_t *options,
+                             char *buffer) {
+  int base_fd = options->base_path ? open(options->base_path, O_RDONLY | O_CLOEXEC) : -1;
+  int result = 0;
+
+  for (size_t i = 0; i < index->count && result >= 0; i++) {
+    chunk_t *chunk = &index->chunks[i];
+
+    if (chunk->source == CHUNK_BASE && (result = copy_chunk(chunk, base_fd, chunk->base_offset, sink, buffer)) > 0) {
+      //base_path changed since it was split into chunks.
+      chunk->source = CHUNK_FETCH;
+    }
+    if (chunk->source == CHUNK_FETCH && options->chunk_store_path) {
+      char *path = store_chunk_path(options->chunk_store_path, chunk);
+      int fd = path ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+      if (fd >= 0 && (result = copy_chunk(chunk, fd, 0, sink, buffer)) == 0) {
+        chunk->source = CHUNK_STORE;
+      }
+      if (fd >= 0) {
+        close(fd);
+      }
+      free(path);
+    }
+  }
+  if (base_fd >= 0) {
+    close(base_fd);
+  }
+  return result < 0 ? -1 : 0;
+}
+
+static int run_writer(request_range_t *range, const char *data, size_t length) {
+  chunk_run_t *run = range->user_data;
+
+  if (download_sink_write_at(run->sink, (off_t) (range->offset + range->received), data, length) != 0) {
+    run->failed = true;
+    return -1;
+  }
+  while (length > 0) {
+    size_t part = run->chunk->size - run->chunk_received < length ? run->chunk->size - run->chunk_received : length;
+    md5_update(&run->md5, data, part);
+    run->chunk_received += part;
+    data += part;
+    length -= part;
+    if (run->chunk_received == run->chunk->size) {
+      unsigned char digest[MD5_DIGEST_LENGTH];
+      md5_final(&run->md5, digest);
+      if (memcmp(digest, run->chunk->md5, MD5_DIGEST_LENGTH) != 0) {
+        logging(L_ERROR, "Chunk at byte %lld does not match its md5", (long long) run->chunk->offset);
+        return -1;
+      }
+      run->chunk++;
+      run->chunk_received = 0;
+      md5_init(&run->md5);
+    }
+  }
+  return 0;
+}
+
+static gaus_error_t *fetch_missing_chunks(const gaus_session_t *session, const gaus_update_t *update,
+                                          chunk_index_t *index, download_sink_t *sink,
+                                          const gaus_download_options_t *options, unsigned int max_streams,
+                                          unsigned int max_attempts, bool *unsupported) {
+  gaus_error_t *status = NULL;
+  request_speed_floor_t floor = {(long) options->min_speed, (long) options->min_speed_time};
+  stream_control_t control;
+  request_range_t *ranges = NULL;
+  chunk_run_t *runs = NULL;
+  size_t count = 0;
+  long status_code = 0;
+  unsigned int attempt;
+  int result = 0;
+
+  if (!(ranges = calloc(index->count ? index->count : 1, sizeof(request_range_t))) ||
+      !(runs = calloc(index->count ? index->count : 1, sizeof(chunk_run_t)))) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to download update");
+    goto out;
+  }
+  for (size_t i = 0; i < index->count; i++) {
+    chunk_t *chunk = &index->chunks[i];
+    if (chunk->source != CHUNK_FETCH) {
+      continue;
+    }
+    //Extend the previous run if this chunk directly follows it.
+    if (count > 0 && ranges[count - 1].offset + ranges[count - 1].length == chunk->offset &&
+        ranges[count - 1].length + (curl_off_t) chunk->size <= CHUNK_RUN_SIZE) {
+      ranges[count - 1].length += (curl_off_t) chunk->size;
+      continue;
+    }
+    ranges[count].offset = chunk->offset;
+    ranges[count].length = (curl_off_t) chunk->size;
+    ranges[count].user_data = &runs[count];
+    runs[count].sink = sink;
+    runs[count].chunk = chunk;
+    count++;
+  }
+
+  stream_control_init(&control, max_streams);
+  for (attempt = 0; attempt < max_attempts && count > 0; attempt++) {
+    //Continue each run from the first chunk that was not completely received.
+    for (size_t i = 0; i < count; i++) {
+      if (ranges[i].received < ranges[i].length) {
+        ranges[i].received = runs[i].chunk->offset - ranges[i].offset;
+        runs[i].chunk_received = 0;
+        md5_init(&runs[i].md5);
+      }
+    }
+
+    result = request_get_ranges(update->download_url, session->token, ranges, count, &control, BANDWIDTH_BULK,
+                                &floor, run_writer);
+    for (size_t i = 0; i < count; i++) {
+      if (runs[i].failed) {
+        status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to write chunks of %s",
+                                   update->update_id);
+        goto out;
+      }
+      if (ranges[i].received < ranges[i].length && ranges[i].status_code) {
+        status_code = ranges[i].status_code;
+      }
+    }
+    if (result == 0) {
+      break;
+    }
+    if (result == 1) {
+      *unsupported = true;
+      goto out;
+    }
+    if (status_code >= 400 && status_code < 500) {
+      break;
+    }
+  }
+
+  if (result != 0 && status_code >= 400) {
+    status = gaus_create_error(__func__, GAUS_HTTP_ERROR, status_code,
+                               "Download failed with http error code %ld from url %s", status_code,
+                               update->download_url);
+  } else if (result != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Download of %s incomplete after %u attempts",
+                               update->download_url, attempt);
+  }
+
+  out:
+  free(ranges);
+  free(runs);
+  return status;
+}
+
+static int check_file_md5(download_sink_t *sink, const gaus_update_t *update, char *buffer, size_t buffer_size) {
+  md5_context_t md5;
+  unsigned char digest[MD5_DIGEST_LENGTH];
+
+  md5_init(&md5);
+  for (off_t offset = 0; offset < (off_t) update->size; offset += (off_t) buffer_size) {
+    size_t length = (off_t) update->size - offset < (off_t) buffer_size ? (size_t) (update->size - offset)
+                                                                         : buffer_size;
+    if (read_all(sink->fd, buffer, length, offset) != 0) {
+      logging(L_ERROR, "Unable to read back download: %s", strerror(errno));
+      return -1;
+    }
+    md5_update(&md5, buffer, length);
+  }
+  md5_final(&md5, digest);
+  return md5_compare_hex(digest, update->md5);
+}
+
+/* Keep the downloaded chunks for later updates.  The store is only a cache, so failures are not errors. */
+static void add_to_store(const chunk_index_t *index, download_sink_t *sink, const char *store_path, char *buffer) {
+  for (size_t i = 0; i < index->count; i++) {
+    const chunk_t *chunk = &index->chunks[i];
+    char *path = NULL;
+    char *temporary_path = NULL;
+    int fd = -1;
+    bool stored = false;
+
+    if (chunk->source != CHUNK_FETCH) {
+      continue;
+    }
+    if ((path = store_chunk_path(store_path, chunk)) && (temporary_path = malloc(strlen(path) + sizeof(".tmp"))) &&
+        read_all(sink->fd, buffer, chunk->size, chunk->offset) == 0) {
+      sprintf(temporary_path, "%s.tmp", path);
+      fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      stored = fd >= 0 && write(fd, buffer, chunk->size) == (ssize_t) chunk->size;
+      stored = fd >= 0 && close(fd) == 0 && stored && rename(temporary_path, path) == 0;
+      if (!stored && fd >= 0) {
+        unlink(temporary_path);
+      }
+    }
+    free(path);
+    free(temporary_path);
+    if (!stored) {
+      logging(L_WARNING, "Unable to add chunks to %s: %s", store_path, strerror(errno));
+      return;
+    }
+  }
+}
@@ -0,0 +1,31 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_DOWNLOAD_CHUNKS_H
+#define GAUS_DOWNLOAD_CHUNKS_H
+
+#include "gaus/gaus_client_types.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Assemble update at destination_path from the chunks listed in its chunk index.  Chunks already in place, in
+ * options->base_path or in options->chunk_store_path are copied and only the others are downloaded, over up to
+ * max_streams concurrent Range requests.  Each chunk is checked against its md5.  Sets *unsupported and returns NULL if
+ * the index or ranges cannot be used, the update then has to be downloaded as a whole. */
+gaus_error_t *download_chunks(const gaus_session_t *session, const gaus_update_t *update, const char *destination_path,
+                              const gaus_download_options_t *options, unsigned int max_streams,
+                              unsigned int max_attempts, bool *unsupported);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_DOWNLOAD_CHUNKS_H
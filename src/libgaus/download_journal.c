@@ -0,0 +1,168 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "download_journal.h"
+#include "log.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DOWNLOAD_JOURNAL_SUFFIX ".journal"
+#define DOWNLOAD_JOURNAL_MAGIC "gaus-download-journal 2"
+
+static char *path_with_suffix(const char *path, const char *suffix) {
+  size_t length = strlen(path) + strlen(suffix) + 1;
+  char *result = malloc(length);
+  if (result) {
+    snprintf(result, length, "%s%s", path, suffix);
+  }
+  return result;
+}
+
+char *download_journal_path(const char *destination_path) {
+  return path_with_suffix(destination_path, DOWNLOAD_JOURNAL_SUFFIX);
+}
+
+/* Read one "<name> <value>" line, returns the value without its newline or NULL. */
+static char *read_field(FILE *file, const char *name, char *line, size_t line_size) {
+  size_t name_length = strlen(name);
+  if (!fgets(line, (int) line_size, file)) {
+    return NULL;
+  }
+  line[strcspn(line, "\n")] = '\0';
+  if (strncmp(line, name, name_length) != 0 || line[name_length] != ' ') {
+    return NULL;
+  }
+  return line + name_length + 1;
+}
+
+static int same_field(FILE *file, const char *name, const char *expected) {
+  char line[1024];
+  const char *value = read_field(file, name, line, sizeof(line));
+  return value && strcmp(value, expected ? expected : "") == 0;
+}
+
+/* Parse "<a> <b> <c> <d> [buffer]" as written by write_md5_state, the buffer holds offset % 64 bytes in hex. */
+static int read_md5_state(const char *value, off_t offset, md5_context_t *md5) {
+  md5_context_t state;
+  size_t buffered = (size_t) offset % MD5_BLOCK_LENGTH;
+  int consumed = 0;
+
+  if (sscanf(value, "%8" SCNx32 " %8" SCNx32 " %8" SCNx32 " %8" SCNx32 "%n", &state.state[0], &state.state[1],
+             &state.state[2], &state.state[3], &consumed) != 4) {
+    return -1;
+  }
+  value += consumed;
+  if (buffered > 0 && *value++ != ' ') {
+    return -1;
+  }
+  for (size_t i = 0; i < buffered; i++) {
+    unsigned int byte;
+    if (sscanf(value + i * 2, "%2x", &byte) != 1) {
+      return -1;
+    }
+    state.buffer[i] = (unsigned char) byte;
+  }
+  if (strlen(value) != buffered * 2) {
+    return -1;
+  }
+  state.count = (uint64_t) offset;
+  *md5 = state;
+  return 0;
+}
+
+static void write_md5_state(FILE *file, const md5_context_t *md5) {
+  fprintf(file, "md5_state %08" PRIx32 " %08" PRIx32 " %08" PRIx32 " %08" PRIx32, md5->state[0], md5->state[1],
+          md5->state[2], md5->state[3]);
+  if (md5->count % MD5_BLOCK_LENGTH > 0) {
+    fputc(' ', file);
+    for (size_t i = 0; i < md5->count % MD5_BLOCK_LENGTH; i++) {
+      fprintf(file, "%02x", md5->buffer[i]);
+    }
+  }
+  fputc('\n', file);
+}
+
+off_t download_journal_read(const char *path, const gaus_update_t *update, md5_context_t *md5) {
+  char line[1024];
+  char size[32];
+  off_t offset = 0;
+  FILE *file = fopen(path, "r");
+
+  if (!file) {
+    return 0;
+  }
+  snprintf(size, sizeof(size), "%u", update->size);
+  if (fgets(line, sizeof(line), file) && strncmp(line, DOWNLOAD_JOURNAL_MAGIC "\n", sizeof(line)) == 0 &&
+      same_field(file, "update_id", update->update_id) &&
+      same_field(file, "size", size) &&
+      same_field(file, "md5", update->md5)) {
+    const char *value = read_field(file, "offset", line, sizeof(line));
+    if (value) {
+      offset = (off_t) strtoll(value, NULL, 10);
+    }
+    if (offset > 0 && (!(value = read_field(file, "md5_state", line, sizeof(line))) ||
+                       read_md5_state(value, offset, md5) != 0)) {
+      logging(L_WARNING, "download_journal: %s is damaged, starting over", path);
+      offset = 0;
+    }
+  } else {
+    logging(L_INFO, "download_journal: %s belongs to another update, starting over", path);
+  }
+  fclose(file);
+  return offset > 0 ? offset : 0;
+}
+
+int download_journal_write(const char *path, const gaus_update_t *update, off_t offset, const md5_context_t *md5) {
+  char *temporary_path = path_with_suffix(path, ".tmp");
+  FILE *file = NULL;
+
+  if (!temporary_path || !(file = fopen(temporary_path, "w"))) {
+    goto error;
+  }
+  fprintf(file, DOWNLOAD_JOURNAL_MAGIC "\nupdate_id %s\nsize %u\nmd5 %s\noffset %lld\n",
+          update->update_id ? update->update_id : "", update->size, update->md5 ? update->md5 : "",
+          (long long) offset);
+  write_md5_state(file, md5);
+  if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+    goto error;
+  }
+  if (fclose(file) != 0) {
+    file = NULL;
+    goto error;
+  }
+  file = NULL;
+  //rename replaces the old journal atomically, a crash leaves either the old or the new one.
+  if (rename(temporary_path, path) != 0) {
+    goto error;
+  }
+  free(temporary_path);
+  return 0;
+
+  error:
+  logging(L_WARNING, "download_journal: unable to write %s: %s", path, strerror(errno));
+  if (file) {
+    fclose(file);
+  }
+  if (temporary_path) {
+    unlink(temporary_path);
+  }
+  free(temporary_path);
+  return -1;
+}
+
+void download_journal_remove(const char *path) {
+  if (unlink(path) != 0 && errno != ENOENT) {
+    logging(L_WARNING, "download_journal: unable to remove %s: %s", path, strerror(errno));
+  }
+}
@@ -0,0 +1,41 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_DOWNLOAD_JOURNAL_H
+#define GAUS_DOWNLOAD_JOURNAL_H
+
+#include "gaus/gaus_client_types.h"
+#include "md5.h"
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The journal records which update a partially downloaded file belongs to, how many of its bytes are known to be on
+ * disk and the MD5 state after them, so an interrupted download can be resumed after a restart without reading the
+ * file again. */
+
+/* The journal path for a download to destination_path, freed by the caller. */
+char *download_journal_path(const char *destination_path);
+
+/* Returns the number of bytes recorded for update in the journal at path and restores md5 to its state after them.
+ * Returns 0 and leaves md5 alone if there is no journal or it belongs to another update. */
+off_t download_journal_read(const char *path, const gaus_update_t *update, md5_context_t *md5);
+
+/* Atomically replace the journal at path.  The caller makes sure offset bytes are on disk first and that md5 has
+ * hashed exactly those. */
+int download_journal_write(const char *path, const gaus_update_t *update, off_t offset, const md5_context_t *md5);
+
+void download_journal_remove(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_DOWNLOAD_JOURNAL_H
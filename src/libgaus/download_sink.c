@@ -0,0 +1,371 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#define _GNU_SOURCE //fallocate, O_DIRECT
+#include "download_sink.h"
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DOWNLOAD_SINK_BUFFER_SIZE (512 * 1024)
+#define DOWNLOAD_SINK_ALIGNMENT 4096
+//Buffers of a direct sink, one fills while the others wait for or are being written.
+#define DOWNLOAD_SINK_DIRECT_BUFFERS 4
+#define DOWNLOAD_SINK_DIRECT_WRITERS 2
+
+typedef enum {
+  BUFFER_FREE,
+  BUFFER_FILLING,
+  BUFFER_QUEUED,
+  BUFFER_WRITING
+} buffer_state_t;
+
+struct download_sink_direct {
+  int fd;                  //The file opened with O_DIRECT
+  pthread_mutex_t lock;
+  pthread_cond_t changed;  //A buffer changed state
+  pthread_t writers[DOWNLOAD_SINK_DIRECT_WRITERS];
+  size_t writer_count;
+  struct {
+    char *data;
+    size_t length;
+    off_t offset;
+    buffer_state_t state;
+  } buffers[DOWNLOAD_SINK_DIRECT_BUFFERS];
+  size_t filling;          //The buffer at sink->buffer
+  off_t end;               //Where the filling buffer goes, always aligned
+  bool failed;             //A write failed, cleared by download_sink_reset
+  bool stopping;
+};
+
+static int write_all(int fd, const char *data, size_t length, off_t offset) {
+  size_t written = 0;
+
+  while (written < length) {
+    ssize_t result = pwrite(fd, data + written, length - written, offset + (off_t) written);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      logging(L_ERROR, "download_sink: write failed: %s", strerror(errno));
+      return -1;
+    }
+    written += (size_t) result;
+  }
+  return 0;
+}
+
+int download_sink_open(download_sink_t *sink, const char *path) {
+  struct stat file_stat;
+  void *buffer = NULL;
+
+  sink->fd = -1;
+  sink->buffer = NULL;
+  sink->buffered = 0;
+  sink->written = 0;
+  sink->device = false;
+  sink->direct = NULL;
+  if (posix_memalign(&buffer, DOWNLOAD_SINK_ALIGNMENT, DOWNLOAD_SINK_BUFFER_SIZE) != 0) {
+    logging(L_ERROR, "download_sink: not enough memory for the write buffer");
+    return -1;
+  }
+  sink->buffer = buffer;
+  if ((sink->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0 || fstat(sink->fd, &file_stat) != 0) {
+    logging(L_ERROR, "download_sink: unable to open %s: %s", path, strerror(errno));
+    download_sink_close(sink);
+    return -1;
+  }
+  sink->written = file_stat.st_size;
+  if (S_ISBLK(file_stat.st_mode)) {
+    //A partition holds whatever was written to it last, its whole size is there to resume from.
+    unsigned long long size = 0;
+    sink->device = true;
+    sink->written = ioctl(sink->fd, BLKGETSIZE64, &size) == 0 ? (off_t) size : 0;
+  }
+  return 0;
+}
+
+static void *direct_writer(void *arg) {
+  download_sink_direct_t *direct = arg;
+
+  pthread_mutex_lock(&direct->lock);
+  while (!direct->stopping) {
+    size_t next = DOWNLOAD_SINK_DIRECT_BUFFERS;
+    int result;
+
+    //Oldest first, so the file grows in order.
+    for (size_t i = 0; i < DOWNLOAD_SINK_DIRECT_BUFFERS; i++) {
+      if (direct->buffers[i].state == BUFFER_QUEUED &&
+          (next == DOWNLOAD_SINK_DIRECT_BUFFERS || direct->buffers[i].offset < direct->buffers[next].offset)) {
+        next = i;
+      }
+    }
+    if (next == DOWNLOAD_SINK_DIRECT_BUFFERS) {
+      pthread_cond_wait(&direct->changed, &direct->lock);
+      continue;
+    }
+    direct->buffers[next].state = BUFFER_WRITING;
+    pthread_mutex_unlock(&direct->lock);
+    result = write_all(direct->fd, direct->buffers[next].data, direct->buffers[next].length,
+                       direct->buffers[next].offset);
+    pthread_mutex_lock(&direct->lock);
+    if (result != 0) {
+      direct->failed = true;
+    }
+    direct->buffers[next].state = BUFFER_FREE;
+    pthread_cond_broadcast(&direct->changed);
+  }
+  pthread_mutex_unlock(&direct->lock);
+  return NULL;
+}
+
+/* Stop the writers, queued buffers are dropped. */
+static void direct_close(download_sink_t *sink) {
+  download_sink_direct_t *direct = sink->direct;
+
+  pthread_mutex_lock(&direct->lock);
+  direct->stopping = true;
+  pthread_cond_broadcast(&direct->changed);
+  pthread_mutex_unlock(&direct->lock);
+  for (size_t i = 0; i < direct->writer_count; i++) {
+    pthread_join(direct->writers[i], NULL);
+  }
+  pthread_cond_destroy(&direct->changed);
+  pthread_mutex_destroy(&direct->lock);
+  close(direct->fd);
+  for (size_t i = 0; i < DOWNLOAD_SINK_DIRECT_BUFFERS; i++) {
+    free(direct->buffers[i].data);
+  }
+  //The buffer of the sink is one of the direct ones.
+  sink->buffer = NULL;
+  free(direct);
+  sink->direct = NULL;
+}
+
+int download_sink_open_direct(download_sink_t *sink, const char *path) {
+  download_sink_direct_t *direct;
+
+  if (download_sink_open(sink, path) != 0) {
+    return -1;
+  }
+  if (!(direct = calloc(1, sizeof(*direct)))) {
+    download_sink_close(sink);
+    return -1;
+  }
+  if ((direct->fd = open(path, O_WRONLY | O_DIRECT | O_CLOEXEC)) < 0) {
+    logging(L_WARNING, "download_sink: writing %s through the page cache, no direct I/O: %s", path,
+            strerror(errno));
+    free(direct);
+    return 0;
+  }
+  pthread_mutex_init(&direct->lock, NULL);
+  pthread_cond_init(&direct->changed, NULL);
+  direct->buffers[0].data = sink->buffer;
+  direct->buffers[0].state = BUFFER_FILLING;
+  sink->direct = direct;
+  for (size_t i = 1; i < DOWNLOAD_SINK_DIRECT_BUFFERS; i++) {
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, DOWNLOAD_SINK_ALIGNMENT, DOWNLOAD_SINK_BUFFER_SIZE) != 0) {
+      logging(L_ERROR, "download_sink: not enough memory for the write buffers");
+      download_sink_close(sink);
+      return -1;
+    }
+    direct->buffers[i].data = buffer;
+  }
+  for (; direct->writer_count < DOWNLOAD_SINK_DIRECT_WRITERS; direct->writer_count++) {
+    if (pthread_create(&direct->writers[direct->writer_count], NULL, direct_writer, direct) != 0) {
+      logging(L_ERROR, "download_sink: unable to start writers");
+      download_sink_close(sink);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Queue the first length bytes of the filling buffer, an aligned amount, and carry the rest over to a free one. */
+static int direct_submit(download_sink_t *sink, size_t length) {
+  download_sink_direct_t *direct = sink->direct;
+  size_t carry = sink->buffered - length;
+  size_t next = DOWNLOAD_SINK_DIRECT_BUFFERS;
+  char *queued = sink->buffer;
+
+  pthread_mutex_lock(&direct->lock);
+  direct->buffers[direct->filling].length = length;
+  direct->buffers[direct->filling].offset = direct->end;
+  direct->buffers[direct->filling].state = BUFFER_QUEUED;
+  direct->end += (off_t) length;
+  pthread_cond_broadcast(&direct->changed);
+  while (!direct->failed) {
+    for (next = 0; next < DOWNLOAD_SINK_DIRECT_BUFFERS && direct->buffers[next].state != BUFFER_FREE; next++) {
+    }
+    if (next < DOWNLOAD_SINK_DIRECT_BUFFERS) {
+      break;
+    }
+    pthread_cond_wait(&direct->changed, &direct->lock);
+  }
+  if (direct->failed) {
+    pthread_mutex_unlock(&direct->lock);
+    return -1;
+  }
+  direct->buffers[next].state = BUFFER_FILLING;
+  direct->filling = next;
+  pthread_mutex_unlock(&direct->lock);
+
+  //The writers only read the queued buffer, so the carry is copied from it without the lock.
+  sink->buffer = direct->buffers[next].data;
+  memcpy(sink->buffer, queued + length, carry);
+  sink->buffered = carry;
+  return 0;
+}
+
+/* Wait until every queued buffer is written. */
+static int direct_drain(download_sink_direct_t *direct) {
+  bool busy = true;
+  int result;
+
+  pthread_mutex_lock(&direct->lock);
+  while (busy) {
+    busy = false;
+    for (size_t i = 0; i < DOWNLOAD_SINK_DIRECT_BUFFERS; i++) {
+      busy = busy || direct->buffers[i].state == BUFFER_QUEUED || direct->buffers[i].state == BUFFER_WRITING;
+    }
+    if (busy) {
+      pthread_cond_wait(&direct->changed, &direct->lock);
+    }
+  }
+  result = direct->failed ? -1 : 0;
+  pthread_mutex_unlock(&direct->lock);
+  return result;
+}
+
+int download_sink_reset(download_sink_t *sink, off_t offset, off_t size) {
+  sink->buffered = 0;
+  if (sink->direct) {
+    direct_drain(sink->direct);
+    sink->direct->failed = false;
+  }
+  //A partition has a fixed size, there is nothing to truncate or reserve.
+  if (!sink->device && ftruncate(sink->fd, offset) != 0) {
+    logging(L_ERROR, "download_sink: unable to truncate: %s", strerror(errno));
+    return -1;
+  }
+  sink->written = offset;
+  if (sink->direct) {
+    //Direct writes start at a block, the part of it that is already there is written again with the rest.
+    off_t start = offset & ~((off_t) DOWNLOAD_SINK_ALIGNMENT - 1);
+    sink->direct->end = start;
+    sink->buffered = (size_t) (offset - start);
+    if (sink->buffered > 0 && pread(sink->fd, sink->buffer, sink->buffered, start) != (ssize_t) sink->buffered) {
+      logging(L_ERROR, "download_sink: unable to read back the block at %lld", (long long) start);
+      sink->buffered = 0;
+      return -1;
+    }
+  }
+  //Reserve the rest in one piece so it is not fragmented.  The size is kept, it tells how far the download got.
+  if (!sink->device && size > offset && fallocate(sink->fd, FALLOC_FL_KEEP_SIZE, offset, size - offset) != 0) {
+    if (errno == ENOSPC) {
+      logging(L_ERROR, "download_sink: no room for %lld bytes", (long long) size);
+      return -1;
+    }
+    logging(L_DEBUG, "download_sink: unable to preallocate: %s", strerror(errno));
+  }
+  return 0;
+}
+
+int download_sink_write(download_sink_t *sink, const char *data, size_t length) {
+  if (sink->direct) {
+    //Everything is copied, O_DIRECT needs aligned memory.
+    while (length > 0) {
+      size_t count = DOWNLOAD_SINK_BUFFER_SIZE - sink->buffered < length ? DOWNLOAD_SINK_BUFFER_SIZE - sink->buffered
+                                                                         : length;
+      memcpy(sink->buffer + sink->buffered, data, count);
+      sink->buffered += count;
+      data += count;
+      length -= count;
+      if (sink->buffered == DOWNLOAD_SINK_BUFFER_SIZE && direct_submit(sink, DOWNLOAD_SINK_BUFFER_SIZE) != 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+  if (sink->buffered + length > DOWNLOAD_SINK_BUFFER_SIZE && download_sink_flush(sink, 0) != 0) {
+    return -1;
+  }
+  if (length >= DOWNLOAD_SINK_BUFFER_SIZE) {
+    //Nothing is gained by copying data that fills the buffer on its own.
+    if (write_all(sink->fd, data, length, sink->written) != 0) {
+      return -1;
+    }
+    sink->written += (off_t) length;
+    return 0;
+  }
+  memcpy(sink->buffer + sink->buffered, data, length);
+  sink->buffered += length;
+  return 0;
+}
+
+int download_sink_write_at(download_sink_t *sink, off_t offset, const char *data, size_t length) {
+  if (write_all(sink->fd, data, length, offset) != 0) {
+    return -1;
+  }
+  if (offset + (off_t) length > sink->written) {
+    sink->written = offset + (off_t) length;
+  }
+  return 0;
+}
+
+int download_sink_flush(download_sink_t *sink, int sync) {
+  if (sink->direct) {
+    size_t aligned = sink->buffered & ~((size_t) DOWNLOAD_SINK_ALIGNMENT - 1);
+    if ((aligned > 0 && direct_submit(sink, aligned) != 0) || direct_drain(sink->direct) != 0) {
+      return -1;
+    }
+    //The start of a block goes through the page cache, and stays buffered to be written again with the whole block.
+    if (sink->buffered > 0 && write_all(sink->fd, sink->buffer, sink->buffered, sink->direct->end) != 0) {
+      return -1;
+    }
+    sink->written = sink->direct->end + (off_t) sink->buffered;
+  } else if (sink->buffered > 0) {
+    if (write_all(sink->fd, sink->buffer, sink->buffered, sink->written) != 0) {
+      return -1;
+    }
+    sink->written += (off_t) sink->buffered;
+    sink->buffered = 0;
+  }
+  if (sync && fdatasync(sink->fd) != 0) {
+    logging(L_ERROR, "download_sink: unable to sync: %s", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+int download_sink_close(download_sink_t *sink) {
+  int result = 0;
+
+  if (sink->direct) {
+    direct_close(sink);
+  }
+  if (sink->fd >= 0 && close(sink->fd) != 0) {
+    logging(L_ERROR, "download_sink: unable to close: %s", strerror(errno));
+    result = -1;
+  }
+  sink->fd = -1;
+  free(sink->buffer);
+  sink->buffer = NULL;
+  sink->buffered = 0;
+  return result;
+}
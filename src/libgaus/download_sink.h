@@ -0,0 +1,61 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_DOWNLOAD_SINK_H
+#define GAUS_DOWNLOAD_SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct download_sink_direct download_sink_direct_t;
+
+/* Writes a download to a file through one large buffer, so the many small chunks curl delivers turn into a few big
+ * writes, and reserves the space the whole download needs up front. */
+typedef struct {
+  int fd;
+  char *buffer;
+  size_t buffered;  //Bytes waiting in buffer, they follow the written ones
+  off_t written;    //Bytes in the file
+  bool device;      //A block device, it keeps its size
+  download_sink_direct_t *direct;  //Writes full buffers around the page cache, NULL for writes through it
+} download_sink_t;
+
+/* Open or create the file at path without truncating it, written is set to its current size.  The file is readable
+ * through fd so a download assembled out of order can be checked. */
+int download_sink_open(download_sink_t *sink, const char *path);
+
+/* Like download_sink_open, but in order writes bypass the page cache with O_DIRECT.  Full buffers are handed to a pool
+ * of writer threads, so several are written while the next one fills.  Only the end of the data that does not fill a
+ * block goes through the page cache.  Files on file systems without O_DIRECT are written through the page cache. */
+int download_sink_open_direct(download_sink_t *sink, const char *path);
+
+/* Drop everything after the first offset bytes and reserve room for size bytes. */
+int download_sink_reset(download_sink_t *sink, off_t offset, off_t size);
+
+int download_sink_write(download_sink_t *sink, const char *data, size_t length);
+
+/* Write data to offset directly, for downloads assembled out of order.  Must not be mixed with buffered writes, and
+ * goes through the page cache even for a sink opened with download_sink_open_direct. */
+int download_sink_write_at(download_sink_t *sink, off_t offset, const char *data, size_t length);
+
+/* Write out the buffer, with sync also make sure the data has reached the disk. */
+int download_sink_flush(download_sink_t *sink, int sync);
+
+/* Close the file, buffered data that was not flushed is dropped. */
+int download_sink_close(download_sink_t *sink);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_DOWNLOAD_SINK_H
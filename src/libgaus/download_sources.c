@@ -0,0 +1,83 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "download_sources.h"
+#include "log.h"
+
+#include <stdlib.h>
+
+int download_sources_init(download_sources_t *sources, const char *url, const char *auth_token,
+                          const char *const *mirrors, size_t mirror_count) {
+  sources->count = 1 + mirror_count;
+  sources->current = 0;
+  if (!(sources->sources = calloc(sources->count, sizeof(download_source_t)))) {
+    return -1;
+  }
+  sources->sources[0].url = url;
+  sources->sources[0].auth_token = auth_token;
+  //The token is for the gaus backend, mirrors serve the package without it.
+  for (size_t i = 0; i < mirror_count; i++) {
+    sources->sources[i + 1].url = mirrors[i];
+  }
+  return 0;
+}
+
+void download_sources_free(download_sources_t *sources) {
+  free(sources->sources);
+  sources->sources = NULL;
+  sources->count = 0;
+}
+
+/* Bytes per second expected from a source, each failure halves it.  Sources not tried yet are expected to be the
+ * fastest. */
+static double expected_rate(const download_source_t *source) {
+  if (source->elapsed_ms == 0 && source->failures == 0) {
+    return -1;
+  }
+  return (double) source->bytes * 1000 / (source->elapsed_ms > 0 ? source->elapsed_ms : 1) /
+         ((double) (1u << (source->failures < 16 ? source->failures : 16)));
+}
+
+int download_sources_record(download_sources_t *sources, curl_off_t bytes, long long elapsed_ms, bool complete,
+                            long status_code) {
+  download_source_t *current = &sources->sources[sources->current];
+  size_t best = sources->count;
+  double best_rate = 0;
+
+  current->bytes += bytes;
+  current->elapsed_ms += elapsed_ms;
+  if (complete) {
+    return 0;
+  }
+  current->failures++;
+  if (status_code >= 400 && status_code < 500) {
+    current->status_code = status_code;
+  }
+  for (size_t i = 0; i < sources->count; i++) {
+    double rate = expected_rate(&sources->sources[i]);
+    if (i == sources->current || sources->sources[i].status_code) {
+      continue;
+    }
+    if (rate < 0) {
+      best = i;
+      break;
+    }
+    if (best == sources->count || rate > best_rate) {
+      best = i;
+      best_rate = rate;
+    }
+  }
+  if (best < sources->count) {
+    logging(L_WARNING, "Switching download from %s to %s", current->url, sources->sources[best].url);
+    sources->current = best;
+    return 0;
+  }
+  //With no other source left a transfer that broke off is resumed from the same one.
+  return current->status_code ? -1 : 0;
+}
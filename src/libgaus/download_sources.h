@@ -0,0 +1,53 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_DOWNLOAD_SOURCES_H
+#define GAUS_DOWNLOAD_SOURCES_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A URL serving the package, and how transfers from it went so far. */
+typedef struct {
+  const char *url;
+  const char *auth_token;  //Sent along to the source, NULL for none
+  curl_off_t bytes;        //Received from the source so far
+  long long elapsed_ms;    //Spent receiving them
+  unsigned int failures;   //Transfers that broke off or were too slow
+  long status_code;        //Client error the source answered with, 0 while it is usable
+} download_source_t;
+
+/* The sources of one package.  The download stays with a source while its transfers complete, and moves to the one
+ * with the best throughput so far once a transfer breaks off, sources not tried yet first. */
+typedef struct {
+  download_source_t *sources;
+  size_t count;
+  size_t current;  //Source of the next transfer
+} download_sources_t;
+
+/* The first source is url with auth_token, the mirrors get no token.  Returns -1 if out of memory. */
+int download_sources_init(download_sources_t *sources, const char *url, const char *auth_token,
+                          const char *const *mirrors, size_t mirror_count);
+
+void download_sources_free(download_sources_t *sources);
+
+/* Record a transfer from the current source that received bytes in elapsed_ms and ended with status_code, and pick
+ * the source of the next one.  Returns -1 if every source answered with a client error. */
+int download_sources_record(download_sources_t *sources, curl_off_t bytes, long long elapsed_ms, bool complete,
+                            long status_code);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_DOWNLOAD_SOURCES_H
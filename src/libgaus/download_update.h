@@ -0,0 +1,38 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_DOWNLOAD_UPDATE_H
+#define GAUS_DOWNLOAD_UPDATE_H
+
+#include "gaus/gaus_client_types.h"
+#include "bandwidth.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* How a download runs, besides its options. */
+typedef struct {
+  bandwidth_class_t traffic_class;
+  bool (*cancelled)(void *user_data);  //Polled while the download runs, NULL if it runs to the end
+  void *user_data;
+} download_control_t;
+
+/* gaus_download_update, with the transfers counted as control->traffic_class.  A cancelled download keeps its progress
+ * in the journal, downloading it again resumes it. */
+gaus_error_t *download_update(const gaus_session_t *session, const gaus_update_t *update,
+                              const char *destination_path, const gaus_download_options_t *options,
+                              const download_control_t *control);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_DOWNLOAD_UPDATE_H
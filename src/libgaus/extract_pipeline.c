@@ -0,0 +1,549 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "extract_pipeline.h"
+#include "log.h"
+#include "ring_buffer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+//Bytes queued between two stages.
+#define EXTRACT_RING_SIZE (256 * 1024)
+#define EXTRACT_CHUNK_SIZE (64 * 1024)
+//Longest name taken from a GNU long name or pax header entry.
+#define EXTRACT_MAX_NAME_LENGTH 4096
+#define TAR_BLOCK_SIZE 512
+
+//Fields of a ustar header block, as offset and length.
+#define TAR_NAME 0, 100
+#define TAR_MODE 100, 8
+#define TAR_SIZE 124, 12
+#define TAR_CHECKSUM 148, 8
+#define TAR_TYPE 156
+#define TAR_LINK_NAME 157, 100
+#define TAR_MAGIC 257
+#define TAR_PREFIX 345, 155
+
+struct extract_pipeline {
+  char *directory;
+  ring_buffer_t package;   //Received package, read by the decompression stage
+  ring_buffer_t archive;   //Decompressed archive, read by the extraction stage
+  pthread_t decompress_thread;
+  pthread_t extract_thread;
+  bool joined;
+  int decompress_result;
+  int extract_result;
+};
+
+static int damaged(const char *description) {
+  logging(L_ERROR, "extract_pipeline: damaged archive, %s", description);
+  return -1;
+}
+
+/* Give up on the archive, the stages before and after see it at their next read or write. */
+static void abort_stages(extract_pipeline_t *pipeline) {
+  ring_buffer_abort(&pipeline->package);
+  ring_buffer_abort(&pipeline->archive);
+}
+
+static void *decompress_stage(void *arg) {
+  extract_pipeline_t *pipeline = arg;
+  z_stream zstream;
+  bool started = false;
+  bool gzip = false;
+  bool stream_end = false;
+  unsigned char *in = malloc(EXTRACT_CHUNK_SIZE);
+  unsigned char *out = malloc(EXTRACT_CHUNK_SIZE);
+  ssize_t length = -1;
+  int result = -1;
+
+  memset(&zstream, 0, sizeof(zstream));
+  while (in && out && (length = ring_buffer_read(&pipeline->package, (char *) in, EXTRACT_CHUNK_SIZE)) > 0) {
+    if (!started) {
+      //Archives are told apart from gzip compressed ones by the gzip magic, a tar header starts with a name.
+      started = true;
+      gzip = in[0] == 0x1f;
+      if (gzip && inflateInit2(&zstream, 15 + 16) != Z_OK) {
+        gzip = false;
+        goto out;
+      }
+    }
+    if (!gzip) {
+      if (ring_buffer_write(&pipeline->archive, (char *) in, (size_t) length) != 0) {
+        goto out;
+      }
+      continue;
+    }
+    zstream.next_in = in;
+    zstream.avail_in = (uInt) length;
+    do {
+      int inflated;
+
+      if (stream_end && zstream.avail_in > 0) {
+        //Concatenated gzip members hold the concatenation of their contents.
+        inflateReset(&zstream);
+        stream_end = false;
+      }
+      zstream.next_out = out;
+      zstream.avail_out = EXTRACT_CHUNK_SIZE;
+      inflated = inflate(&zstream, Z_NO_FLUSH);
+      if (inflated == Z_STREAM_END) {
+        stream_end = true;
+      } else if (inflated != Z_OK && inflated != Z_BUF_ERROR) {
+        damaged(zstream.msg ? zstream.msg : "unable to decompress");
+        goto out;
+      }
+      if (zstream.avail_out < EXTRACT_CHUNK_SIZE &&
+          ring_buffer_write(&pipeline->archive, (char *) out, EXTRACT_CHUNK_SIZE - zstream.avail_out) != 0) {
+        goto out;
+      }
+    } while (zstream.avail_in > 0 || zstream.avail_out == 0);
+  }
+  if (length == 0 && gzip && !stream_end) {
+    damaged("package ends inside the compressed data");
+  } else if (length == 0) {
+    result = 0;
+  }
+
+  out:
+  if (gzip) {
+    inflateEnd(&zstream);
+  }
+  free(in);
+  free(out);
+  if (result == 0) {
+    ring_buffer_close(&pipeline->archive);
+  } else {
+    abort_stages(pipeline);
+  }
+  pipeline->decompress_result = result;
+  return NULL;
+}
+
+/* Returns 0 once length bytes were read, 1 if the archive ended before the first of them, -1 otherwise. */
+static int read_exactly(ring_buffer_t *ring, char *data, size_t length) {
+  size_t done = 0;
+
+  while (done < length) {
+    ssize_t result = ring_buffer_read(ring, data + done, length - done);
+    if (result < 0) {
+      return -1;
+    }
+    if (result == 0) {
+      return done == 0 ? 1 : damaged("archive ends inside an entry");
+    }
+    done += (size_t) result;
+  }
+  return 0;
+}
+
+static int skip(ring_buffer_t *ring, char *buffer, uint64_t length) {
+  while (length > 0) {
+    size_t count = length < EXTRACT_CHUNK_SIZE ? (size_t) length : EXTRACT_CHUNK_SIZE;
+    if (read_exactly(ring, buffer, count) != 0) {
+      return -1;
+    }
+    length -= count;
+  }
+  return 0;
+}
+
+static uint64_t padding(uint64_t size) {
+  return (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+}
+
+/* Numbers are octal text, or big endian binary flagged by the top bit for sizes of 8 GiB and more. */
+static uint64_t tar_number(const char *header, size_t offset, size_t length) {
+  const unsigned char *field = (const unsigned char *) header + offset;
+  uint64_t value = 0;
+  size_t i = 0;
+
+  if (field[0] & 0x80) {
+    value = field[0] & 0x7f;
+    for (i = 1; i < length; i++) {
+      value = value * 256 + field[i];
+    }
+    return value;
+  }
+  while (i < length && (field[i] == ' ' || field[i] == '\0')) {
+    i++;
+  }
+  for (; i < length && field[i] >= '0' && field[i] <= '7'; i++) {
+    value = value * 8 + (field[i] - '0');
+  }
+  return value;
+}
+
+static char *tar_string(const char *header, size_t offset, size_t length) {
+  return strndup(header + offset, length);
+}
+
+/* The checksum is the sum of the header bytes, with its own field counted as spaces. */
+static bool valid_header(const char *header) {
+  const unsigned char *bytes = (const unsigned char *) header;
+  uint64_t sum = 0;
+
+  for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+    sum += i >= 148 && i < 156 ? ' ' : bytes[i];
+  }
+  return sum == tar_number(header, TAR_CHECKSUM);
+}
+
+static bool empty_block(const char *header) {
+  for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+    if (header[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Names must stay inside the directory, so absolute ones and ones going up are refused. */
+static bool contained(const char *name) {
+  const char *component = name;
+
+  if (name[0] == '/') {
+    return false;
+  }
+  while (component) {
+    if (strncmp(component, "..", 2) == 0 && (component[2] == '/' || component[2] == '\0')) {
+      return false;
+    }
+    component = strchr(component, '/');
+    component = component ? component + 1 : NULL;
+  }
+  return true;
+}
+
+/* The path of an entry in the directory, NULL if it would end up outside of it. */
+static char *entry_path(const extract_pipeline_t *pipeline, const char *name) {
+  size_t directory_length = strlen(pipeline->directory);
+  size_t name_length;
+  char *path;
+
+  while (strncmp(name, "./", 2) == 0) {
+    name += 2;
+  }
+  name_length = strlen(name);
+  while (name_length > 0 && name[name_length - 1] == '/') {
+    name_length--;
+  }
+  if (name_length == 0 || !contained(name)) {
+    logging(L_ERROR, "extract_pipeline: refusing to extract %s outside of %s", name, pipeline->directory);
+    return NULL;
+  }
+  if (!(path = malloc(directory_length + 1 + name_length + 1))) {
+    return NULL;
+  }
+  memcpy(path, pipeline->directory, directory_length);
+  path[directory_length] = '/';
+  memcpy(path + directory_length + 1, name, name_length);
+  path[directory_length + 1 + name_length] = '\0';
+  return path;
+}
+
+/* Create the directories leading up to path that the archive did not list. */
+static int make_parents(const extract_pipeline_t *pipeline, char *path) {
+  for (char *slash = strchr(path + strlen(pipeline->directory) + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+      logging(L_ERROR, "extract_pipeline: unable to create %s: %s", path, strerror(errno));
+      *slash = '/';
+      return -1;
+    }
+    *slash = '/';
+  }
+  return 0;
+}
+
+static int write_file(extract_pipeline_t *pipeline, const char *path, uint64_t size, mode_t mode, char *buffer) {
+  int fd;
+  int result = -1;
+
+  unlink(path);
+  if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, mode)) < 0) {
+    logging(L_ERROR, "extract_pipeline: unable to create %s: %s", path, strerror(errno));
+    return -1;
+  }
+  while (size > 0) {
+    size_t count = size < EXTRACT_CHUNK_SIZE ? (size_t) size : EXTRACT_CHUNK_SIZE;
+    size_t written = 0;
+
+    if (read_exactly(&pipeline->archive, buffer, count) != 0) {
+      goto out;
+    }
+    while (written < count) {
+      ssize_t done = write(fd, buffer + written, count - written);
+      if (done < 0 && errno == EINTR) {
+        continue;
+      }
+      if (done <= 0) {
+        logging(L_ERROR, "extract_pipeline: unable to write %s: %s", path, strerror(errno));
+        goto out;
+      }
+      written += (size_t) done;
+    }
+    size -= count;
+  }
+  result = 0;
+
+  out:
+  if (close(fd) != 0) {
+    result = -1;
+  }
+  return result;
+}
+
+/* Relative links without .. stay inside the directory like the names do. */
+static int make_link(const char *header, const char *path, bool symbolic, const extract_pipeline_t *pipeline) {
+  char *target = tar_string(header, TAR_LINK_NAME);
+  char *target_path = NULL;
+  int result = -1;
+
+  if (!target) {
+    return -1;
+  }
+  unlink(path);
+  if (symbolic) {
+    if (!contained(target)) {
+      logging(L_ERROR, "extract_pipeline: refusing link %s to %s outside of %s", path, target, pipeline->directory);
+    } else if (symlink(target, path) != 0) {
+      logging(L_ERROR, "extract_pipeline: unable to create link %s: %s", path, strerror(errno));
+    } else {
+      result = 0;
+    }
+  } else if ((target_path = entry_path(pipeline, target))) {
+    if (link(target_path, path) != 0) {
+      logging(L_ERROR, "extract_pipeline: unable to create link %s: %s", path, strerror(errno));
+    } else {
+      result = 0;
+    }
+  }
+  free(target);
+  free(target_path);
+  return result;
+}
+
+/* A GNU long name entry holds the name, a pax extended header holds records of the form "<length> <key>=<value>\n". */
+static char *read_long_name(extract_pipeline_t *pipeline, char type, uint64_t size, char *buffer) {
+  char *name = NULL;
+
+  if (size >= EXTRACT_MAX_NAME_LENGTH) {
+    damaged("extended header too long");
+    return NULL;
+  }
+  if (read_exactly(&pipeline->archive, buffer, (size_t) size) != 0 ||
+      skip(&pipeline->archive, buffer + size, padding(size)) != 0) {
+    return NULL;
+  }
+  buffer[size] = '\0';
+  if (type == 'L') {
+    return strdup(buffer);
+  }
+  for (char *record = buffer; record < buffer + size;) {
+    char *key = strchr(record, ' ');
+    unsigned long length = strtoul(record, NULL, 10);
+
+    if (!key || length == 0 || record + length > buffer + size) {
+      damaged("bad pax record");
+      free(name);
+      return NULL;
+    }
+    if (strncmp(key + 1, "path=", 5) == 0) {
+      free(name);
+      name = strndup(key + 6, (size_t) (record + length - 1 - (key + 6)));
+    }
+    record += length;
+  }
+  //An empty name makes the entry keep its own.
+  return name ? name : strdup("");
+}
+
+static void *extract_stage(void *arg) {
+  extract_pipeline_t *pipeline = arg;
+  char header[TAR_BLOCK_SIZE];
+  char *buffer = malloc(EXTRACT_CHUNK_SIZE);
+  char *long_name = NULL;
+  int empty_blocks = 0;
+  int result = -1;
+
+  while (buffer) {
+    char *name = NULL;
+    char *path = NULL;
+    uint64_t size;
+    char type;
+    int status = read_exactly(&pipeline->archive, header, TAR_BLOCK_SIZE);
+
+    if (status == 1) {
+      //Some writers leave out the end of archive blocks.
+      result = 0;
+      break;
+    }
+    if (status != 0) {
+      break;
+    }
+    if (empty_block(header)) {
+      if (++empty_blocks == 2) {
+        //Read the rest of the last record so the decompression stage is not held up.
+        while ((status = read_exactly(&pipeline->archive, buffer, TAR_BLOCK_SIZE)) == 0) {
+        }
+        result = status == 1 ? 0 : -1;
+        break;
+      }
+      continue;
+    }
+    empty_blocks = 0;
+    if (!valid_header(header)) {
+      damaged("bad header checksum");
+      break;
+    }
+    size = tar_number(header, TAR_SIZE);
+    type = header[TAR_TYPE];
+    if (type == 'L' || type == 'x') {
+      free(long_name);
+      if (!(long_name = read_long_name(pipeline, type, size, buffer))) {
+        break;
+      }
+      continue;
+    }
+    if (type == 'g') {
+      if (skip(&pipeline->archive, buffer, size + padding(size)) != 0) {
+        break;
+      }
+      continue;
+    }
+
+    if (long_name && long_name[0]) {
+      name = long_name;
+      long_name = NULL;
+    } else {
+      //ustar splits long names into a prefix and the name.
+      char *prefix = memcmp(header + TAR_MAGIC, "ustar", 5) == 0 ? tar_string(header, TAR_PREFIX) : NULL;
+      char *base = tar_string(header, TAR_NAME);
+      if (prefix && prefix[0] && base && (name = malloc(strlen(prefix) + 1 + strlen(base) + 1))) {
+        sprintf(name, "%s/%s", prefix, base);
+      } else if (!prefix || !prefix[0]) {
+        name = base;
+        base = NULL;
+      }
+      free(prefix);
+      free(base);
+    }
+    free(long_name);
+    long_name = NULL;
+    if (!name || !(path = entry_path(pipeline, name)) || make_parents(pipeline, path) != 0) {
+      free(name);
+      free(path);
+      break;
+    }
+
+    status = 0;
+    switch (type) {
+      case '0':
+      case '\0':
+      case '7':
+        status = write_file(pipeline, path, size, (mode_t) tar_number(header, TAR_MODE) & 0777, buffer);
+        size = 0;
+        break;
+      case '5':
+        if (mkdir(path, ((mode_t) tar_number(header, TAR_MODE) & 0777) | 0700) != 0 && errno != EEXIST) {
+          logging(L_ERROR, "extract_pipeline: unable to create %s: %s", path, strerror(errno));
+          status = -1;
+        }
+        break;
+      case '1':
+      case '2':
+        status = make_link(header, path, type == '2', pipeline);
+        break;
+      default:
+        logging(L_WARNING, "extract_pipeline: skipping %s of type %c", name, type);
+        break;
+    }
+    free(name);
+    free(path);
+    if (status != 0 || skip(&pipeline->archive, buffer, size) != 0 ||
+        skip(&pipeline->archive, buffer, padding(tar_number(header, TAR_SIZE))) != 0) {
+      break;
+    }
+  }
+
+  free(long_name);
+  free(buffer);
+  if (result != 0) {
+    abort_stages(pipeline);
+  }
+  pipeline->extract_result = result;
+  return NULL;
+}
+
+static void join_stages(extract_pipeline_t *pipeline) {
+  pthread_join(pipeline->decompress_thread, NULL);
+  pthread_join(pipeline->extract_thread, NULL);
+  pipeline->joined = true;
+}
+
+static void free_pipeline(extract_pipeline_t *pipeline) {
+  ring_buffer_destroy(&pipeline->package);
+  ring_buffer_destroy(&pipeline->archive);
+  free(pipeline->directory);
+  free(pipeline);
+}
+
+extract_pipeline_t *extract_pipeline_create(const char *directory) {
+  extract_pipeline_t *pipeline = calloc(1, sizeof(*pipeline));
+
+  if (!pipeline) {
+    return NULL;
+  }
+  if (!(pipeline->directory = strdup(directory)) ||
+      ring_buffer_init(&pipeline->package, EXTRACT_RING_SIZE) != 0 ||
+      ring_buffer_init(&pipeline->archive, EXTRACT_RING_SIZE) != 0 ||
+      pthread_create(&pipeline->decompress_thread, NULL, decompress_stage, pipeline) != 0) {
+    free_pipeline(pipeline);
+    return NULL;
+  }
+  if (pthread_create(&pipeline->extract_thread, NULL, extract_stage, pipeline) != 0) {
+    abort_stages(pipeline);
+    pthread_join(pipeline->decompress_thread, NULL);
+    free_pipeline(pipeline);
+    return NULL;
+  }
+  return pipeline;
+}
+
+int extract_pipeline_feed(extract_pipeline_t *pipeline, const char *data, size_t length) {
+  return ring_buffer_write(&pipeline->package, data, length);
+}
+
+int extract_pipeline_finish(extract_pipeline_t *pipeline) {
+  ring_buffer_close(&pipeline->package);
+  join_stages(pipeline);
+  return pipeline->decompress_result == 0 && pipeline->extract_result == 0 ? 0 : -1;
+}
+
+void extract_pipeline_free(extract_pipeline_t *pipeline) {
+  if (!pipeline) {
+    return;
+  }
+  if (!pipeline->joined) {
+    abort_stages(pipeline);
+    join_stages(pipeline);
+  }
+  free_pipeline(pipeline);
+}
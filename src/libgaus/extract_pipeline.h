@@ -0,0 +1,39 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_EXTRACT_PIPELINE_H
+#define GAUS_EXTRACT_PIPELINE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Extracts a tar archive, gzip compressed or not, into a directory while it downloads.  Decompression and extraction
+ * each run on a thread of their own, fed through bounded ring buffers, so the files are written while the package is
+ * still being received and a slow stage holds back the ones before it. */
+typedef struct extract_pipeline extract_pipeline_t;
+
+/* directory must exist, entries of the archive are created in it and existing files are replaced. */
+extract_pipeline_t *extract_pipeline_create(const char *directory);
+
+/* Feed the next bytes of the package, returns -1 if the archive is damaged or could not be written. */
+int extract_pipeline_feed(extract_pipeline_t *pipeline, const char *data, size_t length);
+
+/* Wait for the stages to finish, returns 0 if the whole archive was fed and extracted. */
+int extract_pipeline_finish(extract_pipeline_t *pipeline);
+
+/* Stop the stages if they still run. */
+void extract_pipeline_free(extract_pipeline_t *pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_EXTRACT_PIPELINE_H
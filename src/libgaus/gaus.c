@@ -8,8 +8,15 @@
 //
 //THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <gaus/gaus_client_types.h>
+#include "bandwidth.h"
+#include "connection_pool.h"
 #include "curl_wrapper.h"
 #include "gaus.h"
+#include "request_async.h"
+#include "request_headers.h"
+#include "response_buffer.h"
+#include "share_cache.h"
+#include "update_cache.h"
 #include "gaus/gaus_client.h"
 #include "log.h"
 #include <stdio.h>
@@ -18,37 +25,103 @@
 #include <stdarg.h>
 
 gaus_global_state_t gaus_global_state = {
-    NULL,   //Server
     false,  //Initialized
-    NULL,   //Proxy
-    NULL    //CA cert path
+    {
+        NULL,   //Server
+        NULL,   //Proxy
+        NULL,   //CA cert path
+        false,  //HTTP/2
+        GAUS_COMPRESSION_NONE, //Request body compression
+        0,      //Compression level
+        NULL,   //Connection pool
+        PTHREAD_MUTEX_INITIALIZER,
+        {0}     //Stats
+    }
 };
 
+//Client the calls of this thread run with, NULL for the one set up by gaus_global_init.
+static __thread gaus_client_t *current_client = NULL;
+
 gaus_version_t gaus_client_library_version(void) {
   gaus_version_t version = {0, 0, 2};
   return version;
 }
 
+static gaus_error_t *check_options(const char *func, const gaus_initialization_options_t *options) {
+  if (options && (options->request_compression < GAUS_COMPRESSION_NONE ||
+                  options->request_compression > GAUS_COMPRESSION_DEFLATE ||
+                  options->compression_level < 0 || options->compression_level > 9)) {
+    return gaus_create_error(func, GAUS_BAD_INIT_ERROR, 500, "Invalid request compression options");
+  }
+  return NULL;
+}
+
+static void clear_client(gaus_client_t *client) {
+  free(client->serverUrl);
+  free(client->proxy);
+  free(client->ca_path);
+  connection_pool_free(client->pool);
+  client->serverUrl = NULL;
+  client->proxy = NULL;
+  client->ca_path = NULL;
+  client->pool = NULL;
+  memset(&client->stats, 0, sizeof(client->stats));
+}
+
+//Copy the per client settings out of options, curl must be initialized.
+static gaus_error_t *setup_client(const char *func, gaus_client_t *client, const char *serverUrl,
+                                  const gaus_initialization_options_t *options) {
+  client->compression = options ? options->request_compression : GAUS_COMPRESSION_NONE;
+  client->compression_level = options ? options->compression_level : 0;
+  client->serverUrl = strdup(serverUrl);
+  //Ensure that proxy and ca_path are initialized to NULL if not set.
+  client->proxy = options && options->proxy ? strdup(options->proxy) : NULL;
+  client->ca_path = options && options->ca_path ? strdup(options->ca_path) : NULL;
+  client->http2 = false;
+  if (options && options->enable_http2) {
+    if (gaus_curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2) {
+      client->http2 = true;
+    } else {
+      logging(L_WARNING, "%s: curl was built without HTTP/2 support, using HTTP/1.1", func);
+    }
+  }
+  if (options) {
+    client->pool = connection_pool_create(options->max_connections_per_host, options->connection_idle_timeout_seconds);
+  } else {
+    client->pool = connection_pool_create(0, 0);
+  }
+  if (!client->serverUrl || !client->pool || (options && options->proxy && !client->proxy) ||
+      (options && options->ca_path && !client->ca_path)) {
+    clear_client(client);
+    return gaus_create_error(func, GAUS_UNKNOWN_ERROR, 500, "Failed to allocate client settings");
+  }
+  return NULL;
+}
+
 gaus_error_t *gaus_global_init(const char *serverUrl, const gaus_initialization_options_t *options) {
   if (!gaus_global_state.globalInitalized) {
+    gaus_error_t *error = check_options(__func__, options);
+    if (error) {
+      return error;
+    }
+
     //Set state:
     CURLcode status = gaus_curl_global_init(CURL_GLOBAL_ALL);
     if (status != CURLE_OK) {
       return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Failed to globally initialize curl");
     }
-    gaus_global_state.serverUrl = strdup(serverUrl);
-    if (options && options->proxy) {
-      gaus_global_state.proxy = strdup(options->proxy);
-    } else {
-      //Ensure that proxy is initialized to NULL if not set.
-      gaus_global_state.proxy = NULL;
+    if (request_headers_init() != 0) {
+      gaus_curl_global_cleanup();
+      return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Failed to prepare request headers");
     }
-    if (options && options->ca_path) {
-      gaus_global_state.ca_path = strdup(options->ca_path);
-    } else {
-      //Ensure that ca_path is initialized to NULL if not set.
-      gaus_global_state.ca_path = NULL;
+    error = setup_client(__func__, &gaus_global_state.client, serverUrl, options);
+    if (error) {
+      request_headers_cleanup();
+      gaus_curl_global_cleanup();
+      return error;
     }
+    share_cache_init();
+    bandwidth_init(options ? (curl_off_t) options->max_bandwidth : 0);
     gaus_global_state.globalInitalized = true;
 
   }
@@ -57,14 +130,81 @@ gaus_error_t *gaus_global_init(const char *serverUrl, const gaus_initialization_
 
 void gaus_global_cleanup(void) {
   if (gaus_global_state.globalInitalized) {
-    free(gaus_global_state.proxy);
-    free(gaus_global_state.ca_path);
-    free(gaus_global_state.serverUrl);
+    request_async_cleanup();
+    clear_client(&gaus_global_state.client);
+    share_cache_cleanup();
+    bandwidth_init(0);
+    request_headers_cleanup();
+    update_cache_cleanup();
+    response_buffer_cleanup();
     gaus_curl_global_cleanup();
     gaus_global_state.globalInitalized = false;
   }
 }
 
+gaus_error_t *gaus_client_create(const char *serverUrl, const gaus_initialization_options_t *options,
+                                 gaus_client_t **client) {
+  if (!gaus_global_state.globalInitalized) {
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Created client without initializing");
+  }
+  if (!serverUrl || !client) {
+    return gaus_create_error(__func__, GAUS_BAD_INIT_ERROR, 500, "Server url and client must be set");
+  }
+  gaus_error_t *error = check_options(__func__, options);
+  if (error) {
+    return error;
+  }
+  gaus_client_t *created = calloc(1, sizeof(gaus_client_t));
+  if (!created) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Failed to allocate client");
+  }
+  error = setup_client(__func__, created, serverUrl, options);
+  if (error) {
+    free(created);
+    return error;
+  }
+  pthread_mutex_init(&created->stats_lock, NULL);
+  *client = created;
+  return NULL;
+}
+
+void gaus_client_destroy(gaus_client_t *client) {
+  if (client && client != &gaus_global_state.client) {
+    clear_client(client);
+    pthread_mutex_destroy(&client->stats_lock);
+    free(client);
+  }
+}
+
+void gaus_client_get_stats(gaus_client_t *client, gaus_client_stats_t *stats) {
+  if (!client) {
+    client = &gaus_global_state.client;
+  }
+  pthread_mutex_lock(&client->stats_lock);
+  *stats = client->stats;
+  pthread_mutex_unlock(&client->stats_lock);
+}
+
+gaus_client_t *gaus_current_client(void) {
+  return current_client ? current_client : &gaus_global_state.client;
+}
+
+gaus_client_t *gaus_client_enter(gaus_client_t *client) {
+  gaus_client_t *previous = current_client;
+  current_client = client;
+  return previous;
+}
+
+void gaus_client_leave(gaus_client_t *previous) {
+  current_client = previous;
+}
+
+void gaus_client_count_request(gaus_client_t *client) {
+  pthread_mutex_lock(&client->stats_lock);
+  client->stats.requests++;
+  pthread_mutex_unlock(&client->stats_lock);
+}
+
 gaus_error_t *
 gaus_create_error(const char *func, gaus_error_type_t type, unsigned int code, const char *description, ...) {
 
@@ -15,17 +15,44 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <pthread.h>
 #include <gaus/gaus_client_types.h>
+#include "connection_pool.h"
 
-typedef struct {
+/* The settings and connections of one backend.  The settings do not change once the client was set up, so requests
+ * read them without locking. */
+struct gaus_client {
   char *serverUrl;
-  bool globalInitalized;
   char *proxy;
   char *ca_path;
+  bool http2;
+  gaus_compression_t compression;
+  int compression_level;
+  connection_pool_t *pool;      //NULL before gaus_global_init, requests then get a handle of their own
+  pthread_mutex_t stats_lock;
+  gaus_client_stats_t stats;
+};
+
+typedef struct {
+  bool globalInitalized;
+  gaus_client_t client;  //Used by the calls that are not given a client
 } gaus_global_state_t;
 
 extern gaus_global_state_t gaus_global_state;
 
+/* The client requests of the calling thread go to: the one passed to the gaus_client_* call it is in, otherwise the
+ * one set up by gaus_global_init. */
+gaus_client_t *gaus_current_client(void);
+
+/* Send the calling thread's requests to client until gaus_client_leave.  Returns what to pass to gaus_client_leave
+ * to go back to the client that was current before. */
+gaus_client_t *gaus_client_enter(gaus_client_t *client);
+
+void gaus_client_leave(gaus_client_t *previous);
+
+/* Count a request sent through client. */
+void gaus_client_count_request(gaus_client_t *client);
+
 gaus_error_t *
 gaus_create_error(const char *func, gaus_error_type_t type, unsigned int code, const char *description, ...);
 
@@ -12,13 +12,28 @@
 #include "gaus.h"
 #include "log.h"
 #include "request.h"
+#include "request_async.h"
 #include "gaus_json_helpers.h"
 #include "../include/gaus/gaus_client_types.h"
 
 #include <jansson.h>
 #include <string.h>
 
+typedef struct {
+  gaus_session_t *session;
+  gaus_completion_callback_t callback;
+  void *user_data;
+} authenticate_async_context_t;
+
 //Helper functions
+static gaus_error_t *
+check_authenticate_parameters(const char *device_access, const char *device_secret, gaus_session_t *session);
+
+static char *create_authenticate_body(const char *device_access, const char *device_secret);
+
+static gaus_error_t *
+process_authenticate_result(const char *raw_authenticate_result, long status_code, gaus_session_t *session);
+
 static gaus_error_t *
 parse_authenticate_json(json_t *root, gaus_session_t *session);
 
@@ -26,36 +41,99 @@ gaus_error_t *gaus_authenticate(const char *device_access, const char *device_se
   gaus_error_t *status = NULL;
   char *raw_authenticate_result = NULL;
   char *json_auth_post_string = NULL;
-  json_t *json_authenticate_body = NULL;
-  json_t *json_authenticate_response = NULL;
 
-  if (!gaus_global_state.globalInitalized) {
-    status = gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Authenticated without initializing");
+  if ((status = check_authenticate_parameters(device_access, device_secret, session))) {
     goto error;
   }
 
+  json_auth_post_string = create_authenticate_body(device_access, device_secret);
+
+  char url[256];
+  create_url(url, sizeof(url), "%s/authenticate", gaus_current_client()->serverUrl);
+  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
+  raw_authenticate_result = request_post_as_string(url, NULL, json_auth_post_string, BANDWIDTH_CONTROL, &status_code);
+  status = process_authenticate_result(raw_authenticate_result, status_code, session);
+
+  error:
+  response_buffer_free(raw_authenticate_result);
+  free(json_auth_post_string);
+
+  return status;
+}
+
+static void authenticate_async_complete(const char *response, long status_code, void *user_data) {
+  authenticate_async_context_t *context = user_data;
+  gaus_error_t *status = process_authenticate_result(response, status_code, context->session);
+  context->callback(status, context->user_data);
+  free(context);
+}
+
+gaus_error_t *gaus_authenticate_async(const char *device_access, const char *device_secret, gaus_session_t *session,
+                                      gaus_completion_callback_t callback, void *user_data) {
+  gaus_error_t *status = NULL;
+  authenticate_async_context_t *context = NULL;
+  char *json_auth_post_string = NULL;
+
+  if ((status = check_authenticate_parameters(device_access, device_secret, session))) {
+    return status;
+  }
+  if (!callback) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Authenticated without completion callback");
+  }
+
+  context = malloc(sizeof(authenticate_async_context_t));
+  context->session = session;
+  context->callback = callback;
+  context->user_data = user_data;
+
+  json_auth_post_string = create_authenticate_body(device_access, device_secret);
+
+  char url[256];
+  create_url(url, sizeof(url), "%s/authenticate", gaus_current_client()->serverUrl);
+  if (request_post_async(url, NULL, json_auth_post_string, BANDWIDTH_CONTROL, authenticate_async_complete,
+                         context) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to queue authenticate request");
+    free(context);
+  }
+
+  free(json_auth_post_string);
+  return status;
+}
+
+static gaus_error_t *
+check_authenticate_parameters(const char *device_access, const char *device_secret, gaus_session_t *session) {
+  if (!gaus_global_state.globalInitalized) {
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Authenticated without initializing");
+  }
+
   if (!device_access || !device_secret || !session) {
-    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Authenticated invalid parameters");
-    goto error;
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Authenticated invalid parameters");
   }
 
   //Ensure that all char * pointers in session are initialized to NULL so they can be freed safely
   session->device_guid = NULL;
   session->product_guid = NULL;
   session->token = NULL;
+  return NULL;
+}
 
-  json_authenticate_body = json_pack("{s:{s:s, s:s}}",
-                                     DEVICE_AUTH_PARAM_JSON,
-                                     ACCESS_KEY_JSON, device_access,
-                                     SECRET_KEY_JSON, device_secret
+static char *create_authenticate_body(const char *device_access, const char *device_secret) {
+  json_t *json_authenticate_body = json_pack("{s:{s:s, s:s}}",
+                                             DEVICE_AUTH_PARAM_JSON,
+                                             ACCESS_KEY_JSON, device_access,
+                                             SECRET_KEY_JSON, device_secret
   );
 
-  json_auth_post_string = json_dumps(json_authenticate_body, JSON_COMPACT);
+  char *json_auth_post_string = json_dumps(json_authenticate_body, JSON_COMPACT);
+  json_decref(json_authenticate_body);
+  return json_auth_post_string;
+}
+
+static gaus_error_t *
+process_authenticate_result(const char *raw_authenticate_result, long status_code, gaus_session_t *session) {
+  gaus_error_t *status = NULL;
+  json_t *json_authenticate_response = NULL;
 
-  char url[256];
-  create_url(url, sizeof(url), "%s/authenticate", gaus_global_state.serverUrl);
-  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
-  raw_authenticate_result = request_post_as_string(url, NULL, json_auth_post_string, &status_code);
   if (!raw_authenticate_result && status_code < 400) {
     status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Posting authenticate failed");
     goto error;
@@ -76,11 +154,7 @@ gaus_error_t *gaus_authenticate(const char *device_access, const char *device_se
   status = parse_authenticate_json(json_authenticate_response, session);
 
   error:
-  free(raw_authenticate_result);
-  free(json_auth_post_string);
-  json_decref(json_authenticate_body);
   json_decref(json_authenticate_response);
-
   return status;
 }
 
@@ -109,6 +183,8 @@ static gaus_error_t *parse_authenticate_json(json_t *root, gaus_session_t *sessi
                               "Server reply invalid: required \"token\" missing in object");
     goto error;
   }
+  //Build the headers for this session now so its requests only have to look them up.
+  request_headers_release(request_headers_acquire(session->token, gaus_current_client()->compression));
 
   error:
   return error;
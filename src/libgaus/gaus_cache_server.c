@@ -0,0 +1,427 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#define _GNU_SOURCE //accept4, pipe2, strcasestr
+#include "gaus/gaus_client.h"
+#include "artifact_cache.h"
+#include "gaus.h"
+#include "log.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define CACHE_SERVER_MAX_CONNECTIONS 64
+//Largest request head accepted, the requests of update clients are far smaller.
+#define CACHE_SERVER_REQUEST_SIZE 8192
+//Idle keep-alive connections and stalled devices are dropped after this long.
+#define CACHE_SERVER_TIMEOUT_SECONDS 30
+#define CACHE_SERVER_SEND_SIZE (1024 * 1024)
+
+typedef struct cache_connection {
+  gaus_cache_server_t *server;
+  int fd;
+  struct cache_connection *prev;
+  struct cache_connection *next;
+} cache_connection_t;
+
+struct gaus_cache_server {
+  char *cache_path;
+  int listen_fd;
+  int wakeup_pipe[2];
+  unsigned short port;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t connection_closed;
+  cache_connection_t *connections;  //Served on threads of their own
+  size_t connection_count;
+  bool stopping;
+};
+
+static int send_all(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return -1;
+    }
+    data += sent;
+    length -= (size_t) sent;
+  }
+  return 0;
+}
+
+static int send_head(int fd, const char *status, const char *headers, long long length, bool close) {
+  char head[512];
+  int size = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Length: %lld\r\n%s%s\r\n", status, length, headers,
+                      close ? "Connection: close\r\n" : "");
+
+  return size < (int) sizeof(head) ? send_all(fd, head, (size_t) size) : -1;
+}
+
+/* The kernel copies the artifact to the socket, it never passes through the process. */
+static int send_file(int socket_fd, int fd, off_t offset, off_t length) {
+  while (length > 0) {
+    ssize_t sent = sendfile(socket_fd, fd, &offset, length < CACHE_SERVER_SEND_SIZE ? (size_t) length
+                                                                                      : CACHE_SERVER_SEND_SIZE);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return -1;
+    }
+    length -= sent;
+  }
+  return 0;
+}
+
+/* Read a Range header value into first and last.  Returns 0 for a range, 1 to send the whole artifact, which is also
+ * how ranges of other units and multiple ranges are answered, and -1 if it cannot be satisfied. */
+static int parse_range(const char *value, off_t size, off_t *first, off_t *last) {
+  char *end;
+
+  if (strncmp(value, "bytes=", 6) != 0 || strchr(value, ',')) {
+    return 1;
+  }
+  value += 6;
+  if (*value == '-') {
+    long long suffix = strtoll(value + 1, &end, 10);
+    if (end == value + 1 || suffix < 0) {
+      return 1;
+    }
+    if (suffix == 0 || size == 0) {
+      return -1;
+    }
+    *first = size > suffix ? size - suffix : 0;
+    *last = size - 1;
+    return 0;
+  }
+  *first = strtoll(value, &end, 10);
+  if (end == value || *end != '-' || *first < 0) {
+    return 1;
+  }
+  value = end + 1;
+  *last = *value ? strtoll(value, &end, 10) : size - 1;
+  if (*value && (end == value || *last < *first)) {
+    return 1;
+  }
+  if (*last >= size) {
+    *last = size - 1;
+  }
+  return *first < size ? 0 : -1;
+}
+
+/* Answer one request, its head is null terminated after the last line.  Returns 0 to keep the connection. */
+static int handle_request(gaus_cache_server_t *server, int fd, char *request) {
+  char *line_end = strstr(request, "\r\n");
+  char *save = NULL;
+  char *method;
+  char *target;
+  char *version;
+  const char *range = NULL;
+  char headers[256];
+  struct stat artifact_stat;
+  off_t first = 0;
+  off_t last = 0;
+  int artifact_fd;
+  int result;
+  bool close_connection;
+
+  *line_end = '\0';
+  method = strtok_r(request, " ", &save);
+  target = strtok_r(NULL, " ", &save);
+  version = strtok_r(NULL, " ", &save);
+  if (!method || !target || !version || strncmp(version, "HTTP/1.", 7) != 0) {
+    send_head(fd, "400 Bad Request", "", 0, true);
+    return -1;
+  }
+  close_connection = strcmp(version, "HTTP/1.0") == 0;
+  for (char *line = line_end + 2; (line_end = strstr(line, "\r\n")); line = line_end + 2) {
+    *line_end = '\0';
+    if (strncasecmp(line, "Range:", 6) == 0) {
+      range = line + 6 + strspn(line + 6, " \t");
+    } else if (strncasecmp(line, "Connection:", 11) == 0) {
+      close_connection = strcasestr(line + 11, "close") ||
+                         (close_connection && !strcasestr(line + 11, "keep-alive"));
+    }
+  }
+
+  if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0) {
+    return send_head(fd, "405 Method Not Allowed", "Allow: GET, HEAD\r\n", 0, close_connection) == 0 &&
+           !close_connection ? 0 : -1;
+  }
+  target[strcspn(target, "?")] = '\0';
+  artifact_fd = target[0] == '/' ? artifact_cache_open(server->cache_path, target + 1, -1) : -1;
+  if (artifact_fd < 0 || fstat(artifact_fd, &artifact_stat) != 0) {
+    if (artifact_fd >= 0) {
+      close(artifact_fd);
+    }
+    return send_head(fd, "404 Not Found", "", 0, close_connection) == 0 && !close_connection ? 0 : -1;
+  }
+
+  result = range ? parse_range(range, artifact_stat.st_size, &first, &last) : 1;
+  if (result < 0) {
+    snprintf(headers, sizeof(headers), "Content-Range: bytes */%lld\r\n", (long long) artifact_stat.st_size);
+    result = send_head(fd, "416 Range Not Satisfiable", headers, 0, close_connection);
+  } else {
+    if (result == 1) {
+      first = 0;
+      last = artifact_stat.st_size - 1;
+    }
+    snprintf(headers, sizeof(headers), "Accept-Ranges: bytes\r\nContent-Type: application/octet-stream\r\n");
+    if (result == 0) {
+      snprintf(headers + strlen(headers), sizeof(headers) - strlen(headers), "Content-Range: bytes %lld-%lld/%lld\r\n",
+               (long long) first, (long long) last, (long long) artifact_stat.st_size);
+    }
+    result = send_head(fd, result == 0 ? "206 Partial Content" : "200 OK", headers, (long long) (last - first + 1),
+                       close_connection);
+    if (result == 0 && strcmp(method, "GET") == 0) {
+      result = send_file(fd, artifact_fd, first, last - first + 1);
+    }
+  }
+  close(artifact_fd);
+  return result == 0 && !close_connection ? 0 : -1;
+}
+
+static void close_connection(cache_connection_t *connection) {
+  gaus_cache_server_t *server = connection->server;
+
+  pthread_mutex_lock(&server->lock);
+  if (connection->prev) {
+    connection->prev->next = connection->next;
+  } else {
+    server->connections = connection->next;
+  }
+  if (connection->next) {
+    connection->next->prev = connection->prev;
+  }
+  close(connection->fd);
+  server->connection_count--;
+  pthread_cond_signal(&server->connection_closed);
+  pthread_mutex_unlock(&server->lock);
+  free(connection);
+}
+
+static void *serve_connection(void *arg) {
+  cache_connection_t *connection = arg;
+  char *request = malloc(CACHE_SERVER_REQUEST_SIZE + 1);
+  size_t length = 0;
+  sigset_t pipe_signal;
+
+  //sendfile to a device that went away raises SIGPIPE, keep it pending on this thread instead.
+  sigemptyset(&pipe_signal);
+  sigaddset(&pipe_signal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_signal, NULL);
+
+  while (request) {
+    char *end;
+    size_t used;
+
+    request[length] = '\0';
+    while (!(end = strstr(request, "\r\n\r\n"))) {
+      ssize_t received;
+
+      if (length == CACHE_SERVER_REQUEST_SIZE) {
+        send_head(connection->fd, "431 Request Header Fields Too Large", "", 0, true);
+        goto out;
+      }
+      received = recv(connection->fd, request + length, CACHE_SERVER_REQUEST_SIZE - length, 0);
+      if (received < 0 && errno == EINTR) {
+        continue;
+      }
+      if (received <= 0) {
+        goto out;
+      }
+      length += (size_t) received;
+      request[length] = '\0';
+    }
+    //Keep the line break of the last header, the requests after this one stay in the buffer.
+    used = (size_t) (end + 4 - request);
+    end[2] = '\0';
+    if (handle_request(connection->server, connection->fd, request) != 0) {
+      break;
+    }
+    memmove(request, request + used, length - used);
+    length -= used;
+  }
+
+  out:
+  free(request);
+  close_connection(connection);
+  return NULL;
+}
+
+static void start_connection(gaus_cache_server_t *server, int fd) {
+  struct timeval timeout = {CACHE_SERVER_TIMEOUT_SECONDS, 0};
+  cache_connection_t *connection = NULL;
+  pthread_attr_t attributes;
+  pthread_t thread;
+  bool started = false;
+
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  pthread_mutex_lock(&server->lock);
+  if (!server->stopping && server->connection_count < CACHE_SERVER_MAX_CONNECTIONS &&
+      (connection = calloc(1, sizeof(*connection)))) {
+    connection->server = server;
+    connection->fd = fd;
+    connection->next = server->connections;
+    if (server->connections) {
+      server->connections->prev = connection;
+    }
+    server->connections = connection;
+    server->connection_count++;
+  }
+  pthread_mutex_unlock(&server->lock);
+  if (!connection) {
+    send_head(fd, "503 Service Unavailable", "Retry-After: 10\r\n", 0, true);
+    close(fd);
+    return;
+  }
+
+  pthread_attr_init(&attributes);
+  pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+  started = pthread_create(&thread, &attributes, serve_connection, connection) == 0;
+  pthread_attr_destroy(&attributes);
+  if (!started) {
+    logging(L_ERROR, "gaus_cache_server: unable to start a thread for a connection");
+    close_connection(connection);
+  }
+}
+
+static void *accept_connections(void *arg) {
+  gaus_cache_server_t *server = arg;
+  struct pollfd fds[2] = {{server->listen_fd, POLLIN, 0}, {server->wakeup_pipe[0], POLLIN, 0}};
+
+  for (;;) {
+    int fd;
+
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      logging(L_ERROR, "gaus_cache_server: poll failed: %s", strerror(errno));
+      break;
+    }
+    if (fds[1].revents) {
+      break;
+    }
+    if ((fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC)) >= 0) {
+      start_connection(server, fd);
+    } else if (errno == EMFILE || errno == ENFILE) {
+      //Wait for connections to close instead of spinning on the one that cannot be accepted.
+      usleep(100 * 1000);
+    }
+  }
+  return NULL;
+}
+
+static void free_server(gaus_cache_server_t *server) {
+  if (server->listen_fd >= 0) {
+    close(server->listen_fd);
+  }
+  if (server->wakeup_pipe[0] >= 0) {
+    close(server->wakeup_pipe[0]);
+    close(server->wakeup_pipe[1]);
+  }
+  pthread_cond_destroy(&server->connection_closed);
+  pthread_mutex_destroy(&server->lock);
+  free(server->cache_path);
+  free(server);
+}
+
+gaus_error_t *gaus_cache_server_start(const gaus_cache_server_options_t *options, gaus_cache_server_t **server) {
+  struct sockaddr_in address = {.sin_family = AF_INET};
+  socklen_t address_length = sizeof(address);
+  gaus_cache_server_t *started;
+  int reuse = 1;
+
+  if (!options || !options->cache_path || !server) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Start cache server with invalid parameters");
+  }
+  address.sin_port = htons(options->port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (options->address && inet_pton(AF_INET, options->address, &address.sin_addr) != 1) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Invalid cache server address %s", options->address);
+  }
+  if (!(started = calloc(1, sizeof(*started)))) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to start cache server");
+  }
+  started->listen_fd = -1;
+  started->wakeup_pipe[0] = -1;
+  pthread_mutex_init(&started->lock, NULL);
+  pthread_cond_init(&started->connection_closed, NULL);
+  if (!(started->cache_path = strdup(options->cache_path)) ||
+      (started->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+      setsockopt(started->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+      bind(started->listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+      listen(started->listen_fd, SOMAXCONN) != 0 ||
+      getsockname(started->listen_fd, (struct sockaddr *) &address, &address_length) != 0) {
+    gaus_error_t *status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to listen on port %u: %s",
+                                             options->port, strerror(errno));
+    free_server(started);
+    return status;
+  }
+  started->port = ntohs(address.sin_port);
+  if (pipe2(started->wakeup_pipe, O_CLOEXEC) != 0) {
+    started->wakeup_pipe[0] = -1;
+    free_server(started);
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to start cache server");
+  }
+  if (pthread_create(&started->thread, NULL, accept_connections, started) != 0) {
+    free_server(started);
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to start cache server thread");
+  }
+  logging(L_INFO, "Serving %s on port %u", started->cache_path, started->port);
+  *server = started;
+  return NULL;
+}
+
+unsigned short gaus_cache_server_port(const gaus_cache_server_t *server) {
+  return server->port;
+}
+
+void gaus_cache_server_stop(gaus_cache_server_t *server) {
+  if (!server) {
+    return;
+  }
+  pthread_mutex_lock(&server->lock);
+  server->stopping = true;
+  pthread_mutex_unlock(&server->lock);
+  if (write(server->wakeup_pipe[1], "", 1) != 1) {
+    logging(L_WARNING, "gaus_cache_server: unable to wake up the server thread");
+  }
+  pthread_join(server->thread, NULL);
+
+  //Connections in the middle of a transfer end as if the device went away.
+  pthread_mutex_lock(&server->lock);
+  for (cache_connection_t *connection = server->connections; connection; connection = connection->next) {
+    shutdown(connection->fd, SHUT_RDWR);
+  }
+  while (server->connection_count > 0) {
+    pthread_cond_wait(&server->connection_closed, &server->lock);
+  }
+  pthread_mutex_unlock(&server->lock);
+  free_server(server);
+}
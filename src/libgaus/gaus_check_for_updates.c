@@ -1,48 +1,265 @@
-//The MIT License (MIT)
-//
-//Copyright 2018, Sony Mobile Communications Inc.
-//
-//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
-//
-//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
-//
-//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "gaus/gaus_client.h"
 #include "curl_wrapper.h"
 #include "gaus.h"
 #include "log.h"
+#include "json_stream.h"
 #include "request.h"
+#include "request_async.h"
+#include "update_cache.h"
 #include "gaus_json_helpers.h"
-#include <jansson.h>
+#include <stdlib.h>
 #include <string.h>
 
-static gaus_error_t *parse_update_json(json_t *root, unsigned int *updateCount, gaus_update_t **updates);
+typedef enum {
+  FIELD_NONE,
+  FIELD_METADATA,
+  FIELD_SIZE,
+  FIELD_UPDATE_TYPE,
+  FIELD_PACKAGE_TYPE,
+  FIELD_MD5,
+  FIELD_UPDATE_ID,
+  FIELD_VERSION,
+  FIELD_DOWNLOAD_URL,
+  FIELD_BASE_VERSION,
+  FIELD_TARGET_SIZE,
+  FIELD_TARGET_MD5,
+  FIELD_CHUNK_INDEX_URL,
+  FIELD_HASH_TREE_URL,
+  FIELD_HASH_TREE_ROOT
+} update_field_t;
+
+/* Builds the updates while the reply is still arriving, only the update currently being read is held in pieces.
+ * Completed updates are collected into updates, or handed to callback one at a time if it is set. */
+typedef struct {
+  json_stream_t stream;
+  gaus_error_t *error;           //First problem with the reply, nothing more is parsed once set
+  bool updates_key;              //The current member of the root object is "updates"
+  bool updates_seen;
+  bool in_updates;
+  gaus_update_callback_t callback;
+  void *user_data;
+  gaus_update_t *updates;        //Completed updates, if callback is NULL
+  unsigned int update_count;
+  unsigned int update_capacity;
+  gaus_update_t current;
+  update_field_t field;          //The member of current being read
+  bool metadata_valid;           //current has a "metadata" object
+  bool in_metadata;
+  unsigned int metadata_capacity;
+} update_parser_t;
+
+typedef struct {
+  char *url;
+  char *token;
+  unsigned int *update_count;
+  gaus_update_t **updates;
+  update_parser_t parser;
+  request_validators_t conditions;
+  request_validators_t received;
+  gaus_completion_callback_t callback;
+  void *user_data;
+} check_for_updates_async_context_t;
+
+static gaus_error_t *
+check_check_for_updates_parameters(const gaus_session_t *session, unsigned int filter_count,
+                                   const gaus_header_filter_t *filters, unsigned int *update_count,
+                                   gaus_update_t **updates);
+
+static char *create_check_for_updates_url(const gaus_session_t *session, unsigned int filter_count,
+                                          const gaus_header_filter_t *filters);
+
+static int answer_not_modified(long status_code, const char *url, const request_validators_t *conditions,
+                               unsigned int *update_count, gaus_update_t **updates);
+
+static gaus_error_t *
+process_check_for_updates_result(update_parser_t *parser, bool received, long status_code, const char *url,
+                                 const request_validators_t *validators, unsigned int *update_count,
+                                 gaus_update_t **updates);
+
+static void update_parser_init(update_parser_t *parser, gaus_update_callback_t callback, void *user_data);
+
+static size_t update_parser_writer(char *content, size_t size, size_t nmemb, void *userp);
+
+static void update_parser_free(update_parser_t *parser);
 
 gaus_error_t *
 gaus_check_for_updates(const gaus_session_t *session, unsigned int filter_count, const gaus_header_filter_t *filters,
                        unsigned int *update_count, gaus_update_t **updates) {
   gaus_error_t *status = NULL;
-  char *raw_check_for_update_result = NULL;
-  json_t *json_update_response = NULL;
-  char *query_parms = NULL;
-  size_t required_length = 256;
-  char* url = malloc(required_length);
+  char *url = NULL;
+  update_parser_t parser;
+  request_validators_t conditions;
+  request_validators_t received = {0};
+
+  if ((status = check_check_for_updates_parameters(session, filter_count, filters, update_count, updates))) {
+    return status;
+  }
+
+  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
+
+  url = create_check_for_updates_url(session, filter_count, filters);
+  update_cache_validators(url, &conditions);
+  update_parser_init(&parser, NULL, NULL);
+  int err = request_get_streamed(url, session->token, update_parser_writer, &parser, &conditions, &received,
+                                 &status_code);
+  int cached = answer_not_modified(status_code, url, &conditions, update_count, updates);
+  if (cached < 0) {
+    //Evicted since its validators were read, ask once more for the whole reply.
+    logging(L_DEBUG, "Updates not modified but no longer cached for url %s, requesting them again", url);
+    request_validators_free(&conditions);
+    request_validators_free(&received);
+    update_parser_free(&parser);
+    update_parser_init(&parser, NULL, NULL);
+    status_code = 200;
+    err = request_get_streamed(url, session->token, update_parser_writer, &parser, &conditions, &received,
+                               &status_code);
+  }
+  if (cached != 0) {
+    status = process_check_for_updates_result(&parser, err == 0, status_code, url, &received, update_count,
+                                              updates);
+  }
+
+  update_parser_free(&parser);
+  request_validators_free(&conditions);
+  request_validators_free(&received);
+  free(url);
+  return status;
+}
+
+gaus_error_t *
+gaus_check_for_updates_streamed(const gaus_session_t *session, unsigned int filter_count,
+                                const gaus_header_filter_t *filters, gaus_update_callback_t callback,
+                                void *user_data) {
+  gaus_error_t *status = NULL;
+  char *url = NULL;
+  update_parser_t parser;
+  //Without the whole reply there is nothing to answer a 304 with, so the request is never conditional.
+  request_validators_t conditions = {0};
+  request_validators_t received = {0};
+  unsigned int update_count;
+  gaus_update_t *updates = NULL;
+
+  if ((status = check_check_for_updates_parameters(session, filter_count, filters, &update_count, &updates))) {
+    return status;
+  }
+  if (!callback) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates without update callback");
+  }
+
+  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
+
+  url = create_check_for_updates_url(session, filter_count, filters);
+  update_parser_init(&parser, callback, user_data);
+  int err = request_get_streamed(url, session->token, update_parser_writer, &parser, &conditions, &received,
+                                 &status_code);
+  status = process_check_for_updates_result(&parser, err == 0, status_code, url, &received, &update_count, &updates);
+
+  update_parser_free(&parser);
+  request_validators_free(&received);
+  free(url);
+  return status;
+}
+
+static void check_for_updates_async_complete(const char *response, long status_code, void *user_data) {
+  check_for_updates_async_context_t *context = user_data;
+  gaus_error_t *status = NULL;
+
+  int cached = answer_not_modified(status_code, context->url, &context->conditions, context->update_count,
+                                   context->updates);
+  if (cached < 0) {
+    //Evicted since its validators were read, ask once more for the whole reply.
+    logging(L_DEBUG, "Updates not modified but no longer cached for url %s, requesting them again", context->url);
+    request_validators_free(&context->conditions);
+    request_validators_free(&context->received);
+    update_parser_free(&context->parser);
+    update_parser_init(&context->parser, NULL, NULL);
+    if (request_get_streamed_async(context->url, context->token, update_parser_writer, &context->parser,
+                                   &context->conditions, &context->received, check_for_updates_async_complete,
+                                   context) == 0) {
+      return;
+    }
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to queue check for updates request");
+  } else if (cached > 0) {
+    status = process_check_for_updates_result(&context->parser, response != NULL, status_code, context->url,
+                                              &context->received, context->update_count, context->updates);
+  }
+  context->callback(status, context->user_data);
+  update_parser_free(&context->parser);
+  request_validators_free(&context->conditions);
+  request_validators_free(&context->received);
+  free(context->token);
+  free(context->url);
+  free(context);
+}
 
+gaus_error_t *
+gaus_check_for_updates_async(const gaus_session_t *session, unsigned int filter_count,
+                             const gaus_header_filter_t *filters, unsigned int *update_count, gaus_update_t **updates,
+                             gaus_completion_callback_t callback, void *user_data) {
+  gaus_error_t *status = NULL;
+  check_for_updates_async_context_t *context = NULL;
+
+  if ((status = check_check_for_updates_parameters(session, filter_count, filters, update_count, updates))) {
+    return status;
+  }
+  if (!callback) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates without completion callback");
+  }
+
+  if (!(context = malloc(sizeof(check_for_updates_async_context_t)))) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to check for updates");
+  }
+  //Kept for asking again should the cached reply be evicted before the server answers it was not modified.
+  if (!(context->token = strdup(session->token))) {
+    free(context);
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to check for updates");
+  }
+  context->url = create_check_for_updates_url(session, filter_count, filters);
+  context->update_count = update_count;
+  context->updates = updates;
+  update_parser_init(&context->parser, NULL, NULL);
+  update_cache_validators(context->url, &context->conditions);
+  memset(&context->received, 0, sizeof(request_validators_t));
+  context->callback = callback;
+  context->user_data = user_data;
+
+  if (request_get_streamed_async(context->url, session->token, update_parser_writer, &context->parser,
+                                 &context->conditions, &context->received, check_for_updates_async_complete,
+                                 context) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to queue check for updates request");
+    update_parser_free(&context->parser);
+    request_validators_free(&context->conditions);
+    free(context->token);
+    free(context->url);
+    free(context);
+  }
+  return status;
+}
+
+static gaus_error_t *
+check_check_for_updates_parameters(const gaus_session_t *session, unsigned int filter_count,
+                                   const gaus_header_filter_t *filters, unsigned int *update_count,
+                                   gaus_update_t **updates) {
   if (!gaus_global_state.globalInitalized) {
-    status = gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Checked for updates without initializing");
-    goto error;
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Checked for updates without initializing");
   }
 
   if (!session || !session->device_guid || !session->product_guid || !session->token
       || !update_count || !updates) {
-    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates with invalid parameters");
-    goto error;
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates with invalid parameters");
   }
 
   if (filter_count > 0 && !filters) {
-    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates with invalid parameters");
-    goto error;
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates with invalid parameters");
   }
+  return NULL;
+}
+
+static char *create_check_for_updates_url(const gaus_session_t *session, unsigned int filter_count,
+                                          const gaus_header_filter_t *filters) {
+  char *query_parms = NULL;
+  size_t required_length = 256;
+  char* url = malloc(required_length);
 
   if (filter_count > 0) {
     query_parms = strdup("?");
@@ -61,167 +278,386 @@ gaus_check_for_updates(const gaus_session_t *session, unsigned int filter_count,
     free(new_filter);
   }
 
-  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
-
   //Fixme: This should be fixed for production
   int url_length = create_url(url, required_length, "%s/device/%s/%s/check-for-updates%s",
-                            gaus_global_state.serverUrl, session->product_guid, session->device_guid, query_parms);
+                            gaus_current_client()->serverUrl, session->product_guid, session->device_guid, query_parms);
 
   while(url_length < 0) {
       free(url);
       required_length += 256;
       url = malloc(required_length);
       url_length = create_url(url, required_length, "%s/device/%s/%s/check-for-updates%s",
-                 gaus_global_state.serverUrl, session->product_guid, session->device_guid, query_parms);
+                 gaus_current_client()->serverUrl, session->product_guid, session->device_guid, query_parms);
   }
 
-  raw_check_for_update_result = request_get_as_string(url, session->token, &status_code);
-  if (!raw_check_for_update_result && status_code < 400) {
-    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Posting authenticate failed to url %s", url);
-    goto error;
+  free(query_parms);
+  return url;
+}
+
+/* A 304 reply to a conditional request is answered from the update cache.  Returns 1 if the reply was no 304, and -1
+ * if the updates were evicted from the cache since the request was made, the request then has to be made again
+ * without conditions. */
+static int answer_not_modified(long status_code, const char *url, const request_validators_t *conditions,
+                               unsigned int *update_count, gaus_update_t **updates) {
+  if (status_code != 304 || (!conditions->etag && !conditions->last_modified)) {
+    return 1;
   }
+  return update_cache_get(url, conditions, update_count, updates);
+}
+
+/* Replies that parse are stored in the update cache. */
+static gaus_error_t *
+process_check_for_updates_result(update_parser_t *parser, bool received, long status_code, const char *url,
+                                 const request_validators_t *validators, unsigned int *update_count,
+                                 gaus_update_t **updates) {
+  gaus_error_t *status = NULL;
+
   if (status_code >= 400) {
-    status = gaus_create_error(__func__, GAUS_HTTP_ERROR, status_code,
-                               "Posting register failed with http error code %d to url %s",
-                               status_code, url);
-    goto error;
+    return gaus_create_error(__func__, GAUS_HTTP_ERROR, status_code,
+                             "Posting register failed with http error code %d to url %s",
+                             status_code, url);
   }
 
-  json_error_t json_error;
-  if (!(json_update_response = json_loads(raw_check_for_update_result, JSON_DECODE_ANY, &json_error))) {
-    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Error parsing json ");
-    goto error;
+  //The writer aborts the transfer once parsing stops, report why it stopped rather than the aborted transfer.
+  if (parser->error) {
+    status = parser->error;
+    parser->error = NULL;
+    return status;
+  }
+  if (parser->stream.error) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Error parsing json: %s", parser->stream.error);
+  }
+  if (!received) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Posting authenticate failed to url %s", url);
+  }
+  if (json_stream_finish(&parser->stream) != 0) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Error parsing json: %s", parser->stream.error);
+  }
+  if (!parser->updates_seen) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Server reply invalid: \"updates\" was not an array");
   }
 
-  status = parse_update_json(json_update_response, update_count, updates);
-
+  if (parser->callback) {
+    *update_count = 0;
+    *updates = NULL;
+    return NULL;
+  }
+  update_cache_store(url, validators, parser->update_count, parser->updates);
+  *update_count = parser->update_count;
+  *updates = parser->updates;
+  parser->update_count = 0;
+  parser->updates = NULL;
+  return NULL;
+}
 
-  error:
-  free(url);
-  free(query_parms);
-  free(raw_check_for_update_result);
-  json_decref(json_update_response);
-  return status;
+static int invalid_reply(update_parser_t *parser, const char *description) {
+  parser->error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Server reply invalid: %s", description);
+  return -1;
 }
 
-static gaus_error_t *parse_update_json(json_t *root, unsigned int *updateCount, gaus_update_t **updates) {
-  gaus_error_t *error = NULL;
-  json_t *json_updates = NULL;
+static char **string_field(gaus_update_t *update, update_field_t field) {
+  switch (field) {
+    case FIELD_UPDATE_TYPE: return &update->update_type;
+    case FIELD_PACKAGE_TYPE: return &update->package_type;
+    case FIELD_MD5: return &update->md5;
+    case FIELD_UPDATE_ID: return &update->update_id;
+    case FIELD_VERSION: return &update->version;
+    case FIELD_DOWNLOAD_URL: return &update->download_url;
+    case FIELD_BASE_VERSION: return &update->base_version;
+    case FIELD_TARGET_MD5: return &update->target_md5;
+    case FIELD_CHUNK_INDEX_URL: return &update->chunk_index_url;
+    case FIELD_HASH_TREE_URL: return &update->hash_tree_url;
+    case FIELD_HASH_TREE_ROOT: return &update->hash_tree_root;
+    default: return NULL;
+  }
+}
 
-  if (!json_is_object(root)) {
-    error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Server reply invalid: json root is not an object");
-    goto error;
+static update_field_t lookup_field(const char *key) {
+  static const struct {
+    const char *key;
+    update_field_t field;
+  } fields[] = {
+      {METADATA_JSON, FIELD_METADATA},
+      {SIZE_JSON, FIELD_SIZE},
+      {UPDATE_TYPE_JSON, FIELD_UPDATE_TYPE},
+      {PACKAGE_TYPE_JSON, FIELD_PACKAGE_TYPE},
+      {MD5_JSON, FIELD_MD5},
+      {UPDATE_ID_JSON, FIELD_UPDATE_ID},
+      {VERSION_JSON, FIELD_VERSION},
+      {DOWNLOAD_URL_JSON, FIELD_DOWNLOAD_URL},
+      {BASE_VERSION_JSON, FIELD_BASE_VERSION},
+      {TARGET_SIZE_JSON, FIELD_TARGET_SIZE},
+      {TARGET_MD5_JSON, FIELD_TARGET_MD5},
+      {CHUNK_INDEX_URL_JSON, FIELD_CHUNK_INDEX_URL},
+      {HASH_TREE_URL_JSON, FIELD_HASH_TREE_URL},
+      {HASH_TREE_ROOT_JSON, FIELD_HASH_TREE_ROOT},
+  };
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    if (strcmp(key, fields[i].key) == 0) {
+      return fields[i].field;
+    }
   }
+  return FIELD_NONE;
+}
 
-  json_updates = json_object_get(root, UPDATES_JSON);
-  if (!json_is_array(json_updates)) {
-    error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                              "Server reply invalid: \"deviceAuthParameters\" was not an object");
-    goto error;
+static void clear_metadata(update_parser_t *parser) {
+  for (unsigned int i = 0; i < parser->current.metadata_count; i++) {
+    free(parser->current.metadata[i].key);
+    free(parser->current.metadata[i].value);
   }
+  free(parser->current.metadata);
+  parser->current.metadata = NULL;
+  parser->current.metadata_count = 0;
+  parser->metadata_capacity = 0;
+  parser->metadata_valid = false;
+}
 
-  *updateCount = json_array_size(json_updates);
+/* A value of the wrong type counts as missing, as with the dup_dict_string and get_dict_int helpers. */
+static void on_update_member_value(update_parser_t *parser, json_stream_event_t event, const char *value) {
+  char **string = string_field(&parser->current, parser->field);
+
+  if (string) {
+    free(*string);
+    *string = event == JSON_STREAM_STRING ? strdup(value) : NULL;
+  } else if (parser->field == FIELD_SIZE || parser->field == FIELD_TARGET_SIZE) {
+    bool integer = event == JSON_STREAM_NUMBER && !strpbrk(value, ".eE");
+    unsigned int size = integer ? (unsigned int) strtoll(value, NULL, 10) : 0;
+    *(parser->field == FIELD_SIZE ? &parser->current.size : &parser->current.target_size) = size;
+  } else if (parser->field == FIELD_METADATA) {
+    clear_metadata(parser);
+    if (event == JSON_STREAM_OBJECT_START) {
+      parser->metadata_valid = true;
+      parser->in_metadata = true;
+    }
+  }
+}
 
-  if (*updateCount > 0) {
-    //Allocate memory for updates:
-    *updates = malloc(sizeof(gaus_update_t) * *updateCount);
+static int on_metadata_member(update_parser_t *parser, json_stream_event_t event, const char *value) {
+  gaus_update_t *update = &parser->current;
 
-    for (size_t i = 0; i < *updateCount; i++) {
-      json_t *json_metadata = NULL;
+  if (event == JSON_STREAM_KEY) {
+    if (update->metadata_count == parser->metadata_capacity) {
+      unsigned int capacity = parser->metadata_capacity ? parser->metadata_capacity * 2 : 4;
+      gaus_key_value_t *metadata = realloc(update->metadata, sizeof(gaus_key_value_t) * capacity);
+      if (!metadata) {
+        return invalid_reply(parser, "out of memory for metadata");
+      }
+      update->metadata = metadata;
+      parser->metadata_capacity = capacity;
+    }
+    update->metadata[update->metadata_count].key = strdup(value);
+    update->metadata[update->metadata_count].value = NULL;
+    update->metadata_count++;
+    return 0;
+  }
+  if (event != JSON_STREAM_STRING) {
+    return invalid_reply(parser, "metadata value is not a string");
+  }
+  update->metadata[update->metadata_count - 1].value = strdup(value);
+  return 0;
+}
 
-      json_t *json_current_update = json_array_get(json_updates, i);
-      //Ensure that updates has valid to free etc:
+static int collect_update(update_parser_t *parser, gaus_update_t *update) {
+  if (parser->update_count == parser->update_capacity) {
+    unsigned int capacity = parser->update_capacity ? parser->update_capacity * 2 : 4;
+    gaus_update_t *updates = realloc(parser->updates, sizeof(gaus_update_t) * capacity);
+    if (!updates) {
+      return invalid_reply(parser, "out of memory for updates");
+    }
+    parser->updates = updates;
+    parser->update_capacity = capacity;
+  }
+  parser->updates[parser->update_count++] = *update;
+  memset(update, 0, sizeof(gaus_update_t));
+  return 0;
+}
 
-      (*updates)[i].metadata = NULL;
-      (*updates)[i].metadata_count = 0;
-      (*updates)[i].size = 0;
-      (*updates)[i].update_type = NULL;
-      (*updates)[i].package_type = NULL;
-      (*updates)[i].md5 = NULL;
-      (*updates)[i].update_id = NULL;
-      (*updates)[i].version = NULL;
-      (*updates)[i].download_url = NULL;
+/* Checks the update just read in the same order the members used to be looked up, then passes it on. */
+static int finish_update(update_parser_t *parser) {
+  gaus_update_t *update = &parser->current;
 
-      json_metadata = json_object_get(json_current_update, METADATA_JSON);
-      if (!json_is_object(json_metadata)) {
-        error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                  "Server reply invalid: \"metadata\" was not an object");
-        goto error;
-      }
+  if (!parser->metadata_valid) {
+    return invalid_reply(parser, "\"metadata\" was not an object");
+  }
+  if (!update->update_type) {
+    return invalid_reply(parser, "required \"updateType\" missing in object");
+  }
+  if (!update->package_type) {
+    return invalid_reply(parser, "required \"packageType\" missing in object");
+  }
+  if (!update->update_id) {
+    return invalid_reply(parser, "required \"updateId\" missing in object");
+  }
+  if (!update->version) {
+    return invalid_reply(parser, "required \"version\" missing in object");
+  }
 
-      (*updates)[i].metadata_count = json_object_size(json_metadata);
+  bool delta = strcmp(update->package_type, PACKAGE_TYPE_DELTA_JSON) == 0;
+  if (!delta) {
+    free(update->base_version);
+    update->base_version = NULL;
+    update->target_size = 0;
+    free(update->target_md5);
+    update->target_md5 = NULL;
+  } else {
+    free(update->chunk_index_url);
+    update->chunk_index_url = NULL;
+    free(update->hash_tree_url);
+    update->hash_tree_url = NULL;
+    free(update->hash_tree_root);
+    update->hash_tree_root = NULL;
+  }
+  if (!delta && 0 != strcmp(update->package_type, PACKAGE_TYPE_FILE_JSON)) {
+    logging(L_WARNING, "Received update of type \"%s\", not processing further.", update->package_type);
+    update->size = 0;
+    free(update->md5);
+    update->md5 = NULL;
+    free(update->download_url);
+    update->download_url = NULL;
+    free(update->chunk_index_url);
+    update->chunk_index_url = NULL;
+    free(update->hash_tree_url);
+    update->hash_tree_url = NULL;
+    free(update->hash_tree_root);
+    update->hash_tree_root = NULL;
+  } else {
+    if (!update->size) {
+      return invalid_reply(parser, "required \"size\" missing in object");
+    }
+    if (!update->md5) {
+      return invalid_reply(parser, "required \"md5\" missing in object");
+    }
+    if (!update->download_url) {
+      return invalid_reply(parser, "required \"downloadUrl\" missing in object");
+    }
+    if (delta && !update->base_version) {
+      return invalid_reply(parser, "required \"baseVersion\" missing in object");
+    }
+    if (delta && !update->target_size) {
+      return invalid_reply(parser, "required \"targetSize\" missing in object");
+    }
+    if (delta && !update->target_md5) {
+      return invalid_reply(parser, "required \"targetMd5\" missing in object");
+    }
+  }
 
-      //Allocate memory for metadata:
-      (*updates)[i].metadata = malloc(sizeof(gaus_key_value_t) * (*updates)[i].metadata_count);
+  if (!parser->callback) {
+    return collect_update(parser, update);
+  }
+  int stop = parser->callback(update, parser->user_data);
+  update_free(update);
+  if (stop) {
+    parser->error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates stopped by the callback");
+    return -1;
+  }
+  return 0;
+}
 
-      const char *key = NULL;
-      json_t *value = NULL;
-      unsigned int j = 0;
-      json_object_foreach(json_metadata, key, value) {
-        (*updates)[i].metadata[j].key = strdup(key);
+/* The reply is {"updates": [{<update>}, ...]}, depth tells which level of it an event belongs to.  Members that are
+ * not part of an update are skipped without being kept. */
+static int on_json_event(json_stream_event_t event, const char *value, size_t length, unsigned int depth,
+                         void *user_data) {
+  update_parser_t *parser = user_data;
 
-        if (!json_is_string(value)) {
-          error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                    "Server reply invalid: metadata value is not a string");
-          goto error;
+  switch (depth) {
+    case 0:
+      if (event != JSON_STREAM_OBJECT_START && event != JSON_STREAM_OBJECT_END) {
+        return invalid_reply(parser, "json root is not an object");
+      }
+      return 0;
+
+    case 1:
+      if (event == JSON_STREAM_KEY) {
+        parser->updates_key = strcmp(value, UPDATES_JSON) == 0;
+      } else if (parser->updates_key) {
+        if (event == JSON_STREAM_ARRAY_START) {
+          parser->updates_seen = true;
+          parser->in_updates = true;
+        } else if (event == JSON_STREAM_ARRAY_END) {
+          parser->in_updates = false;
+        } else {
+          return invalid_reply(parser, "\"updates\" was not an array");
         }
-
-        (*updates)[i].metadata[j].value = strdup(json_string_value(value));
-        j++;
       }
+      return 0;
 
-      if (!((*updates)[i].update_type = dup_dict_string(json_current_update, UPDATE_TYPE_JSON, NULL))) {
-        error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                  "Server reply invalid: required \\\"updateType\\\" missing in object\"");
-        goto error;
+    case 2:
+      if (!parser->in_updates) {
+        return 0;
       }
-
-      if (!((*updates)[i].package_type = dup_dict_string(json_current_update, PACKAGE_TYPE_JSON, NULL))) {
-        error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                  "Server reply invalid: required \\\"packageType\\\" missing in object\"");
-        goto error;
+      if (event == JSON_STREAM_OBJECT_START) {
+        memset(&parser->current, 0, sizeof(gaus_update_t));
+        parser->field = FIELD_NONE;
+        parser->metadata_valid = false;
+        parser->metadata_capacity = 0;
+        return 0;
       }
+      if (event == JSON_STREAM_OBJECT_END) {
+        return finish_update(parser);
+      }
+      return invalid_reply(parser, "update is not an object");
 
-      if (!((*updates)[i].update_id = dup_dict_string(json_current_update, UPDATE_ID_JSON, NULL))) {
-        error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                  "Server reply invalid: required \\\"updateId\\\" missing in object\"");
-        goto error;
+    case 3:
+      if (!parser->in_updates) {
+        return 0;
+      }
+      if (event == JSON_STREAM_KEY) {
+        parser->field = lookup_field(value);
+      } else if (event == JSON_STREAM_OBJECT_END || event == JSON_STREAM_ARRAY_END) {
+        parser->in_metadata = false;
+      } else {
+        on_update_member_value(parser, event, value);
       }
+      return 0;
 
-      if (!((*updates)[i].version = dup_dict_string(json_current_update, VERSION_JSON, NULL))) {
-        error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                  "Server reply invalid: required \\\"version\\\" missing in object\"");
-        goto error;
+    case 4:
+      if (!parser->in_metadata) {
+        return 0;
       }
+      return on_metadata_member(parser, event, value);
 
-      if (0 != strcmp((*updates)[i].package_type, PACKAGE_TYPE_FILE_JSON)) {
-        logging(L_WARNING, "Received update of type \"%s\", not processing further.", (*updates)[i].package_type);
-        (*updates)[i].size = 0;
-        (*updates)[i].md5 = NULL;
-        (*updates)[i].download_url = NULL;
-        goto error;
-      } else {
-        if (!((*updates)[i].size = get_dict_int(json_current_update, SIZE_JSON, 0))) {
-          error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                    "Server reply invalid: required \"size\" missing in object");
-          goto error;
-        }
+    default:
+      return 0;
+  }
+}
 
-        if (!((*updates)[i].md5 = dup_dict_string(json_current_update, MD5_JSON, NULL))) {
-          error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                    "Server reply invalid: required \\\"md5\\\" missing in object\"");
-          goto error;
-        }
+static void update_parser_init(update_parser_t *parser, gaus_update_callback_t callback, void *user_data) {
+  memset(parser, 0, sizeof(update_parser_t));
+  parser->callback = callback;
+  parser->user_data = user_data;
+  json_stream_init(&parser->stream, on_json_event, parser);
+}
 
-        if (!((*updates)[i].download_url = dup_dict_string(json_current_update, DOWNLOAD_URL_JSON, NULL))) {
-          error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
-                                    "Server reply invalid: required \\\"downloadUrl\\\" missing in object\"");
-          goto error;
-        }
-      }
-    }
+/* Feeds the reply to the parser as curl receives it.  Once the reply is known to be invalid, or the update callback
+ * asked to stop, the transfer is aborted; the status code of the response decides which error is reported. */
+static size_t update_parser_writer(char *content, size_t size, size_t nmemb, void *userp) {
+  update_parser_t *parser = userp;
+  size_t write_size = size * nmemb;
+
+  if (parser->error || json_stream_feed(&parser->stream, content, write_size) != 0) {
+    return 0;
   }
+  return write_size;
+}
 
-  error:
-  return error;
+static void update_parser_free(update_parser_t *parser) {
+  update_free_all(parser->update_count, parser->updates);
+  update_free(&parser->current);
+  if (parser->error) {
+    free(parser->error->description);
+    free(parser->error);
+  }
+  json_stream_free(&parser->stream);
+}
+
+void gaus_update_free(gaus_update_t *update) {
+  if (update) {
+    update_free(update);
+  }
+}
+
+void gaus_updates_free(unsigned int update_count, gaus_update_t *updates) {
+  if (updates) {
+    update_free_all(update_count, updates);
+  }
 }
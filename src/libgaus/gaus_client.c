@@ -0,0 +1,123 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "gaus/gaus_client.h"
+#include "gaus.h"
+
+/* Each call runs with client as the current client of the calling thread, so every request it sets up uses the
+ * settings and connections of client. */
+
+gaus_error_t *gaus_client_register(gaus_client_t *client, const char *product_access, const char *product_secret,
+                                   const char *device_id, char **device_access, char **device_secret,
+                                   unsigned int *poll_interval_seconds) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_register(product_access, product_secret, device_id, device_access, device_secret,
+                                       poll_interval_seconds);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *gaus_client_authenticate(gaus_client_t *client, const char *device_access, const char *device_secret,
+                                       gaus_session_t *session) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_authenticate(device_access, device_secret, session);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *
+gaus_client_check_for_updates(gaus_client_t *client, const gaus_session_t *session, unsigned int filter_count,
+                              const gaus_header_filter_t *filters, unsigned int *update_count,
+                              gaus_update_t **updates) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_check_for_updates(session, filter_count, filters, update_count, updates);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *
+gaus_client_check_for_updates_streamed(gaus_client_t *client, const gaus_session_t *session,
+                                       unsigned int filter_count, const gaus_header_filter_t *filters,
+                                       gaus_update_callback_t callback, void *user_data) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_check_for_updates_streamed(session, filter_count, filters, callback, user_data);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *gaus_client_download_update(gaus_client_t *client, const gaus_session_t *session,
+                                          const gaus_update_t *update, const char *destination_path,
+                                          const gaus_download_options_t *options) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_download_update(session, update, destination_path, options);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *
+gaus_client_report(gaus_client_t *client, const gaus_session_t *session, unsigned int filter_count,
+                   const gaus_header_filter_t *filters, const gaus_report_header_t *header, unsigned int report_count,
+                   const gaus_report_t *reports) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_report(session, filter_count, filters, header, report_count, reports);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *
+gaus_client_register_async(gaus_client_t *client, const char *product_access, const char *product_secret,
+                           const char *device_id, char **device_access, char **device_secret,
+                           unsigned int *poll_interval_seconds, gaus_completion_callback_t callback, void *user_data) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_register_async(product_access, product_secret, device_id, device_access, device_secret,
+                                             poll_interval_seconds, callback, user_data);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *
+gaus_client_authenticate_async(gaus_client_t *client, const char *device_access, const char *device_secret,
+                               gaus_session_t *session, gaus_completion_callback_t callback, void *user_data) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_authenticate_async(device_access, device_secret, session, callback, user_data);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *
+gaus_client_check_for_updates_async(gaus_client_t *client, const gaus_session_t *session, unsigned int filter_count,
+                                    const gaus_header_filter_t *filters, unsigned int *update_count,
+                                    gaus_update_t **updates, gaus_completion_callback_t callback, void *user_data) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_check_for_updates_async(session, filter_count, filters, update_count, updates, callback,
+                                                      user_data);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *
+gaus_client_report_async(gaus_client_t *client, const gaus_session_t *session, unsigned int filter_count,
+                         const gaus_header_filter_t *filters, const gaus_report_header_t *header,
+                         unsigned int report_count, const gaus_report_t *reports, gaus_completion_callback_t callback,
+                         void *user_data) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_report_async(session, filter_count, filters, header, report_count, reports, callback,
+                                           user_data);
+  gaus_client_leave(previous);
+  return status;
+}
+
+gaus_error_t *gaus_client_prefetch_update(gaus_client_t *client, gaus_prefetcher_t *prefetcher,
+                                          const gaus_session_t *session, const gaus_update_t *update,
+                                          gaus_completion_callback_t callback, void *user_data) {
+  gaus_client_t *previous = gaus_client_enter(client);
+  gaus_error_t *status = gaus_prefetch_update(prefetcher, session, update, callback, user_data);
+  gaus_client_leave(previous);
+  return status;
+}
@@ -0,0 +1,962 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "gaus/gaus_client.h"
+#include "artifact_cache.h"
+#include "delta_patch.h"
+#include "download_chunks.h"
+#include "download_journal.h"
+#include "download_sources.h"
+#include "download_update.h"
+#include "download_sink.h"
+#include "extract_pipeline.h"
+#include "gaus.h"
+#include "gaus_json_helpers.h"
+#include "hash_tree.h"
+#include "log.h"
+#include "md5.h"
+#include "peer_discovery.h"
+#include "request.h"
+#include "request_ranges.h"
+#include "response_buffer.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DOWNLOAD_DEFAULT_ATTEMPTS 5
+#define DOWNLOAD_DEFAULT_STREAMS 4
+//Smallest segment of a package downloaded over several streams, smaller packages use a single one.
+#define DOWNLOAD_MIN_SEGMENT_SIZE (256 * 1024)
+//Segments per stream, so streams that finish early pick up more work instead of waiting for the slowest.
+#define DOWNLOAD_SEGMENTS_PER_STREAM 4
+//Bytes read at a time when hashing segments that arrived ahead of the ones before them.
+#define DOWNLOAD_READ_SIZE (64 * 1024)
+//Bytes written between journal updates with GAUS_SYNC_PERIODIC, every update first syncs the file.
+#define DOWNLOAD_DEFAULT_SYNC_INTERVAL (4 * 1024 * 1024)
+
+typedef struct {
+  const gaus_update_t *update;
+  const char *url;       //Source of the current transfer
+  const request_speed_floor_t *floor;
+  const download_control_t *control;
+  bool cancelled;        //The transfer was stopped by control->cancelled
+  const char *journal_path;
+  download_sink_t sink;
+  off_t size;            //Expected size of the package
+  off_t offset;          //Bytes of the package received so far
+  off_t received;        //Bytes received by all transfers, in or out of order, to measure their throughput
+  off_t journal_offset;  //Bytes recorded in the journal
+  off_t sync_interval;   //Bytes between journal updates, 0 to only update it when a transfer breaks off
+  md5_context_t md5;     //Digest of the package received so far
+  bool failed;           //Writing failed, resuming will not help
+  delta_patch_t *patch;  //Rebuilds the target from the base for delta packages, NULL for file packages
+  int base_fd;
+  off_t target_size;     //Expected size of the file, the package size unless it is a delta
+  off_t target_offset;   //Bytes of a delta target written so far
+  md5_context_t target_md5;
+  request_range_t *segments;  //Downloaded concurrently, NULL for a single stream
+  size_t segment_count;
+  size_t head;           //First segment that is not complete, offset lies in it
+  stream_control_t streams;
+  char *read_buffer;
+  const char *extract_path;
+  extract_pipeline_t *extract;  //Unpacks the file while it downloads, NULL unless extract_path is set
+  bool extract_failed;
+  const hash_tree_t *tree;      //Checks each chunk as it arrives, NULL without a hash tree
+  off_t chunk_start;            //Start of the chunk a single stream is receiving
+  md5_context_t chunk_start_md5;  //Digest of the package up to chunk_start
+  md5_context_t chunk_md5;      //Digest of the chunk received so far
+  md5_context_t *segment_md5;   //Digest of the chunk each segment is receiving
+} download_t;
+
+static gaus_error_t *check_download_parameters(const gaus_session_t *session, const gaus_update_t *update,
+                                               const char *destination_path, const gaus_download_options_t *options);
+
+static gaus_error_t *download_from(const gaus_update_t *update, download_sources_t *sources,
+                                   const char *destination_path, const gaus_download_options_t *options,
+                                   const download_control_t *control, const hash_tree_t *tree,
+                                   unsigned int max_streams, unsigned int max_attempts);
+
+static int fetch_hash_tree(const gaus_session_t *session, const gaus_update_t *update, hash_tree_t *tree);
+
+static bool check_cancelled(download_t *download);
+
+static size_t download_writer(char *content, size_t size, size_t nmemb, void *userp);
+
+static int write_piece(download_t *download, const char *data, size_t length);
+
+static void start_chunk(download_t *download);
+
+static int check_chunk(download_t *download, const char *data, size_t length);
+
+static int check_segment(download_t *download, request_range_t *segment, const char *data, size_t length);
+
+static int align_to_chunk(download_t *download);
+
+static int checkpoint(download_t *download);
+
+static int start_over(download_t *download);
+
+static int delta_output(const char *data, size_t length, void *user_data);
+
+static int split_segments(download_t *download, unsigned int max_streams);
+
+static int get_segments(download_t *download, const char *auth_token, long *status_code);
+
+static int extract(download_t *download, const char *data, size_t length);
+
+static int extract_from_file(int fd, off_t length, extract_pipeline_t *pipeline);
+
+static gaus_error_t *extract_download(const gaus_update_t *update, const char *destination_path,
+                                      const char *extract_path);
+
+static const char *cache_path(const gaus_download_options_t *options);
+
+static gaus_error_t *copy_from_cache(const gaus_update_t *update, const char *destination_path,
+                                     const gaus_download_options_t *options, bool *found);
+
+static void add_to_cache(const gaus_update_t *update, const char *destination_path,
+                         const gaus_download_options_t *options);
+
+gaus_error_t *gaus_download_update(const gaus_session_t *session, const gaus_update_t *update,
+                                   const char *destination_path, const gaus_download_options_t *options) {
+  download_control_t control = {BANDWIDTH_BULK, NULL, NULL};
+
+  return download_update(session, update, destination_path, options, &control);
+}
+
+gaus_error_t *download_update(const gaus_session_t *session, const gaus_update_t *update,
+                              const char *destination_path, const gaus_download_options_t *options,
+                              const download_control_t *control) {
+  gaus_error_t *status = NULL;
+  unsigned int max_attempts = options && options->max_attempts ? options->max_attempts : DOWNLOAD_DEFAULT_ATTEMPTS;
+  unsigned int max_streams = options && options->max_streams ? options->max_streams : DOWNLOAD_DEFAULT_STREAMS;
+  hash_tree_t tree = {0};
+  const hash_tree_t *checked = NULL;
+  download_sources_t sources;
+
+  if ((status = check_download_parameters(session, update, destination_path, options))) {
+    return status;
+  }
+  if (cache_path(options) && strcmp(update->package_type, PACKAGE_TYPE_FILE_JSON) == 0) {
+    bool found = false;
+    if ((status = copy_from_cache(update, destination_path, options, &found))) {
+      return status;
+    }
+    if (found) {
+      return options->extract_path ? extract_download(update, destination_path, options->extract_path) : NULL;
+    }
+  }
+  //Without the tree the package is still checked against its md5, only later.
+  if (update->hash_tree_url && strcmp(update->package_type, PACKAGE_TYPE_FILE_JSON) == 0) {
+    if (fetch_hash_tree(session, update, &tree) == 0) {
+      checked = &tree;
+    } else {
+      logging(L_WARNING, "Unable to use hash tree %s, checking %s as a whole", update->hash_tree_url,
+              update->update_id);
+    }
+  }
+  if (options && options->peers && strcmp(update->package_type, PACKAGE_TYPE_FILE_JSON) == 0) {
+    char *url = peer_discovery_find(options->peers, update->md5, update->size);
+    if (url) {
+      //Peers are not the gaus backend, they never get to see the token.
+      logging(L_INFO, "Downloading %s from peer %s", update->update_id, url);
+      if (download_sources_init(&sources, url, NULL, NULL, 0) != 0) {
+        free(url);
+        status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to download update");
+        goto out;
+      }
+      status = download_from(update, &sources, destination_path, options, control, checked, max_streams,
+                             max_attempts);
+      download_sources_free(&sources);
+      free(url);
+      if (!status) {
+        goto out;
+      }
+      //What arrived from the peer is journaled, the download from the backend resumes after it.
+      logging(L_WARNING, "Unable to download %s from a peer, downloading it from the backend", update->update_id);
+      free(status->description);
+      free(status);
+    }
+  }
+  if (update->chunk_index_url && strcmp(update->package_type, PACKAGE_TYPE_FILE_JSON) == 0 && options &&
+      (options->base_path || options->chunk_store_path)) {
+    bool unsupported = false;
+    if ((status = download_chunks(session, update, destination_path, options, max_streams, max_attempts,
+                                  &unsupported))) {
+      goto out;
+    }
+    if (!unsupported) {
+      if (options->extract_path && (status = extract_download(update, destination_path, options->extract_path))) {
+        goto out;
+      }
+      add_to_cache(update, destination_path, options);
+      goto out;
+    }
+    logging(L_WARNING, "Unable to download %s in chunks, downloading it as a whole", update->update_id);
+  }
+  if (download_sources_init(&sources, update->download_url, session->token, options ? options->mirror_urls : NULL,
+                            options ? options->mirror_count : 0) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to download update");
+    goto out;
+  }
+  status = download_from(update, &sources, destination_path, options, control, checked, max_streams, max_attempts);
+  download_sources_free(&sources);
+
+  out:
+  hash_tree_free(&tree);
+  return status;
+}
+
+/* Get the hash tree of update and check it against gaus_update_t::hash_tree_root.  Returns 0 if it can be used. */
+static int fetch_hash_tree(const gaus_session_t *session, const gaus_update_t *update, hash_tree_t *tree) {
+  long status_code = 0;
+  char *document = request_get_as_string(update->hash_tree_url, session->token, &status_code);
+  int result = -1;
+
+  if (document && update->hash_tree_root) {
+    result = hash_tree_parse(tree, document, (off_t) update->size, update->hash_tree_root);
+  }
+  response_buffer_free(document);
+  return result;
+}
+
+static long long now_ms(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Download the package from sources, resuming what the journal records of an earlier download into
+ * destination_path.  With a tree every chunk is checked as it arrives, and a bad one is fetched again. */
+static gaus_error_t *download_from(const gaus_update_t *update, download_sources_t *sources,
+                                   const char *destination_path, const gaus_download_options_t *options,
+                                   const download_control_t *control, const hash_tree_t *tree,
+                                   unsigned int max_streams, unsigned int max_attempts) {
+  gaus_error_t *status = NULL;
+  char *journal_path = NULL;
+  unsigned int attempt;
+  long status_code = 0;
+  unsigned char digest[MD5_DIGEST_LENGTH];
+  request_speed_floor_t floor = {options ? (long) options->min_speed : 0, options ? (long) options->min_speed_time : 0};
+  download_t download = {.update = update, .url = sources->sources[0].url, .floor = &floor, .control = control,
+                         .sink = {.fd = -1}, .base_fd = -1, .tree = tree};
+
+  if (!(journal_path = download_journal_path(destination_path))) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to download update");
+  }
+  download.journal_path = journal_path;
+  download.extract_path = options ? options->extract_path : NULL;
+  download.size = update->size;
+  download.target_size = update->size;
+  if (!options || options->sync_policy == GAUS_SYNC_PERIODIC) {
+    download.sync_interval = options && options->sync_interval ? options->sync_interval
+                                                               : DOWNLOAD_DEFAULT_SYNC_INTERVAL;
+  }
+  if ((options && options->direct_io ? download_sink_open_direct(&download.sink, destination_path)
+                                     : download_sink_open(&download.sink, destination_path)) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to open %s", destination_path);
+    goto out;
+  }
+
+  if (strcmp(update->package_type, PACKAGE_TYPE_DELTA_JSON) == 0) {
+    //The patch cannot be resumed halfway, so a delta is always downloaded from the start and not journaled.
+    download.target_size = update->target_size;
+    download.sync_interval = 0;
+    if ((download.base_fd = open(options->base_path, O_RDONLY | O_CLOEXEC)) < 0 ||
+        !(download.patch = delta_patch_create(download.base_fd, delta_output, &download))) {
+      status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to read base version %s",
+                                 options->base_path);
+      goto out;
+    }
+    md5_init(&download.target_md5);
+    download_journal_remove(journal_path);
+  } else {
+    //Only bytes vouched for by the journal are kept, anything after them may not have reached the disk.
+    download.offset = download_journal_read(journal_path, update, &download.md5);
+  }
+  if (download.offset == 0 || download.offset > download.sink.written || download.offset > download.size) {
+    download.offset = 0;
+    md5_init(&download.md5);
+  }
+  if (download.tree && align_to_chunk(&download) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to read %s", destination_path);
+    goto out;
+  }
+  if (download_sink_reset(&download.sink, download.offset, download.target_size) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to prepare %s", destination_path);
+    goto out;
+  }
+  download.journal_offset = download.offset;
+  start_chunk(&download);
+  if (download.offset > 0) {
+    logging(L_INFO, "Resuming download of %s at byte %lld", update->update_id, (long long) download.offset);
+  }
+  if (download.extract_path &&
+      (!(download.extract = extract_pipeline_create(download.extract_path)) ||
+       extract_from_file(download.sink.fd, download.offset, download.extract) != 0)) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to extract %s into %s",
+                               download.url, download.extract_path);
+    goto out;
+  }
+  //Segments are written out of order through the page cache, which direct I/O is meant to avoid.
+  if (!download.patch && !(options && options->direct_io) && max_streams > 1 &&
+      download.size - download.offset >= 2 * DOWNLOAD_MIN_SEGMENT_SIZE && split_segments(&download, max_streams) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to download update");
+    goto out;
+  }
+
+  //Each source gets as many attempts as a single one would.
+  for (attempt = 0; attempt < max_attempts * sources->count && download.offset < download.size; attempt++) {
+    download_source_t *source = &sources->sources[sources->current];
+    off_t received = download.received;
+    long long started = now_ms();
+    int result;
+
+    if (check_cancelled(&download)) {
+      break;
+    }
+    if (download.patch && download.offset > 0 && start_over(&download) != 0) {
+      status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to prepare %s", destination_path);
+      goto out;
+    }
+    status_code = 0;
+    download.url = source->url;
+    if (download.segments) {
+      result = get_segments(&download, source->auth_token, &status_code);
+    } else {
+      result = request_get_from(source->url, source->auth_token, download.offset, control->traffic_class, &floor,
+                                download_writer, &download, &status_code);
+    }
+
+    if (download.cancelled) {
+      break;
+    }
+    if (download.extract_failed) {
+      status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to extract %s into %s",
+                                 download.url, download.extract_path);
+      goto out;
+    }
+    if (download.failed) {
+      status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to %s %s",
+                                 download.patch ? "apply patch to" : "write", destination_path);
+      goto out;
+    }
+    if (result == 1 && download.segments) {
+      //Carry on over a single stream from the end of the verified data, it starts over if the server does not
+      //resume either.
+      free(download.segments);
+      download.segments = NULL;
+      if (download_sink_reset(&download.sink, download.offset, download.size) != 0) {
+        status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to prepare %s", destination_path);
+        goto out;
+      }
+      start_chunk(&download);
+      continue;
+    }
+    if (result == 1) {
+      //The server ignores ranges, so only a transfer from the start can succeed.
+      if (start_over(&download) != 0) {
+        status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to prepare %s", destination_path);
+        goto out;
+      }
+      continue;
+    }
+    //A slow or broken transfer moves the download to another source, it continues from the verified bytes.
+    if (download_sources_record(sources, download.received - received, now_ms() - started,
+                                download.offset >= download.size, status_code) != 0) {
+      status = gaus_create_error(__func__, GAUS_HTTP_ERROR, status_code,
+                                 "Download failed with http error code %ld from url %s", status_code,
+                                 download.url);
+      goto out;
+    }
+    if (download.offset < download.size) {
+      logging(L_WARNING, "Download of %s broke off at byte %lld of %lld", update->update_id,
+              (long long) download.offset, (long long) download.size);
+      if (!download.patch) {
+        checkpoint(&download);
+      }
+    }
+  }
+
+  if (download.cancelled) {
+    if (!download.patch) {
+      checkpoint(&download);
+    }
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Download of %s cancelled at byte %lld",
+                               download.url, (long long) download.offset);
+    goto out;
+  }
+  if (download.offset < download.size && status_code >= 500) {
+    status = gaus_create_error(__func__, GAUS_HTTP_ERROR, status_code,
+                               "Download failed with http error code %ld from url %s", status_code,
+                               download.url);
+    goto out;
+  }
+  if (download.offset < download.size) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Download of %s incomplete after %u attempts",
+                               download.url, attempt);
+    goto out;
+  }
+  md5_final(&download.md5, digest);
+  if (md5_compare_hex(digest, update->md5) != 0) {
+    //The bytes on disk are wrong, so the next attempt has to start over.
+    download_journal_remove(journal_path);
+    status = gaus_create_error(__func__, GAUS_CHECKSUM_ERROR, 500, "Download of %s does not match md5 %s",
+                               download.url, update->md5);
+    goto out;
+  }
+  if (download.patch) {
+    if (delta_patch_finish(download.patch) != 0 || download.target_offset != download.target_size) {
+      status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Patch %s does not rebuild version %s",
+                                 download.url, update->version);
+      goto out;
+    }
+    md5_final(&download.target_md5, digest);
+    if (md5_compare_hex(digest, update->target_md5) != 0) {
+      status = gaus_create_error(__func__, GAUS_CHECKSUM_ERROR, 500,
+                                 "Version rebuilt from %s does not match md5 %s, is %s version %s?",
+                                 download.url, update->target_md5, options->base_path,
+                                 update->base_version);
+      goto out;
+    }
+  }
+  if (download.extract && extract_pipeline_finish(download.extract) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to extract %s into %s",
+                               download.url, download.extract_path);
+    goto out;
+  }
+  if (download_sink_flush(&download.sink, 1) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to write %s", destination_path);
+    goto out;
+  }
+  download_journal_remove(journal_path);
+  if (!download.patch) {
+    add_to_cache(update, destination_path, options);
+  }
+
+  out:
+  if (download_sink_close(&download.sink) != 0 && !status) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to close %s", destination_path);
+  }
+  delta_patch_free(download.patch);
+  extract_pipeline_free(download.extract);
+  free(download.segments);
+  free(download.segment_md5);
+  free(download.read_buffer);
+  if (download.base_fd >= 0) {
+    close(download.base_fd);
+  }
+  free(journal_path);
+  return status;
+}
+
+static gaus_error_t *check_download_parameters(const gaus_session_t *session, const gaus_update_t *update,
+                                               const char *destination_path, const gaus_download_options_t *options) {
+  if (!gaus_global_state.globalInitalized) {
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Downloaded update without initializing");
+  }
+  if (!session || !session->token || !update || !destination_path ||
+      (options && options->sync_policy != GAUS_SYNC_PERIODIC && options->sync_policy != GAUS_SYNC_ON_COMPLETION) ||
+      (options && options->mirror_count && !options->mirror_urls)) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Download update with invalid parameters");
+  }
+  if (!update->download_url || !update->md5 || !update->package_type ||
+      (strcmp(update->package_type, PACKAGE_TYPE_FILE_JSON) != 0 &&
+       strcmp(update->package_type, PACKAGE_TYPE_DELTA_JSON) != 0)) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Update %s has no package to download",
+                             update->update_id ? update->update_id : "");
+  }
+  if (strcmp(update->package_type, PACKAGE_TYPE_DELTA_JSON) == 0 &&
+      (!update->target_md5 || !options || !options->base_path)) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Delta update %s needs the installed version %s",
+                             update->update_id ? update->update_id : "",
+                             update->base_version ? update->base_version : "");
+  }
+  return NULL;
+}
+
+static size_t download_writer(char *content, size_t size, size_t nmemb, void *userp) {
+  download_t *download = userp;
+  size_t write_size = size * nmemb;
+
+  if (check_cancelled(download)) {
+    return 0;
+  }
+  if (download->offset + (off_t) write_size > download->size) {
+    logging(L_ERROR, "download_writer: server sent more than the %lld bytes of the update",
+            (long long) download->size);
+    download->failed = true;
+    return 0;
+  }
+  download->received += (off_t) write_size;
+  //With a hash tree each chunk is written on its own, so the download can go back to the start of a bad one.
+  for (size_t done = 0, count; done < write_size; done += count) {
+    count = write_size - done;
+    if (download->tree) {
+      off_t end = hash_tree_chunk_end(download->tree, hash_tree_chunk(download->tree, download->offset),
+                                      download->size);
+      count = end - download->offset < (off_t) count ? (size_t) (end - download->offset) : count;
+    }
+    if (write_piece(download, content + done, count) != 0) {
+      return 0;
+    }
+  }
+
+  if (download->sync_interval && download->offset - download->journal_offset >= download->sync_interval) {
+    checkpoint(download);
+  }
+  return write_size;
+}
+
+/* Write the next length bytes of the package, which with a hash tree do not go past the end of a chunk. */
+static int write_piece(download_t *download, const char *data, size_t length) {
+  md5_update(&download->md5, data, length);
+  if (download->patch ? delta_patch_feed(download->patch, data, length) != 0
+                      : download_sink_write(&download->sink, data, length) != 0 ||
+                            extract(download, data, length) != 0) {
+    download->failed = true;
+    return -1;
+  }
+  download->offset += (off_t) length;
+  return download->tree ? check_chunk(download, data, length) : 0;
+}
+
+/* Start a single stream's next chunk at offset, which is where a chunk starts. */
+static void start_chunk(download_t *download) {
+  download->chunk_start = download->offset;
+  download->chunk_start_md5 = download->md5;
+  md5_init(&download->chunk_md5);
+}
+
+/* Hash the length bytes a single stream just wrote into its chunk and check the chunk once it is complete.  A bad
+ * chunk is dropped, the download goes back to its start and -1 aborts the transfer to fetch it again. */
+static int check_chunk(download_t *download, const char *data, size_t length) {
+  size_t chunk = hash_tree_chunk(download->tree, download->chunk_start);
+
+  md5_update(&download->chunk_md5, data, length);
+  if (download->offset < hash_tree_chunk_end(download->tree, chunk, download->size)) {
+    return 0;
+  }
+  if (hash_tree_check(download->tree, chunk, &download->chunk_md5)) {
+    start_chunk(download);
+    return 0;
+  }
+  logging(L_WARNING, "Chunk %zu of %s does not match its hash, fetching it again", chunk,
+          download->update->update_id);
+  download->offset = download->chunk_start;
+  download->md5 = download->chunk_start_md5;
+  md5_init(&download->chunk_md5);
+  if (download_sink_flush(&download->sink, 0) != 0 ||
+      download_sink_reset(&download->sink, download->offset, download->size) != 0) {
+    download->failed = true;
+    return -1;
+  }
+  if (download->extract) {
+    //The extraction cannot take back what it was fed, it starts over with the chunks that were checked.
+    extract_pipeline_free(download->extract);
+    if (!(download->extract = extract_pipeline_create(download->extract_path)) ||
+        extract_from_file(download->sink.fd, download->offset, download->extract) != 0) {
+      download->extract_failed = true;
+    }
+  }
+  return -1;
+}
+
+/* A download journaled without the hash tree may stop inside a chunk.  It goes back to the start of that chunk, so
+ * each chunk is checked as a whole, and the md5 up to there is computed from the file. */
+static int align_to_chunk(download_t *download) {
+  off_t end = download->offset - download->offset % download->tree->chunk_size;
+  off_t offset = 0;
+  char *buffer;
+
+  if (end == download->offset) {
+    return 0;
+  }
+  if (!(buffer = malloc(DOWNLOAD_READ_SIZE))) {
+    return -1;
+  }
+  md5_init(&download->md5);
+  while (offset < end) {
+    ssize_t count = pread(download->sink.fd, buffer, end - offset < DOWNLOAD_READ_SIZE ? (size_t) (end - offset)
+                                                                                       : DOWNLOAD_READ_SIZE, offset);
+    if (count <= 0) {
+      free(buffer);
+      return -1;
+    }
+    md5_update(&download->md5, buffer, (size_t) count);
+    offset += count;
+  }
+  free(buffer);
+  download->offset = end;
+  return 0;
+}
+
+/* Whether the download is to stop, the transfer is then aborted by its writer. */
+static bool check_cancelled(download_t *download) {
+  if (!download->cancelled && download->control->cancelled &&
+      download->control->cancelled(download->control->user_data)) {
+    download->cancelled = true;
+  }
+  return download->cancelled;
+}
+
+/* Record the progress so far in the journal once it is on disk.  A failure only costs progress after a restart. */
+static int checkpoint(download_t *download) {
+  off_t offset = download->offset;
+  const md5_context_t *md5 = &download->md5;
+
+  if (download->tree && !download->segments) {
+    //Only chunks that were checked are recorded, a restart fetches the one in progress again.
+    offset = download->chunk_start;
+    md5 = &download->chunk_start_md5;
+  }
+  if (offset == download->journal_offset) {
+    return 0;
+  }
+  if (download_sink_flush(&download->sink, 1) != 0) {
+    return -1;
+  }
+  if (download_journal_write(download->journal_path, download->update, offset, md5) != 0) {
+    return -1;
+  }
+  download->journal_offset = offset;
+  return 0;
+}
+
+/* Throw away what was received so far and start again from the first byte. */
+static int start_over(download_t *download) {
+  download->offset = 0;
+  download->journal_offset = 0;
+  md5_init(&download->md5);
+  start_chunk(download);
+  download_journal_remove(download->journal_path);
+  if (download->patch) {
+    delta_patch_free(download->patch);
+    if (!(download->patch = delta_patch_create(download->base_fd, delta_output, download))) {
+      return -1;
+    }
+    download->target_offset = 0;
+    md5_init(&download->target_md5);
+  }
+  if (download->extract) {
+    extract_pipeline_free(download->extract);
+    if (!(download->extract = extract_pipeline_create(download->extract_path))) {
+      return -1;
+    }
+  }
+  return download_sink_reset(&download->sink, 0, download->target_size);
+}
+
+/* Receives the version rebuilt from a delta package. */
+static int delta_output(const char *data, size_t length, void *user_data) {
+  download_t *download = user_data;
+
+  if (download->target_offset + (off_t) length > download->target_size) {
+    logging(L_ERROR, "delta_output: patch rebuilds more than the %lld bytes of the update",
+            (long long) download->target_size);
+    return -1;
+  }
+  if (download_sink_write(&download->sink, data, length) != 0) {
+    return -1;
+  }
+  md5_update(&download->target_md5, data, length);
+  download->target_offset += (off_t) length;
+  return extract(download, data, length);
+}
+
+/* Split the rest of the package into segments to download concurrently. */
+static int split_segments(download_t *download, unsigned int max_streams) {
+  off_t remaining = download->size - download->offset;
+  off_t segment_size = remaining / (max_streams * DOWNLOAD_SEGMENTS_PER_STREAM);
+
+  if (segment_size < DOWNLOAD_MIN_SEGMENT_SIZE) {
+    segment_size = DOWNLOAD_MIN_SEGMENT_SIZE;
+  }
+  if (download->tree) {
+    //Segments hold whole chunks, offset already is where one starts.
+    segment_size += (download->tree->chunk_size - segment_size % download->tree->chunk_size) %
+                    download->tree->chunk_size;
+  }
+  download->segment_count = (size_t) ((remaining + segment_size - 1) / segment_size);
+  if (!(download->segments = calloc(download->segment_count, sizeof(request_range_t))) ||
+      !(download->read_buffer = malloc(DOWNLOAD_READ_SIZE)) ||
+      (download->tree && !(download->segment_md5 = calloc(download->segment_count, sizeof(md5_context_t))))) {
+    return -1;
+  }
+  for (size_t i = 0; i < download->segment_count; i++) {
+    download->segments[i].offset = download->offset + (off_t) i * segment_size;
+    download->segments[i].length = i + 1 < download->segment_count ? segment_size
+                                                                   : remaining - (off_t) i * segment_size;
+    download->segments[i].user_data = download;
+    if (download->segment_md5) {
+      md5_init(&download->segment_md5[i]);
+    }
+  }
+  download->head = 0;
+  stream_control_init(&download->streams, max_streams);
+  return 0;
+}
+
+/* Bytes at the start of segment ready to be hashed in order, with a hash tree those of the chunks that were checked. */
+static curl_off_t segment_ready(const download_t *download, const request_range_t *segment) {
+  if (!download->tree || segment->received == segment->length) {
+    return segment->received;
+  }
+  return segment->received - segment->received % download->tree->chunk_size;
+}
+
+/* Hash the segments that arrived ahead of the ones before them, once those are complete. */
+static int catch_up(download_t *download) {
+  for (; download->head < download->segment_count; download->head++) {
+    request_range_t *segment = &download->segments[download->head];
+    curl_off_t ready = segment_ready(download, segment);
+    off_t end = (off_t) (segment->offset + ready);
+
+    while (download->offset < end) {
+      size_t length = end - download->offset < DOWNLOAD_READ_SIZE ? (size_t) (end - download->offset)
+                                                                   : DOWNLOAD_READ_SIZE;
+      ssize_t result = pread(download->sink.fd, download->read_buffer, length, download->offset);
+      if (result <= 0) {
+        logging(L_ERROR, "catch_up: unable to read back segment at byte %lld", (long long) download->offset);
+        return -1;
+      }
+      md5_update(&download->md5, download->read_buffer, (size_t) result);
+      if (extract(download, download->read_buffer, (size_t) result) != 0) {
+        return -1;
+      }
+      download->offset += result;
+    }
+    if (ready < segment->length) {
+      break;
+    }
+  }
+  return 0;
+}
+
+static int segment_writer(request_range_t *segment, const char *data, size_t length) {
+  download_t *download = segment->user_data;
+  off_t position = (off_t) (segment->offset + segment->received);
+
+  if (check_cancelled(download)) {
+    return -1;
+  }
+  if (catch_up(download) != 0 || download_sink_write_at(&download->sink, position, data, length) != 0) {
+    download->failed = true;
+    return -1;
+  }
+  download->received += (off_t) length;
+  if (download->tree) {
+    //Chunks are hashed in order once they were checked, by reading them back.
+    if (check_segment(download, segment, data, length) != 0) {
+      return -1;
+    }
+  } else if (position == download->offset) {
+    //The segment continues what was verified so far, it is hashed without reading it back.
+    md5_update(&download->md5, data, length);
+    if (extract(download, data, length) != 0) {
+      return -1;
+    }
+    download->offset += (off_t) length;
+  }
+  if (download->sync_interval && download->offset - download->journal_offset >= download->sync_interval) {
+    checkpoint(download);
+  }
+  return 0;
+}
+
+/* Hash the length bytes a segment just wrote into its chunks and check each one it completes.  The segment goes back
+ * to the start of a bad chunk and -1 aborts its transfer to fetch it again. */
+static int check_segment(download_t *download, request_range_t *segment, const char *data, size_t length) {
+  md5_context_t *md5 = &download->segment_md5[segment - download->segments];
+  off_t position = (off_t) (segment->offset + segment->received);
+
+  while (length > 0) {
+    size_t chunk = hash_tree_chunk(download->tree, position);
+    off_t end = hash_tree_chunk_end(download->tree, chunk, download->size);
+    size_t count = end - position < (off_t) length ? (size_t) (end - position) : length;
+
+    md5_update(md5, data, count);
+    data += count;
+    length -= count;
+    position += (off_t) count;
+    if (position < end) {
+      break;
+    }
+    if (!hash_tree_check(download->tree, chunk, md5)) {
+      logging(L_WARNING, "Chunk %zu of %s does not match its hash, fetching it again", chunk,
+              download->update->update_id);
+      md5_init(md5);
+      segment->received = (curl_off_t) chunk * download->tree->chunk_size - segment->offset;
+      return -1;
+    }
+    md5_init(md5);
+  }
+  return 0;
+}
+
+/* Fetch what is missing of the segments, the result and status_code are as with request_get_from. */
+static int get_segments(download_t *download, const char *auth_token, long *status_code) {
+  int result = request_get_ranges(download->url, auth_token, download->segments, download->segment_count,
+                                  &download->streams, download->control->traffic_class, download->floor,
+                                  segment_writer);
+
+  if (!download->failed && catch_up(download) != 0) {
+    download->failed = true;
+  }
+  for (size_t i = 0; i < download->segment_count; i++) {
+    if (download->segments[i].received < download->segments[i].length && download->segments[i].status_code) {
+      *status_code = download->segments[i].status_code;
+      break;
+    }
+  }
+  return result;
+}
+
+/* Pass the file on to the extraction in order, only bytes that are part of the md5 so far get there. */
+static int extract(download_t *download, const char *data, size_t length) {
+  if (download->extract && extract_pipeline_feed(download->extract, data, length) != 0) {
+    download->extract_failed = true;
+    return -1;
+  }
+  return 0;
+}
+
+/* Feed the first length bytes of the file at fd, for a download resumed or assembled from chunks. */
+static int extract_from_file(int fd, off_t length, extract_pipeline_t *pipeline) {
+  char *buffer = NULL;
+  off_t offset = 0;
+  int result = -1;
+
+  if (length > 0 && !(buffer = malloc(DOWNLOAD_READ_SIZE))) {
+    return -1;
+  }
+  while (offset < length) {
+    ssize_t count = pread(fd, buffer, length - offset < DOWNLOAD_READ_SIZE ? (size_t) (length - offset)
+                                                                             : DOWNLOAD_READ_SIZE, offset);
+    if (count <= 0 || extract_pipeline_feed(pipeline, buffer, (size_t) count) != 0) {
+      goto out;
+    }
+    offset += count;
+  }
+  result = 0;
+
+  out:
+  free(buffer);
+  return result;
+}
+
+/* Extract a package that is already complete at destination_path. */
+static gaus_error_t *extract_download(const gaus_update_t *update, const char *destination_path,
+                                      const char *extract_path) {
+  extract_pipeline_t *pipeline = NULL;
+  int fd = open(destination_path, O_RDONLY | O_CLOEXEC);
+  int result = -1;
+
+  if (fd >= 0 && (pipeline = extract_pipeline_create(extract_path)) &&
+      extract_from_file(fd, (off_t) update->size, pipeline) == 0) {
+    result = extract_pipeline_finish(pipeline);
+  }
+  extract_pipeline_free(pipeline);
+  if (fd >= 0) {
+    close(fd);
+  }
+  return result == 0 ? NULL : gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to extract %s into %s",
+                                                update->download_url, extract_path);
+}
+
+/* The artifact cache, which is also where the packages served to peers are kept. */
+static const char *cache_path(const gaus_download_options_t *options) {
+  if (!options) {
+    return NULL;
+  }
+  return options->artifact_cache_path || !options->peers ? options->artifact_cache_path : options->peers->cache_path;
+}
+
+/* Copy the package from the artifact cache if it is there, a damaged copy is removed and the package downloaded. */
+static gaus_error_t *copy_from_cache(const gaus_update_t *update, const char *destination_path,
+                                     const gaus_download_options_t *options, bool *found) {
+  gaus_error_t *status = NULL;
+  download_sink_t sink = {.fd = -1};
+  md5_context_t md5;
+  unsigned char digest[MD5_DIGEST_LENGTH];
+  char *buffer = NULL;
+  char *journal_path = NULL;
+  off_t offset = 0;
+  int fd = artifact_cache_open(cache_path(options), update->md5, (off_t) update->size);
+
+  *found = false;
+  if (fd < 0) {
+    return NULL;
+  }
+  //The destination is overwritten from the start, bytes a journal vouches for from a download that broke off are no
+  //longer there to resume after, even if the copy fails.
+  if (!(journal_path = download_journal_path(destination_path))) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to download update");
+    goto out;
+  }
+  download_journal_remove(journal_path);
+  if (!(buffer = malloc(DOWNLOAD_READ_SIZE)) ||
+      (options->direct_io ? download_sink_open_direct(&sink, destination_path)
+                          : download_sink_open(&sink, destination_path)) != 0 ||
+      download_sink_reset(&sink, 0, (off_t) update->size) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to open %s", destination_path);
+    goto out;
+  }
+  md5_init(&md5);
+  while (offset < (off_t) update->size) {
+    ssize_t count = pread(fd, buffer, (off_t) update->size - offset < DOWNLOAD_READ_SIZE
+                                      ? (size_t) ((off_t) update->size - offset) : DOWNLOAD_READ_SIZE, offset);
+    if (count <= 0) {
+      break;
+    }
+    md5_update(&md5, buffer, (size_t) count);
+    if (download_sink_write(&sink, buffer, (size_t) count) != 0) {
+      status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to write %s", destination_path);
+      goto out;
+    }
+    offset += count;
+  }
+  md5_final(&md5, digest);
+  if (offset < (off_t) update->size || md5_compare_hex(digest, update->md5) != 0) {
+    logging(L_WARNING, "Cached package of %s is damaged, downloading it", update->update_id);
+    artifact_cache_remove(cache_path(options), update->md5);
+    goto out;
+  }
+  if (download_sink_flush(&sink, 1) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to write %s", destination_path);
+    goto out;
+  }
+  logging(L_INFO, "Copied %s from the artifact cache", update->update_id);
+  *found = true;
+
+  out:
+  if (download_sink_close(&sink) != 0 && !status) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to close %s", destination_path);
+  }
+  close(fd);
+  free(buffer);
+  free(journal_path);
+  return status;
+}
+
+/* Keep a downloaded package for the devices behind a gateway.  The cache only saves downloads, so failures are not
+ * errors. */
+static void add_to_cache(const gaus_update_t *update, const char *destination_path,
+                         const gaus_download_options_t *options) {
+  if (cache_path(options) &&
+      artifact_cache_add(cache_path(options), update->md5, destination_path, (off_t) update->size,
+                         options->artifact_cache_size) != 0) {
+    logging(L_WARNING, "Unable to add %s to %s", update->update_id, cache_path(options));
+  }
+}
@@ -30,6 +30,22 @@
 #define MD5_JSON "md5"
 #define UPDATE_ID_JSON "updateId"
 #define PACKAGE_TYPE_FILE_JSON "file"
+#define PACKAGE_TYPE_DELTA_JSON "delta"
+#define BASE_VERSION_JSON "baseVersion"
+#define TARGET_SIZE_JSON "targetSize"
+#define TARGET_MD5_JSON "targetMd5"
+#define CHUNK_INDEX_URL_JSON "chunkIndexUrl"
+#define HASH_TREE_URL_JSON "hashTreeUrl"
+#define HASH_TREE_ROOT_JSON "hashTreeRoot"
+
+//Chunk index specific json defines:
+#define CHUNK_MIN_SIZE_JSON "minSize"
+#define CHUNK_AVERAGE_SIZE_JSON "averageSize"
+#define CHUNK_MAX_SIZE_JSON "maxSize"
+#define CHUNKS_JSON "chunks"
+
+//Hash tree specific json defines, the leaves are in CHUNKS_JSON:
+#define CHUNK_SIZE_JSON "chunkSize"
 
 //Report specific json defines:
 #define TYPE_JSON "type"
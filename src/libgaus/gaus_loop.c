@@ -0,0 +1,50 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "gaus/gaus_client.h"
+#include "gaus.h"
+#include "request_async.h"
+#include <stddef.h>
+
+gaus_error_t *gaus_loop_init(const gaus_loop_options_t *options) {
+  if (!gaus_global_state.globalInitalized) {
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Must call gaus_global_init first");
+  }
+  if (!options || !options->socket_callback || !options->timer_callback) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Both loop callbacks are required");
+  }
+  if (request_async_use_loop(options) != 0) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500,
+                             "Unable to use host event loop, was an asynchronous call already made?");
+  }
+  return NULL;
+}
+
+gaus_error_t *gaus_loop_socket_action(int fd, unsigned int events) {
+  if (!gaus_global_state.globalInitalized) {
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Must call gaus_global_init first");
+  }
+  if (fd < 0) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Invalid socket %d", fd);
+  }
+  if (request_async_socket_action(fd, events) != 0) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Failed processing socket %d", fd);
+  }
+  return NULL;
+}
+
+gaus_error_t *gaus_loop_timeout(void) {
+  if (!gaus_global_state.globalInitalized) {
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Must call gaus_global_init first");
+  }
+  if (request_async_socket_action(-1, 0) != 0) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Failed processing timeout");
+  }
+  return NULL;
+}
@@ -0,0 +1,57 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "gaus/gaus_client.h"
+#include "gaus.h"
+#include "log.h"
+#include "peer_discovery.h"
+
+#include <stdlib.h>
+
+struct gaus_peer {
+  gaus_cache_server_t *server;
+  peer_responder_t *responder;
+};
+
+gaus_error_t *gaus_peer_start(const gaus_peer_options_t *options, gaus_peer_t **peer) {
+  gaus_cache_server_options_t server_options = {0};
+  gaus_peer_t *started;
+  gaus_error_t *status;
+
+  if (!options || !options->cache_path || !peer) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Start peer with invalid parameters");
+  }
+  if (!(started = calloc(1, sizeof(*started)))) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to start peer");
+  }
+  server_options.cache_path = options->cache_path;
+  server_options.address = options->address;
+  if ((status = gaus_cache_server_start(&server_options, &started->server))) {
+    free(started);
+    return status;
+  }
+  if (!(started->responder = peer_responder_start(options, gaus_cache_server_port(started->server)))) {
+    gaus_cache_server_stop(started->server);
+    free(started);
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to join the peer group");
+  }
+  logging(L_INFO, "Serving %s to peers", options->cache_path);
+  *peer = started;
+  return NULL;
+}
+
+void gaus_peer_stop(gaus_peer_t *peer) {
+  if (!peer) {
+    return;
+  }
+  //Peers stop being pointed here before the transfers to them are broken off.
+  peer_responder_stop(peer->responder);
+  gaus_cache_server_stop(peer->server);
+  free(peer);
+}
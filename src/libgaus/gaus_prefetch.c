@@ -0,0 +1,234 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "gaus/gaus_client.h"
+#include "artifact_cache.h"
+#include "bandwidth.h"
+#include "download_update.h"
+#include "gaus.h"
+#include "gaus_json_helpers.h"
+#include "log.h"
+#include "md5.h"
+#include "update_cache.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct prefetch_job {
+  gaus_session_t session;
+  gaus_update_t *update;
+  gaus_client_t *client;  //Client of the thread that queued the update, the download runs with its settings
+  gaus_completion_callback_t callback;
+  void *user_data;
+  struct prefetch_job *next;
+} prefetch_job_t;
+
+struct gaus_prefetcher {
+  char *store_path;
+  unsigned long long store_size;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t queued;
+  prefetch_job_t *first;  //Waiting to be prefetched, in the order they were queued
+  prefetch_job_t *last;
+  bool stopping;
+};
+
+static bool prefetcher_in_use = false;
+static pthread_mutex_t prefetcher_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void free_job(prefetch_job_t *job) {
+  free(job->session.device_guid);
+  free(job->session.product_guid);
+  free(job->session.token);
+  if (job->update) {
+    update_free_all(1, job->update);
+  }
+  free(job);
+}
+
+static void finish_job(prefetch_job_t *job, gaus_error_t *status) {
+  if (job->callback) {
+    job->callback(status, job->user_data);
+  } else if (status) {
+    free(status->description);
+    free(status);
+  }
+  free_job(job);
+}
+
+static bool stopping(void *user_data) {
+  gaus_prefetcher_t *prefetcher = user_data;
+  bool result;
+
+  pthread_mutex_lock(&prefetcher->lock);
+  result = prefetcher->stopping;
+  pthread_mutex_unlock(&prefetcher->lock);
+  return result;
+}
+
+/* Download the package of job next to the store, and move it in once it is complete and matches its md5. */
+static gaus_error_t *prefetch(gaus_prefetcher_t *prefetcher, prefetch_job_t *job) {
+  const gaus_update_t *update = job->update;
+  gaus_download_options_t options = {0};
+  download_control_t control = {BANDWIDTH_BACKGROUND, stopping, prefetcher};
+  gaus_error_t *status;
+  char *path;
+
+  if (artifact_cache_contains(prefetcher->store_path, update->md5, (off_t) update->size)) {
+    return NULL;
+  }
+  if (!(path = malloc(strlen(prefetcher->store_path) + strlen(update->md5) + 16))) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to prefetch update");
+  }
+  //Not an entry of the store until it is complete, the journal next to it lets a later prefetch resume it.
+  sprintf(path, "%s/%s.prefetch", prefetcher->store_path, update->md5);
+  //A single connection leaves the most room for everything else.
+  options.max_streams = 1;
+  logging(L_INFO, "Prefetching %s", update->update_id);
+  if (!(status = download_update(&job->session, update, path, &options, &control)) &&
+      artifact_cache_adopt(prefetcher->store_path, update->md5, path, prefetcher->store_size) != 0) {
+    unlink(path);
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to keep %s in %s", update->update_id,
+                               prefetcher->store_path);
+  }
+  free(path);
+  return status;
+}
+
+static void *prefetch_updates(void *arg) {
+  gaus_prefetcher_t *prefetcher = arg;
+
+  pthread_mutex_lock(&prefetcher->lock);
+  for (;;) {
+    prefetch_job_t *job;
+
+    while (!prefetcher->first && !prefetcher->stopping) {
+      pthread_cond_wait(&prefetcher->queued, &prefetcher->lock);
+    }
+    if (prefetcher->stopping) {
+      break;
+    }
+    job = prefetcher->first;
+    if (!(prefetcher->first = job->next)) {
+      prefetcher->last = NULL;
+    }
+    pthread_mutex_unlock(&prefetcher->lock);
+    gaus_client_t *previous = gaus_client_enter(job->client);
+    finish_job(job, prefetch(prefetcher, job));
+    gaus_client_leave(previous);
+    pthread_mutex_lock(&prefetcher->lock);
+  }
+  pthread_mutex_unlock(&prefetcher->lock);
+  return NULL;
+}
+
+static void free_prefetcher(gaus_prefetcher_t *prefetcher) {
+  pthread_cond_destroy(&prefetcher->queued);
+  pthread_mutex_destroy(&prefetcher->lock);
+  free(prefetcher->store_path);
+  free(prefetcher);
+}
+
+gaus_error_t *gaus_prefetch_start(const gaus_prefetch_options_t *options, gaus_prefetcher_t **prefetcher) {
+  gaus_prefetcher_t *started;
+
+  if (!options || !options->store_path || !prefetcher) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Start prefetch with invalid parameters");
+  }
+  pthread_mutex_lock(&prefetcher_lock);
+  if (prefetcher_in_use) {
+    pthread_mutex_unlock(&prefetcher_lock);
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "A prefetch worker is already running");
+  }
+  if (!(started = calloc(1, sizeof(*started))) || !(started->store_path = strdup(options->store_path))) {
+    pthread_mutex_unlock(&prefetcher_lock);
+    free(started);
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to start prefetch");
+  }
+  started->store_size = options->store_size;
+  pthread_mutex_init(&started->lock, NULL);
+  pthread_cond_init(&started->queued, NULL);
+  if (pthread_create(&started->thread, NULL, prefetch_updates, started) != 0) {
+    pthread_mutex_unlock(&prefetcher_lock);
+    free_prefetcher(started);
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to start prefetch thread");
+  }
+  bandwidth_set_background((curl_off_t) options->max_bandwidth);
+  prefetcher_in_use = true;
+  pthread_mutex_unlock(&prefetcher_lock);
+  *prefetcher = started;
+  return NULL;
+}
+
+gaus_error_t *gaus_prefetch_update(gaus_prefetcher_t *prefetcher, const gaus_session_t *session,
+                                   const gaus_update_t *update, gaus_completion_callback_t callback, void *user_data) {
+  unsigned char digest[MD5_DIGEST_LENGTH];
+  prefetch_job_t *job;
+
+  if (!gaus_global_state.globalInitalized) {
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Prefetched update without initializing");
+  }
+  //The md5 names the file in the store, so it has to be a digest.
+  if (!prefetcher || !session || !session->token || !update || !update->download_url || !update->md5 ||
+      md5_from_hex(update->md5, digest) != 0 || !update->package_type ||
+      strcmp(update->package_type, PACKAGE_TYPE_FILE_JSON) != 0) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Prefetch update with invalid parameters");
+  }
+  if (!(job = calloc(1, sizeof(*job)))) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to prefetch update");
+  }
+  job->client = gaus_current_client();
+  job->callback = callback;
+  job->user_data = user_data;
+  if ((session->device_guid && !(job->session.device_guid = strdup(session->device_guid))) ||
+      (session->product_guid && !(job->session.product_guid = strdup(session->product_guid))) ||
+      !(job->session.token = strdup(session->token)) || update_copy_all(1, update, &job->update) != 0) {
+    free_job(job);
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Not enough memory to prefetch update");
+  }
+
+  pthread_mutex_lock(&prefetcher->lock);
+  if (prefetcher->last) {
+    prefetcher->last->next = job;
+  } else {
+    prefetcher->first = job;
+  }
+  prefetcher->last = job;
+  pthread_cond_signal(&prefetcher->queued);
+  pthread_mutex_unlock(&prefetcher->lock);
+  return NULL;
+}
+
+void gaus_prefetch_stop(gaus_prefetcher_t *prefetcher) {
+  prefetch_job_t *job;
+
+  if (!prefetcher) {
+    return;
+  }
+  pthread_mutex_lock(&prefetcher->lock);
+  prefetcher->stopping = true;
+  pthread_cond_signal(&prefetcher->queued);
+  pthread_mutex_unlock(&prefetcher->lock);
+  pthread_join(prefetcher->thread, NULL);
+
+  while ((job = prefetcher->first)) {
+    prefetcher->first = job->next;
+    finish_job(job, gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Prefetch of %s stopped",
+                                      job->update->update_id ? job->update->update_id : job->update->md5));
+  }
+  pthread_mutex_lock(&prefetcher_lock);
+  bandwidth_set_background(0);
+  prefetcher_in_use = false;
+  pthread_mutex_unlock(&prefetcher_lock);
+  free_prefetcher(prefetcher);
+}
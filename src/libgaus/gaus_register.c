@@ -12,11 +12,30 @@
 #include "gaus.h"
 #include "log.h"
 #include "request.h"
+#include "request_async.h"
 #include "gaus_json_helpers.h"
 #include <jansson.h>
 #include <string.h>
 
+typedef struct {
+  char **device_access;
+  char **device_secret;
+  unsigned int *poll_interval_seconds;
+  gaus_completion_callback_t callback;
+  void *user_data;
+} register_async_context_t;
+
 //Helper functions
+static gaus_error_t *
+check_register_parameters(const char *product_access, const char *product_secret, const char *device_id,
+                          char **device_access, char **device_secret, unsigned int *poll_interval_seconds);
+
+static char *create_register_body(const char *product_access, const char *product_secret, const char *device_id);
+
+static gaus_error_t *
+process_register_result(const char *raw_register_result, long status_code,
+                        char **device_access, char **device_secret, unsigned int *poll_interval_seconds);
+
 static gaus_error_t *
 parse_device_json(json_t *root, char **device_access, char **device_secret, unsigned int *poll_interval_seconds);
 
@@ -24,9 +43,72 @@ gaus_error_t *gaus_register(const char *product_access, const char *product_secr
                             char **device_access, char **device_secret, unsigned int *poll_interval_seconds) {
 
   gaus_error_t *error = NULL;
-  json_t *json_register_response = NULL;
-  json_t *json_device_params = NULL;
 
+  if ((error = check_register_parameters(product_access, product_secret, device_id,
+                                         device_access, device_secret, poll_interval_seconds))) {
+    return error;
+  }
+
+  char *jsonString = create_register_body(product_access, product_secret, device_id);
+
+  char url[256];
+  create_url(url, sizeof(url), "%s/register", gaus_current_client()->serverUrl);
+  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
+  char *raw_register_result = request_post_as_string(url, NULL, jsonString, BANDWIDTH_CONTROL, &status_code);
+  error = process_register_result(raw_register_result, status_code, device_access, device_secret,
+                                  poll_interval_seconds);
+
+  response_buffer_free(raw_register_result);
+  free(jsonString);
+  return error;
+}
+
+static void register_async_complete(const char *response, long status_code, void *user_data) {
+  register_async_context_t *context = user_data;
+  gaus_error_t *error = process_register_result(response, status_code, context->device_access,
+                                                context->device_secret, context->poll_interval_seconds);
+  context->callback(error, context->user_data);
+  free(context);
+}
+
+gaus_error_t *gaus_register_async(const char *product_access, const char *product_secret, const char *device_id,
+                                  char **device_access, char **device_secret, unsigned int *poll_interval_seconds,
+                                  gaus_completion_callback_t callback, void *user_data) {
+  gaus_error_t *error = NULL;
+  register_async_context_t *context = NULL;
+  char *jsonString = NULL;
+
+  if ((error = check_register_parameters(product_access, product_secret, device_id,
+                                         device_access, device_secret, poll_interval_seconds))) {
+    return error;
+  }
+  if (!callback) {
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Registered without completion callback");
+  }
+
+  context = malloc(sizeof(register_async_context_t));
+  context->device_access = device_access;
+  context->device_secret = device_secret;
+  context->poll_interval_seconds = poll_interval_seconds;
+  context->callback = callback;
+  context->user_data = user_data;
+
+  jsonString = create_register_body(product_access, product_secret, device_id);
+
+  char url[256];
+  create_url(url, sizeof(url), "%s/register", gaus_current_client()->serverUrl);
+  if (request_post_async(url, NULL, jsonString, BANDWIDTH_CONTROL, register_async_complete, context) != 0) {
+    error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to queue register request");
+    free(context);
+  }
+
+  free(jsonString);
+  return error;
+}
+
+static gaus_error_t *
+check_register_parameters(const char *product_access, const char *product_secret, const char *device_id,
+                          char **device_access, char **device_secret, unsigned int *poll_interval_seconds) {
   if (!gaus_global_state.globalInitalized) {
     return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Registered without initializing");
   }
@@ -36,7 +118,10 @@ gaus_error_t *gaus_register(const char *product_access, const char *product_secr
       || !device_access || !device_secret || !poll_interval_seconds) {
     return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Registered with invalid input parameters");
   }
+  return NULL;
+}
 
+static char *create_register_body(const char *product_access, const char *product_secret, const char *device_id) {
   json_t *register_body_json = json_pack("{s:s,s:{s:s, s:s}}",
                                          DEVICE_ID_JSON, device_id,
                                          PRODUCT_AUTH_PARAM_JSON,
@@ -45,11 +130,16 @@ gaus_error_t *gaus_register(const char *product_access, const char *product_secr
   );
 
   char *jsonString = json_dumps(register_body_json, JSON_COMPACT);
+  json_decref(register_body_json);
+  return jsonString;
+}
+
+static gaus_error_t *
+process_register_result(const char *raw_register_result, long status_code,
+                        char **device_access, char **device_secret, unsigned int *poll_interval_seconds) {
+  gaus_error_t *error = NULL;
+  json_t *json_register_response = NULL;
 
-  char url[256];
-  create_url(url, sizeof(url), "%s/register", gaus_global_state.serverUrl);
-  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
-  char *raw_register_result = request_post_as_string(url, NULL, jsonString, &status_code);
   if (!raw_register_result && status_code < 400) {
     error = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Posting register failed");
     goto error;
@@ -70,10 +160,6 @@ gaus_error_t *gaus_register(const char *product_access, const char *product_secr
   error = parse_device_json(json_register_response, device_access, device_secret, poll_interval_seconds);
 
   error:
-  free(raw_register_result);
-  free(jsonString);
-  json_decref(register_body_json);
-  json_decref(json_device_params);
   json_decref(json_register_response);
   return error;
 }
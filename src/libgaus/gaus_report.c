@@ -10,12 +10,30 @@
 #include "gaus/gaus_client.h"
 #include "gaus.h"
 #include "request.h"
+#include "request_async.h"
 #include "gaus_json_helpers.h"
 #include "log.h"
 
 #include <jansson.h>
 #include <string.h>
 
+typedef struct {
+  gaus_completion_callback_t callback;
+  void *user_data;
+} report_async_context_t;
+
+static gaus_error_t *
+check_report_parameters(const gaus_session_t *session, unsigned int filter_count, const gaus_header_filter_t *filters,
+                        const gaus_report_header_t *header, unsigned int report_count, const gaus_report_t *reports);
+
+static char *create_query_parameters(unsigned int filter_count, const gaus_header_filter_t *filters);
+
+static gaus_error_t *
+create_report_body(const gaus_report_header_t *header, unsigned int report_count, const gaus_report_t *reports,
+                   char **report_post_body);
+
+static gaus_error_t *process_report_result(const char *raw_report_result, long status_code);
+
 static gaus_error_t *
 get_json_for_vints(unsigned int int_count, gaus_v_int_t *v_ints, json_t **json_v_ints);
 
@@ -37,31 +55,107 @@ gaus_error_t *
 gaus_report(const gaus_session_t *session, unsigned int filter_count, const gaus_header_filter_t *filters,
             const gaus_report_header_t *header, unsigned int report_count, const gaus_report_t *reports) {
 
-  json_t *json_header = NULL;
-  json_t *json_to_send = NULL;
-  json_t *json_reports_array = NULL;
-  json_t *json_temp_one_report = NULL;
   char *report_post_body = NULL;
   char *query_parms = NULL;
 
   gaus_error_t *status = NULL;
   char *raw_report_result = NULL;
 
-  if (!gaus_global_state.globalInitalized) {
-    status = gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Checked for updates without initializing");
+  if (NULL != (status = check_report_parameters(session, filter_count, filters, header, report_count, reports))) {
     goto error;
   }
 
+  query_parms = create_query_parameters(filter_count, filters);
+
+  if (NULL != (status = create_report_body(header, report_count, reports, &report_post_body))) {
+    goto error;
+  }
+
+  //Fixme: This should be dynamically allocated:
+  char url[256];
+  create_url(url, sizeof(url), "%s/device/%s/%s/report%s",
+             gaus_current_client()->serverUrl, session->product_guid, session->device_guid, query_parms);
+  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
+  raw_report_result = request_post_as_string(url, session->token, report_post_body, BANDWIDTH_REPORT, &status_code);
+  status = process_report_result(raw_report_result, status_code);
+
+  error:
+  free(report_post_body);
+  response_buffer_free(raw_report_result);
+  free(query_parms);
+  return status;
+}
+
+static void report_async_complete(const char *response, long status_code, void *user_data) {
+  report_async_context_t *context = user_data;
+  gaus_error_t *status = process_report_result(response, status_code);
+  context->callback(status, context->user_data);
+  free(context);
+}
+
+gaus_error_t *
+gaus_report_async(const gaus_session_t *session, unsigned int filter_count, const gaus_header_filter_t *filters,
+                  const gaus_report_header_t *header, unsigned int report_count, const gaus_report_t *reports,
+                  gaus_completion_callback_t callback, void *user_data) {
+  char *report_post_body = NULL;
+  char *query_parms = NULL;
+  report_async_context_t *context = NULL;
+  gaus_error_t *status = NULL;
+
+  if (NULL != (status = check_report_parameters(session, filter_count, filters, header, report_count, reports))) {
+    goto error;
+  }
+  if (!callback) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Report without completion callback");
+    goto error;
+  }
+
+  query_parms = create_query_parameters(filter_count, filters);
+
+  if (NULL != (status = create_report_body(header, report_count, reports, &report_post_body))) {
+    goto error;
+  }
+
+  context = malloc(sizeof(report_async_context_t));
+  context->callback = callback;
+  context->user_data = user_data;
+
+  //Fixme: This should be dynamically allocated:
+  char url[256];
+  create_url(url, sizeof(url), "%s/device/%s/%s/report%s",
+             gaus_current_client()->serverUrl, session->product_guid, session->device_guid, query_parms);
+  if (request_post_async(url, session->token, report_post_body, BANDWIDTH_REPORT, report_async_complete,
+                         context) != 0) {
+    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Unable to queue report request");
+    free(context);
+  }
+
+  error:
+  free(report_post_body);
+  free(query_parms);
+  return status;
+}
+
+static gaus_error_t *
+check_report_parameters(const gaus_session_t *session, unsigned int filter_count, const gaus_header_filter_t *filters,
+                        const gaus_report_header_t *header, unsigned int report_count, const gaus_report_t *reports) {
+  if (!gaus_global_state.globalInitalized) {
+    return gaus_create_error(__func__, GAUS_NO_INIT_ERROR, 500, "Checked for updates without initializing");
+  }
+
   if (!session || !session->device_guid || !session->product_guid || !session->token
       || !header || report_count < 1 || !reports) {
-    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates with invalid parameters");
-    goto error;
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates with invalid parameters");
   }
 
   if (filter_count > 0 && !filters) {
-    status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates with invalid parameters");
-    goto error;
+    return gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Check for updates with invalid parameters");
   }
+  return NULL;
+}
+
+static char *create_query_parameters(unsigned int filter_count, const gaus_header_filter_t *filters) {
+  char *query_parms = NULL;
 
   if (filter_count > 0) {
     query_parms = strdup("?");
@@ -79,6 +173,17 @@ gaus_report(const gaus_session_t *session, unsigned int filter_count, const gaus
     free(filter_string);
     free(new_filter);
   }
+  return query_parms;
+}
+
+static gaus_error_t *
+create_report_body(const gaus_report_header_t *header, unsigned int report_count, const gaus_report_t *reports,
+                   char **report_post_body) {
+  json_t *json_header = NULL;
+  json_t *json_to_send = NULL;
+  json_t *json_reports_array = NULL;
+  json_t *json_temp_one_report = NULL;
+  gaus_error_t *status = NULL;
 
   if (NULL != (status = create_json_for_header(header, &json_header))) {
     goto error;
@@ -121,29 +226,23 @@ gaus_report(const gaus_session_t *session, unsigned int filter_count, const gaus
     status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Error encoding header");
   }
 
-  report_post_body = json_dumps(json_to_send, JSON_COMPACT);
+  *report_post_body = json_dumps(json_to_send, JSON_COMPACT);
+
+  error:
+  json_decref(json_to_send);
+  return status;
+}
+
+static gaus_error_t *process_report_result(const char *raw_report_result, long status_code) {
+  gaus_error_t *status = NULL;
 
-  //Fixme: This should be dynamically allocated:
-  char url[256];
-  create_url(url, sizeof(url), "%s/device/%s/%s/report%s",
-             gaus_global_state.serverUrl, session->product_guid, session->device_guid, query_parms);
-  long status_code = 200; //Initialize to a default passing value unless request says otherwise.
-  raw_report_result = request_post_as_string(url, session->token, report_post_body, &status_code);
   if (!raw_report_result && status_code < 400) {
     status = gaus_create_error(__func__, GAUS_UNKNOWN_ERROR, 500, "Posting authenticate failed");
-    goto error;
-  }
-  if (status_code >= 400) {
+  } else if (status_code >= 400) {
     status = gaus_create_error(__func__, GAUS_HTTP_ERROR, status_code,
                                "Posting authenticate failed with http error code %d",
                                status_code);
-    goto error;
   }
-  error:
-  free(report_post_body);
-  free(raw_report_result);
-  free(query_parms);
-  json_decref(json_to_send);
   return status;
 }
 
@@ -0,0 +1,118 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "hash_tree.h"
+#include "gaus_json_helpers.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int hash_tree_root(const unsigned char (*leaves)[MD5_DIGEST_LENGTH], size_t count,
+                   unsigned char root[MD5_DIGEST_LENGTH]) {
+  unsigned char (*level)[MD5_DIGEST_LENGTH];
+
+  //Each level is computed over the one below it, in place.
+  if (!(level = malloc(count * MD5_DIGEST_LENGTH))) {
+    return -1;
+  }
+  memcpy(level, leaves, count * MD5_DIGEST_LENGTH);
+  while (count > 1) {
+    size_t parents = (count + 1) / 2;
+
+    for (size_t i = 0; i < parents; i++) {
+      if (2 * i + 1 < count) {
+        md5_context_t md5;
+        md5_init(&md5);
+        md5_update(&md5, level[2 * i], 2 * MD5_DIGEST_LENGTH);
+        md5_final(&md5, level[i]);
+      } else {
+        memmove(level[i], level[2 * i], MD5_DIGEST_LENGTH);
+      }
+    }
+    count = parents;
+  }
+  memcpy(root, level[0], MD5_DIGEST_LENGTH);
+  free(level);
+  return 0;
+}
+
+int hash_tree_parse(hash_tree_t *tree, const char *document, off_t size, const char *root) {
+  json_t *json_tree = NULL;
+  json_t *json_chunks;
+  json_error_t json_error;
+  unsigned char expected[MD5_DIGEST_LENGTH];
+  unsigned char actual[MD5_DIGEST_LENGTH];
+  int result = -1;
+
+  memset(tree, 0, sizeof(hash_tree_t));
+  if (md5_from_hex(root, expected) != 0) {
+    logging(L_WARNING, "hash_tree_parse: root %s is not a digest", root ? root : "");
+    return -1;
+  }
+  if (!(json_tree = json_loads(document, 0, &json_error))) {
+    logging(L_WARNING, "Error parsing hash tree: %s", json_error.text);
+    return -1;
+  }
+  tree->chunk_size = get_dict_int(json_tree, CHUNK_SIZE_JSON, 0);
+  json_chunks = json_object_get(json_tree, CHUNKS_JSON);
+  if (tree->chunk_size <= 0 || size <= 0 || !json_is_array(json_chunks) ||
+      json_array_size(json_chunks) != (size_t) ((size + tree->chunk_size - 1) / tree->chunk_size)) {
+    logging(L_WARNING, "hash_tree_parse: tree does not cover the %lld bytes of the package", (long long) size);
+    goto out;
+  }
+  tree->count = json_array_size(json_chunks);
+  if (!(tree->chunks = malloc(tree->count * MD5_DIGEST_LENGTH))) {
+    goto out;
+  }
+  for (size_t i = 0; i < tree->count; i++) {
+    if (md5_from_hex(json_string_value(json_array_get(json_chunks, i)), tree->chunks[i]) != 0) {
+      logging(L_WARNING, "hash_tree_parse: chunk %zu is not a digest", i);
+      goto out;
+    }
+  }
+  if (hash_tree_root((const unsigned char (*)[MD5_DIGEST_LENGTH]) tree->chunks, tree->count, actual) != 0) {
+    goto out;
+  }
+  if (memcmp(actual, expected, MD5_DIGEST_LENGTH) != 0) {
+    logging(L_WARNING, "hash_tree_parse: chunks do not hash to root %s", root);
+    goto out;
+  }
+  result = 0;
+
+  out:
+  if (result != 0) {
+    hash_tree_free(tree);
+  }
+  json_decref(json_tree);
+  return result;
+}
+
+size_t hash_tree_chunk(const hash_tree_t *tree, off_t offset) {
+  return (size_t) (offset / tree->chunk_size);
+}
+
+off_t hash_tree_chunk_end(const hash_tree_t *tree, size_t chunk, off_t size) {
+  off_t end = (off_t) (chunk + 1) * tree->chunk_size;
+
+  return end < size ? end : size;
+}
+
+bool hash_tree_check(const hash_tree_t *tree, size_t chunk, const md5_context_t *md5) {
+  md5_context_t copy = *md5;
+  unsigned char digest[MD5_DIGEST_LENGTH];
+
+  md5_final(&copy, digest);
+  return chunk < tree->count && memcmp(digest, tree->chunks[chunk], MD5_DIGEST_LENGTH) == 0;
+}
+
+void hash_tree_free(hash_tree_t *tree) {
+  free(tree->chunks);
+  memset(tree, 0, sizeof(hash_tree_t));
+}
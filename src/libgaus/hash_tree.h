@@ -0,0 +1,53 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_HASH_TREE_H
+#define GAUS_HASH_TREE_H
+
+#include "md5.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The md5 of each fixed size chunk of a package, so every chunk can be checked on its own as soon as it arrived.  The
+ * chunks are the leaves of a binary hash tree, each node the md5 of its two children's digests and the last node of a
+ * level with no sibling taken up as is.  The leaves come from a separate document and are only trusted once they hash
+ * to the root that came with the update. */
+typedef struct {
+  off_t chunk_size;  //Size of every chunk but the last
+  size_t count;
+  unsigned char (*chunks)[MD5_DIGEST_LENGTH];
+} hash_tree_t;
+
+/* Compute the root of the tree over count leaves, which must be at least one.  Returns 0 unless out of memory. */
+int hash_tree_root(const unsigned char (*leaves)[MD5_DIGEST_LENGTH], size_t count,
+                   unsigned char root[MD5_DIGEST_LENGTH]);
+
+/* Read the leaves of a package of size bytes from the json document and check them against root, a hex digest.
+ * Returns 0 if the document is valid and matches, tree is then freed with hash_tree_free. */
+int hash_tree_parse(hash_tree_t *tree, const char *document, off_t size, const char *root);
+
+/* The chunk holding byte offset of the package and where it ends. */
+size_t hash_tree_chunk(const hash_tree_t *tree, off_t offset);
+
+off_t hash_tree_chunk_end(const hash_tree_t *tree, size_t chunk, off_t size);
+
+/* Whether md5, the digest of all of chunk so far, matches it.  md5 is left as is. */
+bool hash_tree_check(const hash_tree_t *tree, size_t chunk, const md5_context_t *md5);
+
+void hash_tree_free(hash_tree_t *tree);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_HASH_TREE_H
@@ -0,0 +1,403 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "json_stream.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Initial size of the token buffer, it doubles whenever a longer string arrives.
+#define JSON_STREAM_MIN_TOKEN 64
+
+enum {
+  STATE_VALUE,        //A value is required
+  STATE_ARRAY_FIRST,  //A value or the end of an empty array
+  STATE_OBJECT_FIRST, //A key or the end of an empty object
+  STATE_KEY,
+  STATE_COLON,
+  STATE_AFTER_VALUE,  //A separator or the end of the enclosing container
+  STATE_STRING,
+  STATE_ESCAPE,
+  STATE_UNICODE,
+  STATE_NUMBER,
+  STATE_LITERAL
+};
+
+static int fail(json_stream_t *stream, const char *error) {
+  if (!stream->error) {
+    stream->error = error;
+  }
+  return -1;
+}
+
+static int append(json_stream_t *stream, char c) {
+  //Always keep room for the terminating null.
+  if (stream->token_length + 2 > stream->token_capacity) {
+    size_t capacity = stream->token_capacity ? stream->token_capacity * 2 : JSON_STREAM_MIN_TOKEN;
+    char *token = realloc(stream->token, capacity);
+    if (!token) {
+      return fail(stream, "out of memory");
+    }
+    stream->token = token;
+    stream->token_capacity = capacity;
+  }
+  stream->token[stream->token_length++] = c;
+  return 0;
+}
+
+static int emit(json_stream_t *stream, json_stream_event_t event, const char *value, size_t length) {
+  if (stream->callback(event, value, length, stream->depth, stream->user_data) != 0) {
+    return fail(stream, "stopped by callback");
+  }
+  return 0;
+}
+
+static void value_done(json_stream_t *stream) {
+  if (stream->depth == 0) {
+    stream->done = true;
+  }
+  stream->state = STATE_AFTER_VALUE;
+}
+
+static int open_container(json_stream_t *stream, char container) {
+  if (stream->depth == JSON_STREAM_MAX_DEPTH) {
+    return fail(stream, "maximum nesting depth exceeded");
+  }
+  if (emit(stream, container == '{' ? JSON_STREAM_OBJECT_START : JSON_STREAM_ARRAY_START, NULL, 0) != 0) {
+    return -1;
+  }
+  stream->containers[stream->depth++] = container;
+  stream->state = container == '{' ? STATE_OBJECT_FIRST : STATE_ARRAY_FIRST;
+  return 0;
+}
+
+static int close_container(json_stream_t *stream) {
+  char container = stream->containers[--stream->depth];
+  if (emit(stream, container == '{' ? JSON_STREAM_OBJECT_END : JSON_STREAM_ARRAY_END, NULL, 0) != 0) {
+    return -1;
+  }
+  value_done(stream);
+  return 0;
+}
+
+static void start_token(json_stream_t *stream, int state) {
+  stream->token_length = 0;
+  stream->state = state;
+}
+
+static int end_string(json_stream_t *stream) {
+  if (stream->high_surrogate) {
+    return fail(stream, "unpaired surrogate in string");
+  }
+  if (append(stream, '\0') != 0) {
+    return -1;
+  }
+  stream->token_length--;
+  if (stream->in_key) {
+    stream->state = STATE_COLON;
+    return emit(stream, JSON_STREAM_KEY, stream->token, stream->token_length);
+  }
+  value_done(stream);
+  return emit(stream, JSON_STREAM_STRING, stream->token, stream->token_length);
+}
+
+static int append_code_point(json_stream_t *stream, unsigned int cp) {
+  int err = 0;
+  if (cp < 0x80) {
+    err |= append(stream, (char) cp);
+  } else if (cp < 0x800) {
+    err |= append(stream, (char) (0xC0 | (cp >> 6)));
+    err |= append(stream, (char) (0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    err |= append(stream, (char) (0xE0 | (cp >> 12)));
+    err |= append(stream, (char) (0x80 | ((cp >> 6) & 0x3F)));
+    err |= append(stream, (char) (0x80 | (cp & 0x3F)));
+  } else {
+    err |= append(stream, (char) (0xF0 | (cp >> 18)));
+    err |= append(stream, (char) (0x80 | ((cp >> 12) & 0x3F)));
+    err |= append(stream, (char) (0x80 | ((cp >> 6) & 0x3F)));
+    err |= append(stream, (char) (0x80 | (cp & 0x3F)));
+  }
+  return err ? -1 : 0;
+}
+
+static int end_unicode_escape(json_stream_t *stream) {
+  unsigned int cp = stream->unicode;
+
+  stream->state = STATE_STRING;
+  if (stream->high_surrogate) {
+    if (cp < 0xDC00 || cp > 0xDFFF) {
+      return fail(stream, "unpaired surrogate in string");
+    }
+    cp = 0x10000 + ((stream->high_surrogate - 0xD800) << 10) + (cp - 0xDC00);
+    stream->high_surrogate = 0;
+  } else if (cp >= 0xD800 && cp <= 0xDBFF) {
+    stream->high_surrogate = cp;
+    return 0;
+  } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+    return fail(stream, "unpaired surrogate in string");
+  }
+  //Values are handed on as null terminated strings.
+  if (cp == 0) {
+    return fail(stream, "\\u0000 is not supported");
+  }
+  return append_code_point(stream, cp);
+}
+
+//-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool is_valid_number(const char *number) {
+  const char *p = number;
+  if (*p == '-') {
+    p++;
+  }
+  if (*p == '0') {
+    p++;
+  } else if (*p >= '1' && *p <= '9') {
+    while (*p >= '0' && *p <= '9') p++;
+  } else {
+    return false;
+  }
+  if (*p == '.') {
+    p++;
+    if (!(*p >= '0' && *p <= '9')) {
+      return false;
+    }
+    while (*p >= '0' && *p <= '9') p++;
+  }
+  if (*p == 'e' || *p == 'E') {
+    p++;
+    if (*p == '+' || *p == '-') {
+      p++;
+    }
+    if (!(*p >= '0' && *p <= '9')) {
+      return false;
+    }
+    while (*p >= '0' && *p <= '9') p++;
+  }
+  return *p == '\0';
+}
+
+static int end_number_or_literal(json_stream_t *stream) {
+  if (append(stream, '\0') != 0) {
+    return -1;
+  }
+  stream->token_length--;
+  value_done(stream);
+
+  if (stream->literal_state == STATE_NUMBER) {
+    if (!is_valid_number(stream->token)) {
+      return fail(stream, "invalid number");
+    }
+    return emit(stream, JSON_STREAM_NUMBER, stream->token, stream->token_length);
+  }
+  if (strcmp(stream->token, "true") == 0) {
+    return emit(stream, JSON_STREAM_TRUE, NULL, 0);
+  }
+  if (strcmp(stream->token, "false") == 0) {
+    return emit(stream, JSON_STREAM_FALSE, NULL, 0);
+  }
+  if (strcmp(stream->token, "null") == 0) {
+    return emit(stream, JSON_STREAM_NULL, NULL, 0);
+  }
+  return fail(stream, "invalid literal");
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static int feed_char(json_stream_t *stream, char c) {
+  switch (stream->state) {
+    case STATE_STRING:
+      if (stream->high_surrogate && c != '\\') {
+        return fail(stream, "unpaired surrogate in string");
+      }
+      if (c == '"') {
+        return end_string(stream);
+      }
+      if (c == '\\') {
+        stream->state = STATE_ESCAPE;
+        return 0;
+      }
+      if ((unsigned char) c < 0x20) {
+        return fail(stream, "control character in string");
+      }
+      return append(stream, c);
+
+    case STATE_ESCAPE: {
+      char unescaped;
+      if (stream->high_surrogate && c != 'u') {
+        return fail(stream, "unpaired surrogate in string");
+      }
+      switch (c) {
+        case '"': unescaped = '"'; break;
+        case '\\': unescaped = '\\'; break;
+        case '/': unescaped = '/'; break;
+        case 'b': unescaped = '\b'; break;
+        case 'f': unescaped = '\f'; break;
+        case 'n': unescaped = '\n'; break;
+        case 'r': unescaped = '\r'; break;
+        case 't': unescaped = '\t'; break;
+        case 'u':
+          stream->unicode = 0;
+          stream->unicode_digits = 0;
+          stream->state = STATE_UNICODE;
+          return 0;
+        default:
+          return fail(stream, "invalid escape in string");
+      }
+      stream->state = STATE_STRING;
+      return append(stream, unescaped);
+    }
+
+    case STATE_UNICODE: {
+      int value = hex_value(c);
+      if (value < 0) {
+        return fail(stream, "invalid \\u escape in string");
+      }
+      stream->unicode = stream->unicode * 16 + (unsigned int) value;
+      if (++stream->unicode_digits == 4) {
+        return end_unicode_escape(stream);
+      }
+      return 0;
+    }
+
+    case STATE_NUMBER:
+      if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+        return append(stream, c);
+      }
+      if (end_number_or_literal(stream) != 0) {
+        return -1;
+      }
+      return feed_char(stream, c);
+
+    case STATE_LITERAL:
+      if (c >= 'a' && c <= 'z') {
+        return append(stream, c);
+      }
+      if (end_number_or_literal(stream) != 0) {
+        return -1;
+      }
+      return feed_char(stream, c);
+
+    default:
+      break;
+  }
+
+  if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+    return 0;
+  }
+
+  switch (stream->state) {
+    case STATE_ARRAY_FIRST:
+      if (c == ']') {
+        return close_container(stream);
+      }
+      //Fall through
+    case STATE_VALUE:
+      if (c == '{' || c == '[') {
+        return open_container(stream, c);
+      }
+      if (c == '"') {
+        stream->in_key = false;
+        start_token(stream, STATE_STRING);
+        return 0;
+      }
+      if (c == '-' || (c >= '0' && c <= '9')) {
+        start_token(stream, STATE_NUMBER);
+        stream->literal_state = STATE_NUMBER;
+        return append(stream, c);
+      }
+      if (c >= 'a' && c <= 'z') {
+        start_token(stream, STATE_LITERAL);
+        stream->literal_state = STATE_LITERAL;
+        return append(stream, c);
+      }
+      return fail(stream, "unexpected character, expected a value");
+
+    case STATE_OBJECT_FIRST:
+      if (c == '}') {
+        return close_container(stream);
+      }
+      //Fall through
+    case STATE_KEY:
+      if (c == '"') {
+        stream->in_key = true;
+        start_token(stream, STATE_STRING);
+        return 0;
+      }
+      return fail(stream, "unexpected character, expected a key");
+
+    case STATE_COLON:
+      if (c == ':') {
+        stream->state = STATE_VALUE;
+        return 0;
+      }
+      return fail(stream, "unexpected character, expected ':'");
+
+    case STATE_AFTER_VALUE:
+      if (stream->depth == 0) {
+        return fail(stream, "data after the end of the document");
+      }
+      if (c == ',') {
+        stream->state = stream->containers[stream->depth - 1] == '{' ? STATE_KEY : STATE_VALUE;
+        return 0;
+      }
+      if ((c == '}' && stream->containers[stream->depth - 1] == '{')
+          || (c == ']' && stream->containers[stream->depth - 1] == '[')) {
+        return close_container(stream);
+      }
+      return fail(stream, "unexpected character, expected ',' or the end of a container");
+
+    default:
+      return fail(stream, "invalid parser state");
+  }
+}
+
+void json_stream_init(json_stream_t *stream, json_stream_callback_t callback, void *user_data) {
+  memset(stream, 0, sizeof(json_stream_t));
+  stream->callback = callback;
+  stream->user_data = user_data;
+  stream->state = STATE_VALUE;
+}
+
+int json_stream_feed(json_stream_t *stream, const char *data, size_t length) {
+  if (stream->error) {
+    return -1;
+  }
+  for (size_t i = 0; i < length; i++) {
+    if (feed_char(stream, data[i]) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int json_stream_finish(json_stream_t *stream) {
+  //A number or literal at the very end of the document is only complete once we know nothing follows.
+  if (!stream->error && (stream->state == STATE_NUMBER || stream->state == STATE_LITERAL)) {
+    end_number_or_literal(stream);
+  }
+  if (stream->error) {
+    return -1;
+  }
+  if (!stream->done) {
+    return fail(stream, "unexpected end of document");
+  }
+  return 0;
+}
+
+void json_stream_free(json_stream_t *stream) {
+  free(stream->token);
+  stream->token = NULL;
+  stream->token_capacity = 0;
+  stream->token_length = 0;
+}
@@ -0,0 +1,74 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_JSON_STREAM_H
+#define GAUS_JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Documents nested deeper than this are rejected.
+#define JSON_STREAM_MAX_DEPTH 64
+
+typedef enum {
+  JSON_STREAM_OBJECT_START,
+  JSON_STREAM_OBJECT_END,
+  JSON_STREAM_ARRAY_START,
+  JSON_STREAM_ARRAY_END,
+  JSON_STREAM_KEY,
+  JSON_STREAM_STRING,
+  JSON_STREAM_NUMBER,
+  JSON_STREAM_TRUE,
+  JSON_STREAM_FALSE,
+  JSON_STREAM_NULL
+} json_stream_event_t;
+
+/* Called for every token.  value is the null terminated text of keys, strings and numbers and NULL otherwise, it is
+ * only valid for the duration of the call.  depth is the number of containers enclosing the token, a container start
+ * and its end are reported with the same depth.  Return non zero to stop parsing. */
+typedef int (*json_stream_callback_t)(json_stream_event_t event, const char *value, size_t length, unsigned int depth,
+                                      void *user_data);
+
+typedef struct {
+  json_stream_callback_t callback;
+  void *user_data;
+  int state;
+  int literal_state;             //State to continue in once the current literal or number is complete
+  unsigned int depth;
+  char containers[JSON_STREAM_MAX_DEPTH]; //'{' or '[' for every open container
+  bool in_key;
+  bool done;                     //The top level value is complete
+  char *token;                   //The string, number or literal being read, kept across feeds
+  size_t token_length;
+  size_t token_capacity;
+  unsigned int unicode;          //Code point of the \u escape being read
+  unsigned int unicode_digits;
+  unsigned int high_surrogate;   //First half of a surrogate pair waiting for its second half
+  const char *error;             //Set once parsing failed, no further events are reported
+} json_stream_t;
+
+void json_stream_init(json_stream_t *stream, json_stream_callback_t callback, void *user_data);
+
+/* Parse the next length bytes of the document.  Returns 0 on success, -1 once the document is invalid or the callback
+ * stopped parsing. */
+int json_stream_feed(json_stream_t *stream, const char *data, size_t length);
+
+/* Returns 0 if everything fed so far is one complete document, -1 otherwise. */
+int json_stream_finish(json_stream_t *stream);
+
+void json_stream_free(json_stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_JSON_STREAM_H
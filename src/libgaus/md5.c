@@ -0,0 +1,178 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "md5.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define G(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define STEP(f, a, b, c, d, x, t, s) \
+  (a) += f((b), (c), (d)) + (x) + (t); \
+  (a) = ROTATE_LEFT((a), (s)) + (b)
+
+static void md5_transform(uint32_t state[4], const unsigned char block[MD5_BLOCK_LENGTH]) {
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t x[16];
+
+  for (int i = 0; i < 16; i++) {
+    x[i] = (uint32_t) block[i * 4] | ((uint32_t) block[i * 4 + 1] << 8) | ((uint32_t) block[i * 4 + 2] << 16) |
+           ((uint32_t) block[i * 4 + 3] << 24);
+  }
+
+  STEP(F, a, b, c, d, x[0], 0xd76aa478, 7);
+  STEP(F, d, a, b, c, x[1], 0xe8c7b756, 12);
+  STEP(F, c, d, a, b, x[2], 0x242070db, 17);
+  STEP(F, b, c, d, a, x[3], 0xc1bdceee, 22);
+  STEP(F, a, b, c, d, x[4], 0xf57c0faf, 7);
+  STEP(F, d, a, b, c, x[5], 0x4787c62a, 12);
+  STEP(F, c, d, a, b, x[6], 0xa8304613, 17);
+  STEP(F, b, c, d, a, x[7], 0xfd469501, 22);
+  STEP(F, a, b, c, d, x[8], 0x698098d8, 7);
+  STEP(F, d, a, b, c, x[9], 0x8b44f7af, 12);
+  STEP(F, c, d, a, b, x[10], 0xffff5bb1, 17);
+  STEP(F, b, c, d, a, x[11], 0x895cd7be, 22);
+  STEP(F, a, b, c, d, x[12], 0x6b901122, 7);
+  STEP(F, d, a, b, c, x[13], 0xfd987193, 12);
+  STEP(F, c, d, a, b, x[14], 0xa679438e, 17);
+  STEP(F, b, c, d, a, x[15], 0x49b40821, 22);
+
+  STEP(G, a, b, c, d, x[1], 0xf61e2562, 5);
+  STEP(G, d, a, b, c, x[6], 0xc040b340, 9);
+  STEP(G, c, d, a, b, x[11], 0x265e5a51, 14);
+  STEP(G, b, c, d, a, x[0], 0xe9b6c7aa, 20);
+  STEP(G, a, b, c, d, x[5], 0xd62f105d, 5);
+  STEP(G, d, a, b, c, x[10], 0x02441453, 9);
+  STEP(G, c, d, a, b, x[15], 0xd8a1e681, 14);
+  STEP(G, b, c, d, a, x[4], 0xe7d3fbc8, 20);
+  STEP(G, a, b, c, d, x[9], 0x21e1cde6, 5);
+  STEP(G, d, a, b, c, x[14], 0xc33707d6, 9);
+  STEP(G, c, d, a, b, x[3], 0xf4d50d87, 14);
+  STEP(G, b, c, d, a, x[8], 0x455a14ed, 20);
+  STEP(G, a, b, c, d, x[13], 0xa9e3e905, 5);
+  STEP(G, d, a, b, c, x[2], 0xfcefa3f8, 9);
+  STEP(G, c, d, a, b, x[7], 0x676f02d9, 14);
+  STEP(G, b, c, d, a, x[12], 0x8d2a4c8a, 20);
+
+  STEP(H, a, b, c, d, x[5], 0xfffa3942, 4);
+  STEP(H, d, a, b, c, x[8], 0x8771f681, 11);
+  STEP(H, c, d, a, b, x[11], 0x6d9d6122, 16);
+  STEP(H, b, c, d, a, x[14], 0xfde5380c, 23);
+  STEP(H, a, b, c, d, x[1], 0xa4beea44, 4);
+  STEP(H, d, a, b, c, x[4], 0x4bdecfa9, 11);
+  STEP(H, c, d, a, b, x[7], 0xf6bb4b60, 16);
+  STEP(H, b, c, d, a, x[10], 0xbebfbc70, 23);
+  STEP(H, a, b, c, d, x[13], 0x289b7ec6, 4);
+  STEP(H, d, a, b, c, x[0], 0xeaa127fa, 11);
+  STEP(H, c, d, a, b, x[3], 0xd4ef3085, 16);
+  STEP(H, b, c, d, a, x[6], 0x04881d05, 23);
+  STEP(H, a, b, c, d, x[9], 0xd9d4d039, 4);
+  STEP(H, d, a, b, c, x[12], 0xe6db99e5, 11);
+  STEP(H, c, d, a, b, x[15], 0x1fa27cf8, 16);
+  STEP(H, b, c, d, a, x[2], 0xc4ac5665, 23);
+
+  STEP(I, a, b, c, d, x[0], 0xf4292244, 6);
+  STEP(I, d, a, b, c, x[7], 0x432aff97, 10);
+  STEP(I, c, d, a, b, x[14], 0xab9423a7, 15);
+  STEP(I, b, c, d, a, x[5], 0xfc93a039, 21);
+  STEP(I, a, b, c, d, x[12], 0x655b59c3, 6);
+  STEP(I, d, a, b, c, x[3], 0x8f0ccc92, 10);
+  STEP(I, c, d, a, b, x[10], 0xffeff47d, 15);
+  STEP(I, b, c, d, a, x[1], 0x85845dd1, 21);
+  STEP(I, a, b, c, d, x[8], 0x6fa87e4f, 6);
+  STEP(I, d, a, b, c, x[15], 0xfe2ce6e0, 10);
+  STEP(I, c, d, a, b, x[6], 0xa3014314, 15);
+  STEP(I, b, c, d, a, x[13], 0x4e0811a1, 21);
+  STEP(I, a, b, c, d, x[4], 0xf7537e82, 6);
+  STEP(I, d, a, b, c, x[11], 0xbd3af235, 10);
+  STEP(I, c, d, a, b, x[2], 0x2ad7d2bb, 15);
+  STEP(I, b, c, d, a, x[9], 0xeb86d391, 21);
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+}
+
+void md5_init(md5_context_t *context) {
+  context->state[0] = 0x67452301;
+  context->state[1] = 0xefcdab89;
+  context->state[2] = 0x98badcfe;
+  context->state[3] = 0x10325476;
+  context->count = 0;
+}
+
+void md5_update(md5_context_t *context, const void *data, size_t length) {
+  const unsigned char *input = data;
+  size_t buffered = context->count % MD5_BLOCK_LENGTH;
+
+  context->count += length;
+  if (buffered > 0) {
+    size_t missing = MD5_BLOCK_LENGTH - buffered;
+    if (length < missing) {
+      memcpy(context->buffer + buffered, input, length);
+      return;
+    }
+    memcpy(context->buffer + buffered, input, missing);
+    md5_transform(context->state, context->buffer);
+    input += missing;
+    length -= missing;
+  }
+  //Hash whole blocks straight from the input, only a trailing partial block is copied.
+  for (; length >= MD5_BLOCK_LENGTH; input += MD5_BLOCK_LENGTH, length -= MD5_BLOCK_LENGTH) {
+    md5_transform(context->state, input);
+  }
+  memcpy(context->buffer, input, length);
+}
+
+void md5_final(md5_context_t *context, unsigned char digest[MD5_DIGEST_LENGTH]) {
+  static const unsigned char padding[MD5_BLOCK_LENGTH] = {0x80};
+  uint64_t bits = context->count * 8;
+  unsigned char length[8];
+  size_t buffered = context->count % MD5_BLOCK_LENGTH;
+
+  for (int i = 0; i < 8; i++) {
+    length[i] = (unsigned char) (bits >> (8 * i));
+  }
+  md5_update(context, padding, buffered < 56 ? 56 - buffered : 120 - buffered);
+  md5_update(context, length, sizeof(length));
+  for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+    digest[i] = (unsigned char) (context->state[i / 4] >> (8 * (i % 4)));
+  }
+}
+
+void md5_to_hex(const unsigned char digest[MD5_DIGEST_LENGTH], char hex[MD5_HEX_LENGTH + 1]) {
+  for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+    snprintf(hex + i * 2, 3, "%02x", digest[i]);
+  }
+}
+
+int md5_from_hex(const char *hex, unsigned char digest[MD5_DIGEST_LENGTH]) {
+  if (!hex || strlen(hex) != MD5_HEX_LENGTH || strspn(hex, "0123456789abcdefABCDEF") != MD5_HEX_LENGTH) {
+    return -1;
+  }
+  for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+    char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+    digest[i] = (unsigned char) strtoul(byte, NULL, 16);
+  }
+  return 0;
+}
+
+int md5_compare_hex(const unsigned char digest[MD5_DIGEST_LENGTH], const char *hex) {
+  char digest_hex[MD5_HEX_LENGTH + 1];
+
+  md5_to_hex(digest, digest_hex);
+  return hex && strcasecmp(digest_hex, hex) == 0 ? 0 : -1;
+}
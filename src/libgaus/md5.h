@@ -0,0 +1,51 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_MD5_H
+#define GAUS_MD5_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MD5_DIGEST_LENGTH 16
+#define MD5_BLOCK_LENGTH 64
+
+/* Incremental MD5 (RFC 1321), used to verify downloads while they are written.  The fields are exposed so the state
+ * of an interrupted download can be saved and restored. */
+typedef struct {
+  uint32_t state[4];
+  uint64_t count;  //Bytes hashed so far, the last count % MD5_BLOCK_LENGTH of them wait in buffer
+  unsigned char buffer[MD5_BLOCK_LENGTH];
+} md5_context_t;
+
+void md5_init(md5_context_t *context);
+
+void md5_update(md5_context_t *context, const void *data, size_t length);
+
+void md5_final(md5_context_t *context, unsigned char digest[MD5_DIGEST_LENGTH]);
+
+#define MD5_HEX_LENGTH (MD5_DIGEST_LENGTH * 2)
+
+/* Write digest as lowercase hex followed by a null byte to hex. */
+void md5_to_hex(const unsigned char digest[MD5_DIGEST_LENGTH], char hex[MD5_HEX_LENGTH + 1]);
+
+/* Read a hex string in either case into digest, returns 0 if it was a valid digest. */
+int md5_from_hex(const char *hex, unsigned char digest[MD5_DIGEST_LENGTH]);
+
+/* Compare digest to a hex string in either case, returns 0 when they match. */
+int md5_compare_hex(const unsigned char digest[MD5_DIGEST_LENGTH], const char *hex);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_MD5_H
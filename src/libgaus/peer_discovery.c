@@ -0,0 +1,247 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#define _GNU_SOURCE //pipe2
+#include "peer_discovery.h"
+#include "artifact_cache.h"
+#include "log.h"
+#include "md5.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PEER_DEFAULT_GROUP "239.255.71.71"
+#define PEER_DEFAULT_PORT 47071
+#define PEER_PROTOCOL "GAUS-PEER/1"
+#define PEER_MESSAGE_SIZE 128
+//How long to wait for an answer, the query is sent again halfway in case it got lost.
+#define PEER_ANSWER_TIMEOUT_MS 400
+
+struct peer_responder {
+  char *cache_path;
+  unsigned short http_port;
+  int fd;
+  int wakeup_pipe[2];
+  pthread_t thread;
+};
+
+static int group_address(const gaus_peer_options_t *options, struct sockaddr_in *group, struct in_addr *interface) {
+  memset(group, 0, sizeof(*group));
+  group->sin_family = AF_INET;
+  group->sin_port = htons(options->port ? options->port : PEER_DEFAULT_PORT);
+  if (inet_pton(AF_INET, options->group ? options->group : PEER_DEFAULT_GROUP, &group->sin_addr) != 1 ||
+      !IN_MULTICAST(ntohl(group->sin_addr.s_addr))) {
+    logging(L_ERROR, "Invalid peer group %s", options->group);
+    return -1;
+  }
+  interface->s_addr = htonl(INADDR_ANY);
+  if (options->address && inet_pton(AF_INET, options->address, interface) != 1) {
+    logging(L_ERROR, "Invalid peer address %s", options->address);
+    return -1;
+  }
+  return 0;
+}
+
+static long long milliseconds(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Wait until the deadline for a peer to answer that it has the package, NULL if none does. */
+static char *wait_for_answer(int fd, const char *md5, unsigned long long size, long long deadline) {
+  char message[PEER_MESSAGE_SIZE];
+  char answer_md5[MD5_HEX_LENGTH + 1];
+  char host[INET_ADDRSTRLEN];
+  unsigned long long answer_size;
+  unsigned short port;
+  long long remaining;
+
+  while ((remaining = deadline - milliseconds()) > 0) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    struct sockaddr_in from;
+    socklen_t from_length = sizeof(from);
+    ssize_t received;
+    char *url;
+
+    if (poll(&pfd, 1, (int) remaining) <= 0) {
+      continue;
+    }
+    if ((received = recvfrom(fd, message, sizeof(message) - 1, MSG_DONTWAIT, (struct sockaddr *) &from,
+                             &from_length)) <= 0) {
+      continue;
+    }
+    message[received] = '\0';
+    if (sscanf(message, PEER_PROTOCOL " HAVE %32s %llu %hu", answer_md5, &answer_size, &port) != 3 ||
+        strcasecmp(answer_md5, md5) != 0 || answer_size != size || port == 0 ||
+        !inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host))) {
+      continue;
+    }
+    if (!(url = malloc(strlen(host) + strlen(md5) + 16))) {
+      return NULL;
+    }
+    sprintf(url, "http://%s:%u/%s", host, port, md5);
+    return url;
+  }
+  return NULL;
+}
+
+char *peer_discovery_find(const gaus_peer_options_t *options, const char *md5, unsigned long long size) {
+  struct sockaddr_in group;
+  struct in_addr interface;
+  char query[PEER_MESSAGE_SIZE];
+  unsigned char ttl = 1;
+  unsigned char loop = 1;
+  char *url = NULL;
+  int length = snprintf(query, sizeof(query), PEER_PROTOCOL " WANT %s %llu", md5, size);
+  int fd;
+
+  if (length >= (int) sizeof(query) || group_address(options, &group, &interface) != 0) {
+    return NULL;
+  }
+  //Peers are on the same link, and several of them may run on this host.
+  if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0 ||
+      setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) != 0 ||
+      setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0 ||
+      setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) != 0) {
+    logging(L_WARNING, "Unable to ask peers for %s: %s", md5, strerror(errno));
+    goto out;
+  }
+  for (int round = 0; round < 2 && !url; round++) {
+    if (sendto(fd, query, (size_t) length, 0, (struct sockaddr *) &group, sizeof(group)) != length) {
+      logging(L_WARNING, "Unable to ask peers for %s: %s", md5, strerror(errno));
+      goto out;
+    }
+    url = wait_for_answer(fd, md5, size, milliseconds() + PEER_ANSWER_TIMEOUT_MS / 2);
+  }
+
+  out:
+  if (fd >= 0) {
+    close(fd);
+  }
+  return url;
+}
+
+static void answer(peer_responder_t *responder) {
+  char message[PEER_MESSAGE_SIZE];
+  char md5[MD5_HEX_LENGTH + 1];
+  unsigned long long size;
+  struct sockaddr_in from;
+  socklen_t from_length = sizeof(from);
+  ssize_t received = recvfrom(responder->fd, message, sizeof(message) - 1, MSG_DONTWAIT, (struct sockaddr *) &from,
+                              &from_length);
+  int length;
+
+  if (received <= 0) {
+    return;
+  }
+  message[received] = '\0';
+  //Only packages that matched their md5 are added to the cache, so a peer is never pointed to a partial one.
+  if (sscanf(message, PEER_PROTOCOL " WANT %32s %llu", md5, &size) != 2 ||
+      !artifact_cache_contains(responder->cache_path, md5, (off_t) size)) {
+    return;
+  }
+  length = snprintf(message, sizeof(message), PEER_PROTOCOL " HAVE %s %llu %u", md5, size, responder->http_port);
+  if (sendto(responder->fd, message, (size_t) length, 0, (struct sockaddr *) &from, from_length) != length) {
+    logging(L_WARNING, "peer_responder: unable to answer for %s: %s", md5, strerror(errno));
+  }
+}
+
+static void *respond(void *arg) {
+  peer_responder_t *responder = arg;
+  struct pollfd fds[2] = {{responder->fd, POLLIN, 0}, {responder->wakeup_pipe[0], POLLIN, 0}};
+
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      logging(L_ERROR, "peer_responder: poll failed: %s", strerror(errno));
+      break;
+    }
+    if (fds[1].revents) {
+      break;
+    }
+    if (fds[0].revents) {
+      answer(responder);
+    }
+  }
+  return NULL;
+}
+
+static void free_responder(peer_responder_t *responder) {
+  if (responder->fd >= 0) {
+    close(responder->fd);
+  }
+  if (responder->wakeup_pipe[0] >= 0) {
+    close(responder->wakeup_pipe[0]);
+    close(responder->wakeup_pipe[1]);
+  }
+  free(responder->cache_path);
+  free(responder);
+}
+
+peer_responder_t *peer_responder_start(const gaus_peer_options_t *options, unsigned short http_port) {
+  struct sockaddr_in group;
+  struct ip_mreq membership;
+  peer_responder_t *responder;
+  int reuse = 1;
+
+  if (group_address(options, &group, &membership.imr_interface) != 0 ||
+      !(responder = calloc(1, sizeof(*responder)))) {
+    return NULL;
+  }
+  membership.imr_multiaddr = group.sin_addr;
+  responder->http_port = http_port;
+  responder->fd = -1;
+  responder->wakeup_pipe[0] = -1;
+  //Bound to the group, so only queries reach the socket, and shared with the other peers running on this host.
+  if (!(responder->cache_path = strdup(options->cache_path)) ||
+      (responder->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0 ||
+      setsockopt(responder->fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+      bind(responder->fd, (struct sockaddr *) &group, sizeof(group)) != 0 ||
+      setsockopt(responder->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+    logging(L_ERROR, "peer_responder: unable to join peer group: %s", strerror(errno));
+    free_responder(responder);
+    return NULL;
+  }
+  if (pipe2(responder->wakeup_pipe, O_CLOEXEC) != 0) {
+    responder->wakeup_pipe[0] = -1;
+    free_responder(responder);
+    return NULL;
+  }
+  if (pthread_create(&responder->thread, NULL, respond, responder) != 0) {
+    free_responder(responder);
+    return NULL;
+  }
+  return responder;
+}
+
+void peer_responder_stop(peer_responder_t *responder) {
+  if (!responder) {
+    return;
+  }
+  if (write(responder->wakeup_pipe[1], "", 1) != 1) {
+    logging(L_WARNING, "peer_responder: unable to wake up the responder thread");
+  }
+  pthread_join(responder->thread, NULL);
+  free_responder(responder);
+}
@@ -0,0 +1,37 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_PEER_DISCOVERY_H
+#define GAUS_PEER_DISCOVERY_H
+
+#include "gaus/gaus_client_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Devices find the peers keeping a package by asking the whole site on a multicast group, with "GAUS-PEER/1 WANT
+ * <md5> <size>".  Peers keeping it answer the asking device alone with "GAUS-PEER/1 HAVE <md5> <size> <port>", the
+ * port of the cache server they serve it from. */
+
+typedef struct peer_responder peer_responder_t;
+
+/* Ask the peers for the package, and return the URL of the first one answering as a string to free, or NULL. */
+char *peer_discovery_find(const gaus_peer_options_t *options, const char *md5, unsigned long long size);
+
+/* Answer the peers asking for packages kept in options->cache_path on a thread of its own, pointing them to the cache
+ * server on http_port.  Returns NULL if the group cannot be joined. */
+peer_responder_t *peer_responder_start(const gaus_peer_options_t *options, unsigned short http_port);
+
+void peer_responder_stop(peer_responder_t *responder);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_PEER_DISCOVERY_H
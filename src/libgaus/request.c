@@ -14,10 +14,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
+#include "compression.h"
+#include "connection_pool.h"
 #include "curl_wrapper.h"
 #include "gaus.h"
 #include "gaus/gaus_client.h"
+#include "request.h"
+#include "request_async.h"
+#include "share_cache.h"
 
 
 typedef struct FileResponse {
@@ -25,23 +31,20 @@ typedef struct FileResponse {
   FILE *file;
 } FileResponse;
 
-typedef struct InMemoryResponse {
-  char *data;
-  size_t pos;
-} InMemoryResponse;
+static int request_get(const char *url, const char *auth_token, bandwidth_class_t traffic_class,
+                       curl_write_callback response_writer, void *response,
+                       const request_validators_t *conditions, request_validators_t *received, long *status_code);
 
-static int request_get(const char *url, const char *auth_token,
-                       curl_write_callback response_writer, void *response, long *status_code);
-
-static int request_post(const char *url, const char *auth_token, const char *payload,
+static int request_post(const char *url, const char *auth_token, const char *payload, bandwidth_class_t traffic_class,
                         curl_write_callback response_writer, void *response, long *status_code);
 
-static size_t in_memory_response_writer(char *content, size_t size,
-                                        size_t nmemb, void *userp);
-
 static size_t file_response_writer(char *content, size_t size, size_t nmemb,
                                    void *userp);
 
+static size_t in_memory_header_reader(char *header, size_t size, size_t nitems, void *userp);
+
+static size_t validator_header_reader(char *header, size_t size, size_t nitems, void *userp);
+
 static inline void write_char_safe(char *base, size_t *offset, size_t len, char ch) {
   if (base != NULL && *offset + 1 < len) {
     base[*offset] = ch;
@@ -128,105 +131,208 @@ int request_get_as_file(const char *url, const char *token, int fd, long *status
   }
   FileResponse response = {.file = file, .fd = fd};
 
-  int result = request_get(url, token, file_response_writer, &response, status_code);
+  int result = request_get(url, token, BANDWIDTH_BULK, file_response_writer, &response, NULL, NULL, status_code);
   fclose(file);
   return result;
 }
 
-/* Returns the downloaded data as a string */
-char *request_get_as_string(const char *url, const char *auth_token, long *status_code) {
-  struct InMemoryResponse response = {};
-  int err = request_get(url, auth_token, in_memory_response_writer, &response, status_code);
+int request_get_streamed(const char *url, const char *auth_token, curl_write_callback response_writer, void *response,
+                         const request_validators_t *conditions, request_validators_t *received, long *status_code) {
+  return request_get(url, auth_token, BANDWIDTH_CONTROL, response_writer, response, conditions, received,
+                     status_code);
+}
+
+/* Hands the response to the caller on success, the caller frees it with response_buffer_free. */
+static char *finish_string_response(int err, InMemoryResponse *response) {
   if (err) {
-    if (response.pos > 0) {
-      logging(L_ERROR, "%s", response.data);
-    }
-    if (response.data) {
-      free(response.data);
+    if (response->pos > 0) {
+      logging(L_ERROR, "%s", response->data);
     }
+    response_buffer_release(response);
     return NULL;
   }
-  return response.data;
+  if (response->pos > 0 && response->pos < 1000) {
+    logging(L_DEBUG | L_RAW,
+            "----[ data follows ]----\n%s\n"
+            "------------------------",
+            response->data);
+  }
+  return response_buffer_detach(response);
 }
 
-char *request_post_as_string(const char *url, const char *auth_token, const char *payload, long *status_code) {
-  struct InMemoryResponse response = {};
-  int err = request_post(url, auth_token, payload, in_memory_response_writer, &response, status_code);
-  if (err) {
-    if (response.pos > 0) {
-      logging(L_ERROR, "%s", response.data);
-    }
-    if (response.data) {
-      free(response.data);
+/* Returns the downloaded data as a string */
+char *request_get_as_string(const char *url, const char *auth_token, long *status_code) {
+  InMemoryResponse response = {};
+  int err = request_get(url, auth_token, BANDWIDTH_CONTROL, in_memory_response_writer, &response, NULL, NULL,
+                        status_code);
+  return finish_string_response(err, &response);
+}
+
+char *request_post_as_string(const char *url, const char *auth_token, const char *payload,
+                             bandwidth_class_t traffic_class, long *status_code) {
+  InMemoryResponse response = {};
+  int err = request_post(url, auth_token, payload, traffic_class, in_memory_response_writer, &response, status_code);
+  return finish_string_response(err, &response);
+}
+
+static void setup_common_options(CURL *curl, const char *url, const struct curl_slist *headers,
+                                 curl_write_callback response_writer, void *response) {
+  gaus_client_t *client = gaus_current_client();
+  gaus_client_count_request(client);
+  if (client->proxy) {
+    gaus_curl_easy_setopt(curl, CURLOPT_PROXY, client->proxy);
+  }
+
+  if (client->ca_path) {
+    gaus_curl_easy_setopt(curl, CURLOPT_CAPATH, client->ca_path);
+  }
+
+#ifdef GAUS_NO_CA_CHECK
+  logging(L_DEBUG, "skipping verify peer certificate");
+  gaus_curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+#endif
+
+  share_cache_attach(curl);
+  if (client->http2) {
+    //Negotiate HTTP/2 through ALPN and wait for an existing connection to multiplex on rather than opening a new one.
+    gaus_curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+    gaus_curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+  }
+  gaus_curl_easy_setopt(curl, CURLOPT_URL, url);
+  gaus_curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  //Advertise every encoding curl can decode, responses are decompressed before they reach response_writer.
+  gaus_curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+  gaus_curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  gaus_curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_writer);
+  gaus_curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+  if (response_writer == in_memory_response_writer) {
+    gaus_curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, in_memory_header_reader);
+    gaus_curl_easy_setopt(curl, CURLOPT_HEADERDATA, response);
+  }
+}
+
+int request_setup_post(CURL *curl, const char *url, const char *auth_token, const char *payload, char **body,
+                       curl_write_callback response_writer, void *response, request_headers_t **headers) {
+  gaus_client_t *client = gaus_current_client();
+  size_t body_length = strlen(payload);
+
+  *body = NULL;
+  if (!(*headers = request_headers_acquire(auth_token, client->compression))) {
+    return -1;
+  }
+
+  if (client->compression != GAUS_COMPRESSION_NONE) {
+    size_t payload_length = body_length;
+    if (compression_encode(client->compression, client->compression_level, payload,
+                           payload_length, body, &body_length) != 0) {
+      return -1;
     }
-    return NULL;
+    logging(L_DEBUG, "compressed %zu byte request body to %zu bytes", payload_length, body_length);
   }
-  return response.data;
+
+  setup_common_options(curl, url, (*headers)->post, response_writer, response);
+  gaus_curl_easy_setopt(curl, CURLOPT_POSTFIELDS, *body ? *body : payload);
+  gaus_curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long) body_length);
+  return 0;
 }
 
-static int request_post(const char *url, const char *auth_token, const char *payload,
-                        curl_write_callback response_writer, void *response, long *status_code) {
-  CURL *curl = NULL;
-  CURLcode status;
-  struct curl_slist *headers = NULL;
-  long code;
-  char *auth_header = NULL;
-  char *user_agent_header = NULL;
+int request_setup_get(CURL *curl, const char *url, const char *auth_token,
+                      curl_write_callback response_writer, void *response, request_headers_t **headers) {
+  if (!(*headers = request_headers_acquire(auth_token, gaus_current_client()->compression))) {
+    return -1;
+  }
 
-  curl = gaus_curl_easy_init();
-  if (!curl) {
-    goto error;
+  setup_common_options(curl, url, (*headers)->get, response_writer, response);
+  gaus_curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+  return 0;
+}
+
+static struct curl_slist *append_formatted_header(struct curl_slist *list, const char *name, const char *value) {
+  struct curl_slist *appended = NULL;
+  size_t required_length = snprintf(NULL, 0, "%s: %s", name, value) + 1;
+  char *header = malloc(required_length);
+  if (header) {
+    snprintf(header, required_length, "%s: %s", name, value);
+    appended = curl_slist_append(list, header);
+    free(header);
   }
+  if (!appended) {
+    curl_slist_free_all(list);
+  }
+  return appended;
+}
 
-  if (auth_token) {
-    size_t required_auth_header_len = snprintf(NULL, 0, "Authorization: Bearer %s", auth_token) + 1;
-    auth_header = malloc(required_auth_header_len);
-    size_t auth_header_len = snprintf(auth_header, required_auth_header_len,
-                                      "Authorization: Bearer %s", auth_token);
-    if (auth_header_len >= required_auth_header_len) {
-      logging(L_ERROR, "request_get error: Authorization header to large");
-      goto error;
+int request_setup_validators(CURL *curl, const request_headers_t *headers, const request_validators_t *conditions,
+                             request_validators_t *received, struct curl_slist **extra_headers) {
+  *extra_headers = NULL;
+
+  if (conditions && (conditions->etag || conditions->last_modified)) {
+    //The cached header lists are shared, so a conditional request gets its own copy.
+    struct curl_slist *list = NULL;
+    for (const struct curl_slist *item = headers->get; item; item = item->next) {
+      struct curl_slist *appended = curl_slist_append(list, item->data);
+      if (!appended) {
+        curl_slist_free_all(list);
+        return -1;
+      }
+      list = appended;
     }
-    headers = curl_slist_append(headers, auth_header);
-  }
-
-  gaus_version_t version = gaus_client_library_version();
-  size_t required_user_agent_len =
-      snprintf(NULL, 0, "User-Agent: gaus-device-client-c/v%d.%d.%d", version.major, version.minor, version.patch) + 1;
-  user_agent_header = malloc(required_user_agent_len);
-  size_t user_agent_len = snprintf(user_agent_header, required_user_agent_len,
-                                   "User-Agent: gaus-device-client-c/v%d.%d.%d", version.major, version.minor,
-                                   version.patch);
-  if (user_agent_len >= required_user_agent_len) {
-    logging(L_ERROR, "request_get error: User-Agent header too large");
-    goto error;
+    if (conditions->etag && !(list = append_formatted_header(list, "If-None-Match", conditions->etag))) {
+      return -1;
+    }
+    if (conditions->last_modified &&
+        !(list = append_formatted_header(list, "If-Modified-Since", conditions->last_modified))) {
+      return -1;
+    }
+    *extra_headers = list;
+    gaus_curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
   }
-  headers = curl_slist_append(headers, user_agent_header);
-  headers = curl_slist_append(headers, "Content-Type: application/json");
 
-  if (gaus_global_state.proxy) {
-    gaus_curl_easy_setopt(curl, CURLOPT_PROXY, gaus_global_state.proxy);
+  if (received) {
+    gaus_curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, validator_header_reader);
+    gaus_curl_easy_setopt(curl, CURLOPT_HEADERDATA, received);
   }
+  return 0;
+}
+
+void request_validators_free(request_validators_t *validators) {
+  free(validators->etag);
+  free(validators->last_modified);
+  validators->etag = NULL;
+  validators->last_modified = NULL;
+}
 
-  if (gaus_global_state.ca_path) {
-    gaus_curl_easy_setopt(curl, CURLOPT_CAPATH, gaus_global_state.ca_path);
+/* Concurrent requests can only share an HTTP/2 connection when they run on the same multi handle, so in HTTP/2 mode
+ * blocking requests are run by the async engine too. */
+static CURLcode perform_request(CURL *curl) {
+  if (gaus_current_client()->http2) {
+    return request_async_perform(curl);
   }
+  return gaus_curl_easy_perform(curl);
+}
 
-  gaus_curl_easy_setopt(curl, CURLOPT_URL, url);
-  gaus_curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
-  gaus_curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, strlen(payload));
-  gaus_curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+static int request_post(const char *url, const char *auth_token, const char *payload, bandwidth_class_t traffic_class,
+                        curl_write_callback response_writer, void *response, long *status_code) {
+  CURL *curl = NULL;
+  CURLcode status;
+  request_headers_t *headers = NULL;
+  bandwidth_transfer_t *bandwidth = NULL;
+  char *body = NULL;
+  long code;
 
-#ifdef GAUS_NO_CA_CHECK
-  logging(L_DEBUG, "skipping verify peer certificate");
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-#endif
+  curl = connection_pool_acquire(gaus_current_client()->pool, url);
+  if (!curl) {
+    goto error;
+  }
 
-  gaus_curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_writer);
-  gaus_curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+  if (request_setup_post(curl, url, auth_token, payload, &body, response_writer, response, &headers)) {
+    goto error;
+  }
+  bandwidth = bandwidth_attach(curl, traffic_class);
 
   logging(L_DEBUG, "POST %s", url);
-  status = gaus_curl_easy_perform(curl);
+  status = perform_request(curl);
+  bandwidth_detach(bandwidth);
   if (status != 0) {
     logging(L_ERROR,
             "request_post error: unable to request data from %s:", url);
@@ -243,140 +349,201 @@ static int request_post(const char *url, const char *auth_token, const char *pay
     goto error;
   }
 
-  free(auth_header);
-  free(user_agent_header);
-  gaus_curl_easy_cleanup(curl);
-  curl_slist_free_all(headers);
+  connection_pool_release(gaus_current_client()->pool, curl);
+  request_headers_release(headers);
+  free(body);
 
   return 0;
 
   error:
-  free(auth_header);
-  free(user_agent_header);
-  if (curl) {
-    gaus_curl_easy_cleanup(curl);
-  }
-  if (headers) {
-    curl_slist_free_all(headers);
-  }
+  connection_pool_release(gaus_current_client()->pool, curl);
+  request_headers_release(headers);
+  free(body);
   return 1;
 }
 
-static int request_get(const char *url, const char *auth_token,
-                       curl_write_callback response_writer, void *response, long *status_code) {
+static int request_get(const char *url, const char *auth_token, bandwidth_class_t traffic_class,
+                       curl_write_callback response_writer, void *response,
+                       const request_validators_t *conditions, request_validators_t *received, long *status_code) {
   CURL *curl = NULL;
   CURLcode status;
-  struct curl_slist *headers = NULL;
-  char *auth_header = NULL;
-  char *user_agent_header = NULL;
+  request_headers_t *headers = NULL;
+  bandwidth_transfer_t *bandwidth = NULL;
+  struct curl_slist *extra_headers = NULL;
 
-  curl = gaus_curl_easy_init();
+  curl = connection_pool_acquire(gaus_current_client()->pool, url);
   if (!curl) {
     goto error;
   }
 
-#ifdef GAUS_NO_CA_CHECK
-  logging(L_DEBUG, "skipping verify peer certificate");
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-#endif
-
-  gaus_curl_easy_setopt(curl, CURLOPT_URL, url);
-  gaus_curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
-
-  if (auth_token) {
-    size_t required_auth_header_len = snprintf(NULL, 0, "Authorization: Bearer %s", auth_token) + 1;
-    auth_header = malloc(required_auth_header_len);
-    size_t auth_header_len = snprintf(auth_header, required_auth_header_len,
-                                      "Authorization: Bearer %s", auth_token);
-    if (auth_header_len >= required_auth_header_len) {
-      logging(L_ERROR, "request_get error: Authorization header to large");
-      goto error;
-    }
-    headers = curl_slist_append(headers, auth_header);
-  }
-
-  gaus_version_t version = gaus_client_library_version();
-  size_t required_user_agent_len =
-      snprintf(NULL, 0, "User-Agent: gaus-device-client-c/v%d.%d.%d", version.major, version.minor, version.patch) + 1;
-  user_agent_header = malloc(required_user_agent_len);
-  size_t user_agent_len = snprintf(user_agent_header, required_user_agent_len,
-                                   "User-Agent: gaus-device-client-c/v%d.%d.%d", version.major, version.minor,
-                                   version.patch);
-  if (user_agent_len >= required_user_agent_len) {
-    logging(L_ERROR, "request_get error: User-Agent header too large");
+  if (request_setup_get(curl, url, auth_token, response_writer, response, &headers)) {
     goto error;
   }
-  headers = curl_slist_append(headers, user_agent_header);
-  gaus_curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-  if (gaus_global_state.proxy) {
-    gaus_curl_easy_setopt(curl, CURLOPT_PROXY, gaus_global_state.proxy);
-  }
-
-  if (gaus_global_state.ca_path) {
-    gaus_curl_easy_setopt(curl, CURLOPT_CAPATH, gaus_global_state.ca_path);
+  if (request_setup_validators(curl, headers, conditions, received, &extra_headers)) {
+    goto error;
   }
 
-  gaus_curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_writer);
-  gaus_curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+  bandwidth = bandwidth_attach(curl, traffic_class);
 
   logging(L_DEBUG, "GET %s", url);
-  status = gaus_curl_easy_perform(curl);
+  status = perform_request(curl);
+  bandwidth_detach(bandwidth);
   if (status != 0) {
     logging(L_ERROR, "request_get error: %s", curl_easy_strerror(status));
+    if (status == CURLE_WRITE_ERROR) {
+      //The writer refused the reply, its status code still tells the caller which error to report.
+      gaus_curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, status_code);
+    }
     goto error;
   }
 
   gaus_curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, status_code);
+  if (*status_code == 304 && conditions) {
+    logging(L_DEBUG, "GET %s: not modified", url);
+    goto error;
+  }
   if (*status_code != 200) {
     logging(L_ERROR, "request_get error: server responded with code %ld", *status_code);
     goto error;
   }
 
-  free(auth_header);
-  free(user_agent_header);
-  gaus_curl_easy_cleanup(curl);
-  curl_slist_free_all(headers);
+  connection_pool_release(gaus_current_client()->pool, curl);
+  request_headers_release(headers);
+  curl_slist_free_all(extra_headers);
 
   return 0;
 
   error:
-  free(auth_header);
-  free(user_agent_header);
-  if (curl) {
-    gaus_curl_easy_cleanup(curl);
+  connection_pool_release(gaus_current_client()->pool, curl);
+  request_headers_release(headers);
+  curl_slist_free_all(extra_headers);
+  return -1;
+}
+
+void request_set_speed_floor(CURL *curl, const request_speed_floor_t *floor) {
+  gaus_curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, floor && floor->bytes_per_second ? floor->bytes_per_second
+                                                                                       : REQUEST_LOW_SPEED_LIMIT);
+  gaus_curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, floor && floor->seconds ? floor->seconds
+                                                                              : REQUEST_LOW_SPEED_TIME);
+}
+
+int request_get_from(const char *url, const char *auth_token, curl_off_t offset, bandwidth_class_t traffic_class,
+                     const request_speed_floor_t *floor, curl_write_callback response_writer, void *response,
+                     long *status_code) {
+  CURL *curl = NULL;
+  CURLcode status;
+  request_headers_t *headers = NULL;
+  bandwidth_transfer_t *bandwidth = NULL;
+  int result = -1;
+
+  curl = connection_pool_acquire(gaus_current_client()->pool, url);
+  if (!curl) {
+    goto out;
   }
-  if (headers) {
-    curl_slist_free_all(headers);
+
+  if (request_setup_get(curl, url, auth_token, response_writer, response, &headers)) {
+    goto out;
   }
-  return -1;
+  if (offset > 0) {
+    gaus_curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, offset);
+  }
+  //Offsets, the journal and the md5 count bytes of the resource as stored, an encoded response would not line up.
+  gaus_curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, NULL);
+  //Keep error pages out of the caller's file, and give up on a stalled transfer so it can be resumed.
+  gaus_curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+  request_set_speed_floor(curl, floor);
+  bandwidth = bandwidth_attach(curl, traffic_class);
+
+  logging(L_DEBUG, "GET %s from byte %lld", url, (long long) offset);
+  status = perform_request(curl);
+  bandwidth_detach(bandwidth);
+  if (status == CURLE_RANGE_ERROR) {
+    logging(L_WARNING, "request_get_from: server does not support ranges for %s", url);
+    result = 1;
+    goto out;
+  }
+  if (status != 0) {
+    logging(L_ERROR, "request_get_from error: %s", curl_easy_strerror(status));
+    gaus_curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, status_code);
+    goto out;
+  }
+
+  gaus_curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, status_code);
+  if (*status_code != 200 && *status_code != 206) {
+    logging(L_ERROR, "request_get_from error: server responded with code %ld", *status_code);
+    goto out;
+  }
+  result = 0;
+
+  out:
+  connection_pool_release(gaus_current_client()->pool, curl);
+  request_headers_release(headers);
+  return result;
 }
 
-static size_t in_memory_response_writer(char *content, size_t size, size_t nmemb, void *userp) {
+size_t in_memory_response_writer(char *content, size_t size, size_t nmemb, void *userp) {
   InMemoryResponse *resp = userp;
   size_t write_size = size * nmemb;
-  size_t total_size = resp->pos + write_size + 1;
-  /* If resp->data is NULL, then  the  call  is  equivalent  to  malloc(size) */
-  resp->data = realloc(resp->data, total_size);
 
-  if (resp->data == NULL) {
-    logging(L_ERROR, "not enough memory (realloc returned NULL)\n");
+  if (response_buffer_reserve(resp, resp->pos + write_size + 1) != 0) {
+    logging(L_ERROR, "not enough memory for a %zu byte response", resp->pos + write_size + 1);
     return 0;
   }
 
   memcpy(&(resp->data[resp->pos]), content, write_size);
   resp->pos += write_size;
   resp->data[resp->pos] = '\0'; /* Null terminate */
+  return write_size;
+}
 
-  logging(L_DEBUG, "Wrote %d bytes (+ NUL byte) to response (%d total)",
-          write_size, resp->pos);
-  if (resp->pos < 1000) {
-    logging(L_DEBUG | L_RAW,
-            "----[ data follows ]----\n%s\n"
-            "------------------------",
-            resp->data);
+/* Preallocate the whole response when the server announces its size. */
+static size_t in_memory_header_reader(char *header, size_t size, size_t nitems, void *userp) {
+  InMemoryResponse *resp = userp;
+  size_t header_size = size * nitems;
+  static const char content_length[] = "Content-Length:";
+
+  if (header_size > sizeof(content_length) - 1 &&
+      strncasecmp(header, content_length, sizeof(content_length) - 1) == 0) {
+    unsigned long long length = strtoull(header + sizeof(content_length) - 1, NULL, 10);
+    if (length > 0 && length <= RESPONSE_BUFFER_MAX_PREALLOC) {
+      //Failing is fine here, the writer grows the buffer as data arrives.
+      response_buffer_reserve(resp, resp->pos + (size_t) length + 1);
+    }
   }
-  return write_size;
+  return header_size;
+}
+
+static char *dup_header_value(const char *value, size_t length) {
+  while (length > 0 && (*value == ' ' || *value == '\t')) {
+    value++;
+    length--;
+  }
+  while (length > 0 && (value[length - 1] == '\r' || value[length - 1] == '\n' || value[length - 1] == ' ')) {
+    length--;
+  }
+  return length > 0 ? strndup(value, length) : NULL;
+}
+
+/* Remember the ETag and Last-Modified headers of the final response. */
+static size_t validator_header_reader(char *header, size_t size, size_t nitems, void *userp) {
+  request_validators_t *validators = userp;
+  size_t header_size = size * nitems;
+  static const char etag[] = "ETag:";
+  static const char last_modified[] = "Last-Modified:";
+
+  if (header_size > 5 && strncmp(header, "HTTP/", 5) == 0) {
+    //A new status line, anything seen so far belonged to an interim or redirect response.
+    request_validators_free(validators);
+  } else if (header_size > sizeof(etag) - 1 && strncasecmp(header, etag, sizeof(etag) - 1) == 0) {
+    free(validators->etag);
+    validators->etag = dup_header_value(header + sizeof(etag) - 1, header_size - (sizeof(etag) - 1));
+  } else if (header_size > sizeof(last_modified) - 1 &&
+             strncasecmp(header, last_modified, sizeof(last_modified) - 1) == 0) {
+    free(validators->last_modified);
+    validators->last_modified = dup_header_value(header + sizeof(last_modified) - 1,
+                                                 header_size - (sizeof(last_modified) - 1));
+  }
+  return header_size;
 }
 
 static size_t file_response_writer(char *content, size_t size, size_t nmemb, void *userp) {
@@ -11,13 +11,74 @@
 #define GAUS_UPDATECLIENT_REQUEST_H
 
 #include <stddef.h>
+#include <curl/curl.h>
+#include "bandwidth.h"
+#include "request_headers.h"
+#include "response_buffer.h"
 
+/* The returned string is freed with response_buffer_free. */
 char *request_get_as_string(const char *url, const char *auth_token, long *status_code);
 
-char *request_post_as_string(const char *url, const char *auth_token, const char *payload, long *status_code);
+/* The transfer counts against traffic_class when bandwidth is limited. */
+char *request_post_as_string(const char *url, const char *auth_token, const char *payload,
+                             bandwidth_class_t traffic_class, long *status_code);
 
 int request_get_as_file(const char *url, const char *token, int fd, long *status_code);
 
+//A transfer slower than REQUEST_LOW_SPEED_LIMIT bytes per second for REQUEST_LOW_SPEED_TIME seconds is aborted.
+#define REQUEST_LOW_SPEED_LIMIT 1L
+#define REQUEST_LOW_SPEED_TIME 60L
+
+/* The slowest a download may get before it is aborted, so it can be resumed, from another source if there is one.  0
+ * for either uses REQUEST_LOW_SPEED_LIMIT or REQUEST_LOW_SPEED_TIME. */
+typedef struct {
+  long bytes_per_second;
+  long seconds;
+} request_speed_floor_t;
+
+/* Abort the transfer on curl once it stays below floor, which may be NULL for the defaults. */
+void request_set_speed_floor(CURL *curl, const request_speed_floor_t *floor);
+
+/* Hands the response from byte offset on to response_writer, using a Range request if offset is not 0, as part of
+ * traffic_class.  Returns 0 if the server answered with 200 or 206, 1 if it does not support ranges and -1 on other
+ * failures, a transfer below floor included.  status_code is set whenever a response was received. */
+int request_get_from(const char *url, const char *auth_token, curl_off_t offset, bandwidth_class_t traffic_class,
+                     const request_speed_floor_t *floor, curl_write_callback response_writer, void *response,
+                     long *status_code);
+
+/* Validators identifying a version of a response, for conditional requests. */
+typedef struct {
+  char *etag;          //ETag header value, or NULL
+  char *last_modified; //Last-Modified header value, or NULL
+} request_validators_t;
+
+/* Hands the response to response_writer as it arrives.  Returns 0 if the server answered with 200, status_code is
+ * also set if response_writer aborted the transfer.  If conditions is set the request is only answered with a body
+ * if the response no longer matches them, otherwise the server answers 304.  received, if set, is filled in with the
+ * validators of the response. */
+int request_get_streamed(const char *url, const char *auth_token, curl_write_callback response_writer, void *response,
+                         const request_validators_t *conditions, request_validators_t *received, long *status_code);
+
+void request_validators_free(request_validators_t *validators);
+
 int create_url(char *dest, size_t dest_len, char *fmt, ...);
 
+/* Set all options for a request on curl.  On success *headers holds the header lists in use, the caller releases them
+ * with request_headers_release once the transfer is done. */
+int request_setup_get(CURL *curl, const char *url, const char *auth_token,
+                      curl_write_callback response_writer, void *response, request_headers_t **headers);
+
+/* *body is set to the compressed payload when request compression is enabled, the caller frees it once the transfer
+ * is done.  It is NULL if payload is sent as it is, payload must then stay valid until the transfer is done. */
+int request_setup_post(CURL *curl, const char *url, const char *auth_token, const char *payload, char **body,
+                       curl_write_callback response_writer, void *response, request_headers_t **headers);
+
+/* Make the GET set up on curl conditional and capture the validators of its response, see request_get_streamed.  If a
+ * separate header list was needed *extra_headers holds it, the caller frees it once the transfer is done. */
+int request_setup_validators(CURL *curl, const request_headers_t *headers, const request_validators_t *conditions,
+                             request_validators_t *received, struct curl_slist **extra_headers);
+
+/* Write callback collecting the response into an InMemoryResponse */
+size_t in_memory_response_writer(char *content, size_t size, size_t nmemb, void *userp);
+
 #endif
@@ -0,0 +1,499 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "request_async.h"
+#include "curl_wrapper.h"
+#include "log.h"
+#include "request.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//Upper bound for how long the I/O thread sleeps when curl has no timeout pending.
+#define ENGINE_IDLE_WAIT_MS 1000
+
+typedef struct async_transfer {
+  CURL *curl;
+  request_headers_t *headers;
+  struct curl_slist *extra_headers; //Owned per transfer header list, if the shared one did not do
+  char *payload; //Owned copy of the body as sent, curl does not copy CURLOPT_POSTFIELDS
+  bandwidth_transfer_t *bandwidth;
+  InMemoryResponse response;
+  request_callback_t callback;
+  void *user_data;
+  bool waiting;     //A blocking request_async_perform caller owns the transfer and its handle
+  bool done;
+  CURLcode result;
+  struct async_transfer *prev;
+  struct async_transfer *next;
+} async_transfer_t;
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t transfer_done;   //Signalled when a waiting transfer completes
+  pthread_t thread;
+  bool started;
+  bool stopping;
+  bool host_loop;                 //Driven by gaus_loop_* from the host event loop instead of the I/O thread
+  gaus_loop_options_t loop;
+  CURLM *multi;
+  int wakeup_pipe[2];
+  async_transfer_t *pending;      //Submitted but not yet handed to the multi handle
+  async_transfer_t *pending_tail;
+  async_transfer_t *active;       //Owned by the multi handle, only touched by the thread driving it
+} engine = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .transfer_done = PTHREAD_COND_INITIALIZER
+};
+
+static void free_transfer(async_transfer_t *transfer) {
+  if (transfer->curl) {
+    gaus_curl_easy_cleanup(transfer->curl);
+  }
+  bandwidth_detach(transfer->bandwidth);
+  request_headers_release(transfer->headers);
+  curl_slist_free_all(transfer->extra_headers);
+  free(transfer->payload);
+  response_buffer_release(&transfer->response);
+  free(transfer);
+}
+
+static void complete_transfer(async_transfer_t *transfer, CURLcode result) {
+  long status_code = 0;
+  const char *response = NULL;
+
+  if (transfer->waiting) {
+    pthread_mutex_lock(&engine.lock);
+    transfer->result = result;
+    transfer->done = true;
+    pthread_cond_broadcast(&engine.transfer_done);
+    pthread_mutex_unlock(&engine.lock);
+    return;
+  }
+
+  if (result != CURLE_OK) {
+    logging(L_ERROR, "request_async error: %s", curl_easy_strerror(result));
+    if (result == CURLE_WRITE_ERROR) {
+      //The writer refused the reply, its status code still tells the caller which error to report.
+      gaus_curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &status_code);
+    }
+  } else {
+    gaus_curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &status_code);
+    if (status_code == 200) {
+      response = transfer->response.data ? transfer->response.data : "";
+    } else if (status_code == 304 && transfer->extra_headers) {
+      logging(L_DEBUG, "request_async: not modified");
+    } else {
+      logging(L_ERROR, "request_async error: server responded with code %ld", status_code);
+    }
+  }
+  transfer->callback(response, status_code, transfer->user_data);
+  free_transfer(transfer);
+}
+
+static void unlink_active(async_transfer_t *transfer) {
+  if (transfer->prev) {
+    transfer->prev->next = transfer->next;
+  } else {
+    engine.active = transfer->next;
+  }
+  if (transfer->next) {
+    transfer->next->prev = transfer->prev;
+  }
+}
+
+/* Must be called with engine.lock held. */
+static void start_pending_transfers(void) {
+  while (engine.pending) {
+    async_transfer_t *transfer = engine.pending;
+    engine.pending = transfer->next;
+
+    transfer->prev = NULL;
+    transfer->next = engine.active;
+    if (engine.active) {
+      engine.active->prev = transfer;
+    }
+    engine.active = transfer;
+    gaus_curl_multi_add_handle(engine.multi, transfer->curl);
+  }
+  engine.pending_tail = NULL;
+}
+
+/* Take the transfers curl finished off the multi handle, linked through next. */
+static async_transfer_t *take_finished_transfers(void) {
+  async_transfer_t *finished = NULL;
+  CURLMsg *msg;
+  int messages_left;
+  while ((msg = gaus_curl_multi_info_read(engine.multi, &messages_left))) {
+    if (msg->msg != CURLMSG_DONE) {
+      continue;
+    }
+    CURL *curl = msg->easy_handle;
+    async_transfer_t *transfer = NULL;
+    gaus_curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **) &transfer);
+    transfer->result = msg->data.result;
+    gaus_curl_multi_remove_handle(engine.multi, curl);
+    unlink_active(transfer);
+    transfer->next = finished;
+    finished = transfer;
+  }
+  return finished;
+}
+
+static void complete_transfers(async_transfer_t *finished) {
+  while (finished) {
+    async_transfer_t *transfer = finished;
+    finished = transfer->next;
+    complete_transfer(transfer, transfer->result);
+  }
+}
+
+static void drain_wakeup_pipe(void) {
+  char buffer[64];
+  while (read(engine.wakeup_pipe[0], buffer, sizeof(buffer)) > 0) {
+  }
+}
+
+static void *engine_main(void *unused) {
+  (void) unused;
+  int running_handles = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&engine.lock);
+    if (engine.stopping) {
+      pthread_mutex_unlock(&engine.lock);
+      break;
+    }
+    start_pending_transfers();
+    pthread_mutex_unlock(&engine.lock);
+
+    gaus_curl_multi_perform(engine.multi, &running_handles);
+    complete_transfers(take_finished_transfers());
+
+    struct curl_waitfd wakeup = {.fd = engine.wakeup_pipe[0], .events = CURL_WAIT_POLLIN, .revents = 0};
+    gaus_curl_multi_wait(engine.multi, &wakeup, 1, ENGINE_IDLE_WAIT_MS, NULL);
+    drain_wakeup_pipe();
+  }
+  response_buffer_cleanup();
+  return NULL;
+}
+
+/* Must be called with engine.lock held. */
+static int start_engine(void) {
+  if (engine.started) {
+    return 0;
+  }
+
+  if (pipe(engine.wakeup_pipe) != 0) {
+    logging(L_ERROR, "request_async error: unable to create wakeup pipe (%s)", strerror(errno));
+    return -1;
+  }
+  for (int i = 0; i < 2; i++) {
+    fcntl(engine.wakeup_pipe[i], F_SETFL, fcntl(engine.wakeup_pipe[i], F_GETFL) | O_NONBLOCK);
+    fcntl(engine.wakeup_pipe[i], F_SETFD, FD_CLOEXEC);
+  }
+
+  if (!(engine.multi = gaus_curl_multi_init())) {
+    logging(L_ERROR, "request_async error: unable to create curl multi handle");
+    goto error;
+  }
+  gaus_curl_multi_setopt(engine.multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+  engine.stopping = false;
+  if (pthread_create(&engine.thread, NULL, engine_main, NULL) != 0) {
+    logging(L_ERROR, "request_async error: unable to start I/O thread");
+    goto error;
+  }
+  engine.started = true;
+  return 0;
+
+  error:
+  if (engine.multi) {
+    gaus_curl_multi_cleanup(engine.multi);
+    engine.multi = NULL;
+  }
+  close(engine.wakeup_pipe[0]);
+  close(engine.wakeup_pipe[1]);
+  return -1;
+}
+
+static int submit_transfer(async_transfer_t *transfer) {
+  pthread_mutex_lock(&engine.lock);
+  if (start_engine() != 0) {
+    pthread_mutex_unlock(&engine.lock);
+    return -1;
+  }
+
+  transfer->next = NULL;
+  if (engine.pending_tail) {
+    engine.pending_tail->next = transfer;
+  } else {
+    engine.pending = transfer;
+  }
+  engine.pending_tail = transfer;
+  if (engine.host_loop) {
+    //Adding the handle asks the host for a timeout through the timer callback, that gets the transfer going.  The lock
+    //keeps the host loop from driving the multi handle meanwhile.
+    start_pending_transfers();
+    pthread_mutex_unlock(&engine.lock);
+    return 0;
+  }
+  pthread_mutex_unlock(&engine.lock);
+
+  //Wake the I/O thread so it picks up the transfer without waiting for its idle timeout.
+  if (write(engine.wakeup_pipe[1], "", 1) < 0 && errno != EAGAIN) {
+    logging(L_WARNING, "request_async: unable to wake I/O thread (%s)", strerror(errno));
+  }
+  return 0;
+}
+
+static async_transfer_t *create_transfer(request_callback_t callback, void *user_data) {
+  async_transfer_t *transfer = calloc(1, sizeof(async_transfer_t));
+  if (!transfer) {
+    return NULL;
+  }
+  if (!(transfer->curl = gaus_curl_easy_init())) {
+    free(transfer);
+    return NULL;
+  }
+  transfer->callback = callback;
+  transfer->user_data = user_data;
+  gaus_curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer);
+  return transfer;
+}
+
+static int queue_get(async_transfer_t *transfer, const char *url, const char *auth_token,
+                     curl_write_callback response_writer, void *response,
+                     const request_validators_t *conditions, request_validators_t *received) {
+  if (request_setup_get(transfer->curl, url, auth_token, response_writer, response, &transfer->headers) != 0) {
+    return -1;
+  }
+  if (request_setup_validators(transfer->curl, transfer->headers, conditions, received,
+                               &transfer->extra_headers) != 0) {
+    return -1;
+  }
+  transfer->bandwidth = bandwidth_attach(transfer->curl, BANDWIDTH_CONTROL);
+
+  logging(L_DEBUG, "GET (async) %s", url);
+  return submit_transfer(transfer);
+}
+
+int request_get_async(const char *url, const char *auth_token, request_callback_t callback, void *user_data) {
+  async_transfer_t *transfer = create_transfer(callback, user_data);
+  if (!transfer) {
+    logging(L_ERROR, "request_get_async error: unable to create transfer");
+    return -1;
+  }
+
+  if (queue_get(transfer, url, auth_token, in_memory_response_writer, &transfer->response, NULL, NULL) != 0) {
+    free_transfer(transfer);
+    return -1;
+  }
+  return 0;
+}
+
+int request_get_streamed_async(const char *url, const char *auth_token, curl_write_callback response_writer,
+                               void *response, const request_validators_t *conditions,
+                               request_validators_t *received, request_callback_t callback, void *user_data) {
+  async_transfer_t *transfer = create_transfer(callback, user_data);
+  if (!transfer) {
+    logging(L_ERROR, "request_get_streamed_async error: unable to create transfer");
+    return -1;
+  }
+
+  if (queue_get(transfer, url, auth_token, response_writer, response, conditions, received) != 0) {
+    free_transfer(transfer);
+    return -1;
+  }
+  return 0;
+}
+
+int request_post_async(const char *url, const char *auth_token, const char *payload, bandwidth_class_t traffic_class,
+                       request_callback_t callback, void *user_data) {
+  async_transfer_t *transfer = create_transfer(callback, user_data);
+  if (!transfer) {
+    logging(L_ERROR, "request_post_async error: unable to create transfer");
+    return -1;
+  }
+
+  if (!(transfer->payload = strdup(payload))) {
+    goto error;
+  }
+
+  char *body = NULL;
+  if (request_setup_post(transfer->curl, url, auth_token, transfer->payload, &body, in_memory_response_writer,
+                         &transfer->response, &transfer->headers) != 0) {
+    goto error;
+  }
+  if (body) {
+    //curl now sends the compressed copy.
+    free(transfer->payload);
+    transfer->payload = body;
+  }
+  transfer->bandwidth = bandwidth_attach(transfer->curl, traffic_class);
+
+  logging(L_DEBUG, "POST (async) %s", url);
+  if (submit_transfer(transfer) != 0) {
+    goto error;
+  }
+  return 0;
+
+  error:
+  free_transfer(transfer);
+  return -1;
+}
+
+CURLcode request_async_perform(CURL *curl) {
+  async_transfer_t transfer = {.curl = curl, .waiting = true};
+
+  pthread_mutex_lock(&engine.lock);
+  //Waiting on the engine from its own thread, or from a host loop that has to drive it, would never return.
+  bool perform_directly = engine.host_loop || (engine.started && pthread_equal(pthread_self(), engine.thread));
+  pthread_mutex_unlock(&engine.lock);
+  if (perform_directly) {
+    return gaus_curl_easy_perform(curl);
+  }
+
+  gaus_curl_easy_setopt(curl, CURLOPT_PRIVATE, &transfer);
+  if (submit_transfer(&transfer) != 0) {
+    return CURLE_FAILED_INIT;
+  }
+
+  pthread_mutex_lock(&engine.lock);
+  while (!transfer.done) {
+    pthread_cond_wait(&engine.transfer_done, &engine.lock);
+  }
+  pthread_mutex_unlock(&engine.lock);
+  return transfer.result;
+}
+
+void request_async_cleanup(void) {
+  pthread_mutex_lock(&engine.lock);
+  if (!engine.started) {
+    pthread_mutex_unlock(&engine.lock);
+    return;
+  }
+  engine.stopping = true;
+  pthread_mutex_unlock(&engine.lock);
+
+  if (!engine.host_loop) {
+    if (write(engine.wakeup_pipe[1], "", 1) < 0 && errno != EAGAIN) {
+      logging(L_WARNING, "request_async: unable to wake I/O thread (%s)", strerror(errno));
+    }
+    pthread_join(engine.thread, NULL);
+  }
+
+  //Nothing drives the multi handle anymore, abort everything it did not finish.
+  while (engine.active) {
+    async_transfer_t *transfer = engine.active;
+    engine.active = transfer->next;
+    gaus_curl_multi_remove_handle(engine.multi, transfer->curl);
+    complete_transfer(transfer, CURLE_ABORTED_BY_CALLBACK);
+  }
+  while (engine.pending) {
+    async_transfer_t *transfer = engine.pending;
+    engine.pending = transfer->next;
+    complete_transfer(transfer, CURLE_ABORTED_BY_CALLBACK);
+  }
+  engine.pending_tail = NULL;
+
+  gaus_curl_multi_cleanup(engine.multi);
+  engine.multi = NULL;
+  if (!engine.host_loop) {
+    close(engine.wakeup_pipe[0]);
+    close(engine.wakeup_pipe[1]);
+  }
+  engine.host_loop = false;
+  engine.started = false;
+}
+
+static int loop_socket_callback(CURL *curl, curl_socket_t fd, int what, void *userp, void *socketp) {
+  (void) curl;
+  (void) userp;
+  (void) socketp;
+  unsigned int events = 0;
+  if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) {
+    events |= GAUS_LOOP_POLL_IN;
+  }
+  if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) {
+    events |= GAUS_LOOP_POLL_OUT;
+  }
+  //CURL_POLL_REMOVE maps to no events, the host stops watching fd.
+  engine.loop.socket_callback(fd, events, engine.loop.user_data);
+  return 0;
+}
+
+static int loop_timer_callback(CURLM *multi, long timeout_ms, void *userp) {
+  (void) multi;
+  (void) userp;
+  engine.loop.timer_callback(timeout_ms, engine.loop.user_data);
+  return 0;
+}
+
+int request_async_use_loop(const gaus_loop_options_t *options) {
+  pthread_mutex_lock(&engine.lock);
+  if (engine.started) {
+    pthread_mutex_unlock(&engine.lock);
+    logging(L_ERROR, "request_async error: requests are already being processed");
+    return -1;
+  }
+
+  if (!(engine.multi = gaus_curl_multi_init())) {
+    pthread_mutex_unlock(&engine.lock);
+    logging(L_ERROR, "request_async error: unable to create curl multi handle");
+    return -1;
+  }
+  engine.loop = *options;
+  gaus_curl_multi_setopt(engine.multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  gaus_curl_multi_setopt(engine.multi, CURLMOPT_SOCKETFUNCTION, loop_socket_callback);
+  gaus_curl_multi_setopt(engine.multi, CURLMOPT_TIMERFUNCTION, loop_timer_callback);
+  engine.host_loop = true;
+  engine.stopping = false;
+  engine.started = true;
+  pthread_mutex_unlock(&engine.lock);
+  return 0;
+}
+
+int request_async_socket_action(int fd, unsigned int events) {
+  int running_handles = 0;
+  int ev_bitmask = 0;
+
+  if (!engine.host_loop) {
+    logging(L_ERROR, "request_async error: not driven by a host event loop");
+    return -1;
+  }
+  if (events & GAUS_LOOP_POLL_IN) {
+    ev_bitmask |= CURL_CSELECT_IN;
+  }
+  if (events & GAUS_LOOP_POLL_OUT) {
+    ev_bitmask |= CURL_CSELECT_OUT;
+  }
+  if (events & GAUS_LOOP_POLL_ERROR) {
+    ev_bitmask |= CURL_CSELECT_ERR;
+  }
+
+  //Other threads add handles to the multi handle when they submit a transfer, so it is only used under the lock.  The
+  //completion callbacks run without it, they may submit further transfers.
+  pthread_mutex_lock(&engine.lock);
+  CURLMcode result = gaus_curl_multi_socket_action(engine.multi, fd < 0 ? CURL_SOCKET_TIMEOUT : fd, ev_bitmask,
+                                                   &running_handles);
+  async_transfer_t *finished = take_finished_transfers();
+  pthread_mutex_unlock(&engine.lock);
+  complete_transfers(finished);
+  if (result != CURLM_OK) {
+    logging(L_ERROR, "request_async error: %s", curl_multi_strerror(result));
+    return -1;
+  }
+  return 0;
+}
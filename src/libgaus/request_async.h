@@ -0,0 +1,57 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_REQUEST_ASYNC_H
+#define GAUS_REQUEST_ASYNC_H
+
+#include "gaus/gaus_client_types.h"
+#include "request.h"
+#include <curl/curl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Called once a transfer is done.  response is NULL unless the server answered with 200, it is only valid for the
+ * duration of the call.  status_code is 0 if no response was received at all. */
+typedef void (*request_callback_t)(const char *response, long status_code, void *user_data);
+
+/* Queue a request on the library I/O thread, starting the thread on first use.  Returns 0 if the request was queued,
+ * in which case callback is called exactly once from the I/O thread. */
+int request_get_async(const char *url, const char *auth_token, request_callback_t callback, void *user_data);
+
+/* Like request_get_async, but the response is handed to response_writer as it arrives.  The callback is then passed
+ * an empty response on success, and the status code of the response if response_writer aborted the transfer.
+ * conditions and received are used as by request_get_streamed, received must stay valid until the callback was
+ * called. */
+int request_get_streamed_async(const char *url, const char *auth_token, curl_write_callback response_writer,
+                               void *response, const request_validators_t *conditions,
+                               request_validators_t *received, request_callback_t callback, void *user_data);
+
+int request_post_async(const char *url, const char *auth_token, const char *payload, bandwidth_class_t traffic_class,
+                       request_callback_t callback, void *user_data);
+
+/* Run the prepared handle curl on the I/O thread and block until it completed.  Falls back to curl_easy_perform when
+ * called from the I/O thread itself or in host event loop mode. */
+CURLcode request_async_perform(CURL *curl);
+
+/* Stop the I/O thread.  Transfers that have not completed yet are completed with status_code 0. */
+void request_async_cleanup(void);
+
+/* Let the host event loop drive transfers instead of the I/O thread.  Must be called before the first request is
+ * queued.  Callbacks of queued requests are then called from request_async_socket_action. */
+int request_async_use_loop(const gaus_loop_options_t *options);
+
+/* Act on activity on fd, a mask of gaus_loop_event_t, or on an expired timeout if fd is negative. */
+int request_async_socket_action(int fd, unsigned int events);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_REQUEST_ASYNC_H
@@ -0,0 +1,197 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "request_headers.h"
+#include "compression.h"
+#include "gaus/gaus_client.h"
+#include "log.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct {
+  pthread_mutex_t lock;
+  char *user_agent;         //"User-Agent: ..." header, formatted once
+  request_headers_t anonymous[GAUS_COMPRESSION_DEFLATE + 1];
+  request_headers_t entries[REQUEST_HEADERS_CACHE_SIZE];
+  unsigned long use_counter;
+} cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void free_lists(request_headers_t *headers) {
+  curl_slist_free_all(headers->get);
+  curl_slist_free_all(headers->post);
+  free(headers->token);
+  memset(headers, 0, sizeof(request_headers_t));
+}
+
+static struct curl_slist *append_header(struct curl_slist **list, const char *header) {
+  struct curl_slist *appended = curl_slist_append(*list, header);
+  if (appended) {
+    *list = appended;
+  }
+  return appended;
+}
+
+/* Fill in headers->get and headers->post for auth_token and compression. */
+static int build_lists(request_headers_t *headers, const char *auth_token, gaus_compression_t compression) {
+  char *auth_header = NULL;
+  const char *content_encoding = compression_header(compression);
+
+  if (auth_token) {
+    size_t required_auth_header_len = snprintf(NULL, 0, "Authorization: Bearer %s", auth_token) + 1;
+    if (!(auth_header = malloc(required_auth_header_len))) {
+      goto error;
+    }
+    snprintf(auth_header, required_auth_header_len, "Authorization: Bearer %s", auth_token);
+    if (!(headers->token = strdup(auth_token))) {
+      goto error;
+    }
+  }
+
+  if (auth_header && (!append_header(&headers->get, auth_header) || !append_header(&headers->post, auth_header))) {
+    goto error;
+  }
+  if (!append_header(&headers->get, cache.user_agent) || !append_header(&headers->post, cache.user_agent) ||
+      !append_header(&headers->post, "Content-Type: application/json")) {
+    goto error;
+  }
+  if (content_encoding && !append_header(&headers->post, content_encoding)) {
+    goto error;
+  }
+
+  headers->compression = compression;
+  free(auth_header);
+  return 0;
+
+  error:
+  logging(L_ERROR, "request_headers error: unable to build headers");
+  free(auth_header);
+  free_lists(headers);
+  return -1;
+}
+
+int request_headers_init(void) {
+  pthread_mutex_lock(&cache.lock);
+  if (cache.user_agent) {
+    pthread_mutex_unlock(&cache.lock);
+    return 0;
+  }
+
+  gaus_version_t version = gaus_client_library_version();
+  size_t required_user_agent_len =
+      snprintf(NULL, 0, "User-Agent: gaus-device-client-c/v%d.%d.%d", version.major, version.minor, version.patch) + 1;
+  if (!(cache.user_agent = malloc(required_user_agent_len))) {
+    goto error;
+  }
+  snprintf(cache.user_agent, required_user_agent_len, "User-Agent: gaus-device-client-c/v%d.%d.%d",
+           version.major, version.minor, version.patch);
+
+  for (int compression = GAUS_COMPRESSION_NONE; compression <= GAUS_COMPRESSION_DEFLATE; compression++) {
+    if (build_lists(&cache.anonymous[compression], NULL, (gaus_compression_t) compression) != 0) {
+      goto error;
+    }
+  }
+  pthread_mutex_unlock(&cache.lock);
+  return 0;
+
+  error:
+  logging(L_ERROR, "request_headers_init error: unable to build headers");
+  for (int compression = GAUS_COMPRESSION_NONE; compression <= GAUS_COMPRESSION_DEFLATE; compression++) {
+    free_lists(&cache.anonymous[compression]);
+  }
+  free(cache.user_agent);
+  cache.user_agent = NULL;
+  pthread_mutex_unlock(&cache.lock);
+  return -1;
+}
+
+/* Must be called with cache.lock held.  Returns the entry for auth_token and compression, or a free or least recently
+ * used unused entry (emptied) to build it in, or NULL if every entry is in use. */
+static request_headers_t *find_entry(const char *auth_token, gaus_compression_t compression) {
+  request_headers_t *candidate = NULL;
+  for (size_t i = 0; i < REQUEST_HEADERS_CACHE_SIZE; i++) {
+    request_headers_t *entry = &cache.entries[i];
+    if (entry->token && entry->compression == compression && strcmp(entry->token, auth_token) == 0) {
+      return entry;
+    }
+    if (entry->users == 0 && (!candidate || !entry->token ||
+                              (candidate->token && entry->last_used < candidate->last_used))) {
+      candidate = entry;
+    }
+  }
+  if (candidate && candidate->token) {
+    free_lists(candidate);
+  }
+  return candidate;
+}
+
+request_headers_t *request_headers_acquire(const char *auth_token, gaus_compression_t compression) {
+  if (!auth_token) {
+    //Built once at init and never changed, no locking needed.
+    return cache.anonymous[compression].post ? &cache.anonymous[compression] : NULL;
+  }
+
+  pthread_mutex_lock(&cache.lock);
+  request_headers_t *headers = find_entry(auth_token, compression);
+  if (!headers) {
+    //Every cached token is in use by a request, build lists that only live for this request.
+    pthread_mutex_unlock(&cache.lock);
+    if (!(headers = calloc(1, sizeof(request_headers_t)))) {
+      return NULL;
+    }
+    if (build_lists(headers, auth_token, compression) != 0) {
+      free(headers);
+      return NULL;
+    }
+    headers->users = 1;
+    return headers;
+  }
+
+  if (!headers->token && build_lists(headers, auth_token, compression) != 0) {
+    pthread_mutex_unlock(&cache.lock);
+    return NULL;
+  }
+  headers->cached = true;
+  headers->users++;
+  headers->last_used = ++cache.use_counter;
+  pthread_mutex_unlock(&cache.lock);
+  return headers;
+}
+
+void request_headers_release(request_headers_t *headers) {
+  if (!headers || (headers >= cache.anonymous && headers <= &cache.anonymous[GAUS_COMPRESSION_DEFLATE])) {
+    return;
+  }
+  if (!headers->cached) {
+    free_lists(headers);
+    free(headers);
+    return;
+  }
+  pthread_mutex_lock(&cache.lock);
+  headers->users--;
+  pthread_mutex_unlock(&cache.lock);
+}
+
+void request_headers_cleanup(void) {
+  pthread_mutex_lock(&cache.lock);
+  for (size_t i = 0; i < REQUEST_HEADERS_CACHE_SIZE; i++) {
+    free_lists(&cache.entries[i]);
+  }
+  for (int compression = GAUS_COMPRESSION_NONE; compression <= GAUS_COMPRESSION_DEFLATE; compression++) {
+    free_lists(&cache.anonymous[compression]);
+  }
+  free(cache.user_agent);
+  cache.user_agent = NULL;
+  cache.use_counter = 0;
+  pthread_mutex_unlock(&cache.lock);
+}
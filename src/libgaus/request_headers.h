@@ -0,0 +1,49 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_REQUEST_HEADERS_H
+#define GAUS_REQUEST_HEADERS_H
+
+#include <gaus/gaus_client_types.h>
+#include <curl/curl.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REQUEST_HEADERS_CACHE_SIZE 32
+
+/* Prebuilt header lists for one auth token and request compression, shared read-only by every request using them. */
+typedef struct request_headers {
+  char *token;              //NULL for the lists used by requests without a token
+  gaus_compression_t compression;
+  struct curl_slist *get;   //Authorization and User-Agent
+  struct curl_slist *post;  //Same as get plus Content-Type and Content-Encoding if request compression is enabled
+  unsigned int users;       //Requests currently using the lists, they are only freed when unused
+  unsigned long last_used;
+  bool cached;              //False for lists built for a single request when the cache was full
+} request_headers_t;
+
+/* Build the lists used by requests without a token, one per request compression. */
+int request_headers_init(void);
+
+/* Get the header lists for auth_token (may be NULL) and the request compression of the client, building them if this
+ * pair was not seen recently.  The lists must not be modified and stay valid until request_headers_release. */
+request_headers_t *request_headers_acquire(const char *auth_token, gaus_compression_t compression);
+
+void request_headers_release(request_headers_t *headers);
+
+/* Free all lists.  No request may be using them. */
+void request_headers_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_REQUEST_HEADERS_H
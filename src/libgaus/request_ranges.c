@@ -0,0 +1,281 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "request_ranges.h"
+#include "bandwidth.h"
+#include "connection_pool.h"
+#include "curl_wrapper.h"
+#include "gaus.h"
+#include "log.h"
+#include "request.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+//Upper bound for how long to wait for activity on the transfers before checking them again.
+#define RANGES_WAIT_MS 1000
+//Throughput is measured over windows this long, long enough for a new stream to get up to speed.
+#define STREAM_CONTROL_WINDOW_MS 2000
+//Windows to keep a settled stream count before trying one more stream again, the link may have changed.
+#define STREAM_CONTROL_HOLD_WINDOWS 15
+
+typedef struct {
+  CURL *curl;
+  request_headers_t *headers;
+  bandwidth_transfer_t *bandwidth;
+  request_range_t *range;   //Range being fetched, NULL if the stream is idle
+  request_range_writer_t writer;
+  curl_off_t *received;     //Bytes received by all streams, for stream_control_update
+  bool unsupported;         //The server answered with the whole resource instead of the range
+} range_stream_t;
+
+static size_t range_stream_writer(char *content, size_t size, size_t nmemb, void *userp) {
+  range_stream_t *stream = userp;
+  request_range_t *range = stream->range;
+  size_t length = size * nmemb;
+  long status_code = 0;
+
+  gaus_curl_easy_getinfo(stream->curl, CURLINFO_RESPONSE_CODE, &status_code);
+  if (status_code != 206) {
+    stream->unsupported = true;
+    return 0;
+  }
+  if (range->received + (curl_off_t) length > range->length) {
+    logging(L_ERROR, "request_get_ranges: server sent more than the %lld bytes of the range",
+            (long long) range->length);
+    return 0;
+  }
+  if (stream->writer(range, content, length) != 0) {
+    return 0;
+  }
+  range->received += (curl_off_t) length;
+  *stream->received += (curl_off_t) length;
+  return length;
+}
+
+void stream_control_init(stream_control_t *control, unsigned int max_streams) {
+  control->streams = 1;
+  control->max_streams = max_streams ? max_streams : 1;
+  control->bytes = 0;
+  control->window_start_ms = -1;
+  control->previous_rate = 0;
+  control->hold = 0;
+}
+
+unsigned int stream_control_update(stream_control_t *control, curl_off_t bytes, long long now_ms) {
+  curl_off_t rate;
+
+  if (control->window_start_ms < 0) {
+    //Time spent connecting is not throughput.
+    control->window_start_ms = bytes > 0 ? now_ms : -1;
+    return control->streams;
+  }
+  control->bytes += bytes;
+  if (now_ms - control->window_start_ms < STREAM_CONTROL_WINDOW_MS) {
+    return control->streams;
+  }
+  rate = control->bytes * 1000 / (now_ms - control->window_start_ms);
+  control->bytes = 0;
+  control->window_start_ms = now_ms;
+
+  if (control->hold > 0) {
+    if (--control->hold == 0 && control->streams < control->max_streams) {
+      control->previous_rate = rate;
+      control->streams++;
+    }
+    return control->streams;
+  }
+  if (control->previous_rate == 0 ||
+      rate >= control->previous_rate + control->previous_rate / (2 * (control->streams - 1))) {
+    if (control->streams < control->max_streams) {
+      control->previous_rate = rate;
+      control->streams++;
+    } else {
+      control->hold = STREAM_CONTROL_HOLD_WINDOWS;
+    }
+  } else {
+    //The last stream added less than half of what each of the others carries, the link is full.
+    control->streams--;
+    control->previous_rate = 0;
+    control->hold = STREAM_CONTROL_HOLD_WINDOWS;
+  }
+  logging(L_DEBUG, "request_get_ranges: %lld bytes per second, using %u streams", (long long) rate,
+          control->streams);
+  return control->streams;
+}
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void release_stream(range_stream_t *stream) {
+  bandwidth_detach(stream->bandwidth);
+  connection_pool_release(gaus_current_client()->pool, stream->curl);
+  request_headers_release(stream->headers);
+  stream->bandwidth = NULL;
+  stream->curl = NULL;
+  stream->headers = NULL;
+  stream->range = NULL;
+}
+
+/* Returns 1 without starting the stream if wait is false and every handle for the host is in use. */
+static int start_stream(CURLM *multi, range_stream_t *stream, const char *url, const char *auth_token,
+                        bandwidth_class_t traffic_class, const request_speed_floor_t *floor,
+                        request_range_t *range, bool wait) {
+  char spec[64];
+
+  if (!wait && !(stream->curl = connection_pool_try_acquire(gaus_current_client()->pool, url))) {
+    return 1;
+  }
+  stream->range = range;
+  stream->unsupported = false;
+  if ((wait && !(stream->curl = connection_pool_acquire(gaus_current_client()->pool, url))) ||
+      request_setup_get(stream->curl, url, auth_token, range_stream_writer, stream, &stream->headers)) {
+    release_stream(stream);
+    return -1;
+  }
+  snprintf(spec, sizeof(spec), "%" CURL_FORMAT_CURL_OFF_T "-%" CURL_FORMAT_CURL_OFF_T,
+           range->offset + range->received, range->offset + range->length - 1);
+  gaus_curl_easy_setopt(stream->curl, CURLOPT_RANGE, spec);
+  //Ranges count bytes of the resource as stored, an encoded response would not line up with them.
+  gaus_curl_easy_setopt(stream->curl, CURLOPT_ACCEPT_ENCODING, NULL);
+  gaus_curl_easy_setopt(stream->curl, CURLOPT_FAILONERROR, 1L);
+  request_set_speed_floor(stream->curl, floor);
+  gaus_curl_easy_setopt(stream->curl, CURLOPT_PRIVATE, stream);
+  stream->bandwidth = bandwidth_attach(stream->curl, traffic_class);
+
+  logging(L_DEBUG, "GET %s bytes %s", url, spec);
+  if (gaus_curl_multi_add_handle(multi, stream->curl) != CURLM_OK) {
+    release_stream(stream);
+    return -1;
+  }
+  return 0;
+}
+
+static void finish_stream(CURLM *multi, range_stream_t *stream, CURLcode result) {
+  request_range_t *range = stream->range;
+
+  range->status_code = 0;
+  gaus_curl_easy_getinfo(stream->curl, CURLINFO_RESPONSE_CODE, &range->status_code);
+  if (stream->unsupported) {
+    logging(L_WARNING, "request_get_ranges: server does not support ranges, it answered with code %ld",
+            range->status_code);
+  } else if (result != CURLE_OK) {
+    logging(L_ERROR, "request_get_ranges error: %s at byte %lld", curl_easy_strerror(result),
+            (long long) (range->offset + range->received));
+  }
+  gaus_curl_multi_remove_handle(multi, stream->curl);
+  release_stream(stream);
+}
+
+int request_get_ranges(const char *url, const char *auth_token, request_range_t *ranges, size_t count,
+                       stream_control_t *control, bandwidth_class_t traffic_class,
+                       const request_speed_floor_t *floor, request_range_writer_t writer) {
+  range_stream_t *streams = NULL;
+  unsigned int max_streams;
+  curl_off_t received = 0;
+  CURLM *multi = NULL;
+  size_t next = 0;
+  unsigned int active = 0;
+  int running_handles = 0;
+  bool unsupported = false;
+  bool stalled = false;
+  int result = -1;
+
+  //Every stream holds a pooled handle, asking for more than a host gets would wait on ourselves.
+  if (control->max_streams > connection_pool_max_per_host(gaus_current_client()->pool)) {
+    control->max_streams = connection_pool_max_per_host(gaus_current_client()->pool);
+  }
+  if (control->streams > control->max_streams) {
+    control->streams = control->max_streams;
+  }
+  max_streams = control->max_streams;
+  if (!(streams = calloc(max_streams, sizeof(range_stream_t))) || !(multi = gaus_curl_multi_init())) {
+    logging(L_ERROR, "request_get_ranges error: unable to set up transfers");
+    goto out;
+  }
+  gaus_curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  for (unsigned int i = 0; i < max_streams; i++) {
+    streams[i].writer = writer;
+    streams[i].received = &received;
+  }
+
+  for (;;) {
+    unsigned int wanted = stream_control_update(control, received, now_ms());
+    received = 0;
+    for (unsigned int i = 0; i < max_streams && active < wanted && !unsupported && !stalled; i++) {
+      if (streams[i].range) {
+        continue;
+      }
+      while (next < count && ranges[next].received >= ranges[next].length) {
+        next++;
+      }
+      if (next == count) {
+        break;
+      }
+      //Other downloads may hold the handles for the host, only wait for one while holding none ourselves, the
+      //handles of running streams are only returned while the multi handle is driven.
+      int started = start_stream(multi, &streams[i], url, auth_token, traffic_class, floor, &ranges[next],
+                                 active == 0);
+      if (started > 0) {
+        break;
+      }
+      if (started < 0) {
+        //Let the transfers already running finish, the caller can fetch the rest again.
+        stalled = true;
+        break;
+      }
+      next++;
+      active++;
+    }
+    if (active == 0) {
+      break;
+    }
+
+    gaus_curl_multi_perform(multi, &running_handles);
+    CURLMsg *msg;
+    int messages_left;
+    while ((msg = gaus_curl_multi_info_read(multi, &messages_left))) {
+      if (msg->msg != CURLMSG_DONE) {
+        continue;
+      }
+      range_stream_t *stream = NULL;
+      CURLcode transfer_result = msg->data.result;
+      gaus_curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **) &stream);
+      unsupported = unsupported || stream->unsupported;
+      finish_stream(multi, stream, transfer_result);
+      active--;
+    }
+    if (active > 0) {
+      gaus_curl_multi_wait(multi, NULL, 0, RANGES_WAIT_MS, NULL);
+    }
+  }
+
+  if (unsupported) {
+    result = 1;
+    goto out;
+  }
+  result = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (ranges[i].received < ranges[i].length) {
+      result = -1;
+    }
+  }
+
+  out:
+  if (multi) {
+    gaus_curl_multi_cleanup(multi);
+  }
+  free(streams);
+  return result;
+}
@@ -0,0 +1,62 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_REQUEST_RANGES_H
+#define GAUS_REQUEST_RANGES_H
+
+#include <curl/curl.h>
+#include "request.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A byte range of a resource, see request_get_ranges. */
+typedef struct {
+  curl_off_t offset;    //First byte of the range
+  curl_off_t length;
+  curl_off_t received;  //Bytes of the range handed to the writer so far
+  long status_code;     //Status of the last response for the range, 0 if none was received
+  void *user_data;
+} request_range_t;
+
+/* Receives length bytes of range from byte range->offset + range->received of the resource.  received is advanced
+ * when it returns 0, -1 aborts the transfer of the range. */
+typedef int (*request_range_writer_t)(request_range_t *range, const char *data, size_t length);
+
+/* Picks how many ranges to fetch at the same time from the throughput measured with each count.  It starts with one
+ * stream and adds one more as long as the last one added carried at least half as much as each of the others, so
+ * streams are added while the link has room and dropped again once it is full. */
+typedef struct {
+  unsigned int streams;       //Streams to run now
+  unsigned int max_streams;
+  curl_off_t bytes;           //Received in the current measurement window
+  long long window_start_ms;  //Start of the current window, negative before the first bytes
+  curl_off_t previous_rate;   //Bytes per second measured with one stream less, 0 if there is no measurement
+  unsigned int hold;          //Windows to stay at streams before trying one more, 0 while still trying
+} stream_control_t;
+
+void stream_control_init(stream_control_t *control, unsigned int max_streams);
+
+/* Count bytes received by now_ms, on a monotonic clock, and return the number of streams to run. */
+unsigned int stream_control_update(stream_control_t *control, curl_off_t bytes, long long now_ms);
+
+/* Fetch what is missing of each range of url, the bytes from offset + received, over as many concurrent transfers of
+ * traffic_class as control picks, each aborted once it stays below floor.  Blocks until each incomplete range was
+ * requested once.  Returns 0 if every range is complete, 1 if the server does not support ranges and -1 if some ranges
+ * are still incomplete, fetching them again continues them.  Keeping control for the next call keeps the stream count
+ * it settled on. */
+int request_get_ranges(const char *url, const char *auth_token, request_range_t *ranges, size_t count,
+                       stream_control_t *control, bandwidth_class_t traffic_class,
+                       const request_speed_floor_t *floor, request_range_writer_t writer);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_REQUEST_RANGES_H
@@ -0,0 +1,115 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "response_buffer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define RESPONSE_BUFFER_MIN_CAPACITY 1024
+
+typedef struct {
+  char *data;
+  size_t capacity;
+} spare_buffer_t;
+
+//One spare buffer per thread so requests on different threads never contend for it.  The detached buffer is
+//remembered so response_buffer_free knows its capacity.
+static __thread spare_buffer_t spare;
+static __thread spare_buffer_t detached;
+
+static pthread_key_t spare_key;
+static pthread_once_t spare_key_once = PTHREAD_ONCE_INIT;
+
+static void free_spare(void *unused) {
+  (void) unused;
+  free(spare.data);
+  spare.data = NULL;
+  spare.capacity = 0;
+}
+
+static void create_spare_key(void) {
+  pthread_key_create(&spare_key, free_spare);
+}
+
+static void keep_spare(char *data, size_t capacity) {
+  if (capacity > RESPONSE_BUFFER_MAX_SPARE || capacity <= spare.capacity) {
+    free(data);
+    return;
+  }
+  free(spare.data);
+  spare.data = data;
+  spare.capacity = capacity;
+  //Any non NULL value makes the destructor run when this thread exits.
+  pthread_once(&spare_key_once, create_spare_key);
+  pthread_setspecific(spare_key, &spare);
+}
+
+int response_buffer_reserve(InMemoryResponse *response, size_t size) {
+  if (size <= response->capacity) {
+    return 0;
+  }
+
+  if (!response->data && spare.data && spare.capacity >= size) {
+    response->data = spare.data;
+    response->capacity = spare.capacity;
+    spare.data = NULL;
+    spare.capacity = 0;
+    return 0;
+  }
+
+  size_t capacity = response->capacity < RESPONSE_BUFFER_MIN_CAPACITY ? RESPONSE_BUFFER_MIN_CAPACITY
+                                                                       : response->capacity;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  /* If response->data is NULL, then the call is equivalent to malloc(capacity) */
+  char *data = realloc(response->data, capacity);
+  if (!data) {
+    return -1;
+  }
+  response->data = data;
+  response->capacity = capacity;
+  return 0;
+}
+
+char *response_buffer_detach(InMemoryResponse *response) {
+  char *data = response->data;
+  detached.data = data;
+  detached.capacity = response->capacity;
+  response->data = NULL;
+  response->pos = 0;
+  response->capacity = 0;
+  return data;
+}
+
+void response_buffer_free(char *data) {
+  if (!data) {
+    return;
+  }
+  if (data == detached.data) {
+    detached.data = NULL;
+    keep_spare(data, detached.capacity);
+    return;
+  }
+  free(data);
+}
+
+void response_buffer_release(InMemoryResponse *response) {
+  if (response->data) {
+    keep_spare(response->data, response->capacity);
+  }
+  response->data = NULL;
+  response->pos = 0;
+  response->capacity = 0;
+}
+
+void response_buffer_cleanup(void) {
+  free_spare(NULL);
+}
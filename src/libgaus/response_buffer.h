@@ -0,0 +1,48 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_RESPONSE_BUFFER_H
+#define GAUS_RESPONSE_BUFFER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Buffers up to this size are kept per thread for the next response instead of being freed.
+#define RESPONSE_BUFFER_MAX_SPARE (1024 * 1024)
+//Never preallocate more than this from a Content-Length header, larger bodies grow as they arrive.
+#define RESPONSE_BUFFER_MAX_PREALLOC (64 * 1024 * 1024)
+
+typedef struct InMemoryResponse {
+  char *data;
+  size_t pos;
+  size_t capacity;
+} InMemoryResponse;
+
+/* Make room for at least size bytes, growing geometrically.  An empty response first takes the spare buffer of the
+ * calling thread.  Returns -1 if out of memory, the response is left unchanged in that case. */
+int response_buffer_reserve(InMemoryResponse *response, size_t size);
+
+/* Hand the data of response to a caller that frees it with response_buffer_free on the same thread. */
+char *response_buffer_detach(InMemoryResponse *response);
+
+void response_buffer_free(char *data);
+
+/* Done with the data of response, keep the buffer as the spare of this thread if it is not too large. */
+void response_buffer_release(InMemoryResponse *response);
+
+/* Free the spare buffer of the calling thread. */
+void response_buffer_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_RESPONSE_BUFFER_H
@@ -0,0 +1,105 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "ring_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int ring_buffer_init(ring_buffer_t *ring, size_t size) {
+  memset(ring, 0, sizeof(*ring));
+  if (!(ring->data = malloc(size))) {
+    return -1;
+  }
+  ring->size = size;
+  pthread_mutex_init(&ring->lock, NULL);
+  pthread_cond_init(&ring->not_full, NULL);
+  pthread_cond_init(&ring->not_empty, NULL);
+  return 0;
+}
+
+void ring_buffer_destroy(ring_buffer_t *ring) {
+  if (ring->data) {
+    pthread_cond_destroy(&ring->not_empty);
+    pthread_cond_destroy(&ring->not_full);
+    pthread_mutex_destroy(&ring->lock);
+    free(ring->data);
+    ring->data = NULL;
+  }
+}
+
+int ring_buffer_write(ring_buffer_t *ring, const char *data, size_t length) {
+  pthread_mutex_lock(&ring->lock);
+  while (length > 0) {
+    size_t end;
+    size_t count;
+
+    while (ring->length == ring->size && !ring->aborted) {
+      pthread_cond_wait(&ring->not_full, &ring->lock);
+    }
+    if (ring->aborted) {
+      pthread_mutex_unlock(&ring->lock);
+      return -1;
+    }
+    //Copy up to the end of the free space or of the array, whichever comes first.
+    end = (ring->start + ring->length) % ring->size;
+    count = ring->size - ring->length;
+    if (count > ring->size - end) {
+      count = ring->size - end;
+    }
+    if (count > length) {
+      count = length;
+    }
+    memcpy(ring->data + end, data, count);
+    ring->length += count;
+    data += count;
+    length -= count;
+    pthread_cond_signal(&ring->not_empty);
+  }
+  pthread_mutex_unlock(&ring->lock);
+  return 0;
+}
+
+ssize_t ring_buffer_read(ring_buffer_t *ring, char *data, size_t length) {
+  size_t count;
+
+  pthread_mutex_lock(&ring->lock);
+  while (ring->length == 0 && !ring->closed && !ring->aborted) {
+    pthread_cond_wait(&ring->not_empty, &ring->lock);
+  }
+  if (ring->aborted) {
+    pthread_mutex_unlock(&ring->lock);
+    return -1;
+  }
+  count = ring->length < length ? ring->length : length;
+  if (count > ring->size - ring->start) {
+    count = ring->size - ring->start;
+  }
+  memcpy(data, ring->data + ring->start, count);
+  ring->start = (ring->start + count) % ring->size;
+  ring->length -= count;
+  pthread_cond_signal(&ring->not_full);
+  pthread_mutex_unlock(&ring->lock);
+  return (ssize_t) count;
+}
+
+void ring_buffer_close(ring_buffer_t *ring) {
+  pthread_mutex_lock(&ring->lock);
+  ring->closed = true;
+  pthread_cond_broadcast(&ring->not_empty);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+void ring_buffer_abort(ring_buffer_t *ring) {
+  pthread_mutex_lock(&ring->lock);
+  ring->aborted = true;
+  pthread_cond_broadcast(&ring->not_empty);
+  pthread_cond_broadcast(&ring->not_full);
+  pthread_mutex_unlock(&ring->lock);
+}
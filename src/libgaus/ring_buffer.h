@@ -0,0 +1,56 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_RING_BUFFER_H
+#define GAUS_RING_BUFFER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A bounded byte queue between a writing and a reading thread.  The writer waits while it is full and the reader while
+ * it is empty, so a slow reader holds back the writer instead of letting data pile up in memory. */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t not_full;
+  pthread_cond_t not_empty;
+  char *data;
+  size_t size;
+  size_t start;    //Position of the oldest byte
+  size_t length;   //Bytes waiting to be read
+  bool closed;     //The writer is done, the reader gets what is left and then the end
+  bool aborted;    //One side gave up, both return at once
+} ring_buffer_t;
+
+int ring_buffer_init(ring_buffer_t *ring, size_t size);
+
+void ring_buffer_destroy(ring_buffer_t *ring);
+
+/* Queue all of data, returns -1 if the ring was aborted. */
+int ring_buffer_write(ring_buffer_t *ring, const char *data, size_t length);
+
+/* Wait for data and take up to length bytes.  Returns the bytes taken, 0 at the end once the ring is closed and empty,
+ * or -1 if it was aborted. */
+ssize_t ring_buffer_read(ring_buffer_t *ring, char *data, size_t length);
+
+/* No more data will be written. */
+void ring_buffer_close(ring_buffer_t *ring);
+
+/* Give up, wakes up the other side. */
+void ring_buffer_abort(ring_buffer_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_RING_BUFFER_H
@@ -0,0 +1,73 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "share_cache.h"
+#include "curl_wrapper.h"
+#include "log.h"
+
+#include <pthread.h>
+
+static struct {
+  CURLSH *share;
+  //curl asks for a lock per kind of shared data, so e.g. DNS lookups do not wait on TLS session lookups.
+  pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+} cache;
+
+static void lock_shared_data(CURL *curl, curl_lock_data data, curl_lock_access access, void *userptr) {
+  (void) curl;
+  (void) access;
+  (void) userptr;
+  pthread_mutex_lock(&cache.locks[data]);
+}
+
+static void unlock_shared_data(CURL *curl, curl_lock_data data, void *userptr) {
+  (void) curl;
+  (void) userptr;
+  pthread_mutex_unlock(&cache.locks[data]);
+}
+
+int share_cache_init(void) {
+  if (cache.share) {
+    return 0;
+  }
+
+  if (!(cache.share = gaus_curl_share_init())) {
+    logging(L_WARNING, "share_cache: unable to create shared cache, handles will not share connections");
+    return -1;
+  }
+  for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+    pthread_mutex_init(&cache.locks[i], NULL);
+  }
+  gaus_curl_share_setopt(cache.share, CURLSHOPT_LOCKFUNC, lock_shared_data);
+  gaus_curl_share_setopt(cache.share, CURLSHOPT_UNLOCKFUNC, unlock_shared_data);
+  gaus_curl_share_setopt(cache.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  gaus_curl_share_setopt(cache.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  gaus_curl_share_setopt(cache.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+  return 0;
+}
+
+void share_cache_attach(CURL *curl) {
+  if (cache.share) {
+    gaus_curl_easy_setopt(curl, CURLOPT_SHARE, cache.share);
+  }
+}
+
+void share_cache_cleanup(void) {
+  if (!cache.share) {
+    return;
+  }
+
+  if (gaus_curl_share_cleanup(cache.share) != CURLSHE_OK) {
+    logging(L_WARNING, "share_cache: shared cache still in use during cleanup");
+  }
+  for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+    pthread_mutex_destroy(&cache.locks[i]);
+  }
+  cache.share = NULL;
+}
@@ -0,0 +1,32 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_SHARE_CACHE_H
+#define GAUS_SHARE_CACHE_H
+
+#include <curl/curl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Create the process wide cache of DNS lookups, TLS sessions and connections shared by all handles.  Returns -1 if it
+ * could not be created, handles then each keep their own caches. */
+int share_cache_init(void);
+
+/* Make curl use the shared cache.  Must be set again after curl_easy_reset. */
+void share_cache_attach(CURL *curl);
+
+/* Release the shared cache.  All handles using it must have been cleaned up first. */
+void share_cache_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_SHARE_CACHE_H
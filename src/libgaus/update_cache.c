@@ -0,0 +1,211 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include "update_cache.h"
+#include "log.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char *url;
+  request_validators_t validators;
+  unsigned int update_count;
+  gaus_update_t *updates;
+  unsigned long last_used;
+} update_cache_entry_t;
+
+static struct {
+  pthread_mutex_t lock;
+  update_cache_entry_t entries[UPDATE_CACHE_SIZE];
+  unsigned long use_counter;
+} cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static bool same_string(const char *a, const char *b) {
+  return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+static void free_entry(update_cache_entry_t *entry) {
+  free(entry->url);
+  request_validators_free(&entry->validators);
+  update_free_all(entry->update_count, entry->updates);
+  memset(entry, 0, sizeof(update_cache_entry_t));
+}
+
+/* Must be called with cache.lock held. */
+static update_cache_entry_t *find_entry(const char *url) {
+  for (size_t i = 0; i < UPDATE_CACHE_SIZE; i++) {
+    if (cache.entries[i].url && strcmp(cache.entries[i].url, url) == 0) {
+      return &cache.entries[i];
+    }
+  }
+  return NULL;
+}
+
+static char *dup_or_null(const char *string) {
+  return string ? strdup(string) : NULL;
+}
+
+int update_cache_validators(const char *url, request_validators_t *validators) {
+  int result = -1;
+
+  memset(validators, 0, sizeof(request_validators_t));
+  pthread_mutex_lock(&cache.lock);
+  update_cache_entry_t *entry = find_entry(url);
+  if (entry) {
+    validators->etag = dup_or_null(entry->validators.etag);
+    validators->last_modified = dup_or_null(entry->validators.last_modified);
+    result = 0;
+  }
+  pthread_mutex_unlock(&cache.lock);
+  return result;
+}
+
+int update_cache_get(const char *url, const request_validators_t *validators, unsigned int *update_count,
+                     gaus_update_t **updates) {
+  int result = -1;
+
+  pthread_mutex_lock(&cache.lock);
+  update_cache_entry_t *entry = find_entry(url);
+  if (entry && same_string(entry->validators.etag, validators->etag) &&
+      same_string(entry->validators.last_modified, validators->last_modified) &&
+      update_copy_all(entry->update_count, entry->updates, updates) == 0) {
+    *update_count = entry->update_count;
+    entry->last_used = ++cache.use_counter;
+    result = 0;
+  }
+  pthread_mutex_unlock(&cache.lock);
+  return result;
+}
+
+void update_cache_store(const char *url, const request_validators_t *validators, unsigned int update_count,
+                        const gaus_update_t *updates) {
+  update_cache_entry_t fresh = {0};
+
+  if (!validators->etag && !validators->last_modified) {
+    return;
+  }
+  //Copy outside the lock, the list can be long.
+  if (!(fresh.url = strdup(url)) || update_copy_all(update_count, updates, &fresh.updates) != 0) {
+    logging(L_WARNING, "update_cache: not enough memory to cache %u updates", update_count);
+    free(fresh.url);
+    return;
+  }
+  fresh.update_count = update_count;
+  fresh.validators.etag = dup_or_null(validators->etag);
+  fresh.validators.last_modified = dup_or_null(validators->last_modified);
+
+  pthread_mutex_lock(&cache.lock);
+  update_cache_entry_t *entry = find_entry(url);
+  if (!entry) {
+    //Take a free entry, or the least recently used one.
+    entry = &cache.entries[0];
+    for (size_t i = 0; i < UPDATE_CACHE_SIZE && entry->url; i++) {
+      if (!cache.entries[i].url || cache.entries[i].last_used < entry->last_used) {
+        entry = &cache.entries[i];
+      }
+    }
+  }
+  update_cache_entry_t old = *entry;
+  fresh.last_used = ++cache.use_counter;
+  *entry = fresh;
+  pthread_mutex_unlock(&cache.lock);
+
+  free_entry(&old);
+}
+
+void update_cache_cleanup(void) {
+  pthread_mutex_lock(&cache.lock);
+  for (size_t i = 0; i < UPDATE_CACHE_SIZE; i++) {
+    free_entry(&cache.entries[i]);
+  }
+  cache.use_counter = 0;
+  pthread_mutex_unlock(&cache.lock);
+}
+
+static int copy_update(gaus_update_t *copy, const gaus_update_t *update) {
+  memset(copy, 0, sizeof(gaus_update_t));
+  if (update->metadata_count > 0) {
+    if (!(copy->metadata = calloc(update->metadata_count, sizeof(gaus_key_value_t)))) {
+      return -1;
+    }
+    copy->metadata_count = update->metadata_count;
+    for (unsigned int i = 0; i < update->metadata_count; i++) {
+      if ((update->metadata[i].key && !(copy->metadata[i].key = strdup(update->metadata[i].key))) ||
+          (update->metadata[i].value && !(copy->metadata[i].value = strdup(update->metadata[i].value)))) {
+        return -1;
+      }
+    }
+  }
+  copy->size = update->size;
+  copy->target_size = update->target_size;
+  //Members that are NULL, like md5 of updates that are not files, stay NULL.
+  if ((update->update_type && !(copy->update_type = strdup(update->update_type))) ||
+      (update->package_type && !(copy->package_type = strdup(update->package_type))) ||
+      (update->md5 && !(copy->md5 = strdup(update->md5))) ||
+      (update->update_id && !(copy->update_id = strdup(update->update_id))) ||
+      (update->version && !(copy->version = strdup(update->version))) ||
+      (update->download_url && !(copy->download_url = strdup(update->download_url))) ||
+      (update->base_version && !(copy->base_version = strdup(update->base_version))) ||
+      (update->target_md5 && !(copy->target_md5 = strdup(update->target_md5))) ||
+      (update->chunk_index_url && !(copy->chunk_index_url = strdup(update->chunk_index_url))) ||
+      (update->hash_tree_url && !(copy->hash_tree_url = strdup(update->hash_tree_url))) ||
+      (update->hash_tree_root && !(copy->hash_tree_root = strdup(update->hash_tree_root)))) {
+    return -1;
+  }
+  return 0;
+}
+
+int update_copy_all(unsigned int count, const gaus_update_t *updates, gaus_update_t **copy) {
+  *copy = NULL;
+  if (count == 0) {
+    return 0;
+  }
+  if (!(*copy = calloc(count, sizeof(gaus_update_t)))) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    if (copy_update(&(*copy)[i], &updates[i]) != 0) {
+      update_free_all(count, *copy);
+      *copy = NULL;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void update_free(gaus_update_t *update) {
+  for (unsigned int i = 0; i < update->metadata_count; i++) {
+    free(update->metadata[i].key);
+    free(update->metadata[i].value);
+  }
+  free(update->metadata);
+  free(update->update_type);
+  free(update->package_type);
+  free(update->md5);
+  free(update->update_id);
+  free(update->version);
+  free(update->download_url);
+  free(update->base_version);
+  free(update->target_md5);
+  free(update->chunk_index_url);
+  free(update->hash_tree_url);
+  free(update->hash_tree_root);
+  memset(update, 0, sizeof(gaus_update_t));
+}
+
+void update_free_all(unsigned int count, gaus_update_t *updates) {
+  for (unsigned int i = 0; i < count; i++) {
+    update_free(&updates[i]);
+  }
+  free(updates);
+}
@@ -0,0 +1,49 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef GAUS_UPDATE_CACHE_H
+#define GAUS_UPDATE_CACHE_H
+
+#include "gaus/gaus_client_types.h"
+#include "request.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Number of check-for-updates URLs, i.e. device and filter combinations, whose last reply is remembered.
+#define UPDATE_CACHE_SIZE 8
+
+/* Copy the validators of the cached reply for url into validators.  Returns -1 and leaves validators empty if nothing
+ * is cached for url. */
+int update_cache_validators(const char *url, request_validators_t *validators);
+
+/* Hand a copy of the cached updates for url to the caller, as long as they still match validators.  Returns -1 if
+ * they are no longer cached. */
+int update_cache_get(const char *url, const request_validators_t *validators, unsigned int *update_count,
+                     gaus_update_t **updates);
+
+/* Remember a copy of updates as the reply for url.  Nothing is kept if validators is empty. */
+void update_cache_store(const char *url, const request_validators_t *validators, unsigned int update_count,
+                        const gaus_update_t *updates);
+
+void update_cache_cleanup(void);
+
+/* Deep copy count updates into a new array, returns -1 if out of memory. */
+int update_copy_all(unsigned int count, const gaus_update_t *updates, gaus_update_t **copy);
+
+/* Free the members of update and empty it. */
+void update_free(gaus_update_t *update);
+
+void update_free_all(unsigned int count, gaus_update_t *updates);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //GAUS_UPDATE_CACHE_H
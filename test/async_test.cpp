@@ -0,0 +1,343 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include <gtest/gtest.h>
+#include "gaus/gaus_client.h"
+#include "curl_mock.h"
+
+//Access gaus curl wrapper
+#include "../src/libgaus/curl_wrapper.h"
+#include "../src/libgaus/update_cache.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <condition_variable>
+#include <mutex>
+
+//Collects the results of gaus_*_async callbacks so tests can wait for them.
+class AsyncResults {
+public:
+  std::mutex lock;
+  std::condition_variable completed;
+  std::vector<gaus_error_t *> errors;
+
+  bool waitFor(size_t count) {
+    std::unique_lock<std::mutex> guard(lock);
+    return completed.wait_for(guard, std::chrono::seconds(5), [&] { return errors.size() >= count; });
+  }
+
+  ~AsyncResults() {
+    for (gaus_error_t *error : errors) {
+      if (error) {
+        free(error->description);
+        free(error);
+      }
+    }
+  }
+};
+
+static void collectResult(gaus_error_t *error, void *user_data) {
+  AsyncResults *results = static_cast<AsyncResults *>(user_data);
+  std::lock_guard<std::mutex> guard(results->lock);
+  results->errors.push_back(error);
+  results->completed.notify_all();
+}
+
+class GausAsync : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    setupMocks();
+    resetCurlMockHistory();
+    //Setup a default fake response that will work for all tests.
+    free(fakeResponse);
+    fakeResponse = strdup("{}");
+  }
+
+  virtual void TearDown() {
+    gaus_global_cleanup();
+    cleanupMocks();
+  }
+};
+
+TEST_F(GausAsync, fails_without_initialize) {
+  AsyncResults results;
+  gaus_session_t session;
+
+  gaus_error_t *status = gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &session, collectResult,
+                                                 &results);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_NO_INIT_ERROR, status->error_type);
+  EXPECT_EQ(0, results.errors.size());
+
+  //Cleanup after test
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausAsync, fails_without_callback) {
+  gaus_session_t session;
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &session, NULL, NULL);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_EQ(0, curlPerformData.size());
+
+  //Cleanup after test
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausAsync, registers_device) {
+  AsyncResults results;
+  std::string serverUrl = "fakeServerUrl";
+  gaus_global_init(serverUrl.c_str(), NULL);
+  free(fakeResponse);
+  fakeResponse = strdup("{"
+                        "\"deviceAuthParameters\":{\"accessKey\":\"FAKEACCESS\",\"secretKey\":\"FAKESECRET\"},"
+                        "\"pollIntervalSeconds\":42"
+                        "}");
+
+  char *device_access = NULL;
+  char *device_secret = NULL;
+  unsigned int poll_interval = 0;
+  gaus_error_t *status = gaus_register_async("fakeProductAccess", "fakeProductSecret", "fakeDeviceId",
+                                             &device_access, &device_secret, &poll_interval, collectResult, &results);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_TRUE(results.waitFor(1));
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), results.errors[0]);
+  EXPECT_EQ(curlPerformData[0].CURLOPT_URL, serverUrl + "/register");
+  EXPECT_STREQ("FAKEACCESS", device_access);
+  EXPECT_STREQ("FAKESECRET", device_secret);
+  EXPECT_EQ(42, poll_interval);
+
+  //Cleanup
+  free(device_access);
+  free(device_secret);
+}
+
+TEST_F(GausAsync, authenticates_device) {
+  AsyncResults results;
+  std::string serverUrl = "fakeServerUrl";
+  gaus_global_init(serverUrl.c_str(), NULL);
+  free(fakeResponse);
+  fakeResponse = strdup("{"
+                        "\"deviceGUID\": \"FAKEDEVICEGUID\","
+                        "\"productGUID\":\"FAKEPRODUCTGUID\","
+                        "\"token\": \"FAKETOKEN\""
+                        "}");
+
+  gaus_session_t session;
+  gaus_error_t *status = gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &session, collectResult,
+                                                 &results);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_TRUE(results.waitFor(1));
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), results.errors[0]);
+  EXPECT_EQ(curlPerformData[0].CURLOPT_URL, serverUrl + "/authenticate");
+  EXPECT_STREQ("FAKEDEVICEGUID", session.device_guid);
+  EXPECT_STREQ("FAKEPRODUCTGUID", session.product_guid);
+  EXPECT_STREQ("FAKETOKEN", session.token);
+
+  //Cleanup
+  free(session.device_guid);
+  free(session.product_guid);
+  free(session.token);
+}
+
+TEST_F(GausAsync, checks_for_updates) {
+  AsyncResults results;
+  gaus_global_init("fakeServerUrl", NULL);
+  free(fakeResponse);
+  fakeResponse = strdup("{\"updates\": []}");
+
+  gaus_session_t session = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 1;
+  gaus_update_t *updates = NULL;
+  gaus_error_t *status = gaus_check_for_updates_async(&session, 0, NULL, &updateCount, &updates, collectResult,
+                                                      &results);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_TRUE(results.waitFor(1));
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), results.errors[0]);
+  EXPECT_EQ(curlPerformData[0].CURLOPT_URL,
+            "fakeServerUrl/device/fakeProductGUID/fakeDeviceGUID/check-for-updates");
+  EXPECT_EQ(0, updateCount);
+
+  //Cleanup
+  gaus_updates_free(updateCount, updates);
+  free(session.device_guid);
+  free(session.product_guid);
+  free(session.token);
+}
+
+//Tags the reply with an ETag and answers 304 to requests for it, after evicting it from the update cache.
+static long evictingResponseCode = 200;
+
+static CURLcode mock_curl_easy_perform_evicting_cache(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  curlPerformData.push_back(options);
+  evictingResponseCode = 200;
+  for (std::string &header : options.CURLOPT_HEADER) {
+    if (header == "If-None-Match: \"v1\"") {
+      update_cache_cleanup();
+      evictingResponseCode = 304;
+    }
+  }
+  std::string headers[] = {"HTTP/1.1 " + std::to_string(evictingResponseCode) + " Whatever\r\n",
+                           "ETag: \"v1\"\r\n", "\r\n"};
+  for (std::string &header : headers) {
+    (*options.CURLOPT_HEADERFUNCTION)(&header[0], sizeof(char), header.size(), options.CURLOPT_HEADERDATA);
+  }
+  if (evictingResponseCode == 200) {
+    (*options.CURLOPT_WRITEFUNCTION)(fakeResponse, sizeof(char), strlen(fakeResponse), options.CURLOPT_WRITEDATA);
+  }
+  return CURLE_OK;
+}
+
+static CURLcode mock_curl_easy_getinfo_evicting_cache(CURL *curl, CURLINFO info, ...) {
+  va_list valist;
+  va_start(valist, info);
+  if (info == CURLINFO_RESPONSE_CODE) {
+    *va_arg(valist, long*) = evictingResponseCode;
+  } else if (info == CURLINFO_PRIVATE) {
+    std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+    *va_arg(valist, void**) = allCurlData[curl].setOptions.CURLOPT_PRIVATE;
+  }
+  va_end(valist);
+  return CURLE_OK;
+}
+
+TEST_F(GausAsync, checks_for_updates_again_when_evicted_before_not_modified) {
+  AsyncResults results;
+  gaus_global_init("fakeServerUrl", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_evicting_cache;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_evicting_cache;
+  free(fakeResponse);
+  fakeResponse = strdup("{\"updates\": [{\"metadata\": {}, \"size\": 1, \"updateType\": \"firmware\","
+                        "\"packageType\": \"file\", \"md5\": \"FAKEMD5\", \"updateId\": \"FAKEUPDATEID\","
+                        "\"version\": \"1\", \"downloadUrl\": \"FAKEDOWNLOADURL\"}]}");
+
+  gaus_session_t session = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount[2] = {0, 0};
+  gaus_update_t *updates[2] = {NULL, NULL};
+  for (int i = 0; i < 2; i++) {
+    gaus_error_t *status = gaus_check_for_updates_async(&session, 0, NULL, &updateCount[i], &updates[i],
+                                                        collectResult, &results);
+    ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+    ASSERT_TRUE(results.waitFor(i + 1));
+  }
+
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), results.errors[1]);
+  ASSERT_EQ(3, curlPerformData.size());
+  EXPECT_EQ(curlPerformData[0].CURLOPT_HEADER, curlPerformData[2].CURLOPT_HEADER);
+  ASSERT_EQ(1, updateCount[1]);
+  EXPECT_STREQ("FAKEUPDATEID", updates[1][0].update_id);
+
+  //Cleanup
+  gaus_updates_free(updateCount[0], updates[0]);
+  gaus_updates_free(updateCount[1], updates[1]);
+  free(session.device_guid);
+  free(session.product_guid);
+  free(session.token);
+}
+
+static CURLcode mock_curl_easy_perform_failed(CURL *curl) {
+  return CURLE_COULDNT_CONNECT;
+}
+
+TEST_F(GausAsync, reports_errors_through_callback) {
+  AsyncResults results;
+  gaus_global_init("fakeServerUrl", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_failed;
+
+  gaus_session_t session;
+  gaus_error_t *status = gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &session, collectResult,
+                                                 &results);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_TRUE(results.waitFor(1));
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), results.errors[0]);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, results.errors[0]->error_type);
+  EXPECT_EQ(500, results.errors[0]->http_error_code);
+}
+
+TEST_F(GausAsync, sends_many_reports_concurrently) {
+  AsyncResults results;
+  const unsigned int requestCount = 50;
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_session_t session = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  gaus_report_header_t header = {
+      strdup("FAKE_TIMESTAMP")
+  };
+  gaus_report_t report = {};
+  report.report_type = GAUS_REPORT_UPDATE;
+  report.report.update_status.type = strdup("Status");
+  report.report.update_status.ts = strdup("FAKE_TIME");
+
+  for (unsigned int i = 0; i < requestCount; i++) {
+    gaus_error_t *status = gaus_report_async(&session, 0, NULL, &header, 1, &report, collectResult, &results);
+    ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  }
+  //Inputs are copied when queued, freeing them early must be safe.
+  free(report.report.update_status.type);
+  free(report.report.update_status.ts);
+  free(header.ts);
+
+  ASSERT_TRUE(results.waitFor(requestCount));
+  for (gaus_error_t *error : results.errors) {
+    EXPECT_EQ(static_cast<gaus_error_t *>(NULL), error);
+  }
+  EXPECT_EQ(requestCount, curlPerformData.size());
+  EXPECT_NE(std::string::npos, curlPerformData[0].CURLOPT_POSTFIELDS.find("\"header\":{"));
+
+  //Cleanup
+  free(session.device_guid);
+  free(session.product_guid);
+  free(session.token);
+}
+
+TEST_F(GausAsync, cleanup_completes_outstanding_calls) {
+  AsyncResults results;
+  const unsigned int requestCount = 10;
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_session_t sessions[requestCount];
+  for (unsigned int i = 0; i < requestCount; i++) {
+    gaus_error_t *status = gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &sessions[i],
+                                                   collectResult, &results);
+    ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  }
+  gaus_global_cleanup();
+
+  //Every callback has run once cleanup returns, either finished or aborted.
+  EXPECT_EQ(requestCount, results.errors.size());
+  for (unsigned int i = 0; i < requestCount; i++) {
+    free(sessions[i].device_guid);
+    free(sessions[i].product_guid);
+    free(sessions[i].token);
+  }
+}
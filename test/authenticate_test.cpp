@@ -462,6 +462,48 @@ TEST_F(GausAuthenticate, does_not_use_proxy_if_null) {
 }
 
 
+TEST_F(GausAuthenticate, uses_server_and_proxy_of_client) {
+  std::string serverUrl = "fakeServerUrl";
+  std::string clientServerUrl = "otherServerUrl";
+  std::string fakeProxy = "fakeProxy";
+  gaus_session_t session = {};
+  gaus_session_t clientSession = {};
+  gaus_client_t *client = NULL;
+  gaus_client_stats_t stats;
+  gaus_initialization_options_t options = {
+      fakeProxy.c_str()
+  };
+
+  gaus_global_init(serverUrl.c_str(), NULL);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_client_create(clientServerUrl.c_str(), &options, &client));
+
+  gaus_error_t *status = gaus_client_authenticate(client, "fakeDeviceAccess", "fakeDeviceSecret", &clientSession);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  //The client is only used for calls made through it.
+  status = gaus_authenticate("fakeDeviceAccess", "fakeDeviceSecret", &session);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(curlPerformData[0].CURLOPT_URL, clientServerUrl + "/authenticate");
+  EXPECT_EQ(fakeProxy, curlPerformData[0].CURLOPT_PROXY);
+  EXPECT_EQ(curlPerformData[1].CURLOPT_URL, serverUrl + "/authenticate");
+  EXPECT_EQ(MOCK_NOT_SET, curlPerformData[1].CURLOPT_PROXY);
+  gaus_client_get_stats(client, &stats);
+  EXPECT_EQ(1, stats.requests);
+  gaus_client_get_stats(NULL, &stats);
+  EXPECT_EQ(1, stats.requests);
+
+  //Cleanup after test
+  gaus_client_destroy(client);
+  free(clientSession.device_guid);
+  free(clientSession.product_guid);
+  free(clientSession.token);
+  free(session.device_guid);
+  free(session.product_guid);
+  free(session.token);
+}
+
+
 TEST_F(GausAuthenticate, has_correct_version_in_header) {
   std::string serverUrl = "fakeServerUrl";
   gaus_session_t session;
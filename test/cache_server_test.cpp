@@ -0,0 +1,142 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include <gtest/gtest.h>
+#include "gaus/gaus_client.h"
+
+#include <arpa/inet.h>
+#include <fstream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const std::string fakePackage = "0123456789abcdefghijklmnopqrstuvwxyz";
+static const std::string fakePackageMd5 = "e9b1713db620f1e3a14b6812de523f4b";
+
+class GausCacheServer : public ::testing::Test {
+protected:
+  std::string cachePath;
+  gaus_cache_server_t *server = nullptr;
+
+  virtual void SetUp() {
+    cachePath = ::testing::TempDir() + "gaus_cache_server_test";
+    mkdir(cachePath.c_str(), 0755);
+    std::ofstream(cachePath + "/" + fakePackageMd5, std::ios::binary) << fakePackage;
+
+    gaus_cache_server_options_t options = {};
+    options.cache_path = cachePath.c_str();
+    options.address = "127.0.0.1";
+    ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_cache_server_start(&options, &server));
+  }
+
+  virtual void TearDown() {
+    gaus_cache_server_stop(server);
+    unlink((cachePath + "/" + fakePackageMd5).c_str());
+    rmdir(cachePath.c_str());
+  }
+
+  //Send requests on one connection and read the answers until the server closes it.
+  std::string fetch(const std::string &requests) {
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(gaus_cache_server_port(server));
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_EQ(0, connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+    EXPECT_EQ(static_cast<ssize_t>(requests.size()), send(fd, requests.data(), requests.size(), 0));
+    std::string answers;
+    char buffer[4096];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      answers.append(buffer, received);
+    }
+    close(fd);
+    return answers;
+  }
+};
+
+static std::string get(const std::string &target, const std::string &headers = "") {
+  return "GET " + target + " HTTP/1.1\r\nHost: gateway\r\n" + headers + "Connection: close\r\n\r\n";
+}
+
+TEST_F(GausCacheServer, serves_cached_package) {
+  std::string answer = fetch(get("/" + fakePackageMd5));
+
+  EXPECT_EQ(0, answer.find("HTTP/1.1 200 OK\r\n"));
+  EXPECT_NE(std::string::npos, answer.find("Content-Length: 36\r\n"));
+  EXPECT_EQ("\r\n\r\n" + fakePackage, answer.substr(answer.size() - fakePackage.size() - 4));
+}
+
+TEST_F(GausCacheServer, finds_package_by_uppercase_md5) {
+  std::string upper = fakePackageMd5;
+  for (char &c : upper) {
+    c = static_cast<char>(toupper(c));
+  }
+
+  EXPECT_EQ(0, fetch(get("/" + upper)).find("HTTP/1.1 200 OK\r\n"));
+}
+
+TEST_F(GausCacheServer, serves_ranges) {
+  std::string answer = fetch(get("/" + fakePackageMd5, "Range: bytes=10-19\r\n"));
+
+  EXPECT_EQ(0, answer.find("HTTP/1.1 206 Partial Content\r\n"));
+  EXPECT_NE(std::string::npos, answer.find("Content-Range: bytes 10-19/36\r\n"));
+  EXPECT_EQ("\r\n\r\nabcdefghij", answer.substr(answer.size() - 14));
+
+  answer = fetch(get("/" + fakePackageMd5, "Range: bytes=30-\r\n"));
+  EXPECT_EQ("\r\n\r\nuvwxyz", answer.substr(answer.size() - 10));
+
+  answer = fetch(get("/" + fakePackageMd5, "Range: bytes=-4\r\n"));
+  EXPECT_EQ("\r\n\r\nwxyz", answer.substr(answer.size() - 8));
+}
+
+TEST_F(GausCacheServer, refuses_ranges_past_the_end) {
+  std::string answer = fetch(get("/" + fakePackageMd5, "Range: bytes=36-\r\n"));
+
+  EXPECT_EQ(0, answer.find("HTTP/1.1 416 Range Not Satisfiable\r\n"));
+  EXPECT_NE(std::string::npos, answer.find("Content-Range: bytes */36\r\n"));
+}
+
+TEST_F(GausCacheServer, answers_several_requests_on_one_connection) {
+  std::string first = "HEAD /" + fakePackageMd5 + " HTTP/1.1\r\nHost: gateway\r\n\r\n";
+
+  std::string answers = fetch(first + get("/" + fakePackageMd5));
+
+  EXPECT_EQ(0, answers.find("HTTP/1.1 200 OK\r\n"));
+  size_t second = answers.find("HTTP/1.1 200 OK\r\n", 1);
+  ASSERT_NE(std::string::npos, second);
+  //The answer to HEAD has no body
+  EXPECT_EQ("\r\n\r\n", answers.substr(second - 4, 4));
+  EXPECT_EQ(fakePackage, answers.substr(answers.size() - fakePackage.size()));
+}
+
+TEST_F(GausCacheServer, answers_not_found_for_other_packages) {
+  EXPECT_EQ(0, fetch(get("/00000000000000000000000000000000")).find("HTTP/1.1 404 Not Found\r\n"));
+  EXPECT_EQ(0, fetch(get("/../etc/passwd")).find("HTTP/1.1 404 Not Found\r\n"));
+}
+
+TEST_F(GausCacheServer, refuses_other_methods) {
+  std::string request = "DELETE /" + fakePackageMd5 + " HTTP/1.1\r\nConnection: close\r\n\r\n";
+
+  EXPECT_EQ(0, fetch(request).find("HTTP/1.1 405 Method Not Allowed\r\n"));
+  EXPECT_TRUE(std::ifstream(cachePath + "/" + fakePackageMd5).good());
+}
+
+TEST(GausCacheServerStart, fails_without_cache_path) {
+  gaus_cache_server_t *server = nullptr;
+  gaus_cache_server_options_t options = {};
+
+  gaus_error_t *status = gaus_cache_server_start(&options, &server);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  free(status->description);
+  free(status);
+}
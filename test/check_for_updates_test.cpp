@@ -13,6 +13,7 @@
 
 //Access gaus curl wrapper
 #include "../src/libgaus/curl_wrapper.h"
+#include "../src/libgaus/update_cache.h"
 
 #include <cstdarg>
 
@@ -39,10 +40,6 @@ protected:
   }
 };
 
-static void freeUpdates(unsigned int updateCount, gaus_update_t **updates);
-
-static void freeUpdate(gaus_update_t *update);
-
 TEST_F(GausCheckForUpdates, fails_without_initialize) {
   gaus_session_t fakeSession = {
       strdup("fakeDeviceGUID"),
@@ -457,6 +454,34 @@ TEST_F(GausCheckForUpdates, handles_errors_on_perform_with_status_400) {
   free(status);
 }
 
+TEST_F(GausCheckForUpdates, reports_http_error_when_error_page_aborts_parsing) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  free(fakeResponse);
+  fakeResponse = strdup("<html><body>Internal Server Error</body></html>");
+  gaus_global_init("fakeServerUrl", NULL);
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_return_500;
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_HTTP_ERROR, status->error_type);
+  EXPECT_EQ(500, status->http_error_code);
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+  free(status->description);
+  free(status);
+}
+
 
 TEST_F(GausCheckForUpdates, retreives_no_updates_correctly_from_server) {
   std::string serverUrl = "fakeServerUrl";
@@ -488,29 +513,6 @@ TEST_F(GausCheckForUpdates, retreives_no_updates_correctly_from_server) {
   free(status);
 }
 
-static void freeUpdate(gaus_update_t update) {
-  for (int i = 0; i < update.metadata_count; i++) {
-    free(update.metadata[i].key);
-    free(update.metadata[i].value);
-  }
-  update.metadata_count = 0;
-  update.size = 0;
-  free(update.metadata);
-  free(update.update_type);
-  free(update.package_type);
-  free(update.md5);
-  free(update.update_id);
-  free(update.version);
-  free(update.download_url);
-}
-
-static void freeUpdates(unsigned int updateCount, gaus_update_t **updates) {
-  for (int i = 0; i < updateCount; i++) {
-    freeUpdate((*updates)[i]);
-  }
-  free(*updates);
-}
-
 TEST_F(GausCheckForUpdates, retreives_one_updates_correctly_from_server) {
   std::string serverUrl = "fakeServerUrl";
   std::string fakeDeviceGuid = "fakeDeviceGUID";
@@ -578,7 +580,7 @@ TEST_F(GausCheckForUpdates, retreives_one_updates_correctly_from_server) {
   EXPECT_EQ(updates[0].download_url, fakeDownloadUrl);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
@@ -682,7 +684,7 @@ TEST_F(GausCheckForUpdates, retreives_two_updates_correctly_from_server) {
   EXPECT_EQ(updates[1].version, fakeVersion2);
   EXPECT_EQ(updates[1].download_url, fakeDownloadUrl2);
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
@@ -758,7 +760,7 @@ TEST_F(GausCheckForUpdates, handles_multiple_metadata_correctly) {
   EXPECT_EQ(metaKeys[fakeMetaKey2], fakeMetaValue2);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
@@ -825,7 +827,7 @@ TEST_F(GausCheckForUpdates, handles_missing_update_type) {
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(status->description);
   free(status);
 }
@@ -889,7 +891,7 @@ TEST_F(GausCheckForUpdates, handles_missing_package_type) {
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(status->description);
   free(status);
 }
@@ -953,7 +955,7 @@ TEST_F(GausCheckForUpdates, handles_missing_md5) {
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(status->description);
   free(status);
 }
@@ -1017,7 +1019,7 @@ TEST_F(GausCheckForUpdates, handles_missing_updateId) {
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(status->description);
   free(status);
 }
@@ -1081,7 +1083,7 @@ TEST_F(GausCheckForUpdates, handles_missing_version) {
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(status->description);
   free(status);
 }
@@ -1145,7 +1147,7 @@ TEST_F(GausCheckForUpdates, handles_missing_download_url) {
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(status->description);
   free(status);
 }
@@ -1206,7 +1208,7 @@ TEST_F(GausCheckForUpdates, handles_missing_meta_data) {
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(status->description);
   free(status);
 }
@@ -1246,7 +1248,7 @@ TEST_F(GausCheckForUpdates, handles_malformed_json_from_server) {
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(status->description);
   free(status);
 }
@@ -1280,7 +1282,7 @@ TEST_F(GausCheckForUpdates, handles_one_filter_correctly) {
   EXPECT_EQ(curlPerformData[0].CURLOPT_HTTPGET, 1L);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(filters[0].filter_name);
   free(filters[0].filter_value);
   free(fakeSession.device_guid);
@@ -1326,7 +1328,7 @@ TEST_F(GausCheckForUpdates, handles_several_filter_correctly) {
   EXPECT_EQ(curlPerformData[0].CURLOPT_HTTPGET, 1L);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   for (int i = 0; i < filterCount; i++) {
     free(filters[i].filter_name);
     free(filters[i].filter_value);
@@ -1399,7 +1401,7 @@ TEST_F(GausCheckForUpdates, uses_proxy_from_init) {
   EXPECT_EQ(fakeProxy, curlPerformData[0].CURLOPT_PROXY);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
@@ -1470,7 +1472,7 @@ TEST_F(GausCheckForUpdates, uses_ca_cert_from_init) {
   EXPECT_EQ(fakeCAPath, curlPerformData[0].CURLOPT_CAPATH);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
@@ -1538,7 +1540,7 @@ TEST_F(GausCheckForUpdates, does_not_use_proxy_if_null) {
   EXPECT_EQ(MOCK_NOT_SET, curlPerformData[0].CURLOPT_PROXY);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
@@ -1612,7 +1614,7 @@ TEST_F(GausCheckForUpdates, handles_really_long_tokens) {
   EXPECT_EQ(updates[0].download_url, fakeDownloadUrl);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
@@ -1677,7 +1679,7 @@ TEST_F(GausCheckForUpdates, gets_a_nul_for_missing_things_if_not_file_type) {
   EXPECT_EQ(updates[0].download_url, static_cast<char *>(NULL));
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(fakeSession.device_guid);
   free(fakeSession.product_guid);
   free(fakeSession.token);
@@ -1762,6 +1764,745 @@ TEST_F(GausCheckForUpdates, works_with_very_long_url) {
     free(status);
 }
 
+TEST_F(GausCheckForUpdates, reuses_connection_between_requests) {
+  std::string serverUrl = "fakeServerUrl";
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  gaus_global_init(serverUrl.c_str(), NULL);
+
+  gaus_error_t *firstStatus = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+  gaus_error_t *secondStatus = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), firstStatus);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), secondStatus);
+  ASSERT_EQ(2, curlPerformHandles.size());
+  EXPECT_EQ(curlPerformHandles[0], curlPerformHandles[1]);
+  //Options from the first request must not leak into the second one
+  EXPECT_EQ(curlPerformData[0].CURLOPT_HEADER.size(), curlPerformData[1].CURLOPT_HEADER.size());
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, retrieves_a_large_update_list) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  const unsigned int fakeUpdateCount = 2000; //Several hundred kB, delivered in many chunks
+  std::string fakeManyUpdatesResponse = "{\"updates\":[";
+  for (unsigned int i = 0; i < fakeUpdateCount; i++) {
+    fakeManyUpdatesResponse += std::string(i ? "," : "") +
+                               "{" +
+                               "\"metadata\": {\"FAKEMETAKEY\": \"FAKEMETAVALUE\"}," +
+                               "\"size\": " + std::to_string(i + 1) + "," +
+                               "\"updateType\": \"firmware\"," +
+                               "\"packageType\": \"file\"," +
+                               "\"md5\": \"FAKEMD5\"," +
+                               "\"updateId\": \"FAKEUPDATEID" + std::to_string(i) + "\"," +
+                               "\"version\": \"FAKEVERSION\"," +
+                               "\"downloadUrl\": \"FAKEDOWNLOADURL\"" +
+                               "}";
+  }
+  fakeManyUpdatesResponse += "]}";
+  ASSERT_GT(fakeManyUpdatesResponse.size(), 10 * CURL_MAX_WRITE_SIZE);
+  free(fakeResponse);
+  fakeResponse = strdup(fakeManyUpdatesResponse.c_str());
+
+  gaus_global_init("fakeServerUrl", NULL);
+
+  //Twice, so nothing is left over from the first response
+  for (int attempt = 0; attempt < 2; attempt++) {
+    unsigned int updateCount = 0;
+    gaus_update_t *updates = NULL;
+
+    gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+    ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+    ASSERT_EQ(fakeUpdateCount, updateCount);
+    EXPECT_EQ(std::string("FAKEUPDATEID0"), updates[0].update_id);
+    EXPECT_EQ(fakeUpdateCount, updates[fakeUpdateCount - 1].size);
+    EXPECT_EQ("FAKEUPDATEID" + std::to_string(fakeUpdateCount - 1), updates[fakeUpdateCount - 1].update_id);
+    gaus_updates_free(updateCount, updates);
+  }
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+//Like mock_curl_easy_perform, but split the body into single bytes so every token crosses a write boundary.
+static CURLcode mock_curl_easy_perform_one_byte_at_a_time(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  curlPerformData.push_back(allCurlData[curl].setOptions);
+  curlPerformHandles.push_back(curl);
+  write_function_t writeFunction = allCurlData[curl].setOptions.CURLOPT_WRITEFUNCTION;
+  void *writeData = allCurlData[curl].setOptions.CURLOPT_WRITEDATA;
+  for (size_t offset = 0; fakeResponse[offset]; offset++) {
+    (*writeFunction)(fakeResponse + offset, sizeof(char), 1, writeData);
+  }
+  return CURLE_OK;
+}
+
+TEST_F(GausCheckForUpdates, parses_a_reply_split_inside_tokens) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  free(fakeResponse);
+  fakeResponse = strdup(
+      "{\"unknown\": {\"nested\": [1.5e3, true, null, {\"updates\": 5}]},\n"
+      " \"updates\": [\n"
+      "  {\"metadata\": {\"k\\u00e9y\": \"tab\\there \\\"quoted\\\" \\ud83d\\ude80\", \"empty\": \"\"},\n"
+      "   \"size\": 4096, \"updateType\": \"firmware\", \"packageType\": \"file\", \"md5\": \"FAKEMD5\",\n"
+      "   \"updateId\": \"FAKEUPDATEID\", \"version\": \"1.0\\/2\", \"downloadUrl\": \"FAKEDOWNLOADURL\",\n"
+      "   \"extra\": [[{\"metadata\": 1}]]},\n"
+      "  {\"metadata\": {}, \"updateType\": \"config\", \"packageType\": \"other\", \"updateId\": \"SECONDID\",\n"
+      "   \"version\": \"2\"}\n"
+      " ]}");
+  gaus_global_init("fakeServerUrl", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_one_byte_at_a_time;
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, updateCount);
+  ASSERT_EQ(2, updates[0].metadata_count);
+  EXPECT_EQ(std::string("k\xc3\xa9y"), updates[0].metadata[0].key);
+  EXPECT_EQ(std::string("tab\there \"quoted\" \xf0\x9f\x9a\x80"), updates[0].metadata[0].value);
+  EXPECT_EQ(std::string("empty"), updates[0].metadata[1].key);
+  EXPECT_EQ(std::string(""), updates[0].metadata[1].value);
+  EXPECT_EQ(4096, updates[0].size);
+  EXPECT_EQ(std::string("1.0/2"), updates[0].version);
+  EXPECT_EQ(std::string("FAKEDOWNLOADURL"), updates[0].download_url);
+  //Updates of other package types no longer stop the updates after them from being read
+  EXPECT_EQ(0, updates[1].metadata_count);
+  EXPECT_EQ(std::string("SECONDID"), updates[1].update_id);
+  EXPECT_EQ(static_cast<char *>(NULL), updates[1].download_url);
+
+  //Cleanup after test
+  gaus_updates_free(updateCount, updates);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+static const char *twoUpdatesReply =
+    "{\"updates\": [\n"
+    "  {\"metadata\": {\"key\": \"value\"}, \"size\": 4096, \"updateType\": \"firmware\",\n"
+    "   \"packageType\": \"file\", \"md5\": \"FAKEMD5\", \"updateId\": \"FAKEUPDATEID\", \"version\": \"1.0\",\n"
+    "   \"downloadUrl\": \"FAKEDOWNLOADURL\"},\n"
+    "  {\"metadata\": {}, \"updateType\": \"config\", \"packageType\": \"other\", \"updateId\": \"SECONDID\",\n"
+    "   \"version\": \"2\"}\n"
+    " ]}";
+
+struct StreamedUpdates {
+  std::vector<std::string> updateIds;
+  std::vector<std::string> metadataValues;
+  size_t stopAfter = 0;
+};
+
+static int collectStreamedUpdate(const gaus_update_t *update, void *user_data) {
+  StreamedUpdates *streamed = static_cast<StreamedUpdates *>(user_data);
+  streamed->updateIds.push_back(update->update_id);
+  for (unsigned int i = 0; i < update->metadata_count; i++) {
+    streamed->metadataValues.push_back(update->metadata[i].value);
+  }
+  return streamed->updateIds.size() == streamed->stopAfter ? 1 : 0;
+}
+
+TEST_F(GausCheckForUpdates, streams_each_update_to_callback) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  StreamedUpdates streamed;
+
+  free(fakeResponse);
+  fakeResponse = strdup(twoUpdatesReply);
+  gaus_global_init("fakeServerUrl", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_one_byte_at_a_time;
+
+  gaus_error_t *status = gaus_check_for_updates_streamed(&fakeSession, 0, NULL, collectStreamedUpdate, &streamed);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(std::vector<std::string>({"FAKEUPDATEID", "SECONDID"}), streamed.updateIds);
+  EXPECT_EQ(std::vector<std::string>({"value"}), streamed.metadataValues);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(curlPerformData[0].CURLOPT_URL,
+            "fakeServerUrl/device/fakeProductGUID/fakeDeviceGUID/check-for-updates");
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, stops_streaming_when_callback_asks) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  StreamedUpdates streamed;
+  streamed.stopAfter = 1;
+
+  free(fakeResponse);
+  fakeResponse = strdup(twoUpdatesReply);
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_check_for_updates_streamed(&fakeSession, 0, NULL, collectStreamedUpdate, &streamed);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_STREQ("Check for updates stopped by the callback", status->description);
+  EXPECT_EQ(std::vector<std::string>({"FAKEUPDATEID"}), streamed.updateIds);
+
+  //Cleanup after test
+  free(status->description);
+  free(status);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, streamed_fails_without_callback) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_check_for_updates_streamed(&fakeSession, 0, NULL, NULL, NULL);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_EQ(0, curlPerformData.size());
+
+  //Cleanup after test
+  free(status->description);
+  free(status);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, handles_truncated_json_from_server) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  free(fakeResponse);
+  fakeResponse = strdup("{\"updates\": [{\"metadata\": {}, \"updateType\": \"firm");
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_EQ(500, status->http_error_code);
+  EXPECT_EQ(0, updateCount);
+  EXPECT_EQ(static_cast<gaus_update_t *>(NULL), updates);
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausCheckForUpdates, parses_delta_updates) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  free(fakeResponse);
+  fakeResponse = strdup(
+      "{\"updates\": [\n"
+      "  {\"metadata\": {}, \"size\": 512, \"updateType\": \"firmware\", \"packageType\": \"delta\",\n"
+      "   \"md5\": \"PATCHMD5\", \"updateId\": \"DELTAID\", \"version\": \"2.0\", \"downloadUrl\": \"PATCHURL\",\n"
+      "   \"baseVersion\": \"1.0\", \"targetSize\": 4096, \"targetMd5\": \"TARGETMD5\"},\n"
+      "  {\"metadata\": {}, \"size\": 4096, \"updateType\": \"firmware\", \"packageType\": \"file\",\n"
+      "   \"md5\": \"FILEMD5\", \"updateId\": \"FILEID\", \"version\": \"2.0\", \"downloadUrl\": \"FILEURL\",\n"
+      "   \"baseVersion\": \"1.0\", \"targetSize\": 4096, \"targetMd5\": \"TARGETMD5\"}\n"
+      "]}");
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, updateCount);
+  EXPECT_EQ(std::string("delta"), updates[0].package_type);
+  EXPECT_EQ(512, updates[0].size);
+  EXPECT_EQ(std::string("PATCHMD5"), updates[0].md5);
+  EXPECT_EQ(std::string("PATCHURL"), updates[0].download_url);
+  EXPECT_EQ(std::string("1.0"), updates[0].base_version);
+  EXPECT_EQ(4096, updates[0].target_size);
+  EXPECT_EQ(std::string("TARGETMD5"), updates[0].target_md5);
+  //Only delta packages have a base
+  EXPECT_EQ(static_cast<char *>(NULL), updates[1].base_version);
+  EXPECT_EQ(0, updates[1].target_size);
+  EXPECT_EQ(static_cast<char *>(NULL), updates[1].target_md5);
+
+  //Cleanup after test
+  gaus_updates_free(updateCount, updates);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, fails_on_delta_update_without_base_version) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  free(fakeResponse);
+  fakeResponse = strdup(
+      "{\"updates\": [{\"metadata\": {}, \"size\": 512, \"updateType\": \"firmware\", \"packageType\": \"delta\",\n"
+      " \"md5\": \"PATCHMD5\", \"updateId\": \"DELTAID\", \"version\": \"2.0\", \"downloadUrl\": \"PATCHURL\",\n"
+      " \"targetSize\": 4096, \"targetMd5\": \"TARGETMD5\"}]}");
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_NE(std::string::npos, std::string(status->description).find("baseVersion"));
+  EXPECT_EQ(static_cast<gaus_update_t *>(NULL), updates);
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausCheckForUpdates, parses_chunk_index_url_of_file_updates) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  free(fakeResponse);
+  fakeResponse = strdup(
+      "{\"updates\": [\n"
+      "  {\"metadata\": {}, \"size\": 4096, \"updateType\": \"firmware\", \"packageType\": \"file\",\n"
+      "   \"md5\": \"FILEMD5\", \"updateId\": \"FILEID\", \"version\": \"2.0\", \"downloadUrl\": \"FILEURL\",\n"
+      "   \"chunkIndexUrl\": \"INDEXURL\"},\n"
+      "  {\"metadata\": {}, \"size\": 512, \"updateType\": \"firmware\", \"packageType\": \"delta\",\n"
+      "   \"md5\": \"PATCHMD5\", \"updateId\": \"DELTAID\", \"version\": \"2.0\", \"downloadUrl\": \"PATCHURL\",\n"
+      "   \"baseVersion\": \"1.0\", \"targetSize\": 4096, \"targetMd5\": \"TARGETMD5\",\n"
+      "   \"chunkIndexUrl\": \"INDEXURL\"}\n"
+      "]}");
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, updateCount);
+  EXPECT_EQ(std::string("INDEXURL"), updates[0].chunk_index_url);
+  //Only file packages are split into chunks
+  EXPECT_EQ(static_cast<char *>(NULL), updates[1].chunk_index_url);
+
+  //Cleanup after test
+  gaus_updates_free(updateCount, updates);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, parses_hash_tree_of_file_updates) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  free(fakeResponse);
+  fakeResponse = strdup(
+      "{\"updates\": [\n"
+      "  {\"metadata\": {}, \"size\": 4096, \"updateType\": \"firmware\", \"packageType\": \"file\",\n"
+      "   \"md5\": \"FILEMD5\", \"updateId\": \"FILEID\", \"version\": \"2.0\", \"downloadUrl\": \"FILEURL\",\n"
+      "   \"hashTreeUrl\": \"TREEURL\", \"hashTreeRoot\": \"TREEROOT\"},\n"
+      "  {\"metadata\": {}, \"size\": 512, \"updateType\": \"firmware\", \"packageType\": \"delta\",\n"
+      "   \"md5\": \"PATCHMD5\", \"updateId\": \"DELTAID\", \"version\": \"2.0\", \"downloadUrl\": \"PATCHURL\",\n"
+      "   \"baseVersion\": \"1.0\", \"targetSize\": 4096, \"targetMd5\": \"TARGETMD5\",\n"
+      "   \"hashTreeUrl\": \"TREEURL\", \"hashTreeRoot\": \"TREEROOT\"}\n"
+      "]}");
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, updateCount);
+  EXPECT_EQ(std::string("TREEURL"), updates[0].hash_tree_url);
+  EXPECT_EQ(std::string("TREEROOT"), updates[0].hash_tree_root);
+  //Only file packages are checked chunk by chunk
+  EXPECT_EQ(static_cast<char *>(NULL), updates[1].hash_tree_url);
+  EXPECT_EQ(static_cast<char *>(NULL), updates[1].hash_tree_root);
+
+  //Cleanup after test
+  gaus_updates_free(updateCount, updates);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+//A server that tags its reply with fakeEtag and answers 304 if the request already has that version.
+static std::string fakeEtag;
+static long fakeResponseCode = 200;
+
+static CURLcode mock_curl_easy_perform_with_etag(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  curlPerformData.push_back(options);
+  curlPerformHandles.push_back(curl);
+  fakeResponseCode = 200;
+  for (std::string &header : options.CURLOPT_HEADER) {
+    if (header == "If-None-Match: " + fakeEtag) {
+      fakeResponseCode = 304;
+    }
+  }
+  std::string headers[] = {"HTTP/1.1 " + std::to_string(fakeResponseCode) + " Whatever\r\n",
+                           "ETag: " + fakeEtag + "\r\n",
+                           "Last-Modified: Wed, 21 Oct 2015 07:28:00 GMT\r\n",
+                           "\r\n"};
+  for (std::string &header : headers) {
+    (*options.CURLOPT_HEADERFUNCTION)(&header[0], sizeof(char), header.size(), options.CURLOPT_HEADERDATA);
+  }
+  if (fakeResponseCode == 200) {
+    (*options.CURLOPT_WRITEFUNCTION)(fakeResponse, sizeof(char), strlen(fakeResponse), options.CURLOPT_WRITEDATA);
+  }
+  return CURLE_OK;
+}
+
+static CURLcode mock_curl_easy_getinfo_with_etag(CURL *curl, CURLINFO info, ...) {
+  va_list valist;
+  va_start(valist, info);
+  if (info == CURLINFO_RESPONSE_CODE) {
+    *va_arg(valist, long*) = fakeResponseCode;
+  }
+  va_end(valist);
+  return CURLE_OK;
+}
+
+static std::string oneUpdateResponse(const std::string &updateId) {
+  return "{\"updates\":[{\"metadata\": {}, \"size\": 1, \"updateType\": \"firmware\", \"packageType\": \"file\","
+         "\"md5\": \"FAKEMD5\", \"updateId\": \"" + updateId + "\", \"version\": \"1\","
+         "\"downloadUrl\": \"FAKEDOWNLOADURL\"}]}";
+}
+
+TEST_F(GausCheckForUpdates, answers_unmodified_updates_from_cache) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int firstCount = 0;
+  gaus_update_t *firstUpdates = NULL;
+  unsigned int secondCount = 0;
+  gaus_update_t *secondUpdates = NULL;
+
+  fakeEtag = "\"v1\"";
+  free(fakeResponse);
+  fakeResponse = strdup(oneUpdateResponse("FIRSTID").c_str());
+  gaus_global_init("fakeServerUrl", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_etag;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_etag;
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL),
+            gaus_check_for_updates(&fakeSession, 0, NULL, &firstCount, &firstUpdates));
+  //Would not parse, but is never sent
+  free(fakeResponse);
+  fakeResponse = strdup("not json");
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL),
+            gaus_check_for_updates(&fakeSession, 0, NULL, &secondCount, &secondUpdates));
+
+  ASSERT_EQ(2, curlPerformData.size());
+  std::vector<std::string> &conditionalHeaders = curlPerformData[1].CURLOPT_HEADER;
+  EXPECT_NE(conditionalHeaders.end(), std::find(conditionalHeaders.begin(), conditionalHeaders.end(),
+                                                "If-None-Match: \"v1\""));
+  EXPECT_NE(conditionalHeaders.end(), std::find(conditionalHeaders.begin(), conditionalHeaders.end(),
+                                                "If-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT"));
+  EXPECT_NE(conditionalHeaders.end(), std::find(conditionalHeaders.begin(), conditionalHeaders.end(),
+                                                "Authorization: Bearer fakeToken"));
+  ASSERT_EQ(1, firstCount);
+  ASSERT_EQ(1, secondCount);
+  EXPECT_NE(firstUpdates, secondUpdates);
+  EXPECT_EQ(std::string("FIRSTID"), secondUpdates[0].update_id);
+  EXPECT_EQ(std::string("FAKEDOWNLOADURL"), secondUpdates[0].download_url);
+
+  //Cleanup after test
+  gaus_updates_free(firstCount, firstUpdates);
+  gaus_updates_free(secondCount, secondUpdates);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+//Like mock_curl_easy_perform_with_etag, but the cached reply is evicted while the request is on its way.
+static CURLcode mock_curl_easy_perform_evicting_cache(CURL *curl) {
+  update_cache_cleanup();
+  return mock_curl_easy_perform_with_etag(curl);
+}
+
+TEST_F(GausCheckForUpdates, requests_updates_again_when_evicted_before_not_modified) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  fakeEtag = "\"v1\"";
+  free(fakeResponse);
+  fakeResponse = strdup(oneUpdateResponse("FIRSTID").c_str());
+  gaus_global_init("fakeServerUrl", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_etag;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_etag;
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates));
+  gaus_updates_free(updateCount, updates);
+  gaus_curl_easy_perform = mock_curl_easy_perform_evicting_cache;
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(3, curlPerformData.size());
+  std::vector<std::string> &conditionalHeaders = curlPerformData[1].CURLOPT_HEADER;
+  EXPECT_NE(conditionalHeaders.end(), std::find(conditionalHeaders.begin(), conditionalHeaders.end(),
+                                                "If-None-Match: \"v1\""));
+  //Asked again without conditions, just like the first time
+  EXPECT_EQ(curlPerformData[0].CURLOPT_HEADER, curlPerformData[2].CURLOPT_HEADER);
+  ASSERT_EQ(1, updateCount);
+  EXPECT_EQ(std::string("FIRSTID"), updates[0].update_id);
+
+  //Cleanup after test
+  gaus_updates_free(updateCount, updates);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, parses_updates_again_once_modified) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  fakeEtag = "\"v1\"";
+  free(fakeResponse);
+  fakeResponse = strdup(oneUpdateResponse("FIRSTID").c_str());
+  gaus_global_init("fakeServerUrl", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_etag;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_etag;
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates));
+  gaus_updates_free(updateCount, updates);
+  fakeEtag = "\"v2\"";
+  free(fakeResponse);
+  fakeResponse = strdup(oneUpdateResponse("SECONDID").c_str());
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates));
+  ASSERT_EQ(1, updateCount);
+  EXPECT_EQ(std::string("SECONDID"), updates[0].update_id);
+  gaus_updates_free(updateCount, updates);
+  //The new version is what is cached now
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates));
+  ASSERT_EQ(1, updateCount);
+  EXPECT_EQ(std::string("SECONDID"), updates[0].update_id);
+  EXPECT_EQ(304, fakeResponseCode);
+
+  //Cleanup after test
+  gaus_updates_free(updateCount, updates);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, reuses_headers_for_a_session) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  gaus_session_t otherSession = {
+      strdup("otherDeviceGUID"),
+      strdup("otherProductGUID"),
+      strdup("otherToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  gaus_global_init("fakeServerUrl", NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates));
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_check_for_updates(&otherSession, 0, NULL, &updateCount, &updates));
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates));
+
+  ASSERT_EQ(3, curlPerformData.size());
+  EXPECT_EQ(curlPerformData[0].CURLOPT_HTTPHEADER, curlPerformData[2].CURLOPT_HTTPHEADER);
+  EXPECT_NE(curlPerformData[0].CURLOPT_HTTPHEADER, curlPerformData[1].CURLOPT_HTTPHEADER);
+  EXPECT_EQ(std::vector<std::string>({"Authorization: Bearer fakeToken", "User-Agent: gaus-device-client-c/v0.0.2"}),
+            curlPerformData[2].CURLOPT_HEADER);
+  EXPECT_EQ(std::vector<std::string>({"Authorization: Bearer otherToken", "User-Agent: gaus-device-client-c/v0.0.2"}),
+            curlPerformData[1].CURLOPT_HEADER);
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+  free(otherSession.device_guid);
+  free(otherSession.product_guid);
+  free(otherSession.token);
+}
+
+TEST_F(GausCheckForUpdates, builds_headers_for_more_sessions_than_are_cached) {
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+  const int sessionCount = 100;
+
+  gaus_global_init("fakeServerUrl", NULL);
+
+  for (int i = 0; i < sessionCount; i++) {
+    std::string token = "token" + std::to_string(i % 50);
+    gaus_session_t session = {
+        strdup("fakeDeviceGUID"),
+        strdup("fakeProductGUID"),
+        strdup(token.c_str())
+    };
+
+    ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_check_for_updates(&session, 0, NULL, &updateCount, &updates));
+    ASSERT_EQ("Authorization: Bearer " + token, curlPerformData.back().CURLOPT_HEADER[0]);
+
+    free(session.device_guid);
+    free(session.product_guid);
+    free(session.token);
+  }
+}
+
+TEST_F(GausCheckForUpdates, uses_shared_dns_tls_and_connection_cache) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  ASSERT_NE(nullptr, curlShareHandle);
+  EXPECT_EQ(curlShareHandle, curlPerformData[0].CURLOPT_SHARE);
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+TEST_F(GausCheckForUpdates, multiplexes_requests_over_http2_when_enabled) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  gaus_initialization_options_t options = {};
+  options.enable_http2 = true;
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+
+  gaus_global_init("fakeServerUrl", &options);
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(CURL_HTTP_VERSION_2TLS, curlPerformData[0].CURLOPT_HTTP_VERSION);
+  EXPECT_EQ(1L, curlPerformData[0].CURLOPT_PIPEWAIT);
+  //Blocking requests run on the shared multi handle so they can share a connection
+  EXPECT_EQ(1, allCurlMultiData.size());
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
+static curl_version_info_data *mock_curl_version_info_without_http2(CURLversion version) {
+  static curl_version_info_data info = {};
+  info.version = "mock";
+  return &info;
+}
+
+TEST_F(GausCheckForUpdates, uses_http1_when_curl_lacks_http2) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  gaus_initialization_options_t options = {};
+  options.enable_http2 = true;
+  unsigned int updateCount = 0;
+  gaus_update_t *updates = NULL;
+  gaus_curl_version_info = mock_curl_version_info_without_http2;
+
+  gaus_global_init("fakeServerUrl", &options);
+
+  gaus_error_t *status = gaus_check_for_updates(&fakeSession, 0, NULL, &updateCount, &updates);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(MOCK_NOT_SET_LONG, curlPerformData[0].CURLOPT_HTTP_VERSION);
+  EXPECT_EQ(0, allCurlMultiData.size());
+
+  //Cleanup after test
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+}
+
 //Test against a real backend
 //#define TEST_GAUS_REAL
 #ifdef TEST_GAUS_REAL
@@ -1811,7 +2552,7 @@ TEST_F(GausCheckForUpdates, try_for_real) {
   ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
 
   //Cleanup after test
-  freeUpdates(updateCount, &updates);
+  gaus_updates_free(updateCount, updates);
   free(filters[0].filter_name);
   free(filters[0].filter_value);
   free(device_access);
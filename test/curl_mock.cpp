@@ -8,7 +8,9 @@
 //
 //THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "curl_mock.h"
+#include <algorithm>
 #include <cstring>
+#include <poll.h>
 
 //Allow backing up original functions to so we can restore them
 bool mocks_setup = false;
@@ -19,12 +21,36 @@ curl_easy_setopt_t *original_curl_easy_setopt;
 curl_easy_cleanup_t *original_curl_easy_cleanup;
 curl_global_cleanup_t *original_curl_global_cleanup;
 curl_easy_getinfo_t *original_curl_easy_getinfo;
+curl_easy_reset_t *original_curl_easy_reset;
+curl_multi_init_t *original_curl_multi_init;
+curl_multi_add_handle_t *original_curl_multi_add_handle;
+curl_multi_remove_handle_t *original_curl_multi_remove_handle;
+curl_multi_perform_t *original_curl_multi_perform;
+curl_multi_wait_t *original_curl_multi_wait;
+curl_multi_info_read_t *original_curl_multi_info_read;
+curl_multi_cleanup_t *original_curl_multi_cleanup;
+curl_multi_setopt_t *original_curl_multi_setopt;
+curl_multi_socket_action_t *original_curl_multi_socket_action;
+curl_share_init_t *original_curl_share_init;
+curl_share_setopt_t *original_curl_share_setopt;
+curl_share_cleanup_t *original_curl_share_cleanup;
+curl_version_info_t *original_curl_version_info;
 
 //Storage for curl mocking
+std::recursive_mutex curlMockLock;
 std::map<CURL *, CurlMockData> allCurlData;
+std::map<CURLM *, CurlMultiMockData> allCurlMultiData;
+CURLSH *curlShareHandle = {nullptr};
+std::vector<long> curlSharedData;
 std::vector<CurlOptionsData> curlPerformData;
+std::vector<CURL *> curlPerformHandles;
 CurlCallCounter curlCallCounter;
 char *fakeResponse = strdup("{}");
+size_t fakeResponseLength = 0;
+
+size_t fakeResponseSize() {
+  return fakeResponseLength ? fakeResponseLength : strlen(fakeResponse);
+}
 
 //** Curl mock functions
 CURLcode mock_curl_global_init(long flags) {
@@ -33,6 +59,7 @@ CURLcode mock_curl_global_init(long flags) {
 }
 
 CURL *mock_curl_easy_init(void) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
   //Allocate a string and use its address to track this curl
   CURL *curl = static_cast<CURL *>(strdup("fakeHandle"));
   CurlMockData emptyData;
@@ -41,31 +68,68 @@ CURL *mock_curl_easy_init(void) {
 }
 
 CURLcode mock_curl_easy_perform(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
   curlPerformData.push_back(allCurlData[curl].setOptions);
+  curlPerformHandles.push_back(curl);
+  size_t responseLength = fakeResponseSize();
+  write_function_t headerFunction = allCurlData[curl].setOptions.CURLOPT_HEADERFUNCTION;
+  if (headerFunction) {
+    void *headerData = allCurlData[curl].setOptions.CURLOPT_HEADERDATA;
+    std::string headers[] = {"HTTP/1.1 200 OK\r\n", "Content-Length: " + std::to_string(responseLength) + "\r\n",
+                             "\r\n"};
+    for (std::string &header : headers) {
+      (*headerFunction)(&header[0], sizeof(char), header.size(), headerData);
+    }
+  }
   write_function_t writeFunction = allCurlData[curl].setOptions.CURLOPT_WRITEFUNCTION;
   if (writeFunction) {
     void *writeData = allCurlData[curl].setOptions.CURLOPT_WRITEDATA;
-    (*writeFunction)(fakeResponse, sizeof(char), strlen(fakeResponse), writeData);
+    //Like curl, deliver the body in chunks of at most CURL_MAX_WRITE_SIZE
+    for (size_t offset = 0; offset < responseLength; offset += CURL_MAX_WRITE_SIZE) {
+      size_t chunk = std::min(responseLength - offset, static_cast<size_t>(CURL_MAX_WRITE_SIZE));
+      if ((*writeFunction)(fakeResponse + offset, sizeof(char), chunk, writeData) != chunk) {
+        return CURLE_WRITE_ERROR;
+      }
+    }
   }
-  //Always return ok
   return CURLE_OK;
 }
 
 CURLcode mock_curl_easy_setopt(CURL *curl, CURLoption option, ...) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
   va_list valist;
   va_start(valist, option);
   curl_slist *current = NULL;
+  const char *current_string = NULL;
 
   switch (option) {
     case CURLOPT_URL:
       allCurlData[curl].setOptions.CURLOPT_URL = va_arg(valist, char*);
       break;
     case CURLOPT_POSTFIELDS:
-      allCurlData[curl].setOptions.CURLOPT_POSTFIELDS = va_arg(valist, char*);
+      allCurlData[curl].setOptions.postFieldsPointer = va_arg(valist, char*);
+      allCurlData[curl].setOptions.CURLOPT_POSTFIELDS = allCurlData[curl].setOptions.postFieldsPointer;
+      break;
+    case CURLOPT_POSTFIELDSIZE:
+      //Compressed bodies are only complete with the size given here
+      allCurlData[curl].setOptions.CURLOPT_POSTFIELDSIZE = va_arg(valist, long);
+      allCurlData[curl].setOptions.CURLOPT_POSTFIELDS.assign(allCurlData[curl].setOptions.postFieldsPointer,
+                                                             allCurlData[curl].setOptions.CURLOPT_POSTFIELDSIZE);
+      break;
+    case CURLOPT_ACCEPT_ENCODING:
+      //NULL turns decoding off again
+      current_string = va_arg(valist, char*);
+      allCurlData[curl].setOptions.CURLOPT_ACCEPT_ENCODING = current_string ? current_string : MOCK_NOT_SET;
       break;
     case CURLOPT_WRITEFUNCTION:
       allCurlData[curl].setOptions.CURLOPT_WRITEFUNCTION = va_arg(valist, write_function_t);
       break;
+    case CURLOPT_HEADERFUNCTION:
+      allCurlData[curl].setOptions.CURLOPT_HEADERFUNCTION = va_arg(valist, write_function_t);
+      break;
+    case CURLOPT_HEADERDATA:
+      allCurlData[curl].setOptions.CURLOPT_HEADERDATA = va_arg(valist, void*);
+      break;
     case CURLOPT_WRITEDATA:
       allCurlData[curl].setOptions.CURLOPT_WRITEDATA = va_arg(valist, void*);
       break;
@@ -78,9 +142,47 @@ CURLcode mock_curl_easy_setopt(CURL *curl, CURLoption option, ...) {
     case CURLOPT_HTTPGET:
       allCurlData[curl].setOptions.CURLOPT_HTTPGET = va_arg(valist, long);
       break;
+    case CURLOPT_HTTP_VERSION:
+      allCurlData[curl].setOptions.CURLOPT_HTTP_VERSION = va_arg(valist, long);
+      break;
+    case CURLOPT_PIPEWAIT:
+      allCurlData[curl].setOptions.CURLOPT_PIPEWAIT = va_arg(valist, long);
+      break;
+    case CURLOPT_RANGE:
+      current_string = va_arg(valist, char*);
+      allCurlData[curl].setOptions.CURLOPT_RANGE = current_string ? current_string : MOCK_NOT_SET;
+      break;
+    case CURLOPT_RESUME_FROM_LARGE:
+      allCurlData[curl].setOptions.CURLOPT_RESUME_FROM_LARGE = va_arg(valist, curl_off_t);
+      break;
+    case CURLOPT_LOW_SPEED_LIMIT:
+      allCurlData[curl].setOptions.CURLOPT_LOW_SPEED_LIMIT = va_arg(valist, long);
+      break;
+    case CURLOPT_LOW_SPEED_TIME:
+      allCurlData[curl].setOptions.CURLOPT_LOW_SPEED_TIME = va_arg(valist, long);
+      break;
+    case CURLOPT_MAX_RECV_SPEED_LARGE:
+      allCurlData[curl].setOptions.CURLOPT_MAX_RECV_SPEED_LARGE = va_arg(valist, curl_off_t);
+      break;
+    case CURLOPT_MAX_SEND_SPEED_LARGE:
+      allCurlData[curl].setOptions.CURLOPT_MAX_SEND_SPEED_LARGE = va_arg(valist, curl_off_t);
+      break;
+    case CURLOPT_XFERINFOFUNCTION:
+      allCurlData[curl].setOptions.CURLOPT_XFERINFOFUNCTION = va_arg(valist, curl_xferinfo_callback);
+      break;
+    case CURLOPT_XFERINFODATA:
+      allCurlData[curl].setOptions.CURLOPT_XFERINFODATA = va_arg(valist, void*);
+      break;
+    case CURLOPT_SHARE:
+      allCurlData[curl].setOptions.CURLOPT_SHARE = va_arg(valist, void*);
+      break;
+    case CURLOPT_PRIVATE:
+      allCurlData[curl].setOptions.CURLOPT_PRIVATE = va_arg(valist, void*);
+      break;
     case CURLOPT_HTTPHEADER:
       //Loop over options in list and add them to vector for easier testing
       current = va_arg(valist, curl_slist*);
+      allCurlData[curl].setOptions.CURLOPT_HTTPHEADER = current;
       while (current) {
         std::string temp(current->data);
         allCurlData[curl].setOptions.CURLOPT_HEADER.push_back(temp);
@@ -96,6 +198,7 @@ CURLcode mock_curl_easy_setopt(CURL *curl, CURLoption option, ...) {
 }
 
 void mock_curl_easy_cleanup(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
   allCurlData.erase(curl);
   free(curl); //Cleanup our fakeHandle string
 }
@@ -105,6 +208,7 @@ void mock_curl_global_cleanup(void) {
 }
 
 CURLcode mock_curl_easy_getinfo(CURL *curl, CURLINFO info, ...) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
   long *code;
   va_list valist;
   va_start(valist, info);
@@ -114,6 +218,9 @@ CURLcode mock_curl_easy_getinfo(CURL *curl, CURLINFO info, ...) {
       code = va_arg(valist, long*);
       *code = 200;
       break;
+    case CURLINFO_PRIVATE:
+      *va_arg(valist, void**) = allCurlData[curl].setOptions.CURLOPT_PRIVATE;
+      break;
     default:
       //doNothing unless this is a param we need to handle
       break;
@@ -122,6 +229,152 @@ CURLcode mock_curl_easy_getinfo(CURL *curl, CURLINFO info, ...) {
   return CURLE_OK;
 }
 
+void mock_curl_easy_reset(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  allCurlData[curl].setOptions = CurlOptionsData();
+}
+
+CURLM *mock_curl_multi_init(void) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  //Allocate a string and use its address to track this multi
+  CURLM *multi = static_cast<CURLM *>(strdup("fakeMultiHandle"));
+  allCurlMultiData.emplace(multi, CurlMultiMockData());
+  return multi;
+}
+
+CURLMcode mock_curl_multi_add_handle(CURLM *multi, CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlMultiMockData &data = allCurlMultiData[multi];
+  data.handles.push_back(curl);
+  if (data.timerFunction) {
+    //Like curl, ask for a timeout so the new transfer gets started
+    data.timerFunction(multi, 0, nullptr);
+  }
+  return CURLM_OK;
+}
+
+CURLMcode mock_curl_multi_remove_handle(CURLM *multi, CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  auto &handles = allCurlMultiData[multi].handles;
+  handles.erase(std::remove(handles.begin(), handles.end(), curl), handles.end());
+  return CURLM_OK;
+}
+
+CURLMcode mock_curl_multi_perform(CURLM *multi, int *running_handles) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  //Complete every added handle at once through the (possibly overridden) easy perform mock
+  CurlMultiMockData &data = allCurlMultiData[multi];
+  for (CURL *curl : data.handles) {
+    CURLMsg message = {};
+    message.msg = CURLMSG_DONE;
+    message.easy_handle = curl;
+    message.data.result = gaus_curl_easy_perform(curl);
+    data.messages.push_back(message);
+  }
+  data.handles.clear();
+  *running_handles = 0;
+  return CURLM_OK;
+}
+
+CURLMcode mock_curl_multi_socket_action(CURLM *multi, curl_socket_t s, int ev_bitmask, int *running_handles) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  allCurlMultiData[multi].socketActions.push_back(s);
+  return mock_curl_multi_perform(multi, running_handles);
+}
+
+CURLMcode mock_curl_multi_setopt(CURLM *multi, CURLMoption option, ...) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  va_list valist;
+  va_start(valist, option);
+  switch (option) {
+    case CURLMOPT_TIMERFUNCTION:
+      allCurlMultiData[multi].timerFunction = va_arg(valist, curl_multi_timer_callback);
+      break;
+    default:
+      //doNothing unless this is a param we need to handle
+      break;
+  }
+  va_end(valist);
+  return CURLM_OK;
+}
+
+CURLSH *mock_curl_share_init(void) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  curlCallCounter.shareInit++;
+  curlSharedData.clear();
+  //Allocate a string and use its address to track the share
+  curlShareHandle = static_cast<CURLSH *>(strdup("fakeShareHandle"));
+  return curlShareHandle;
+}
+
+CURLSHcode mock_curl_share_setopt(CURLSH *share, CURLSHoption option, ...) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  va_list valist;
+  va_start(valist, option);
+  if (option == CURLSHOPT_SHARE) {
+    curlSharedData.push_back(va_arg(valist, long));
+  }
+  va_end(valist);
+  return CURLSHE_OK;
+}
+
+CURLSHcode mock_curl_share_cleanup(CURLSH *share) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  curlCallCounter.shareCleanup++;
+  free(share); //Cleanup our fakeShareHandle string
+  curlShareHandle = nullptr;
+  return CURLSHE_OK;
+}
+
+curl_version_info_data *mock_curl_version_info(CURLversion version) {
+  //Pretend curl was built with every feature the library checks for
+  static curl_version_info_data info = {};
+  info.age = version;
+  info.version = "mock";
+  info.features = CURL_VERSION_HTTP2;
+  return &info;
+}
+
+CURLMcode mock_curl_multi_wait(CURLM *multi, struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms,
+                               int *numfds) {
+  {
+    std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+    CurlMultiMockData &data = allCurlMultiData[multi];
+    if (!data.handles.empty() || !data.messages.empty()) {
+      timeout_ms = 0;
+    }
+  }
+  //Sleep on the extra fds like the real implementation so wakeups work, without holding the lock.
+  std::vector<pollfd> fds;
+  for (unsigned int i = 0; i < extra_nfds; i++) {
+    fds.push_back({extra_fds[i].fd, POLLIN, 0});
+  }
+  int ready = poll(fds.data(), fds.size(), timeout_ms);
+  if (numfds) {
+    *numfds = ready > 0 ? ready : 0;
+  }
+  return CURLM_OK;
+}
+
+CURLMsg *mock_curl_multi_info_read(CURLM *multi, int *msgs_in_queue) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlMultiMockData &data = allCurlMultiData[multi];
+  if (data.messages.empty()) {
+    *msgs_in_queue = 0;
+    return nullptr;
+  }
+  data.lastMessage = data.messages.front();
+  data.messages.pop_front();
+  *msgs_in_queue = data.messages.size();
+  return &data.lastMessage;
+}
+
+CURLMcode mock_curl_multi_cleanup(CURLM *multi) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  allCurlMultiData.erase(multi);
+  free(multi); //Cleanup our fakeMultiHandle string
+  return CURLM_OK;
+}
 
 //Mock setup/teardown functions:
 void setupMocks() {
@@ -134,6 +387,20 @@ void setupMocks() {
     original_curl_easy_cleanup = gaus_curl_easy_cleanup;
     original_curl_global_cleanup = gaus_curl_global_cleanup;
     original_curl_easy_getinfo = gaus_curl_easy_getinfo;
+    original_curl_easy_reset = gaus_curl_easy_reset;
+    original_curl_multi_init = gaus_curl_multi_init;
+    original_curl_multi_add_handle = gaus_curl_multi_add_handle;
+    original_curl_multi_remove_handle = gaus_curl_multi_remove_handle;
+    original_curl_multi_perform = gaus_curl_multi_perform;
+    original_curl_multi_wait = gaus_curl_multi_wait;
+    original_curl_multi_info_read = gaus_curl_multi_info_read;
+    original_curl_multi_cleanup = gaus_curl_multi_cleanup;
+    original_curl_multi_setopt = gaus_curl_multi_setopt;
+    original_curl_multi_socket_action = gaus_curl_multi_socket_action;
+    original_curl_share_init = gaus_curl_share_init;
+    original_curl_share_setopt = gaus_curl_share_setopt;
+    original_curl_share_cleanup = gaus_curl_share_cleanup;
+    original_curl_version_info = gaus_curl_version_info;
 
     //Setup our "mocks"
     gaus_curl_global_init = mock_curl_global_init;
@@ -143,6 +410,20 @@ void setupMocks() {
     gaus_curl_easy_cleanup = mock_curl_easy_cleanup;
     gaus_curl_global_cleanup = mock_curl_global_cleanup;
     gaus_curl_easy_getinfo = mock_curl_easy_getinfo;
+    gaus_curl_easy_reset = mock_curl_easy_reset;
+    gaus_curl_multi_init = mock_curl_multi_init;
+    gaus_curl_multi_add_handle = mock_curl_multi_add_handle;
+    gaus_curl_multi_remove_handle = mock_curl_multi_remove_handle;
+    gaus_curl_multi_perform = mock_curl_multi_perform;
+    gaus_curl_multi_wait = mock_curl_multi_wait;
+    gaus_curl_multi_info_read = mock_curl_multi_info_read;
+    gaus_curl_multi_cleanup = mock_curl_multi_cleanup;
+    gaus_curl_multi_setopt = mock_curl_multi_setopt;
+    gaus_curl_multi_socket_action = mock_curl_multi_socket_action;
+    gaus_curl_share_init = mock_curl_share_init;
+    gaus_curl_share_setopt = mock_curl_share_setopt;
+    gaus_curl_share_cleanup = mock_curl_share_cleanup;
+    gaus_curl_version_info = mock_curl_version_info;
     mocks_setup = true;
   } else {
     throw "Attempted to setup mocks twice!";
@@ -159,6 +440,20 @@ void cleanupMocks() {
     gaus_curl_easy_cleanup = original_curl_easy_cleanup;
     gaus_curl_global_cleanup = original_curl_global_cleanup;
     gaus_curl_easy_getinfo = original_curl_easy_getinfo;
+    gaus_curl_easy_reset = original_curl_easy_reset;
+    gaus_curl_multi_init = original_curl_multi_init;
+    gaus_curl_multi_add_handle = original_curl_multi_add_handle;
+    gaus_curl_multi_remove_handle = original_curl_multi_remove_handle;
+    gaus_curl_multi_perform = original_curl_multi_perform;
+    gaus_curl_multi_wait = original_curl_multi_wait;
+    gaus_curl_multi_info_read = original_curl_multi_info_read;
+    gaus_curl_multi_cleanup = original_curl_multi_cleanup;
+    gaus_curl_multi_setopt = original_curl_multi_setopt;
+    gaus_curl_multi_socket_action = original_curl_multi_socket_action;
+    gaus_curl_share_init = original_curl_share_init;
+    gaus_curl_share_setopt = original_curl_share_setopt;
+    gaus_curl_share_cleanup = original_curl_share_cleanup;
+    gaus_curl_version_info = original_curl_version_info;
     mocks_setup = false;
   } else {
     throw "Attempting to restore without having mocked!";
@@ -167,14 +462,19 @@ void cleanupMocks() {
 
 //Mock control functions:
 void resetCurlMockHistory() {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
   free(fakeResponse);
   fakeResponse = strdup("{}");
+  fakeResponseLength = 0;
   allCurlData.clear();
   curlPerformData.clear();
+  curlPerformHandles.clear();
   curlCallCounter.reset();
 }
 
 void CurlCallCounter::reset(void) {
   globalInit = 0;
   globalCleanup = 0;
+  shareInit = 0;
+  shareCleanup = 0;
 }
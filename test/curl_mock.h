@@ -11,7 +11,9 @@
 #define GAUS_CURL_MOCK_H
 
 #include <cstdarg>
+#include <deque>
 #include <map>
+#include <mutex>
 #include <iostream>
 #include <vector>
 
@@ -27,9 +29,23 @@ extern curl_easy_setopt_t *original_curl_easy_setopt;
 extern curl_easy_cleanup_t *original_curl_easy_cleanup;
 extern curl_global_cleanup_t *original_curl_global_cleanup;
 extern curl_easy_getinfo_t *original_curl_easy_getinfo;
+extern curl_easy_reset_t *original_curl_easy_reset;
+extern curl_multi_init_t *original_curl_multi_init;
+extern curl_multi_add_handle_t *original_curl_multi_add_handle;
+extern curl_multi_remove_handle_t *original_curl_multi_remove_handle;
+extern curl_multi_perform_t *original_curl_multi_perform;
+extern curl_multi_wait_t *original_curl_multi_wait;
+extern curl_multi_info_read_t *original_curl_multi_info_read;
+extern curl_multi_cleanup_t *original_curl_multi_cleanup;
+extern curl_multi_setopt_t *original_curl_multi_setopt;
+extern curl_multi_socket_action_t *original_curl_multi_socket_action;
+extern curl_share_init_t *original_curl_share_init;
+extern curl_share_setopt_t *original_curl_share_setopt;
+extern curl_share_cleanup_t *original_curl_share_cleanup;
+extern curl_version_info_t *original_curl_version_info;
 
 //Data structures for mocks:
-typedef void (*write_function_t)(char *ptr, size_t size, size_t nmemb, void *userdata);
+typedef size_t (*write_function_t)(char *ptr, size_t size, size_t nmemb, void *userdata);
 
 #define MOCK_NOT_SET "NOT_SET"
 #define MOCK_NOT_SET_LONG -1L
@@ -38,18 +54,38 @@ class CurlOptionsData {
 public:
   std::string CURLOPT_URL = MOCK_NOT_SET; //If this is set multiple times we overwrite old value
   std::string CURLOPT_POSTFIELDS = MOCK_NOT_SET; //If this is set multiple times we overwrite old value
+  const char *postFieldsPointer = {nullptr}; //CURLOPT_POSTFIELDS as passed, it may hold null bytes
+  long CURLOPT_POSTFIELDSIZE = MOCK_NOT_SET_LONG;
+  std::string CURLOPT_ACCEPT_ENCODING = MOCK_NOT_SET;
   void *CURLOPT_WRITEDATA = {nullptr}; //If this is set multiple times we overwrite old value
-  write_function_t CURLOPT_WRITEFUNCTION;
+  write_function_t CURLOPT_WRITEFUNCTION = {nullptr};
+  void *CURLOPT_HEADERDATA = {nullptr};
+  write_function_t CURLOPT_HEADERFUNCTION = {nullptr};
   std::string CURLOPT_PROXY = MOCK_NOT_SET; //If this is set multiple times we overwrite old value
   std::string CURLOPT_CAPATH = MOCK_NOT_SET; //If this is set multiple times we overwrite old value
   long CURLOPT_HTTPGET = MOCK_NOT_SET_LONG;
+  long CURLOPT_HTTP_VERSION = MOCK_NOT_SET_LONG;
+  long CURLOPT_PIPEWAIT = MOCK_NOT_SET_LONG;
+  curl_off_t CURLOPT_RESUME_FROM_LARGE = MOCK_NOT_SET_LONG;
+  std::string CURLOPT_RANGE = MOCK_NOT_SET;
+  curl_off_t CURLOPT_MAX_RECV_SPEED_LARGE = MOCK_NOT_SET_LONG;
+  long CURLOPT_LOW_SPEED_LIMIT = MOCK_NOT_SET_LONG;
+  long CURLOPT_LOW_SPEED_TIME = MOCK_NOT_SET_LONG;
+  curl_off_t CURLOPT_MAX_SEND_SPEED_LARGE = MOCK_NOT_SET_LONG;
+  curl_xferinfo_callback CURLOPT_XFERINFOFUNCTION = {nullptr};
+  void *CURLOPT_XFERINFODATA = {nullptr};
   std::vector<std::string> CURLOPT_HEADER;
+  curl_slist *CURLOPT_HTTPHEADER = {nullptr}; //The list itself, CURLOPT_HEADER holds its contents
+  void *CURLOPT_PRIVATE = {nullptr};
+  void *CURLOPT_SHARE = {nullptr};
 };
 
 class CurlCallCounter {
 public:
   int globalInit = {0};
   int globalCleanup = {0};
+  int shareInit = {0};
+  int shareCleanup = {0};
 
   void reset(void);
 };
@@ -59,13 +95,30 @@ public:
   CurlOptionsData setOptions;
 };
 
-//Hold results of curl operations
+class CurlMultiMockData {
+public:
+  std::vector<CURL *> handles; //Added and not yet performed
+  std::deque<CURLMsg> messages;
+  CURLMsg lastMessage;
+  curl_multi_timer_callback timerFunction = {nullptr};
+  std::vector<curl_socket_t> socketActions; //Sockets passed to curl_multi_socket_action
+};
+
+//Hold results of curl operations.  The library I/O thread calls the mocks too, so they lock curlMockLock.
+extern std::recursive_mutex curlMockLock;
 extern std::map<CURL *, CurlMockData> allCurlData;
+extern std::map<CURLM *, CurlMultiMockData> allCurlMultiData;
+extern CURLSH *curlShareHandle; //Last share handle created
+extern std::vector<long> curlSharedData; //CURLSHOPT_SHARE values set on it
 extern std::vector<CurlOptionsData> curlPerformData;
+extern std::vector<CURL *> curlPerformHandles;
 extern CurlCallCounter curlCallCounter;
 
 //Used to send a response to the CURLOPT_WRITE_FUNCTION
 extern char *fakeResponse;
+extern size_t fakeResponseLength; //Length of a binary fakeResponse, 0 if it is a string
+
+size_t fakeResponseSize();
 
 //Mock functions
 CURLcode mock_curl_global_init(long flags);
@@ -82,6 +135,35 @@ void mock_curl_global_cleanup(void);
 
 CURLcode mock_curl_easy_getinfo(CURL *curl, CURLINFO info, ...);
 
+void mock_curl_easy_reset(CURL *curl);
+
+CURLM *mock_curl_multi_init(void);
+
+CURLMcode mock_curl_multi_add_handle(CURLM *multi, CURL *curl);
+
+CURLMcode mock_curl_multi_remove_handle(CURLM *multi, CURL *curl);
+
+CURLMcode mock_curl_multi_perform(CURLM *multi, int *running_handles);
+
+CURLMcode mock_curl_multi_wait(CURLM *multi, struct curl_waitfd extra_fds[], unsigned int extra_nfds, int timeout_ms,
+                               int *numfds);
+
+CURLMsg *mock_curl_multi_info_read(CURLM *multi, int *msgs_in_queue);
+
+CURLMcode mock_curl_multi_cleanup(CURLM *multi);
+
+CURLMcode mock_curl_multi_setopt(CURLM *multi, CURLMoption option, ...);
+
+CURLMcode mock_curl_multi_socket_action(CURLM *multi, curl_socket_t s, int ev_bitmask, int *running_handles);
+
+CURLSH *mock_curl_share_init(void);
+
+CURLSHcode mock_curl_share_setopt(CURLSH *share, CURLSHoption option, ...);
+
+CURLSHcode mock_curl_share_cleanup(CURLSH *share);
+
+curl_version_info_data *mock_curl_version_info(CURLversion version);
+
 //Setup/Teardown:
 void setupMocks();
 
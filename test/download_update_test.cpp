@@ -0,0 +1,2245 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include <gtest/gtest.h>
+#include "gaus/gaus_client.h"
+#include "curl_mock.h"
+
+//Access gaus curl wrapper
+#include "../src/libgaus/bandwidth.h"
+#include "../src/libgaus/curl_wrapper.h"
+//Access the digest used to verify downloads
+#include "../src/libgaus/md5.h"
+//Access the chunker to split packages like the server
+#include "../src/libgaus/chunker.h"
+//Access the control picking the number of concurrent streams
+#include "../src/libgaus/download_sources.h"
+#include "../src/libgaus/request_ranges.h"
+//Access the connection pool of the client downloads go through
+#include "../src/libgaus/gaus.h"
+//Access the hash tree checking each chunk of a download
+#include "../src/libgaus/hash_tree.h"
+
+#include <cstdarg>
+#include <atomic>
+#include <cinttypes>
+#include <condition_variable>
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static const std::string fakePackage = "0123456789abcdefghijklmnopqrstuvwxyz";
+static const char *fakePackageMd5 = "E9B1713DB620F1E3A14B6812DE523F4B";
+
+class GausDownloadUpdate : public ::testing::Test {
+protected:
+  std::string destination;
+  std::string journal;
+  gaus_session_t fakeSession = {nullptr, nullptr, nullptr};
+  gaus_update_t fakeUpdate = {};
+
+  virtual void SetUp() {
+    setupMocks();
+    resetCurlMockHistory();
+    free(fakeResponse);
+    fakeResponse = strdup(fakePackage.c_str());
+    destination = ::testing::TempDir() + "gaus_download_update_test.bin";
+    journal = destination + ".journal";
+    unlink(destination.c_str());
+    unlink(journal.c_str());
+
+    fakeSession.device_guid = strdup("fakeDeviceGUID");
+    fakeSession.product_guid = strdup("fakeProductGUID");
+    fakeSession.token = strdup("fakeToken");
+    fakeUpdate.size = fakePackage.size();
+    fakeUpdate.update_type = strdup("firmware");
+    fakeUpdate.package_type = strdup("file");
+    fakeUpdate.md5 = strdup(fakePackageMd5);
+    fakeUpdate.update_id = strdup("FAKEUPDATEID");
+    fakeUpdate.version = strdup("1.0");
+    fakeUpdate.download_url = strdup("https://fakeserver/package");
+  }
+
+  virtual
+
+  void TearDown() {
+    free(fakeSession.device_guid);
+    free(fakeSession.product_guid);
+    free(fakeSession.token);
+    gaus_update_free(&fakeUpdate);
+    unlink(destination.c_str());
+    unlink(journal.c_str());
+    gaus_global_cleanup();
+    cleanupMocks();
+  }
+};
+
+static std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+static bool fileExists(const std::string &path) {
+  return access(path.c_str(), F_OK) == 0;
+}
+
+static void freeError(gaus_error_t *status) {
+  free(status->description);
+  free(status);
+}
+
+//Bytes the fake server sends before the connection drops, negative to never drop it.
+static long fakeBreakAfter = -1;
+//Number of transfers that drop, later ones complete.
+static int fakeBreakCount = 0;
+
+//Serve fakeResponse from the requested range, dropping the connection as configured.
+static CURLcode mock_curl_easy_perform_with_range(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  curlPerformData.push_back(options);
+  curlPerformHandles.push_back(curl);
+  size_t offset = options.CURLOPT_RESUME_FROM_LARGE > 0 ? options.CURLOPT_RESUME_FROM_LARGE : 0;
+  size_t length = fakeResponseSize() - offset;
+  bool drop = fakeBreakCount > 0 && fakeBreakAfter >= 0 && static_cast<size_t>(fakeBreakAfter) < length;
+  if (drop) {
+    fakeBreakCount--;
+    length = fakeBreakAfter;
+  }
+  if (length > 0 && (*options.CURLOPT_WRITEFUNCTION)(fakeResponse + offset, sizeof(char), length,
+                                                      options.CURLOPT_WRITEDATA) != length) {
+    return CURLE_WRITE_ERROR;
+  }
+  return drop ? CURLE_PARTIAL_FILE : CURLE_OK;
+}
+
+//Write a journal for the first offset bytes of package
+static void writeJournal(const std::string &path, const std::string &updateId, size_t size, const char *md5,
+                         long offset, const std::string &package = fakePackage) {
+  md5_context_t context;
+  char state[64];
+  md5_init(&context);
+  md5_update(&context, package.data(), offset);
+  snprintf(state, sizeof(state), "%08" PRIx32 " %08" PRIx32 " %08" PRIx32 " %08" PRIx32, context.state[0],
+           context.state[1], context.state[2], context.state[3]);
+
+  std::ofstream file(path);
+  file << "gaus-download-journal 2\nupdate_id " << updateId << "\nsize " << size << "\nmd5 " << md5
+       << "\noffset " << offset << "\nmd5_state " << state << " ";
+  for (long i = 0; i < offset % MD5_BLOCK_LENGTH; i++) {
+    snprintf(state, sizeof(state), "%02x", context.buffer[i]);
+    file << state;
+  }
+  file << "\n";
+}
+
+TEST_F(GausDownloadUpdate, fails_without_initialize) {
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_NO_INIT_ERROR, status->error_type);
+  EXPECT_EQ(500, status->http_error_code);
+  EXPECT_NE(0, strlen(status->description));
+  EXPECT_EQ(0, curlPerformData.size());
+  EXPECT_FALSE(fileExists(destination));
+
+  freeError(status);
+}
+
+TEST_F(GausDownloadUpdate, fails_with_invalid_parameters) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_update_t noUrl = fakeUpdate;
+  noUrl.download_url = NULL;
+
+  gaus_error_t *statuses[] = {
+      gaus_download_update(NULL, &fakeUpdate, destination.c_str(), NULL),
+      gaus_download_update(&fakeSession, NULL, destination.c_str(), NULL),
+      gaus_download_update(&fakeSession, &fakeUpdate, NULL, NULL),
+      gaus_download_update(&fakeSession, &noUrl, destination.c_str(), NULL)
+  };
+
+  for (gaus_error_t *status : statuses) {
+    ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+    EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+    EXPECT_NE(0, strlen(status->description));
+    freeError(status);
+  }
+  EXPECT_EQ(0, curlPerformData.size());
+}
+
+TEST_F(GausDownloadUpdate, downloads_update_to_file) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(fakeUpdate.download_url, curlPerformData[0].CURLOPT_URL);
+  EXPECT_EQ(MOCK_NOT_SET_LONG, curlPerformData[0].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(fakePackage, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadUpdate, resumes_an_interrupted_transfer) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  fakeBreakAfter = 10;
+  fakeBreakCount = 2;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(3, curlPerformData.size());
+  EXPECT_EQ(MOCK_NOT_SET_LONG, curlPerformData[0].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(10, curlPerformData[1].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(20, curlPerformData[2].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(fakePackage, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+/* A server that gzip encodes responses for clients accepting it.  The range of a resumed request then counts bytes of
+ * the encoded resource, which can not be decoded on their own. */
+static CURLcode mock_curl_easy_perform_with_gzip_range(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  if (options.CURLOPT_ACCEPT_ENCODING != MOCK_NOT_SET && options.CURLOPT_RESUME_FROM_LARGE > 0) {
+    curlPerformData.push_back(options);
+    if (options.CURLOPT_HEADERFUNCTION) {
+      char header[] = "Content-Encoding: gzip\r\n";
+      (*options.CURLOPT_HEADERFUNCTION)(header, sizeof(char), strlen(header), options.CURLOPT_HEADERDATA);
+    }
+    return CURLE_BAD_CONTENT_ENCODING;
+  }
+  return mock_curl_easy_perform_with_range(curl);
+}
+
+TEST_F(GausDownloadUpdate, resumes_without_content_encoding) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_gzip_range;
+  fakeBreakAfter = 10;
+  fakeBreakCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(MOCK_NOT_SET, curlPerformData[0].CURLOPT_ACCEPT_ENCODING);
+  EXPECT_EQ(MOCK_NOT_SET, curlPerformData[1].CURLOPT_ACCEPT_ENCODING);
+  EXPECT_EQ(10, curlPerformData[1].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(fakePackage, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadUpdate, keeps_journal_when_giving_up) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  fakeBreakAfter = 5;
+  fakeBreakCount = 2;
+  gaus_download_options_t options = {2};
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(fakePackage.substr(0, 10), readFile(destination));
+  EXPECT_NE(std::string::npos, readFile(journal).find("offset 10\n"));
+  freeError(status);
+
+  //A later call picks up where the last one stopped
+  curlPerformData.clear();
+  status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(10, curlPerformData[0].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(fakePackage, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadUpdate, discards_bytes_not_in_journal) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  std::ofstream(destination) << fakePackage.substr(0, 8) << "garbage";
+  writeJournal(journal, fakeUpdate.update_id, fakeUpdate.size, fakeUpdate.md5, 8);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(8, curlPerformData[0].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+TEST_F(GausDownloadUpdate, ignores_journal_of_another_update) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  std::ofstream(destination) << "something else";
+  writeJournal(journal, "OTHERUPDATEID", fakeUpdate.size, fakeUpdate.md5, 8);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(MOCK_NOT_SET_LONG, curlPerformData[0].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(fakePackage, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+static CURLcode mock_curl_easy_perform_without_ranges(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  if (options.CURLOPT_RESUME_FROM_LARGE > 0) {
+    curlPerformData.push_back(options);
+    return CURLE_RANGE_ERROR;
+  }
+  return mock_curl_easy_perform_with_range(curl);
+}
+
+TEST_F(GausDownloadUpdate, starts_over_when_server_ignores_ranges) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_without_ranges;
+  std::ofstream(destination) << fakePackage.substr(0, 8);
+  writeJournal(journal, fakeUpdate.update_id, fakeUpdate.size, fakeUpdate.md5, 8);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(8, curlPerformData[0].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(MOCK_NOT_SET_LONG, curlPerformData[1].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+TEST_F(GausDownloadUpdate, rejects_more_data_than_update_size) {
+  gaus_global_init("fakeServer", NULL);
+  fakeUpdate.size = 10;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_EQ(1, curlPerformData.size());
+  freeError(status);
+}
+
+static long fakeResponseCode = 404;
+
+static CURLcode mock_curl_easy_perform_with_http_error(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  curlPerformData.push_back(allCurlData[curl].setOptions);
+  curlPerformHandles.push_back(curl);
+  return CURLE_HTTP_RETURNED_ERROR;
+}
+
+static CURLcode mock_curl_easy_getinfo_with_http_error(CURL *curl, CURLINFO info, ...) {
+  va_list valist;
+  va_start(valist, info);
+  if (info == CURLINFO_RESPONSE_CODE) {
+    *va_arg(valist, long*) = fakeResponseCode;
+  }
+  va_end(valist);
+  return CURLE_OK;
+}
+
+TEST_F(GausDownloadUpdate, fails_on_client_http_error) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_http_error;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_http_error;
+  fakeResponseCode = 404;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_HTTP_ERROR, status->error_type);
+  EXPECT_EQ(404, status->http_error_code);
+  EXPECT_EQ(1, curlPerformData.size());
+  freeError(status);
+}
+
+TEST_F(GausDownloadUpdate, retries_server_http_errors) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_http_error;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_http_error;
+  fakeResponseCode = 503;
+  gaus_download_options_t options = {3};
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_HTTP_ERROR, status->error_type);
+  EXPECT_EQ(503, status->http_error_code);
+  EXPECT_EQ(3, curlPerformData.size());
+  freeError(status);
+}
+
+TEST_F(GausDownloadUpdate, fails_on_checksum_mismatch) {
+  gaus_global_init("fakeServer", NULL);
+  free(fakeUpdate.md5);
+  fakeUpdate.md5 = strdup("00000000000000000000000000000000");
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_CHECKSUM_ERROR, status->error_type);
+  EXPECT_NE(0, strlen(status->description));
+  EXPECT_FALSE(fileExists(journal));
+  freeError(status);
+}
+
+TEST_F(GausDownloadUpdate, verifies_checksum_across_resumed_transfers) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  free(fakeResponse);
+  fakeResponse = static_cast<char *>(malloc(1001));
+  for (int i = 0; i < 1000; i++) {
+    fakeResponse[i] = static_cast<char>('a' + i % 26);
+  }
+  fakeResponse[1000] = '\0';
+  fakeUpdate.size = 1000;
+  free(fakeUpdate.md5);
+  fakeUpdate.md5 = strdup("303fb697b589019cb3edba04b794e575");
+  //Break inside a block, right after one and across several
+  fakeBreakAfter = 77;
+  fakeBreakCount = 3;
+  gaus_download_options_t options = {2};
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  freeError(status);
+  fakeBreakAfter = 128;
+  status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(std::string(fakeResponse), readFile(destination));
+}
+
+TEST_F(GausDownloadUpdate, writes_large_downloads_in_full) {
+  gaus_global_init("fakeServer", NULL);
+  const size_t size = 3 * 512 * 1024 + 12345;
+  unsigned char digest[MD5_DIGEST_LENGTH];
+  char hex[MD5_DIGEST_LENGTH * 2 + 1];
+  md5_context_t context;
+  free(fakeResponse);
+  fakeResponse = static_cast<char *>(malloc(size + 1));
+  for (size_t i = 0; i < size; i++) {
+    fakeResponse[i] = static_cast<char>('A' + i % 51);
+  }
+  fakeResponse[size] = '\0';
+  md5_init(&context);
+  md5_update(&context, fakeResponse, size);
+  md5_final(&context, digest);
+  for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+    snprintf(hex + i * 2, 3, "%02x", digest[i]);
+  }
+  fakeUpdate.size = size;
+  free(fakeUpdate.md5);
+  fakeUpdate.md5 = strdup(hex);
+  gaus_download_options_t options = {0, GAUS_SYNC_ON_COMPLETION};
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(std::string(fakeResponse), readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadUpdate, keeps_journal_of_broken_transfer_when_syncing_on_completion) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  fakeBreakAfter = 12;
+  fakeBreakCount = 1;
+  gaus_download_options_t options = {1, GAUS_SYNC_ON_COMPLETION};
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(fakePackage.substr(0, 12), readFile(destination));
+  EXPECT_NE(std::string::npos, readFile(journal).find("offset 12\n"));
+  freeError(status);
+}
+
+TEST_F(GausDownloadUpdate, rejects_invalid_sync_policy) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_download_options_t options = {0, static_cast<gaus_sync_policy_t>(7)};
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_EQ(0, curlPerformData.size());
+  freeError(status);
+}
+
+TEST_F(GausDownloadUpdate, runs_unlimited_without_max_bandwidth) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  //Counted so a later background transfer makes way for it, but not limited itself
+  EXPECT_EQ(0, curlPerformData[0].CURLOPT_MAX_RECV_SPEED_LARGE);
+  EXPECT_NE(nullptr, curlPerformData[0].CURLOPT_XFERINFOFUNCTION);
+}
+
+//Rates set while a download runs and a report is sent alongside it
+static curl_off_t downloadRateAlone;
+static curl_off_t downloadRateDuringReport;
+static curl_off_t downloadRateAfterReport;
+static curl_off_t reportRate;
+static CURL *downloadCurl;
+
+static CURLcode mock_curl_easy_perform_with_report(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  if (options.CURLOPT_POSTFIELDS != MOCK_NOT_SET) {
+    CurlOptionsData &download = allCurlData[downloadCurl].setOptions;
+    reportRate = options.CURLOPT_MAX_SEND_SPEED_LARGE;
+    //curl calls the progress callback of the download as it goes on
+    download.CURLOPT_XFERINFOFUNCTION(download.CURLOPT_XFERINFODATA, 0, 0, 0, 0);
+    downloadRateDuringReport = download.CURLOPT_MAX_RECV_SPEED_LARGE;
+    return mock_curl_easy_perform(curl);
+  }
+
+  downloadCurl = curl;
+  downloadRateAlone = options.CURLOPT_MAX_RECV_SPEED_LARGE;
+  gaus_session_t session = {strdup("fakeDeviceGUID"), strdup("fakeProductGUID"), strdup("fakeToken")};
+  char timestamp[] = "FAKE_TIMESTAMP";
+  char type[] = "Status";
+  gaus_report_header_t header = {timestamp};
+  gaus_report_t report = {};
+  report.report.update_status.type = type;
+  report.report.update_status.ts = timestamp;
+  report.report_type = GAUS_REPORT_UPDATE;
+  char *package = fakeResponse;
+  fakeResponse = strdup("{}");
+  gaus_error_t *status = gaus_report(&session, 0, NULL, &header, 1, &report);
+  free(fakeResponse);
+  fakeResponse = package;
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  options.CURLOPT_XFERINFOFUNCTION(options.CURLOPT_XFERINFODATA, 0, 0, 0, 0);
+  downloadRateAfterReport = options.CURLOPT_MAX_RECV_SPEED_LARGE;
+
+  free(session.device_guid);
+  free(session.product_guid);
+  free(session.token);
+  return mock_curl_easy_perform(curl);
+}
+
+TEST_F(GausDownloadUpdate, shares_max_bandwidth_with_reports) {
+  gaus_initialization_options_t initOptions = {};
+  initOptions.max_bandwidth = 5000;
+  gaus_global_init("fakeServer", &initOptions);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_report;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  //Alone the download gets everything, while the report runs it gets a fifth and the report the rest
+  EXPECT_EQ(5000, downloadRateAlone);
+  EXPECT_EQ(4000, reportRate);
+  EXPECT_EQ(1000, downloadRateDuringReport);
+  EXPECT_EQ(5000, downloadRateAfterReport);
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+static std::string md5Hex(const std::string &data) {
+  unsigned char digest[MD5_DIGEST_LENGTH];
+  char hex[MD5_DIGEST_LENGTH * 2 + 1];
+  md5_context_t context;
+  md5_init(&context);
+  md5_update(&context, data.data(), data.size());
+  md5_final(&context, digest);
+  for (int i = 0; i < MD5_DIGEST_LENGTH; i++) {
+    snprintf(hex + i * 2, 3, "%02x", digest[i]);
+  }
+  return hex;
+}
+
+static std::string gzipped(const std::string &data) {
+  z_stream stream = {};
+  std::string compressed(compressBound(data.size()) + 32, '\0');
+  deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+  stream.avail_out = compressed.size();
+  deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  return compressed;
+}
+
+static void appendOfftin(std::string &out, int64_t value) {
+  uint64_t magnitude = value < 0 ? -value : value;
+  for (int i = 0; i < 8; i++) {
+    unsigned char byte = static_cast<unsigned char>(magnitude >> (8 * i));
+    out.push_back(static_cast<char>(i == 7 && value < 0 ? byte | 0x80 : byte));
+  }
+}
+
+//A gzip compressed ENDSLEY/BSDIFF43 patch that diffs the start of target against base, skips back in base and adds
+//the rest of target as extra bytes.
+static std::string makePatch(const std::string &base, const std::string &target) {
+  size_t common = std::min(base.size(), target.size() / 2);
+  std::string patch = "ENDSLEY/BSDIFF43";
+  appendOfftin(patch, target.size());
+  appendOfftin(patch, common);
+  appendOfftin(patch, 0);
+  appendOfftin(patch, -static_cast<int64_t>(common / 2));
+  for (size_t i = 0; i < common; i++) {
+    patch.push_back(static_cast<char>(target[i] - base[i]));
+  }
+  appendOfftin(patch, 0);
+  appendOfftin(patch, target.size() - common);
+  appendOfftin(patch, 0);
+  patch.append(target, common, std::string::npos);
+  return gzipped(patch);
+}
+
+class GausDownloadDeltaUpdate : public GausDownloadUpdate {
+protected:
+  std::string basePath;
+  std::string base;
+  std::string target;
+  gaus_download_options_t options = {};
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    basePath = ::testing::TempDir() + "gaus_download_update_test.base";
+    for (int i = 0; i < 200000; i++) {
+      base.push_back(static_cast<char>('a' + i % 23));
+    }
+    std::ofstream(basePath, std::ios::binary) << base;
+    //Change every thousandth byte and append a tail that is not in base
+    target = base;
+    for (size_t i = 0; i < target.size(); i += 1000) {
+      target[i] = '#';
+    }
+    for (int i = 0; i < 150000; i++) {
+      target.push_back(static_cast<char>(i * 7));
+    }
+    setPatch(makePatch(base, target));
+
+    free(fakeUpdate.package_type);
+    fakeUpdate.package_type = strdup("delta");
+    fakeUpdate.base_version = strdup("0.9");
+    fakeUpdate.target_size = target.size();
+    fakeUpdate.target_md5 = strdup(md5Hex(target).c_str());
+    options.base_path = basePath.c_str();
+  }
+
+  virtual
+
+  void TearDown() {
+    unlink(basePath.c_str());
+    GausDownloadUpdate::TearDown();
+  }
+
+  void setPatch(const std::string &patch) {
+    free(fakeResponse);
+    fakeResponse = static_cast<char *>(malloc(patch.size()));
+    memcpy(fakeResponse, patch.data(), patch.size());
+    fakeResponseLength = patch.size();
+    fakeUpdate.size = patch.size();
+    free(fakeUpdate.md5);
+    fakeUpdate.md5 = strdup(md5Hex(patch).c_str());
+  }
+};
+
+TEST_F(GausDownloadDeltaUpdate, rebuilds_target_from_base_while_downloading) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_LT(fakeUpdate.size, target.size() / 10);
+  EXPECT_EQ(target, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadDeltaUpdate, starts_over_after_broken_transfer) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  fakeBreakAfter = 100;
+  fakeBreakCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(MOCK_NOT_SET_LONG, curlPerformData[1].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(target, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadDeltaUpdate, fails_on_wrong_base) {
+  gaus_global_init("fakeServer", NULL);
+  std::ofstream(basePath, std::ios::binary) << "not the base version";
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_CHECKSUM_ERROR, status->error_type);
+  freeError(status);
+}
+
+TEST_F(GausDownloadDeltaUpdate, fails_on_damaged_patch) {
+  gaus_global_init("fakeServer", NULL);
+  std::string patch = makePatch(base, target);
+  patch.resize(patch.size() / 2);
+  setPatch(patch);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  freeError(status);
+}
+
+TEST_F(GausDownloadDeltaUpdate, fails_without_base_path) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_EQ(0, curlPerformData.size());
+  freeError(status);
+}
+
+TEST(GausMd5, matches_rfc_1321_test_suite) {
+  std::pair<std::string, const char *> vectors[] = {
+      {"", "d41d8cd98f00b204e9800998ecf8427e"},
+      {"a", "0cc175b9c0f1b6a831c399e269772661"},
+      {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+      {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+      {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+      {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", "d174ab98d277d9f5a5611c2c9f419d9f"},
+      {"12345678901234567890123456789012345678901234567890123456789012345678901234567890",
+       "57edf4a22be3c955ac49da2e2107b67a"}
+  };
+
+  for (auto &vector : vectors) {
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    md5_context_t context;
+    md5_init(&context);
+    //Feed a byte at a time to cover partial blocks
+    for (char c : vector.first) {
+      md5_update(&context, &c, 1);
+    }
+    md5_final(&context, digest);
+    EXPECT_EQ(0, md5_compare_hex(digest, vector.second)) << vector.first;
+  }
+}
+
+static const char *fakeChunkIndexUrl = "https://fakeserver/package.chunks";
+//Served for fakeChunkIndexUrl, fakeResponse holds the package.
+static std::string fakeChunkIndex;
+//Number of range responses with a flipped byte, later ones are intact.
+static int fakeCorruptCount = 0;
+
+//Serve the chunk index, and fakeResponse as a whole or the requested range of it.
+static CURLcode mock_curl_easy_perform_with_chunks(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  curlPerformData.push_back(options);
+  curlPerformHandles.push_back(curl);
+  std::string body;
+  if (options.CURLOPT_URL == fakeChunkIndexUrl) {
+    body = fakeChunkIndex;
+  } else if (options.CURLOPT_RANGE != MOCK_NOT_SET) {
+    unsigned long long first = 0;
+    unsigned long long last = 0;
+    sscanf(options.CURLOPT_RANGE.c_str(), "%llu-%llu", &first, &last);
+    body.assign(fakeResponse + first, last - first + 1);
+    if (fakeCorruptCount > 0) {
+      fakeCorruptCount--;
+      body[body.size() / 2] ^= 1;
+    }
+  } else {
+    body.assign(fakeResponse, fakeResponseSize());
+  }
+  bool drop = fakeBreakCount > 0 && fakeBreakAfter >= 0 && static_cast<size_t>(fakeBreakAfter) < body.size();
+  if (drop) {
+    fakeBreakCount--;
+    body.resize(fakeBreakAfter);
+  }
+  if (!body.empty() && (*options.CURLOPT_WRITEFUNCTION)(&body[0], sizeof(char), body.size(),
+                                                         options.CURLOPT_WRITEDATA) != body.size()) {
+    return CURLE_WRITE_ERROR;
+  }
+  return drop ? CURLE_PARTIAL_FILE : CURLE_OK;
+}
+
+//Answer range requests with 206 like a server that supports them.
+static CURLcode mock_curl_easy_getinfo_with_ranges(CURL *curl, CURLINFO info, ...) {
+  va_list valist;
+  va_start(valist, info);
+  void *argument = va_arg(valist, void *);
+  va_end(valist);
+  if (info == CURLINFO_RESPONSE_CODE) {
+    std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+    *static_cast<long *>(argument) = allCurlData[curl].setOptions.CURLOPT_RANGE != MOCK_NOT_SET ? 206 : 200;
+    return CURLE_OK;
+  }
+  return mock_curl_easy_getinfo(curl, info, argument);
+}
+
+//Split package the way the library splits the base, and list the chunks.
+static std::string makeChunkIndex(const std::string &package) {
+  chunker_t chunker;
+  std::string chunks;
+  size_t start = 0;
+  chunker_init(&chunker, 256, 1024, 4096);
+  while (start < package.size()) {
+    size_t end = chunker_scan(&chunker, reinterpret_cast<const unsigned char *>(package.data()) + start,
+                              package.size() - start);
+    size_t length = end ? end : package.size() - start;
+    chunks += std::string(chunks.empty() ? "" : ",") + "{\"size\": " + std::to_string(length) + ", \"md5\": \"" +
+              md5Hex(package.substr(start, length)) + "\"}";
+    start += length;
+  }
+  return "{\"minSize\": 256, \"averageSize\": 1024, \"maxSize\": 4096, \"chunks\": [" + chunks + "]}";
+}
+
+//Bytes of the package fetched with range requests.
+static size_t rangeBytes() {
+  size_t bytes = 0;
+  for (CurlOptionsData &options : curlPerformData) {
+    unsigned long long first = 0;
+    unsigned long long last = 0;
+    if (sscanf(options.CURLOPT_RANGE.c_str(), "%llu-%llu", &first, &last) == 2) {
+      bytes += last - first + 1;
+    }
+  }
+  return bytes;
+}
+
+class GausDownloadChunkedUpdate : public GausDownloadUpdate {
+protected:
+  std::string basePath;
+  std::string storePath;
+  std::string base;
+  std::string target;
+  gaus_download_options_t options = {};
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    basePath = ::testing::TempDir() + "gaus_download_update_test.base";
+    storePath = ::testing::TempDir() + "gaus_download_update_test.store";
+    removeStore();
+    mkdir(storePath.c_str(), 0755);
+
+    std::mt19937 random(42);
+    for (int i = 0; i < 65536; i++) {
+      target.push_back(static_cast<char>(random()));
+    }
+    //The base lacks some bytes in the middle and has others changed
+    base = target.substr(0, 20000) + target.substr(20100);
+    for (size_t i = 40000; i < 41000; i++) {
+      base[i] = '#';
+    }
+    std::ofstream(basePath, std::ios::binary) << base;
+
+    free(fakeResponse);
+    fakeResponse = static_cast<char *>(malloc(target.size()));
+    memcpy(fakeResponse, target.data(), target.size());
+    fakeResponseLength = target.size();
+    fakeUpdate.size = target.size();
+    free(fakeUpdate.md5);
+    fakeUpdate.md5 = strdup(md5Hex(target).c_str());
+    fakeUpdate.chunk_index_url = strdup(fakeChunkIndexUrl);
+    fakeChunkIndex = makeChunkIndex(target);
+    fakeCorruptCount = 0;
+    options.base_path = basePath.c_str();
+    gaus_curl_easy_perform = mock_curl_easy_perform_with_chunks;
+    gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_ranges;
+  }
+
+  virtual
+
+  void TearDown() {
+    unlink(basePath.c_str());
+    removeStore();
+    GausDownloadUpdate::TearDown();
+  }
+
+  int storedChunks() {
+    int count = 0;
+    DIR *directory = opendir(storePath.c_str());
+    while (struct dirent *entry = readdir(directory)) {
+      count += entry->d_name[0] != '.';
+    }
+    closedir(directory);
+    return count;
+  }
+
+  void removeStore() {
+    DIR *directory = opendir(storePath.c_str());
+    if (directory) {
+      while (struct dirent *entry = readdir(directory)) {
+        unlink((storePath + "/" + entry->d_name).c_str());
+      }
+      closedir(directory);
+    }
+    rmdir(storePath.c_str());
+  }
+};
+
+TEST_F(GausDownloadChunkedUpdate, downloads_only_chunks_missing_from_base) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_LT(1, curlPerformData.size());
+  EXPECT_EQ(fakeChunkIndexUrl, curlPerformData[0].CURLOPT_URL);
+  for (size_t i = 1; i < curlPerformData.size(); i++) {
+    EXPECT_EQ(fakeUpdate.download_url, curlPerformData[i].CURLOPT_URL);
+    EXPECT_NE(MOCK_NOT_SET, curlPerformData[i].CURLOPT_RANGE);
+  }
+  //Only the chunks around the two changes are fetched
+  EXPECT_LT(0, rangeBytes());
+  EXPECT_GT(target.size() / 4, rangeBytes());
+  EXPECT_EQ(target, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadChunkedUpdate, reuses_chunks_added_to_store) {
+  gaus_global_init("fakeServer", NULL);
+  options.base_path = NULL;
+  options.chunk_store_path = storePath.c_str();
+  std::string secondDestination = destination + ".second";
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(target.size(), rangeBytes());
+  EXPECT_LT(0, storedChunks());
+
+  curlPerformData.clear();
+  status = gaus_download_update(&fakeSession, &fakeUpdate, secondDestination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(fakeChunkIndexUrl, curlPerformData[0].CURLOPT_URL);
+  EXPECT_EQ(target, readFile(secondDestination));
+  unlink(secondDestination.c_str());
+}
+
+TEST_F(GausDownloadChunkedUpdate, keeps_chunks_already_in_destination) {
+  gaus_global_init("fakeServer", NULL);
+  options.base_path = NULL;
+  options.chunk_store_path = storePath.c_str();
+  std::ofstream(destination, std::ios::binary) << target.substr(0, target.size() / 2);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  //The second half and the chunk cut off in the middle
+  EXPECT_LE(target.size() / 2, rangeBytes());
+  EXPECT_GE(target.size() / 2 + 4096, rangeBytes());
+  EXPECT_EQ(target, readFile(destination));
+}
+
+TEST_F(GausDownloadChunkedUpdate, fetches_chunks_that_do_not_match_again) {
+  gaus_global_init("fakeServer", NULL);
+  fakeCorruptCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_LT(2, curlPerformData.size());
+  //The corrupted first range is asked for again from the chunk that did not match
+  unsigned long long first[2];
+  unsigned long long last[2];
+  ASSERT_EQ(2, sscanf(curlPerformData[1].CURLOPT_RANGE.c_str(), "%llu-%llu", &first[0], &last[0]));
+  ASSERT_EQ(2, sscanf(curlPerformData.back().CURLOPT_RANGE.c_str(), "%llu-%llu", &first[1], &last[1]));
+  EXPECT_LE(first[0], first[1]);
+  EXPECT_EQ(last[0], last[1]);
+  EXPECT_EQ(target, readFile(destination));
+}
+
+TEST_F(GausDownloadChunkedUpdate, downloads_whole_package_without_range_support) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(fakeUpdate.download_url, curlPerformData.back().CURLOPT_URL);
+  EXPECT_EQ(MOCK_NOT_SET, curlPerformData.back().CURLOPT_RANGE);
+  EXPECT_EQ(target, readFile(destination));
+}
+
+//A link where each stream gets at most perStream bytes per second and all of them together at most total.
+static unsigned int settledStreams(unsigned int maxStreams, curl_off_t perStream, curl_off_t total) {
+  stream_control_t control;
+  long long now = 0;
+  stream_control_init(&control, maxStreams);
+  stream_control_update(&control, 1, now);
+  for (int second = 0; second < 60; second++) {
+    now += 1000;
+    stream_control_update(&control, std::min(perStream * control.streams, total), now);
+  }
+  return control.streams;
+}
+
+TEST(GausStreamControl, adds_streams_until_the_link_is_full) {
+  EXPECT_EQ(4, settledStreams(8, 100000, 350000));
+  EXPECT_EQ(1, settledStreams(8, 100000, 100000));
+}
+
+TEST(GausStreamControl, stays_within_max_streams) {
+  EXPECT_EQ(3, settledStreams(3, 100000, 1000000));
+  EXPECT_EQ(1, settledStreams(1, 100000, 1000000));
+}
+
+class GausDownloadSegmentedUpdate : public GausDownloadUpdate {
+protected:
+  std::string package;
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    std::mt19937 random(7);
+    for (int i = 0; i < 1024 * 1024 + 100; i++) {
+      package.push_back(static_cast<char>(random()));
+    }
+    free(fakeResponse);
+    fakeResponse = static_cast<char *>(malloc(package.size()));
+    memcpy(fakeResponse, package.data(), package.size());
+    fakeResponseLength = package.size();
+    fakeUpdate.size = package.size();
+    free(fakeUpdate.md5);
+    fakeUpdate.md5 = strdup(md5Hex(package).c_str());
+    fakeBreakCount = 0;
+    gaus_curl_easy_perform = mock_curl_easy_perform_with_chunks;
+    gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_ranges;
+  }
+};
+
+TEST_F(GausDownloadSegmentedUpdate, downloads_segments_into_place) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_LT(1, curlPerformData.size());
+  unsigned long long expectedFirst = 0;
+  for (CurlOptionsData &options : curlPerformData) {
+    unsigned long long first = 0;
+    unsigned long long last = 0;
+    ASSERT_EQ(2, sscanf(options.CURLOPT_RANGE.c_str(), "%llu-%llu", &first, &last));
+    EXPECT_EQ(expectedFirst, first);
+    expectedFirst = last + 1;
+  }
+  EXPECT_EQ(package.size(), expectedFirst);
+  EXPECT_EQ(package, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadSegmentedUpdate, downloads_over_one_stream_if_asked_to) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_download_options_t options = {};
+  options.max_streams = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(MOCK_NOT_SET, curlPerformData[0].CURLOPT_RANGE);
+  EXPECT_EQ(package, readFile(destination));
+}
+
+static int copyRange(request_range_t *range, const char *data, size_t length) {
+  std::string *copy = static_cast<std::string *>(range->user_data);
+  copy->replace(static_cast<size_t>(range->offset + range->received), length, data, length);
+  return 0;
+}
+
+TEST_F(GausDownloadSegmentedUpdate, fetches_ranges_while_other_transfers_hold_connections_to_the_host) {
+  gaus_initialization_options_t initOptions = {};
+  initOptions.max_connections_per_host = 2;
+  gaus_global_init("fakeServer", &initOptions);
+  //Another transfer to the same host, the ranges get the one handle left
+  CURL *held = connection_pool_acquire(gaus_current_client()->pool, fakeUpdate.download_url);
+  ASSERT_NE(static_cast<CURL *>(NULL), held);
+  std::string copy(package.size(), '\0');
+  curl_off_t half = static_cast<curl_off_t>(package.size() / 2);
+  request_range_t ranges[2] = {
+      {0, half, 0, 0, &copy},
+      {half, static_cast<curl_off_t>(package.size()) - half, 0, 0, &copy}
+  };
+  stream_control_t control;
+  stream_control_init(&control, 2);
+  control.streams = 2;
+
+  int result = request_get_ranges(fakeUpdate.download_url, "fakeToken", ranges, 2, &control, BANDWIDTH_BULK, NULL,
+                                  copyRange);
+
+  connection_pool_release(gaus_current_client()->pool, held);
+  EXPECT_EQ(0, result);
+  EXPECT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(package, copy);
+}
+
+TEST_F(GausDownloadSegmentedUpdate, continues_broken_segments) {
+  gaus_global_init("fakeServer", NULL);
+  fakeBreakAfter = 1000;
+  fakeBreakCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  unsigned long long first = 0;
+  unsigned long long last = 0;
+  ASSERT_EQ(2, sscanf(curlPerformData.back().CURLOPT_RANGE.c_str(), "%llu-%llu", &first, &last));
+  //Only the first segment broke, it is continued where it stopped
+  EXPECT_EQ(1000, first);
+  EXPECT_EQ(package, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadSegmentedUpdate, downloads_over_one_stream_without_range_support) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(MOCK_NOT_SET, curlPerformData.back().CURLOPT_RANGE);
+  EXPECT_EQ(package, readFile(destination));
+}
+
+static std::string md5Raw(const std::string &data) {
+  unsigned char digest[MD5_DIGEST_LENGTH];
+  md5_context_t context;
+  md5_init(&context);
+  md5_update(&context, data.data(), data.size());
+  md5_final(&context, digest);
+  return std::string(reinterpret_cast<char *>(digest), MD5_DIGEST_LENGTH);
+}
+
+static std::string hexOf(const std::string &digest) {
+  char hex[MD5_HEX_LENGTH + 1];
+  md5_to_hex(reinterpret_cast<const unsigned char *>(digest.data()), hex);
+  return hex;
+}
+
+TEST(GausHashTree, hashes_pairs_and_takes_up_the_odd_node) {
+  std::string leaves[] = {md5Raw("a"), md5Raw("b"), md5Raw("c")};
+  unsigned char packed[3][MD5_DIGEST_LENGTH];
+  unsigned char root[MD5_DIGEST_LENGTH];
+  for (int i = 0; i < 3; i++) {
+    memcpy(packed[i], leaves[i].data(), MD5_DIGEST_LENGTH);
+  }
+
+  ASSERT_EQ(0, hash_tree_root(packed, 3, root));
+  EXPECT_EQ(md5Raw(md5Raw(leaves[0] + leaves[1]) + leaves[2]),
+            std::string(reinterpret_cast<char *>(root), MD5_DIGEST_LENGTH));
+  ASSERT_EQ(0, hash_tree_root(packed, 1, root));
+  EXPECT_EQ(leaves[0], std::string(reinterpret_cast<char *>(root), MD5_DIGEST_LENGTH));
+}
+
+TEST(GausHashTree, accepts_only_trees_matching_their_root_and_size) {
+  hash_tree_t tree;
+  std::string leaves[] = {md5Raw("0123"), md5Raw("45")};
+  std::string document = "{\"chunkSize\": 4, \"chunks\": [\"" + hexOf(leaves[0]) + "\", \"" + hexOf(leaves[1]) + "\"]}";
+  std::string root = hexOf(md5Raw(leaves[0] + leaves[1]));
+
+  ASSERT_EQ(0, hash_tree_parse(&tree, document.c_str(), 6, root.c_str()));
+  EXPECT_EQ(4, tree.chunk_size);
+  EXPECT_EQ(1, hash_tree_chunk(&tree, 5));
+  EXPECT_EQ(6, hash_tree_chunk_end(&tree, 1, 6));
+  md5_context_t md5;
+  md5_init(&md5);
+  md5_update(&md5, "45", 2);
+  EXPECT_TRUE(hash_tree_check(&tree, 1, &md5));
+  EXPECT_FALSE(hash_tree_check(&tree, 0, &md5));
+  hash_tree_free(&tree);
+
+  EXPECT_NE(0, hash_tree_parse(&tree, document.c_str(), 6, hexOf(leaves[0]).c_str()));
+  EXPECT_NE(0, hash_tree_parse(&tree, document.c_str(), 9, root.c_str()));
+  EXPECT_NE(0, hash_tree_parse(&tree, "{\"chunkSize\": 0, \"chunks\": []}", 6, root.c_str()));
+  EXPECT_EQ(nullptr, tree.chunks);
+}
+
+static const char *fakeHashTreeUrl = "https://fakeserver/package.tree";
+static const size_t fakeTreeChunkSize = 64 * 1024;
+//Served for fakeHashTreeUrl, fakeResponse holds the package.
+static std::string fakeHashTree;
+//Byte of the package flipped in the next fakeCorruptCount responses that carry it.
+static size_t fakeCorruptAt = 0;
+
+static CURLcode mock_curl_easy_perform_with_hash_tree(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  curlPerformData.push_back(options);
+  curlPerformHandles.push_back(curl);
+  std::string body;
+  size_t first = 0;
+  if (options.CURLOPT_URL == fakeHashTreeUrl) {
+    body = fakeHashTree;
+  } else {
+    unsigned long long last = fakeResponseSize() - 1;
+    if (options.CURLOPT_RANGE != MOCK_NOT_SET) {
+      unsigned long long rangeFirst = 0;
+      sscanf(options.CURLOPT_RANGE.c_str(), "%llu-%llu", &rangeFirst, &last);
+      first = rangeFirst;
+    } else if (options.CURLOPT_RESUME_FROM_LARGE > 0) {
+      first = options.CURLOPT_RESUME_FROM_LARGE;
+    }
+    body.assign(fakeResponse + first, last - first + 1);
+    if (fakeCorruptCount > 0 && fakeCorruptAt >= first && fakeCorruptAt <= last) {
+      fakeCorruptCount--;
+      body[fakeCorruptAt - first] ^= 1;
+    }
+  }
+  bool drop = fakeBreakCount > 0 && fakeBreakAfter >= 0 && static_cast<size_t>(fakeBreakAfter) < body.size();
+  if (drop) {
+    fakeBreakCount--;
+    body.resize(fakeBreakAfter);
+  }
+  if (!body.empty() && (*options.CURLOPT_WRITEFUNCTION)(&body[0], sizeof(char), body.size(),
+                                                         options.CURLOPT_WRITEDATA) != body.size()) {
+    return CURLE_WRITE_ERROR;
+  }
+  return drop ? CURLE_PARTIAL_FILE : CURLE_OK;
+}
+
+class GausDownloadHashTreeUpdate : public GausDownloadSegmentedUpdate {
+protected:
+  virtual void SetUp() {
+    GausDownloadSegmentedUpdate::SetUp();
+    std::vector<std::string> level;
+    fakeHashTree = "{\"chunkSize\": " + std::to_string(fakeTreeChunkSize) + ", \"chunks\": [";
+    for (size_t offset = 0; offset < package.size(); offset += fakeTreeChunkSize) {
+      level.push_back(md5Raw(package.substr(offset, fakeTreeChunkSize)));
+      fakeHashTree += (offset ? ", \"" : "\"") + hexOf(level.back()) + "\"";
+    }
+    fakeHashTree += "]}";
+    while (level.size() > 1) {
+      std::vector<std::string> parents;
+      for (size_t i = 0; i < level.size(); i += 2) {
+        parents.push_back(i + 1 < level.size() ? md5Raw(level[i] + level[i + 1]) : level[i]);
+      }
+      level = parents;
+    }
+    fakeUpdate.hash_tree_url = strdup(fakeHashTreeUrl);
+    fakeUpdate.hash_tree_root = strdup(hexOf(level[0]).c_str());
+    fakeCorruptAt = 400000;
+    fakeCorruptCount = 0;
+    gaus_curl_easy_perform = mock_curl_easy_perform_with_hash_tree;
+  }
+};
+
+TEST_F(GausDownloadHashTreeUpdate, fetches_only_bad_chunk_of_a_segment_again) {
+  gaus_global_init("fakeServer", NULL);
+  fakeCorruptCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(fakeHashTreeUrl, curlPerformData[0].CURLOPT_URL);
+  //The chunk holding the flipped byte starts at 393216, the segment it is part of before it
+  unsigned long long first = 0;
+  unsigned long long last = 0;
+  ASSERT_EQ(2, sscanf(curlPerformData.back().CURLOPT_RANGE.c_str(), "%llu-%llu", &first, &last));
+  EXPECT_EQ(6 * fakeTreeChunkSize, first);
+  EXPECT_EQ(package, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadHashTreeUpdate, fetches_only_bad_chunk_of_a_single_stream_again) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_download_options_t options = {};
+  options.max_streams = 1;
+  fakeCorruptCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(3, curlPerformData.size());
+  EXPECT_EQ(6 * fakeTreeChunkSize, curlPerformData[2].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(package, readFile(destination));
+}
+
+TEST_F(GausDownloadHashTreeUpdate, journals_only_checked_chunks) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_download_options_t options = {};
+  options.max_streams = 1;
+  options.max_attempts = 1;
+  fakeBreakAfter = 100000;
+  fakeBreakCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  freeError(status);
+  status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(4, curlPerformData.size());
+  //The second chunk was in progress when the transfer broke off
+  EXPECT_EQ(fakeTreeChunkSize, curlPerformData[3].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(package, readFile(destination));
+}
+
+TEST_F(GausDownloadHashTreeUpdate, checks_whole_package_if_tree_does_not_match_root) {
+  gaus_global_init("fakeServer", NULL);
+  free(fakeUpdate.hash_tree_root);
+  fakeUpdate.hash_tree_root = strdup(fakeUpdate.md5);
+  fakeCorruptCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_CHECKSUM_ERROR, status->error_type);
+  freeError(status);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL),
+            gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), NULL));
+  EXPECT_EQ(package, readFile(destination));
+}
+
+//Append a ustar entry to an archive.
+static void addTarEntry(std::string &archive, const std::string &name, const std::string &contents, char type = '0',
+                        const std::string &link = "", unsigned int mode = 0644) {
+  std::string header(512, '\0');
+  name.copy(&header[0], 100);
+  snprintf(&header[100], 8, "%07o", mode);
+  snprintf(&header[108], 8, "%07o", 0);
+  snprintf(&header[116], 8, "%07o", 0);
+  snprintf(&header[124], 12, "%011zo", contents.size());
+  snprintf(&header[136], 12, "%011o", 0);
+  header.replace(148, 8, 8, ' ');
+  header[156] = type;
+  link.copy(&header[157], 100);
+  memcpy(&header[257], "ustar\0" "00", 8);
+  unsigned int sum = 0;
+  for (char c : header) {
+    sum += static_cast<unsigned char>(c);
+  }
+  snprintf(&header[148], 8, "%06o", sum);
+  archive += header;
+  archive += contents;
+  archive.append((512 - contents.size() % 512) % 512, '\0');
+}
+
+static void removeTree(const std::string &path) {
+  struct stat info;
+  if (lstat(path.c_str(), &info) != 0) {
+    return;
+  }
+  if (S_ISDIR(info.st_mode)) {
+    DIR *directory = opendir(path.c_str());
+    while (struct dirent *entry = readdir(directory)) {
+      if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+        removeTree(path + "/" + entry->d_name);
+      }
+    }
+    closedir(directory);
+    rmdir(path.c_str());
+  } else {
+    unlink(path.c_str());
+  }
+}
+
+class GausDownloadExtractedUpdate : public GausDownloadUpdate {
+protected:
+  std::string extractPath;
+  std::string app;
+  std::string config = "server=fakeServer\n";
+  std::string longName;
+  gaus_download_options_t options = {};
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    extractPath = ::testing::TempDir() + "gaus_download_update_test.d";
+    removeTree(extractPath);
+    mkdir(extractPath.c_str(), 0755);
+    options.extract_path = extractPath.c_str();
+
+    std::mt19937 random(3);
+    for (int i = 0; i < 300000; i++) {
+      app.push_back(static_cast<char>(random() % 4));
+    }
+    longName = "share/" + std::string(150, 'n');
+  }
+
+  virtual
+
+  void TearDown() {
+    removeTree(extractPath);
+    removeTree(::testing::TempDir() + "escaped");
+    GausDownloadUpdate::TearDown();
+  }
+
+  std::string makeArchive(size_t appCopies = 1) {
+    std::string archive;
+    addTarEntry(archive, "./bin/", "", '5', "", 0755);
+    std::string appContents;
+    for (size_t i = 0; i < appCopies; i++) {
+      appContents += app;
+    }
+    addTarEntry(archive, "./bin/app", appContents, '0', "", 0755);
+    addTarEntry(archive, "./etc/config", config);
+    addTarEntry(archive, "./current", "", '2', "bin/app");
+    addTarEntry(archive, "././@LongLink", longName + '\0', 'L');
+    addTarEntry(archive, longName.substr(0, 100), config);
+    archive.append(1024, '\0');
+    return archive;
+  }
+
+  void setPackage(const std::string &package) {
+    free(fakeResponse);
+    fakeResponse = static_cast<char *>(malloc(package.size()));
+    memcpy(fakeResponse, package.data(), package.size());
+    fakeResponseLength = package.size();
+    fakeUpdate.size = package.size();
+    free(fakeUpdate.md5);
+    fakeUpdate.md5 = strdup(md5Hex(package).c_str());
+  }
+
+  void expectExtracted(size_t appCopies = 1) {
+    std::string appContents;
+    for (size_t i = 0; i < appCopies; i++) {
+      appContents += app;
+    }
+    EXPECT_EQ(appContents, readFile(extractPath + "/bin/app"));
+    EXPECT_EQ(config, readFile(extractPath + "/etc/config"));
+    EXPECT_EQ(config, readFile(extractPath + "/" + longName));
+    char link[32] = {};
+    EXPECT_LT(0, readlink((extractPath + "/current").c_str(), link, sizeof(link) - 1));
+    EXPECT_STREQ("bin/app", link);
+    struct stat info;
+    ASSERT_EQ(0, stat((extractPath + "/bin/app").c_str(), &info));
+    EXPECT_EQ(0755, info.st_mode & 0777);
+  }
+};
+
+TEST_F(GausDownloadExtractedUpdate, extracts_compressed_archive_while_downloading) {
+  gaus_global_init("fakeServer", NULL);
+  std::string package = gzipped(makeArchive());
+  setPackage(package);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  expectExtracted();
+  EXPECT_EQ(package, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadExtractedUpdate, extracts_archive_downloaded_in_segments) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_chunks;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_ranges;
+  setPackage(makeArchive(4));
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_NE(MOCK_NOT_SET, curlPerformData[0].CURLOPT_RANGE);
+  expectExtracted(4);
+}
+
+TEST_F(GausDownloadExtractedUpdate, extracts_what_a_resumed_download_already_has) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  setPackage(gzipped(makeArchive()));
+  options.max_attempts = 1;
+  fakeBreakAfter = 5000;
+  fakeBreakCount = 1;
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  freeError(status);
+
+  status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(5000, curlPerformData[1].CURLOPT_RESUME_FROM_LARGE);
+  expectExtracted();
+}
+
+TEST_F(GausDownloadExtractedUpdate, refuses_entries_outside_of_directory) {
+  gaus_global_init("fakeServer", NULL);
+  std::string archive;
+  addTarEntry(archive, "../escaped", config);
+  archive.append(1024, '\0');
+  setPackage(gzipped(archive));
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+  EXPECT_FALSE(fileExists(::testing::TempDir() + "escaped"));
+  freeError(status);
+}
+
+class GausDownloadDirectUpdate : public GausDownloadUpdate {
+protected:
+  std::string package;
+  gaus_download_options_t options = {};
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    std::mt19937 random(11);
+    //Not a whole number of blocks, so the end goes through the page cache
+    for (int i = 0; i < 3 * 1024 * 1024 + 123; i++) {
+      package.push_back(static_cast<char>(random()));
+    }
+    free(fakeResponse);
+    fakeResponse = static_cast<char *>(malloc(package.size()));
+    memcpy(fakeResponse, package.data(), package.size());
+    fakeResponseLength = package.size();
+    fakeUpdate.size = package.size();
+    free(fakeUpdate.md5);
+    fakeUpdate.md5 = strdup(md5Hex(package).c_str());
+    gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+    options.direct_io = true;
+  }
+};
+
+TEST_F(GausDownloadDirectUpdate, writes_package_with_direct_io) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(MOCK_NOT_SET, curlPerformData[0].CURLOPT_RANGE);
+  EXPECT_EQ(package, readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadDirectUpdate, continues_in_the_middle_of_a_block) {
+  gaus_global_init("fakeServer", NULL);
+  fakeBreakAfter = 700001;
+  fakeBreakCount = 2;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(3, curlPerformData.size());
+  EXPECT_EQ(1400002, curlPerformData[2].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(package, readFile(destination));
+}
+
+TEST_F(GausDownloadDirectUpdate, resumes_from_the_journal_in_the_middle_of_a_block) {
+  gaus_global_init("fakeServer", NULL);
+  options.max_attempts = 1;
+  fakeBreakAfter = 1000001;
+  fakeBreakCount = 1;
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  freeError(status);
+
+  status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(1000001, curlPerformData[1].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(package, readFile(destination));
+}
+
+class GausDownloadCachedUpdate : public GausDownloadUpdate {
+protected:
+  std::string cachePath;
+  std::string cachedPackage;
+  gaus_download_options_t options = {};
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    cachePath = ::testing::TempDir() + "gaus_download_update_test.cache";
+    removeTree(cachePath);
+    mkdir(cachePath.c_str(), 0755);
+    cachedPackage = cachePath + "/e9b1713db620f1e3a14b6812de523f4b";
+    options.artifact_cache_path = cachePath.c_str();
+    gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  }
+
+  virtual
+
+  void TearDown() {
+    removeTree(cachePath);
+    GausDownloadUpdate::TearDown();
+  }
+
+  //Add an entry last used seconds ago
+  void addEntry(const std::string &name, const std::string &contents, int age) {
+    std::string path = cachePath + "/" + name;
+    std::ofstream(path, std::ios::binary) << contents;
+    struct timespec times[2];
+    clock_gettime(CLOCK_REALTIME, &times[0]);
+    times[0].tv_sec -= age;
+    times[1] = times[0];
+    utimensat(AT_FDCWD, path.c_str(), times, 0);
+  }
+};
+
+TEST_F(GausDownloadCachedUpdate, copies_cached_package_instead_of_downloading) {
+  gaus_global_init("fakeServer", NULL);
+  std::ofstream(cachedPackage, std::ios::binary) << fakePackage;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(0, curlPerformData.size());
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+TEST_F(GausDownloadCachedUpdate, adds_downloaded_package_to_cache) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(fakePackage, readFile(cachedPackage));
+}
+
+TEST_F(GausDownloadCachedUpdate, downloads_package_again_if_cached_one_is_damaged) {
+  gaus_global_init("fakeServer", NULL);
+  std::string damaged = fakePackage;
+  damaged[3] = '#';
+  std::ofstream(cachedPackage, std::ios::binary) << damaged;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(fakePackage, readFile(destination));
+  EXPECT_EQ(fakePackage, readFile(cachedPackage));
+}
+
+TEST_F(GausDownloadCachedUpdate, does_not_resume_on_damaged_cached_package) {
+  gaus_global_init("fakeServer", NULL);
+  //Larger than the write buffer, so the damaged copy reaches the destination before it is found out
+  std::string package(1024 * 1024, 'p');
+  free(fakeResponse);
+  fakeResponse = static_cast<char *>(malloc(package.size()));
+  memcpy(fakeResponse, package.data(), package.size());
+  fakeResponseLength = package.size();
+  fakeUpdate.size = package.size();
+  free(fakeUpdate.md5);
+  fakeUpdate.md5 = strdup(md5Hex(package).c_str());
+  options.max_streams = 1;
+  std::string damaged = package;
+  damaged[3] = '#';
+  std::ofstream(cachePath + "/" + fakeUpdate.md5, std::ios::binary) << damaged;
+  //A download into the destination that broke off earlier
+  std::ofstream(destination) << package.substr(0, 8);
+  writeJournal(journal, fakeUpdate.update_id, fakeUpdate.size, fakeUpdate.md5, 8, package);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  //The damaged copy overwrote those bytes, the download starts over
+  EXPECT_EQ(MOCK_NOT_SET_LONG, curlPerformData[0].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_TRUE(package == readFile(destination));
+  EXPECT_FALSE(fileExists(journal));
+}
+
+TEST_F(GausDownloadCachedUpdate, removes_least_recently_used_packages) {
+  gaus_global_init("fakeServer", NULL);
+  std::string oldest = "00000000000000000000000000000001";
+  std::string older = "00000000000000000000000000000002";
+  addEntry(oldest, std::string(20, 'a'), 200);
+  addEntry(older, std::string(20, 'b'), 100);
+  //Room for the new package and one of the others
+  options.artifact_cache_size = fakePackage.size() + 20;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_FALSE(fileExists(cachePath + "/" + oldest));
+  EXPECT_TRUE(fileExists(cachePath + "/" + older));
+  EXPECT_EQ(fakePackage, readFile(cachedPackage));
+}
+
+//Fetch http://127.0.0.1:<port><path> for real, from the cache server of a peer started by the test.
+static bool fetchFromPeer(const std::string &url, std::string &body) {
+  const std::string prefix = "http://127.0.0.1:";
+  if (url.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<uint16_t>(std::stoi(url.substr(prefix.size()))));
+  inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+  std::string request = "GET " + url.substr(url.find('/', prefix.size())) +
+                        " HTTP/1.1\r\nHost: peer\r\nConnection: close\r\n\r\n";
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  std::string response;
+  char buffer[4096];
+  ssize_t received;
+  if (connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0 &&
+      send(fd, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size())) {
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      response.append(buffer, received);
+    }
+  }
+  close(fd);
+  size_t head_end = response.find("\r\n\r\n");
+  if (response.compare(0, 15, "HTTP/1.1 200 OK") != 0 || head_end == std::string::npos) {
+    return false;
+  }
+  body = response.substr(head_end + 4);
+  return true;
+}
+
+//Download from the peers started by the test, and from the fake server otherwise.
+static CURLcode mock_curl_easy_perform_from_peers(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  CurlOptionsData &options = allCurlData[curl].setOptions;
+  if (options.CURLOPT_URL.compare(0, 7, "http://") != 0) {
+    return mock_curl_easy_perform_with_range(curl);
+  }
+  curlPerformData.push_back(options);
+  curlPerformHandles.push_back(curl);
+  std::string body;
+  if (!fetchFromPeer(options.CURLOPT_URL, body)) {
+    return CURLE_COULDNT_CONNECT;
+  }
+  if (!body.empty() && (*options.CURLOPT_WRITEFUNCTION)(const_cast<char *>(body.data()), sizeof(char), body.size(),
+                                                         options.CURLOPT_WRITEDATA) != body.size()) {
+    return CURLE_WRITE_ERROR;
+  }
+  return CURLE_OK;
+}
+
+class GausDownloadPeerUpdate : public GausDownloadUpdate {
+protected:
+  std::string ownCachePath;
+  std::string peerCachePaths[2];
+  gaus_peer_t *peers[2] = {nullptr, nullptr};
+  gaus_peer_options_t peerOptions = {};
+  gaus_download_options_t options = {};
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    ownCachePath = ::testing::TempDir() + "gaus_download_update_test.own";
+    removeTree(ownCachePath);
+    mkdir(ownCachePath.c_str(), 0755);
+    peerOptions.cache_path = ownCachePath.c_str();
+    peerOptions.address = "127.0.0.1";
+    //Away from the default group and port, so devices on the network running the tests are not asked.
+    peerOptions.group = "239.255.71.72";
+    peerOptions.port = 47172;
+    options.peers = &peerOptions;
+    gaus_curl_easy_perform = mock_curl_easy_perform_from_peers;
+  }
+
+  virtual
+
+  void TearDown() {
+    for (int i = 0; i < 2; i++) {
+      gaus_peer_stop(peers[i]);
+      removeTree(peerCachePaths[i]);
+    }
+    removeTree(ownCachePath);
+    GausDownloadUpdate::TearDown();
+  }
+
+  //Start a peer on loopback keeping package, or nothing if it is empty.
+  void startPeer(int index, const std::string &package) {
+    peerCachePaths[index] = ::testing::TempDir() + "gaus_download_update_test.peer" + std::to_string(index);
+    removeTree(peerCachePaths[index]);
+    mkdir(peerCachePaths[index].c_str(), 0755);
+    if (!package.empty()) {
+      std::ofstream(peerCachePaths[index] + "/e9b1713db620f1e3a14b6812de523f4b", std::ios::binary) << package;
+    }
+    gaus_peer_options_t options = peerOptions;
+    options.cache_path = peerCachePaths[index].c_str();
+    ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_peer_start(&options, &peers[index]));
+  }
+};
+
+TEST_F(GausDownloadPeerUpdate, downloads_package_from_peer_that_has_it) {
+  gaus_global_init("fakeServer", NULL);
+  startPeer(0, "");
+  startPeer(1, fakePackage);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  std::string url = curlPerformData[0].CURLOPT_URL;
+  EXPECT_EQ(0, url.find("http://127.0.0.1:"));
+  EXPECT_EQ(url.size() - strlen(fakePackageMd5), url.find(fakePackageMd5));
+  for (const std::string &header : curlPerformData[0].CURLOPT_HEADER) {
+    EXPECT_EQ(std::string::npos, header.find("Authorization"));
+  }
+  EXPECT_EQ(fakePackage, readFile(destination));
+  //Kept to be served to the next peers
+  EXPECT_EQ(fakePackage, readFile(ownCachePath + "/e9b1713db620f1e3a14b6812de523f4b"));
+}
+
+TEST_F(GausDownloadPeerUpdate, downloads_from_server_when_no_peer_has_package) {
+  gaus_global_init("fakeServer", NULL);
+  startPeer(0, "");
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(fakeUpdate.download_url, curlPerformData[0].CURLOPT_URL);
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+TEST_F(GausDownloadPeerUpdate, downloads_from_server_when_peer_package_is_damaged) {
+  gaus_global_init("fakeServer", NULL);
+  std::string damaged = fakePackage;
+  damaged[3] = '#';
+  startPeer(0, damaged);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(0, curlPerformData[0].CURLOPT_URL.find("http://127.0.0.1:"));
+  EXPECT_EQ(fakeUpdate.download_url, curlPerformData[1].CURLOPT_URL);
+  EXPECT_EQ(fakePackage, readFile(destination));
+  EXPECT_EQ(fakePackage, readFile(ownCachePath + "/e9b1713db620f1e3a14b6812de523f4b"));
+}
+
+TEST_F(GausDownloadPeerUpdate, serves_downloaded_package_to_next_peer) {
+  gaus_global_init("fakeServer", NULL);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(),
+                                                                    &options));
+  gaus_peer_options_t ownOptions = peerOptions;
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_peer_start(&ownOptions, &peers[0]));
+  std::string nextCachePath = ::testing::TempDir() + "gaus_download_update_test.next";
+  removeTree(nextCachePath);
+  mkdir(nextCachePath.c_str(), 0755);
+  gaus_peer_options_t nextOptions = peerOptions;
+  nextOptions.cache_path = nextCachePath.c_str();
+  options.peers = &nextOptions;
+  unlink(destination.c_str());
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(0, curlPerformData[1].CURLOPT_URL.find("http://127.0.0.1:"));
+  EXPECT_EQ(fakePackage, readFile(destination));
+  removeTree(nextCachePath);
+}
+
+TEST_F(GausDownloadPeerUpdate, fails_to_start_with_invalid_group) {
+  gaus_peer_t *peer = nullptr;
+  peerOptions.group = "10.0.0.1";
+
+  gaus_error_t *status = gaus_peer_start(&peerOptions, &peer);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(nullptr, peer);
+  freeError(status);
+}
+
+TEST(GausDownloadSources, tries_mirrors_not_used_yet_first) {
+  const char *mirrors[] = {"https://mirror1/package", "https://mirror2/package"};
+  download_sources_t sources;
+  ASSERT_EQ(0, download_sources_init(&sources, "https://fakeserver/package", "fakeToken", mirrors, 2));
+
+  EXPECT_EQ(0, download_sources_record(&sources, 1000, 1000, false, 0));
+  EXPECT_EQ(1, sources.current);
+  EXPECT_EQ(nullptr, sources.sources[1].auth_token);
+  EXPECT_EQ(0, download_sources_record(&sources, 10, 1000, false, 0));
+  EXPECT_EQ(2, sources.current);
+  download_sources_free(&sources);
+}
+
+TEST(GausDownloadSources, moves_to_fastest_source_once_all_were_tried) {
+  const char *mirrors[] = {"https://mirror1/package", "https://mirror2/package"};
+  download_sources_t sources;
+  ASSERT_EQ(0, download_sources_init(&sources, "https://fakeserver/package", "fakeToken", mirrors, 2));
+
+  EXPECT_EQ(0, download_sources_record(&sources, 100, 1000, false, 0));
+  EXPECT_EQ(0, download_sources_record(&sources, 100000, 1000, false, 0));
+  EXPECT_EQ(0, download_sources_record(&sources, 1000, 1000, false, 0));
+  EXPECT_EQ(1, sources.current);
+  EXPECT_EQ(0, download_sources_record(&sources, 500, 1000, true, 0));
+  EXPECT_EQ(1, sources.current);
+  download_sources_free(&sources);
+}
+
+TEST(GausDownloadSources, stays_with_only_source) {
+  download_sources_t sources;
+  ASSERT_EQ(0, download_sources_init(&sources, "https://fakeserver/package", "fakeToken", nullptr, 0));
+
+  EXPECT_EQ(0, download_sources_record(&sources, 10, 1000, false, 503));
+  EXPECT_EQ(0, sources.current);
+  EXPECT_EQ(-1, download_sources_record(&sources, 0, 10, false, 404));
+  download_sources_free(&sources);
+}
+
+TEST(GausDownloadSources, drops_sources_answering_with_client_errors) {
+  const char *mirrors[] = {"https://mirror1/package"};
+  download_sources_t sources;
+  ASSERT_EQ(0, download_sources_init(&sources, "https://fakeserver/package", "fakeToken", mirrors, 1));
+
+  EXPECT_EQ(0, download_sources_record(&sources, 0, 10, false, 404));
+  EXPECT_EQ(1, sources.current);
+  EXPECT_EQ(-1, download_sources_record(&sources, 0, 10, false, 403));
+  download_sources_free(&sources);
+}
+
+static std::string fakeMissingUrl;
+
+//Answer 404 for fakeMissingUrl, and serve the package from any other URL.
+static CURLcode mock_curl_easy_perform_with_missing_url(CURL *curl) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  if (allCurlData[curl].setOptions.CURLOPT_URL == fakeMissingUrl) {
+    return mock_curl_easy_perform_with_http_error(curl);
+  }
+  return mock_curl_easy_perform_with_range(curl);
+}
+
+static CURLcode mock_curl_easy_getinfo_with_missing_url(CURL *curl, CURLINFO info, ...) {
+  std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+  va_list valist;
+  va_start(valist, info);
+  void *argument = va_arg(valist, void *);
+  va_end(valist);
+  if (info == CURLINFO_RESPONSE_CODE && allCurlData[curl].setOptions.CURLOPT_URL == fakeMissingUrl) {
+    *static_cast<long *>(argument) = 404;
+    return CURLE_OK;
+  }
+  return mock_curl_easy_getinfo(curl, info, argument);
+}
+
+class GausDownloadMirroredUpdate : public GausDownloadUpdate {
+protected:
+  const char *mirrors[2] = {"https://mirror1/package", "https://mirror2/package"};
+  gaus_download_options_t options = {};
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    options.mirror_urls = mirrors;
+    options.mirror_count = 2;
+    gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  }
+
+  virtual
+
+  void TearDown() {
+    fakeBreakAfter = -1;
+    fakeBreakCount = 0;
+    gaus_curl_easy_getinfo = mock_curl_easy_getinfo;
+    GausDownloadUpdate::TearDown();
+  }
+};
+
+TEST_F(GausDownloadMirroredUpdate, stays_with_download_url_while_it_completes) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(fakeUpdate.download_url, curlPerformData[0].CURLOPT_URL);
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+TEST_F(GausDownloadMirroredUpdate, resumes_broken_transfer_from_mirror) {
+  gaus_global_init("fakeServer", NULL);
+  fakeBreakAfter = 10;
+  fakeBreakCount = 1;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ(fakeUpdate.download_url, curlPerformData[0].CURLOPT_URL);
+  EXPECT_EQ("https://mirror1/package", curlPerformData[1].CURLOPT_URL);
+  EXPECT_EQ(10, curlPerformData[1].CURLOPT_RESUME_FROM_LARGE);
+  for (const std::string &header : curlPerformData[1].CURLOPT_HEADER) {
+    EXPECT_EQ(std::string::npos, header.find("Authorization"));
+  }
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+TEST_F(GausDownloadMirroredUpdate, skips_source_answering_with_client_error) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_missing_url;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_missing_url;
+  fakeMissingUrl = fakeUpdate.download_url;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_EQ("https://mirror1/package", curlPerformData[1].CURLOPT_URL);
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+TEST_F(GausDownloadMirroredUpdate, fails_when_every_source_answers_with_client_error) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_http_error;
+  gaus_curl_easy_getinfo = mock_curl_easy_getinfo_with_http_error;
+  fakeResponseCode = 404;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_HTTP_ERROR, status->error_type);
+  EXPECT_EQ(404, status->http_error_code);
+  EXPECT_EQ(3, curlPerformData.size());
+  freeError(status);
+}
+
+TEST_F(GausDownloadMirroredUpdate, aborts_transfers_below_speed_floor) {
+  gaus_global_init("fakeServer", NULL);
+  options.min_speed = 65536;
+  options.min_speed_time = 5;
+
+  gaus_error_t *status = gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(), &options);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(65536, curlPerformData[0].CURLOPT_LOW_SPEED_LIMIT);
+  EXPECT_EQ(5, curlPerformData[0].CURLOPT_LOW_SPEED_TIME);
+}
+
+TEST(GausBandwidth, background_transfers_make_way_for_others) {
+  int background = 0;
+  int bulk = 0;
+  CURL *backgroundCurl = reinterpret_cast<CURL *>(&background);
+  CURL *bulkCurl = reinterpret_cast<CURL *>(&bulk);
+  setupMocks();
+  resetCurlMockHistory();
+  bandwidth_set_background(1000);
+
+  bandwidth_transfer_t *backgroundTransfer = bandwidth_attach(backgroundCurl, BANDWIDTH_BACKGROUND);
+  CurlOptionsData &options = allCurlData[backgroundCurl].setOptions;
+  EXPECT_EQ(1000, options.CURLOPT_MAX_RECV_SPEED_LARGE);
+  bandwidth_transfer_t *bulkTransfer = bandwidth_attach(bulkCurl, BANDWIDTH_BULK);
+  //Counted to slow down the prefetch, but not limited itself
+  ASSERT_NE(nullptr, bulkTransfer);
+  EXPECT_EQ(0, allCurlData[bulkCurl].setOptions.CURLOPT_MAX_RECV_SPEED_LARGE);
+  options.CURLOPT_XFERINFOFUNCTION(options.CURLOPT_XFERINFODATA, 0, 0, 0, 0);
+  EXPECT_EQ(BANDWIDTH_BACKGROUND_TRICKLE, options.CURLOPT_MAX_RECV_SPEED_LARGE);
+  bandwidth_detach(bulkTransfer);
+  options.CURLOPT_XFERINFOFUNCTION(options.CURLOPT_XFERINFODATA, 0, 0, 0, 0);
+  EXPECT_EQ(1000, options.CURLOPT_MAX_RECV_SPEED_LARGE);
+
+  bandwidth_detach(backgroundTransfer);
+  bandwidth_set_background(0);
+  cleanupMocks();
+}
+
+TEST(GausBandwidth, background_transfers_make_way_for_transfers_started_before_them) {
+  int background = 0;
+  int bulk = 0;
+  CURL *backgroundCurl = reinterpret_cast<CURL *>(&background);
+  CURL *bulkCurl = reinterpret_cast<CURL *>(&bulk);
+  setupMocks();
+  resetCurlMockHistory();
+  bandwidth_set_background(1000);
+
+  bandwidth_transfer_t *bulkTransfer = bandwidth_attach(bulkCurl, BANDWIDTH_BULK);
+  ASSERT_NE(nullptr, bulkTransfer);
+  EXPECT_EQ(0, allCurlData[bulkCurl].setOptions.CURLOPT_MAX_RECV_SPEED_LARGE);
+  bandwidth_transfer_t *backgroundTransfer = bandwidth_attach(backgroundCurl, BANDWIDTH_BACKGROUND);
+  CurlOptionsData &options = allCurlData[backgroundCurl].setOptions;
+  EXPECT_EQ(BANDWIDTH_BACKGROUND_TRICKLE, options.CURLOPT_MAX_RECV_SPEED_LARGE);
+  bandwidth_detach(bulkTransfer);
+  options.CURLOPT_XFERINFOFUNCTION(options.CURLOPT_XFERINFODATA, 0, 0, 0, 0);
+  EXPECT_EQ(1000, options.CURLOPT_MAX_RECV_SPEED_LARGE);
+
+  bandwidth_detach(backgroundTransfer);
+  bandwidth_set_background(0);
+  cleanupMocks();
+}
+
+//Set once the test stops the prefetch, the fake server then sends the rest slowly until the download gives up.
+static std::atomic<bool> fakeStopRequested(false);
+static std::atomic<bool> fakeTransferStarted(false);
+
+static CURLcode mock_curl_easy_perform_until_stopped(CURL *curl) {
+  CurlOptionsData options;
+  {
+    std::lock_guard<std::recursive_mutex> guard(curlMockLock);
+    options = allCurlData[curl].setOptions;
+    curlPerformData.push_back(options);
+    curlPerformHandles.push_back(curl);
+  }
+  size_t offset = 10;
+  if ((*options.CURLOPT_WRITEFUNCTION)(fakeResponse, sizeof(char), offset, options.CURLOPT_WRITEDATA) != offset) {
+    return CURLE_WRITE_ERROR;
+  }
+  fakeTransferStarted = true;
+  while (offset < fakeResponseSize()) {
+    if (!fakeStopRequested) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    if ((*options.CURLOPT_WRITEFUNCTION)(fakeResponse + offset, sizeof(char), 1, options.CURLOPT_WRITEDATA) != 1) {
+      return CURLE_WRITE_ERROR;
+    }
+    offset++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return CURLE_OK;
+}
+
+class GausPrefetchUpdate : public GausDownloadUpdate {
+protected:
+  std::string storePath;
+  std::string storedPackage;
+  gaus_prefetcher_t *prefetcher = nullptr;
+  gaus_prefetch_options_t prefetchOptions = {};
+  std::mutex lock;
+  std::condition_variable finished;
+  std::vector<gaus_error_t *> results;
+
+  virtual void SetUp() {
+    GausDownloadUpdate::SetUp();
+    storePath = ::testing::TempDir() + "gaus_download_update_test.store";
+    removeTree(storePath);
+    mkdir(storePath.c_str(), 0755);
+    storedPackage = storePath + "/e9b1713db620f1e3a14b6812de523f4b";
+    prefetchOptions.store_path = storePath.c_str();
+    gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+    fakeStopRequested = false;
+    fakeTransferStarted = false;
+  }
+
+  virtual
+
+  void TearDown() {
+    gaus_prefetch_stop(prefetcher);
+    for (gaus_error_t *status : results) {
+      if (status) {
+        freeError(status);
+      }
+    }
+    removeTree(storePath);
+    GausDownloadUpdate::TearDown();
+  }
+
+  static void prefetched(gaus_error_t *error, void *user_data) {
+    GausPrefetchUpdate *test = static_cast<GausPrefetchUpdate *>(user_data);
+    std::lock_guard<std::mutex> guard(test->lock);
+    test->results.push_back(error);
+    test->finished.notify_all();
+  }
+
+  void waitForResults(size_t count) {
+    std::unique_lock<std::mutex> guard(lock);
+    ASSERT_TRUE(finished.wait_for(guard, std::chrono::seconds(10), [&] { return results.size() >= count; }));
+  }
+};
+
+TEST_F(GausPrefetchUpdate, fails_without_initialize) {
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_start(&prefetchOptions, &prefetcher));
+
+  gaus_error_t *status = gaus_prefetch_update(prefetcher, &fakeSession, &fakeUpdate, prefetched, this);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_NO_INIT_ERROR, status->error_type);
+  freeError(status);
+}
+
+TEST_F(GausPrefetchUpdate, allows_one_worker_at_a_time) {
+  gaus_prefetcher_t *second = nullptr;
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_start(&prefetchOptions, &prefetcher));
+
+  gaus_error_t *status = gaus_prefetch_start(&prefetchOptions, &second);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(nullptr, second);
+  freeError(status);
+}
+
+TEST_F(GausPrefetchUpdate, prefetches_package_into_store) {
+  gaus_global_init("fakeServer", NULL);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_start(&prefetchOptions, &prefetcher));
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_update(prefetcher, &fakeSession, &fakeUpdate,
+                                                                    prefetched, this));
+  waitForResults(1);
+
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), results[0]);
+  ASSERT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(fakeUpdate.download_url, curlPerformData[0].CURLOPT_URL);
+  EXPECT_EQ(fakePackage, readFile(storedPackage));
+  EXPECT_FALSE(fileExists(storedPackage + ".prefetch"));
+
+  //The install then starts without downloading
+  gaus_download_options_t options = {};
+  options.artifact_cache_path = storePath.c_str();
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_download_update(&fakeSession, &fakeUpdate, destination.c_str(),
+                                                                    &options));
+  EXPECT_EQ(1, curlPerformData.size());
+  EXPECT_EQ(fakePackage, readFile(destination));
+}
+
+TEST_F(GausPrefetchUpdate, skips_package_already_in_store) {
+  gaus_global_init("fakeServer", NULL);
+  std::ofstream(storedPackage, std::ios::binary) << fakePackage;
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_start(&prefetchOptions, &prefetcher));
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_update(prefetcher, &fakeSession, &fakeUpdate,
+                                                                    prefetched, this));
+  waitForResults(1);
+
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), results[0]);
+  EXPECT_EQ(0, curlPerformData.size());
+}
+
+TEST_F(GausPrefetchUpdate, stop_keeps_progress_of_running_prefetch) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_curl_easy_perform = mock_curl_easy_perform_until_stopped;
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_start(&prefetchOptions, &prefetcher));
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_update(prefetcher, &fakeSession, &fakeUpdate,
+                                                                    prefetched, this));
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_update(prefetcher, &fakeSession, &fakeUpdate,
+                                                                    prefetched, this));
+  while (!fakeTransferStarted) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  fakeStopRequested = true;
+  gaus_prefetch_stop(prefetcher);
+  prefetcher = nullptr;
+
+  //The running prefetch and the queued one both report that they stopped
+  ASSERT_EQ(2, results.size());
+  EXPECT_NE(static_cast<gaus_error_t *>(NULL), results[0]);
+  EXPECT_NE(static_cast<gaus_error_t *>(NULL), results[1]);
+  EXPECT_EQ(1, curlPerformData.size());
+  EXPECT_FALSE(fileExists(storedPackage));
+  EXPECT_TRUE(fileExists(storePath + "/" + fakePackageMd5 + ".prefetch.journal"));
+
+  //Queued again it resumes after the bytes kept
+  gaus_curl_easy_perform = mock_curl_easy_perform_with_range;
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_start(&prefetchOptions, &prefetcher));
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_prefetch_update(prefetcher, &fakeSession, &fakeUpdate,
+                                                                    prefetched, this));
+  waitForResults(3);
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), results[2]);
+  ASSERT_EQ(2, curlPerformData.size());
+  EXPECT_LT(0, curlPerformData[1].CURLOPT_RESUME_FROM_LARGE);
+  EXPECT_EQ(fakePackage, readFile(storedPackage));
+}
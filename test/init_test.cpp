@@ -44,6 +44,16 @@ TEST_F(GausInit, multiple_global_initialize) {
   EXPECT_EQ(1, curlCallCounter.globalInit);
 }
 
+TEST_F(GausInit, initialize_shares_caches_between_handles) {
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), gaus_global_init("fakeServerUrl", NULL));
+  EXPECT_EQ(1, curlCallCounter.shareInit);
+  EXPECT_EQ(std::vector<long>({CURL_LOCK_DATA_DNS, CURL_LOCK_DATA_SSL_SESSION, CURL_LOCK_DATA_CONNECT}),
+            curlSharedData);
+
+  gaus_global_cleanup();
+  EXPECT_EQ(1, curlCallCounter.shareCleanup);
+}
+
 TEST_F(GausInit, multiple_global_cleanup) {
   EXPECT_EQ(static_cast<gaus_error_t *>(NULL), gaus_global_init("fakeServerUrl", NULL));
   gaus_global_cleanup();
@@ -110,3 +120,76 @@ TEST_F(GausInit, global_init_handles_ca_path_in_options) {
 
   free(status);
 }
+
+TEST_F(GausInit, global_init_handles_connection_pool_options) {
+  gaus_initialization_options_t options = {
+      .proxy = NULL,
+      .ca_path = NULL,
+      .max_connections_per_host = 2,
+      .connection_idle_timeout_seconds = 30
+  };
+  gaus_error_t *status = gaus_global_init("fakeServerUrl", &options);
+  ASSERT_EQ(NULL, status);
+
+  free(status);
+}
+
+TEST_F(GausInit, global_init_rejects_invalid_compression_options) {
+  gaus_initialization_options_t options = {};
+  options.request_compression = GAUS_COMPRESSION_GZIP;
+  options.compression_level = 10;
+  gaus_error_t *status = gaus_global_init("fakeServerUrl", &options);
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_BAD_INIT_ERROR, status->error_type);
+  EXPECT_EQ(0, curlCallCounter.globalInit);
+
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausInit, client_create_fails_without_initialize) {
+  gaus_client_t *client = NULL;
+  gaus_error_t *status = gaus_client_create("fakeServerUrl", NULL, &client);
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_NO_INIT_ERROR, status->error_type);
+  EXPECT_EQ(static_cast<gaus_client_t *>(NULL), client);
+
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausInit, client_create_rejects_invalid_compression_options) {
+  gaus_client_t *client = NULL;
+  gaus_initialization_options_t options = {};
+  options.request_compression = GAUS_COMPRESSION_GZIP;
+  options.compression_level = -1;
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), gaus_global_init("fakeServerUrl", NULL));
+  gaus_error_t *status = gaus_client_create("otherServerUrl", &options, &client);
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_BAD_INIT_ERROR, status->error_type);
+  EXPECT_EQ(static_cast<gaus_client_t *>(NULL), client);
+
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausInit, client_create_and_destroy) {
+  gaus_client_t *client = NULL;
+  gaus_client_stats_t stats;
+  gaus_initialization_options_t options = {
+      .proxy = "fakeproxy",
+      .ca_path = "fake-ca-cert-path",
+      .max_connections_per_host = 2
+  };
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), gaus_global_init("fakeServerUrl", NULL));
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_client_create("otherServerUrl", &options, &client));
+  ASSERT_NE(static_cast<gaus_client_t *>(NULL), client);
+  gaus_client_get_stats(client, &stats);
+  EXPECT_EQ(0, stats.requests);
+  //Clients share the process wide curl state.
+  EXPECT_EQ(1, curlCallCounter.globalInit);
+  EXPECT_EQ(1, curlCallCounter.shareInit);
+
+  gaus_client_destroy(client);
+  gaus_client_destroy(NULL);
+}
@@ -0,0 +1,250 @@
+//The MIT License (MIT)
+//
+//Copyright 2018, Sony Mobile Communications Inc.
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#include <gtest/gtest.h>
+#include "gaus/gaus_client.h"
+#include "curl_mock.h"
+
+//Access gaus curl wrapper
+#include "../src/libgaus/curl_wrapper.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//Records what the library asked of the host event loop.
+class FakeLoop {
+public:
+  std::vector<long> timeouts;
+  std::map<int, unsigned int> watched;
+  std::vector<gaus_error_t *> completions;
+
+  ~FakeLoop() {
+    for (gaus_error_t *error : completions) {
+      if (error) {
+        free(error->description);
+        free(error);
+      }
+    }
+  }
+};
+
+static void fakeLoopSocket(int fd, unsigned int events, void *user_data) {
+  static_cast<FakeLoop *>(user_data)->watched[fd] = events;
+}
+
+static void fakeLoopTimer(long timeout_ms, void *user_data) {
+  static_cast<FakeLoop *>(user_data)->timeouts.push_back(timeout_ms);
+}
+
+static void fakeLoopCompleted(gaus_error_t *error, void *user_data) {
+  static_cast<FakeLoop *>(user_data)->completions.push_back(error);
+}
+
+class GausLoop : public ::testing::Test {
+protected:
+  FakeLoop loop;
+  gaus_loop_options_t options = {fakeLoopSocket, fakeLoopTimer, &loop};
+  gaus_session_t session = {};
+
+  virtual void SetUp() {
+    setupMocks();
+    resetCurlMockHistory();
+    //Setup a default fake response that will work for all tests.
+    free(fakeResponse);
+    fakeResponse = strdup("{"
+                          "\"deviceGUID\": \"FAKEDEVICEGUID\","
+                          "\"productGUID\":\"FAKEPRODUCTGUID\","
+                          "\"token\": \"FAKETOKEN\""
+                          "}");
+  }
+
+  virtual void TearDown() {
+    gaus_global_cleanup();
+    cleanupMocks();
+    free(session.device_guid);
+    free(session.product_guid);
+    free(session.token);
+  }
+};
+
+TEST_F(GausLoop, fails_without_initialize) {
+  gaus_error_t *status = gaus_loop_init(&options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_NO_INIT_ERROR, status->error_type);
+  EXPECT_EQ(500, status->http_error_code);
+  EXPECT_NE(0, strlen(status->description));
+
+  //Cleanup after test
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausLoop, fails_without_callbacks) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_loop_options_t noTimer = {fakeLoopSocket, NULL, &loop};
+
+  gaus_error_t *status = gaus_loop_init(&noTimer);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+
+  //Cleanup after test
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausLoop, fails_without_loop_init) {
+  gaus_global_init("fakeServer", NULL);
+
+  gaus_error_t *status = gaus_loop_timeout();
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+
+  //Cleanup after test
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausLoop, fails_after_async_call) {
+  gaus_global_init("fakeServer", NULL);
+  gaus_error_t *status = gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &session,
+                                                 fakeLoopCompleted, &loop);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+
+  status = gaus_loop_init(&options);
+
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), status);
+  EXPECT_EQ(GAUS_UNKNOWN_ERROR, status->error_type);
+
+  //Cleanup after test
+  free(status->description);
+  free(status);
+}
+
+TEST_F(GausLoop, runs_requests_when_timer_expires) {
+  gaus_global_init("fakeServer", NULL);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_loop_init(&options));
+
+  gaus_error_t *status = gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &session,
+                                                 fakeLoopCompleted, &loop);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, loop.timeouts.size());
+  EXPECT_EQ(0, loop.timeouts[0]);
+  //Nothing happens until the host loop hands control to the library
+  EXPECT_EQ(0, curlPerformData.size());
+  EXPECT_EQ(0, loop.completions.size());
+
+  status = gaus_loop_timeout();
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, loop.completions.size());
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), loop.completions[0]);
+  EXPECT_EQ(curlPerformData[0].CURLOPT_URL, "fakeServer/authenticate");
+  EXPECT_STREQ("FAKETOKEN", session.token);
+}
+
+TEST_F(GausLoop, passes_socket_activity_to_curl) {
+  gaus_global_init("fakeServer", NULL);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_loop_init(&options));
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL),
+            gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &session, fakeLoopCompleted, &loop));
+
+  gaus_error_t *status = gaus_loop_socket_action(42, GAUS_LOOP_POLL_IN);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(1, loop.completions.size());
+  EXPECT_EQ(static_cast<gaus_error_t *>(NULL), loop.completions[0]);
+  ASSERT_EQ(1, allCurlMultiData.size());
+  EXPECT_EQ(std::vector<curl_socket_t>{42}, allCurlMultiData.begin()->second.socketActions);
+}
+
+TEST_F(GausLoop, cleanup_aborts_outstanding_calls) {
+  gaus_global_init("fakeServer", NULL);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_loop_init(&options));
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL),
+            gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &session, fakeLoopCompleted, &loop));
+
+  gaus_global_cleanup();
+
+  ASSERT_EQ(1, loop.completions.size());
+  ASSERT_NE(static_cast<gaus_error_t *>(NULL), loop.completions[0]);
+  EXPECT_EQ(0, curlPerformData.size());
+}
+
+//Set if the multi handle was used by two threads at once, which libcurl does not allow.
+static std::atomic<int> multiUsers(0);
+static std::atomic<bool> multiUsedConcurrently(false);
+
+static void enterMulti() {
+  if (multiUsers++ > 0) {
+    multiUsedConcurrently = true;
+  }
+  //Widen the window a concurrent use would fall into.
+  std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+static CURLMcode exclusive_curl_multi_add_handle(CURLM *multi, CURL *curl) {
+  enterMulti();
+  CURLMcode result = mock_curl_multi_add_handle(multi, curl);
+  multiUsers--;
+  return result;
+}
+
+static CURLMcode exclusive_curl_multi_socket_action(CURLM *multi, curl_socket_t s, int ev_bitmask,
+                                                    int *running_handles) {
+  enterMulti();
+  CURLMcode result = mock_curl_multi_socket_action(multi, s, ev_bitmask, running_handles);
+  multiUsers--;
+  return result;
+}
+
+TEST_F(GausLoop, accepts_calls_from_other_threads_while_running) {
+  const size_t callCount = 20;
+  std::vector<gaus_session_t> sessions(callCount);
+  multiUsedConcurrently = false;
+  gaus_curl_multi_add_handle = exclusive_curl_multi_add_handle;
+  gaus_curl_multi_socket_action = exclusive_curl_multi_socket_action;
+  gaus_global_init("fakeServer", NULL);
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), gaus_loop_init(&options));
+
+  std::thread caller([&]() {
+    for (gaus_session_t &callSession : sessions) {
+      callSession = {};
+      EXPECT_EQ(static_cast<gaus_error_t *>(NULL),
+                gaus_authenticate_async("fakeDeviceAccess", "fakeDeviceSecret", &callSession, fakeLoopCompleted,
+                                        &loop));
+    }
+  });
+  //The host loop keeps driving the library while the other thread queues calls.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (loop.completions.size() < callCount && std::chrono::steady_clock::now() < deadline) {
+    gaus_error_t *status = gaus_loop_timeout();
+    EXPECT_EQ(static_cast<gaus_error_t *>(NULL), status);
+    if (status) {
+      free(status->description);
+      free(status);
+      break;
+    }
+  }
+  caller.join();
+
+  EXPECT_FALSE(multiUsedConcurrently);
+  ASSERT_EQ(callCount, loop.completions.size());
+  for (size_t i = 0; i < callCount; i++) {
+    EXPECT_EQ(static_cast<gaus_error_t *>(NULL), loop.completions[i]);
+    EXPECT_STREQ("FAKETOKEN", sessions[i].token);
+    free(sessions[i].device_guid);
+    free(sessions[i].product_guid);
+    free(sessions[i].token);
+  }
+}
@@ -15,6 +15,7 @@
 #include "../src/libgaus/curl_wrapper.h"
 
 #include <cstdarg>
+#include <zlib.h>
 
 #include <map>
 #include <iostream>
@@ -728,6 +729,110 @@ TEST_F(GausReport, posts_correct_json_for_update_report) {
 }
 
 
+//Inflate a gzip or zlib wrapped body
+static std::string decompress(const std::string &compressed) {
+  z_stream stream = {};
+  std::string result;
+  char buffer[4096];
+  inflateInit2(&stream, 15 + 32);
+  stream.next_in = (Bytef *) compressed.data();
+  stream.avail_in = compressed.size();
+  int status;
+  do {
+    stream.next_out = (Bytef *) buffer;
+    stream.avail_out = sizeof(buffer);
+    status = inflate(&stream, Z_NO_FLUSH);
+    result.append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (status == Z_OK);
+  inflateEnd(&stream);
+  return status == Z_STREAM_END ? result : "";
+}
+
+TEST_F(GausReport, posts_uncompressed_json_by_default) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  gaus_report_header_t header = {
+      strdup("FAKE_TIMESTAMP")
+  };
+  gaus_report_t report[1] = {};
+  report[0].report_type = GAUS_REPORT_GENERIC;
+  report[0].report.generic.type = strdup("metrics");
+  report[0].report.generic.ts = strdup("FAKE_TIME");
+  gaus_global_init("fakeServerUrl", NULL);
+
+  gaus_error_t *status = gaus_report(&fakeSession, 0, NULL, &header, 1, report);
+
+  ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+  ASSERT_EQ(curlPerformData.size(), 1);
+  EXPECT_NE(std::string::npos, curlPerformData[0].CURLOPT_POSTFIELDS.find("\"header\":{"));
+  EXPECT_EQ(curlPerformData[0].CURLOPT_POSTFIELDS.size(), curlPerformData[0].CURLOPT_POSTFIELDSIZE);
+  for (std::string &headerLine : curlPerformData[0].CURLOPT_HEADER) {
+    EXPECT_EQ(std::string::npos, headerLine.find("Content-Encoding"));
+  }
+  //Responses are always accepted compressed
+  EXPECT_EQ(std::string(""), curlPerformData[0].CURLOPT_ACCEPT_ENCODING);
+
+  //Cleanup after test
+  freeReports(1, report);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+  free(header.ts);
+}
+
+TEST_F(GausReport, posts_compressed_json_when_enabled) {
+  gaus_session_t fakeSession = {
+      strdup("fakeDeviceGUID"),
+      strdup("fakeProductGUID"),
+      strdup("fakeToken")
+  };
+  gaus_report_header_t header = {
+      strdup("FAKE_TIMESTAMP")
+  };
+  gaus_report_t report[1] = {};
+  report[0].report_type = GAUS_REPORT_GENERIC;
+  report[0].report.generic.type = strdup("metrics");
+  report[0].report.generic.ts = strdup("FAKE_TIME");
+  const struct {
+    gaus_compression_t codec;
+    std::string header;
+  } codecs[] = {
+      {GAUS_COMPRESSION_GZIP, "Content-Encoding: gzip"},
+      {GAUS_COMPRESSION_DEFLATE, "Content-Encoding: deflate"}
+  };
+
+  for (auto &codec : codecs) {
+    gaus_initialization_options_t options = {};
+    options.request_compression = codec.codec;
+    options.compression_level = 9;
+    resetCurlMockHistory();
+    gaus_global_init("fakeServerUrl", &options);
+
+    gaus_error_t *status = gaus_report(&fakeSession, 0, NULL, &header, 1, report);
+
+    ASSERT_EQ(static_cast<gaus_error_t *>(NULL), status);
+    ASSERT_EQ(curlPerformData.size(), 1);
+    EXPECT_NE(curlPerformData[0].CURLOPT_HEADER.end(),
+              std::find(curlPerformData[0].CURLOPT_HEADER.begin(), curlPerformData[0].CURLOPT_HEADER.end(),
+                        codec.header));
+    EXPECT_EQ(curlPerformData[0].CURLOPT_POSTFIELDS.size(), curlPerformData[0].CURLOPT_POSTFIELDSIZE);
+    std::string body = decompress(curlPerformData[0].CURLOPT_POSTFIELDS);
+    EXPECT_NE(std::string::npos, body.find("\"ts\":\"FAKE_TIMESTAMP\""));
+    EXPECT_NE(std::string::npos, body.find("\"type\":\"event.generic.metrics\""));
+    gaus_global_cleanup();
+  }
+
+  //Cleanup after test
+  freeReports(1, report);
+  free(fakeSession.device_guid);
+  free(fakeSession.product_guid);
+  free(fakeSession.token);
+  free(header.ts);
+}
+
 TEST_F(GausReport, posts_correct_json_for_two_update_report) {
   std::string serverUrl = "fakeServerUrl";
   gaus_session_t fakeSession = {